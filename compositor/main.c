@@ -196,30 +196,26 @@ weston_log_file_close(void)
 	weston_logfile = stderr;
 }
 
+/* The message is passed on unformatted, so that subscribers deferring the
+ * formatting, like the deferred flight recorder, get to do so. The timestamp
+ * goes along as its prefix, so that each line is a single message. */
 static int
 vlog(const char *fmt, va_list ap)
 {
-	const char *oom = "Out of memory";
 	char timestr[128];
-	int len = 0;
-	char *str;
-
-	if (weston_log_scope_is_enabled(log_scope)) {
-		int len_va;
-		char *log_timestamp = weston_log_timestamp(timestr,
-							   sizeof(timestr));
-		len_va = vasprintf(&str, fmt, ap);
-		if (len_va >= 0) {
-			len = weston_log_scope_printf(log_scope, "%s %s",
-						      log_timestamp, str);
-			free(str);
-		} else {
-			len = weston_log_scope_printf(log_scope, "%s %s",
-						      log_timestamp, oom);
-		}
-	}
+	int saved_errno = errno;
+	size_t len;
 
-	return len;
+	if (!weston_log_scope_is_enabled(log_scope))
+		return 0;
+
+	weston_log_timestamp(timestr, sizeof(timestr) - 1);
+	len = strlen(timestr);
+	timestr[len] = ' ';
+	timestr[len + 1] = '\0';
+	errno = saved_errno;
+
+	return weston_log_scope_vprintf_prefixed(log_scope, timestr, fmt, ap);
 }
 
 static int
@@ -661,6 +657,11 @@ usage(int error_code)
 		"  -f, --flight-rec-scopes=SCOPE\n\t\t\tSpecify log scopes to "
 			"subscribe to.\n\t\t\tCan specify multiple scopes, "
 			"each followed by comma\n"
+		"  --flight-rec-deferred\n\t\t\tStore messages unformatted in the flight "
+			"recorder\n\t\t\tand format them only when it is displayed\n"
+		"  --trace=FILE\t\tWrite timeline points to FILE as Chrome\n"
+			"\t\t\ttrace-event JSON (chrome://tracing, Perfetto)\n"
+		"  --trace-renderer\tInclude renderer (GPU) phases in the trace\n"
 		"  -h, --help\t\tThis help message\n\n");
 
 #if defined(BUILD_DRM_COMPOSITOR)
@@ -691,6 +692,9 @@ usage(int error_code)
 		"\tnormal 90 180 270 flipped flipped-90 flipped-180 flipped-270\n"
 		"  --use-pixman\t\tUse the pixman (CPU) renderer (default: no rendering)\n"
 		"  --use-gl\t\tUse the GL renderer (default: no rendering)\n"
+		"  --unthrottled\t\tRepaint as fast as possible, for benchmarking\n"
+		"  --frame-export=PATH\tShare pixman output frames on the unix socket\n"
+		"\t\t\tPATH-<output name>\n"
 		"  --no-outputs\t\tDo not create any virtual outputs\n"
 		"\n");
 #endif
@@ -1065,6 +1069,8 @@ weston_compositor_init_config(struct weston_compositor *ec,
 				      &ec->kb_repeat_rate, 40);
 	weston_config_section_get_int(s, "repeat-delay",
 				      &ec->kb_repeat_delay, 400);
+	weston_config_section_get_bool(s, "repeat-in-compositor",
+				       &ec->kb_repeat_in_compositor, false);
 
 	weston_config_section_get_bool(s, "vt-switching",
 				       &ec->vt_switching, true);
@@ -1084,6 +1090,14 @@ weston_compositor_init_config(struct weston_compositor *ec,
 
 	/* weston.ini [libinput] */
 	s = weston_config_get_section(config, "libinput", NULL, NULL);
+	weston_config_section_get_bool(s, "coalesce-motion",
+				       &ec->coalesce_pointer_motion, false);
+	weston_config_section_get_bool(s, "input-thread",
+				       &ec->input_thread, false);
+	weston_config_section_get_bool(s, "touch-resample",
+				       &ec->touch_resample, false);
+	weston_config_section_get_uint(s, "touch-predict-ms",
+				       &ec->touch_predict_msec, 0);
 	weston_config_section_get_bool(s, "touchscreen_calibrator", &cal, 0);
 	if (cal)
 		weston_compositor_enable_touch_calibrator(ec,
@@ -2554,6 +2568,7 @@ load_headless_backend(struct weston_compositor *c,
 	bool no_outputs;
 	int ret = 0;
 	char *transform = NULL;
+	char *frame_export = NULL;
 
 	struct wet_output_config *parsed_options = wet_init_parsed_options(c);
 	if (!parsed_options)
@@ -2570,6 +2585,8 @@ load_headless_backend(struct weston_compositor *c,
 		{ WESTON_OPTION_INTEGER, "height", 0, &parsed_options->height },
 		{ WESTON_OPTION_BOOLEAN, "use-pixman", 0, &config.use_pixman },
 		{ WESTON_OPTION_BOOLEAN, "use-gl", 0, &config.use_gl },
+		{ WESTON_OPTION_BOOLEAN, "unthrottled", 0, &config.unthrottled },
+		{ WESTON_OPTION_STRING, "frame-export", 0, &frame_export },
 		{ WESTON_OPTION_STRING, "transform", 0, &transform },
 		{ WESTON_OPTION_BOOLEAN, "no-outputs", 0, &no_outputs },
 	};
@@ -2586,6 +2603,7 @@ load_headless_backend(struct weston_compositor *c,
 
 	config.base.struct_version = WESTON_HEADLESS_BACKEND_CONFIG_VERSION;
 	config.base.struct_size = sizeof(struct weston_headless_backend_config);
+	config.frame_export_path = frame_export;
 
 	wet_set_simple_head_configurator(c, headless_backend_output_configure);
 
@@ -2593,6 +2611,8 @@ load_headless_backend(struct weston_compositor *c,
 	ret = weston_compositor_load_backend(c, WESTON_BACKEND_HEADLESS,
 					     &config.base);
 
+	free(frame_export);
+
 	if (ret < 0)
 		return ret;
 
@@ -3096,6 +3116,10 @@ wet_main(int argc, char *argv[])
 	char *log = NULL;
 	char *log_scopes = NULL;
 	char *flight_rec_scopes = NULL;
+	bool flight_rec_deferred = false;
+	char *trace_file = NULL;
+	bool trace_renderer = false;
+	FILE *trace_fp = NULL;
 	char *server_socket = NULL;
 	int32_t idle_time = -1;
 	int32_t help = 0;
@@ -3114,6 +3138,7 @@ wet_main(int argc, char *argv[])
 	struct weston_log_context *log_ctx = NULL;
 	struct weston_log_subscriber *logger = NULL;
 	struct weston_log_subscriber *flight_rec = NULL;
+	struct weston_log_subscriber *trace = NULL;
 	sigset_t mask;
 
 	bool wait_for_debugger = false;
@@ -3137,6 +3162,9 @@ wet_main(int argc, char *argv[])
 		{ WESTON_OPTION_BOOLEAN, "debug", 0, &debug_protocol },
 		{ WESTON_OPTION_STRING, "logger-scopes", 'l', &log_scopes },
 		{ WESTON_OPTION_STRING, "flight-rec-scopes", 'f', &flight_rec_scopes },
+		{ WESTON_OPTION_BOOLEAN, "flight-rec-deferred", 0, &flight_rec_deferred },
+		{ WESTON_OPTION_STRING, "trace", 0, &trace_file },
+		{ WESTON_OPTION_BOOLEAN, "trace-renderer", 0, &trace_renderer },
 	};
 
 	wl_list_init(&wet.layoutput_list);
@@ -3171,11 +3199,34 @@ wet_main(int argc, char *argv[])
 	weston_log_set_handler(vlog, vlog_continue);
 
 	logger = weston_log_subscriber_create_log(weston_logfile);
-	flight_rec = weston_log_subscriber_create_flight_rec(DEFAULT_FLIGHT_REC_SIZE);
+	if (flight_rec_deferred)
+		flight_rec = weston_log_subscriber_create_flight_rec_deferred(DEFAULT_FLIGHT_REC_SIZE);
+	else
+		flight_rec = weston_log_subscriber_create_flight_rec(DEFAULT_FLIGHT_REC_SIZE);
 
 	weston_log_subscribe_to_scopes(log_ctx, logger, flight_rec,
 				       log_scopes, flight_rec_scopes);
 
+	if (trace_file) {
+		trace_fp = fopen(trace_file, "w");
+		if (!trace_fp) {
+			fprintf(stderr, "Failed to open trace file '%s': %s\n",
+				trace_file, strerror(errno));
+		} else {
+			trace = weston_log_subscriber_create_trace(trace_fp,
+								   trace_renderer);
+			if (!trace) {
+				fprintf(stderr, "Failed to create the trace "
+					"subscriber for '%s'\n", trace_file);
+				fclose(trace_fp);
+				trace_fp = NULL;
+			}
+		}
+
+		if (trace)
+			weston_log_subscribe(log_ctx, trace, "timeline-binary");
+	}
+
 	weston_log("%s\n"
 		   STAMP_SPACE "%s\n"
 		   STAMP_SPACE "Bug reports to: %s\n"
@@ -3388,6 +3439,10 @@ out:
 	weston_compositor_destroy(wet.compositor);
 	weston_log_subscriber_destroy_log(logger);
 	weston_log_subscriber_destroy_flight_rec(flight_rec);
+	if (trace)
+		weston_log_subscriber_destroy_trace(trace);
+	if (trace_fp)
+		fclose(trace_fp);
 
 out_signals:
 	for (i = ARRAY_LENGTH(signals) - 1; i >= 0; i--)
@@ -3407,6 +3462,7 @@ out_display:
 	free(socket_name);
 	free(option_modules);
 	free(log);
+	free(trace_file);
 	free(modules);
 
 	return ret;
@@ -29,12 +29,23 @@
 #include <signal.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/socket.h>
+#include <sys/wait.h>
 
 #include <libweston/libweston.h>
 #include "compositor/weston.h"
 #include <libweston/xwayland-api.h>
 #include "shared/helpers.h"
+#include "shared/timespec-util.h"
+
+/* Restarts after a crash back off from this delay, doubling per crash */
+#define WARM_START_BACKOFF_MS 1000
+#define WARM_START_BACKOFF_MAX_MS 60000
+/* Warm start is given up after this many crashes in a row */
+#define WARM_START_MAX_CRASHES 5
+/* A server that ran this long resets the crash count */
+#define WARM_START_STABLE_MS 30000
 
 struct wet_xwayland {
 	struct weston_compositor *compositor;
@@ -44,8 +55,68 @@ struct wet_xwayland {
 	struct wl_client *client;
 	int wm_fd;
 	struct weston_process process;
+
+	/* Warm start: spawn Xwayland ahead of the first X client */
+	bool warm_start;
+	int32_t warm_start_delay; /* ms */
+	struct wl_event_source *warm_start_timer;
+	int warm_start_crashes;
+	struct timespec spawn_time;
 };
 
+static int
+warm_start_handler(void *data)
+{
+	struct wet_xwayland *wxw = data;
+
+	wxw->api->spawn(wxw->xwayland);
+
+	return 0;
+}
+
+static void
+schedule_warm_start(struct wet_xwayland *wxw)
+{
+	int64_t delay = wxw->warm_start_delay;
+	int i;
+
+	if (wxw->warm_start_crashes > 0) {
+		delay = MAX(delay, WARM_START_BACKOFF_MS);
+		for (i = 1; i < wxw->warm_start_crashes; i++)
+			delay *= 2;
+		delay = MIN(delay, WARM_START_BACKOFF_MAX_MS);
+	}
+
+	/* A zero timeout would disarm the timer */
+	wl_event_source_timer_update(wxw->warm_start_timer, MAX(delay, 1));
+}
+
+/* Counts a crash of the X server, or resets the count after a clean exit
+ * or a long enough run. Returns false once warm start should give up. */
+static bool
+warm_start_account_exit(struct wet_xwayland *wxw, int status)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (timespec_sub_to_msec(&now, &wxw->spawn_time) >= WARM_START_STABLE_MS)
+		wxw->warm_start_crashes = 0;
+
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+		wxw->warm_start_crashes = 0;
+		return true;
+	}
+
+	wxw->warm_start_crashes++;
+	if (wxw->warm_start_crashes < WARM_START_MAX_CRASHES)
+		return true;
+
+	weston_log("Xwayland crashed %d times in a row, "
+		   "disabling warm start\n", wxw->warm_start_crashes);
+
+	return false;
+}
+
 static int
 handle_sigusr1(int signal_number, void *data)
 {
@@ -146,6 +217,7 @@ spawn_xserver(void *user_data, const char *display, int abstract_fd, int unix_fd
 
 		wxw->process.pid = pid;
 		weston_watch_process(&wxw->process);
+		clock_gettime(CLOCK_MONOTONIC, &wxw->spawn_time);
 		break;
 
 	case -1:
@@ -168,6 +240,22 @@ xserver_cleanup(struct weston_process *process, int status)
 	wxw->sigusr1_source = wl_event_loop_add_signal(loop, SIGUSR1,
                                                        handle_sigusr1, wxw);
 	wxw->client = NULL;
+
+	if (!wxw->warm_start)
+		return;
+
+	if (!warm_start_account_exit(wxw, status)) {
+		wxw->warm_start = false;
+		wl_event_source_remove(wxw->warm_start_timer);
+		wxw->warm_start_timer = NULL;
+		return;
+	}
+
+	/* Bring the server back before the next X client asks for it,
+	 * backing off while it keeps crashing. If it died during its
+	 * initialization, the module has stopped listening and spawn()
+	 * does nothing. */
+	schedule_warm_start(wxw);
 }
 
 int
@@ -177,6 +265,7 @@ wet_load_xwayland(struct weston_compositor *comp)
 	struct weston_xwayland *xwayland;
 	struct wet_xwayland *wxw;
 	struct wl_event_loop *loop;
+	struct weston_config_section *section;
 
 	if (weston_compositor_load_xwayland(comp) < 0)
 		return -1;
@@ -208,5 +297,20 @@ wet_load_xwayland(struct weston_compositor *comp)
 	wxw->sigusr1_source = wl_event_loop_add_signal(loop, SIGUSR1,
 						       handle_sigusr1, wxw);
 
+	section = weston_config_get_section(wet_get_config(comp),
+					    "xwayland", NULL, NULL);
+	weston_config_section_get_bool(section, "warm-start",
+				       &wxw->warm_start, false);
+	weston_config_section_get_int(section, "warm-start-delay",
+				      &wxw->warm_start_delay, 0);
+
+	if (wxw->warm_start) {
+		wxw->warm_start_timer =
+			wl_event_loop_add_timer(loop, warm_start_handler, wxw);
+		if (!wxw->warm_start_timer)
+			return -1;
+		schedule_warm_start(wxw);
+	}
+
 	return 0;
 }
@@ -1379,12 +1379,20 @@ touch_move_grab_motion(struct weston_touch_grab *grab,
 	struct weston_touch_move_grab *move = (struct weston_touch_move_grab *) grab;
 	struct shell_surface *shsurf = move->base.shsurf;
 	struct weston_surface *es;
-	int dx = wl_fixed_to_int(grab->touch->grab_x + move->dx);
-	int dy = wl_fixed_to_int(grab->touch->grab_y + move->dy);
+	wl_fixed_t gx = grab->touch->grab_x;
+	wl_fixed_t gy = grab->touch->grab_y;
+	int dx, dy;
 
 	if (!shsurf || !move->active)
 		return;
 
+	/* Keep the window under the finger rather than where it was */
+	weston_touch_get_predicted_position(grab->touch,
+					    grab->touch->grab_touch_id,
+					    &gx, &gy);
+	dx = wl_fixed_to_int(gx + move->dx);
+	dy = wl_fixed_to_int(gy + move->dy);
+
 	es = weston_desktop_surface_get_surface(shsurf->desktop_surface);
 
 	weston_view_set_position(shsurf->view, dx, dy);
@@ -34,7 +34,7 @@ extern "C" {
 
 #include <libweston/libweston.h>
 
-#define WESTON_HEADLESS_BACKEND_CONFIG_VERSION 2
+#define WESTON_HEADLESS_BACKEND_CONFIG_VERSION 4
 
 struct weston_headless_backend_config {
 	struct weston_backend_config base;
@@ -44,6 +44,77 @@ struct weston_headless_backend_config {
 
 	/** Whether to use the GL renderer, conflicts with use_pixman */
 	bool use_gl;
+
+	/** Finish frames as soon as rendering completes instead of
+	 * simulating a 60 Hz refresh, for benchmarking the compositor */
+	bool unthrottled;
+
+	/** If not NULL, back pixman outputs with a ring of shared memory
+	 * buffers and publish every frame on a unix socket at
+	 * "<frame_export_path>-<output name>", see
+	 * struct weston_headless_frame_export_buffers */
+	const char *frame_export_path;
+};
+
+/** Number of buffers in the frame export ring of each output */
+#define WESTON_HEADLESS_FRAME_EXPORT_BUFFERS 4
+
+/** Maximum number of damage rectangles in a frame message; if the damage
+ * is more fragmented than this, only its extents are sent */
+#define WESTON_HEADLESS_FRAME_EXPORT_MAX_RECTS 32
+
+enum weston_headless_frame_export_type {
+	WESTON_HEADLESS_FRAME_EXPORT_TYPE_BUFFERS = 1,
+	WESTON_HEADLESS_FRAME_EXPORT_TYPE_FRAME = 2,
+};
+
+/** First message sent on a SOCK_SEQPACKET frame export connection
+ *
+ * The message carries WESTON_HEADLESS_FRAME_EXPORT_BUFFERS file
+ * descriptors as SCM_RIGHTS ancillary data, one per ring buffer, each
+ * size bytes long. A buffer starts with the pixels in the given DRM
+ * format. At seq_offset it holds an aligned 64-bit sequence stamp: 0
+ * while the compositor draws into the buffer, then the seq of the frame
+ * it holds, see struct weston_headless_frame_export_frame.
+ */
+struct weston_headless_frame_export_buffers {
+	uint32_t type; /**< WESTON_HEADLESS_FRAME_EXPORT_TYPE_BUFFERS */
+	uint32_t n_buffers;
+	uint32_t format;
+	int32_t width;
+	int32_t height;
+	int32_t stride;
+	uint64_t size;
+	uint64_t seq_offset;
+};
+
+struct weston_headless_frame_export_rect {
+	int32_t x1, y1, x2, y2;
+};
+
+/** Sent after every repaint of the output
+ *
+ * The buffer at index buffer holds the complete frame. The compositor
+ * reuses it once WESTON_HEADLESS_FRAME_EXPORT_BUFFERS - 1 more frames
+ * have been drawn, without waiting for the receiver. To tell whether a
+ * copy of the pixels is intact, read the buffer's sequence stamp with
+ * acquire ordering before copying and again after copying; the copy is
+ * only good if both equal seq.
+ *
+ * The rectangles are the damage relative to the previous frame, in
+ * buffer coordinates. A message is dropped rather than delayed if the
+ * receiver does not keep up; the seq gap shows it.
+ */
+struct weston_headless_frame_export_frame {
+	uint32_t type; /**< WESTON_HEADLESS_FRAME_EXPORT_TYPE_FRAME */
+	uint32_t buffer;
+	uint64_t seq;
+	int64_t tv_sec;
+	int64_t tv_nsec;
+	uint32_t n_rects;
+	uint32_t padding;
+	struct weston_headless_frame_export_rect
+		rects[WESTON_HEADLESS_FRAME_EXPORT_MAX_RECTS];
 };
 
 #ifdef  __cplusplus
@@ -281,6 +281,14 @@ struct weston_output {
 	int destroying;
 	struct wl_list feedback_list;
 
+	/** If set, the next repaint is scheduled immediately after the
+	 *  previous frame finishes instead of following the refresh rate.
+	 *  Meant for benchmarking only. */
+	bool repaint_unthrottled;
+
+	/** Frame timing statistics, see the 'repaint-stats' log scope */
+	struct weston_output_repaint_stats *repaint_stats;
+
 	uint32_t transform;
 	int32_t native_scale;
 	int32_t current_scale;
@@ -604,6 +612,9 @@ struct weston_touch {
 	struct timespec grab_time;
 
 	struct wl_list timestamps_list;
+
+	/* Motion history, see weston_touch_get_predicted_position() */
+	struct weston_touch_resampler *resampler;
 };
 
 void
@@ -693,6 +704,10 @@ weston_touch_send_motion(struct weston_touch *touch,
 void
 weston_touch_send_frame(struct weston_touch *touch);
 
+bool
+weston_touch_get_predicted_position(struct weston_touch *touch, int touch_id,
+				    wl_fixed_t *x, wl_fixed_t *y);
+
 
 void
 weston_seat_set_selection(struct weston_seat *seat,
@@ -756,6 +771,20 @@ struct weston_keyboard {
 	struct xkb_keymap *pending_keymap;
 
 	struct wl_list timestamps_list;
+
+	/* Key and modifier events held back while a backend delivers a
+	 * batch of input, see weston_keyboard_begin_batch() */
+	bool batching;
+	struct wl_array batch;
+
+	/* Key repeat generated by the compositor, if enabled */
+	struct {
+		struct wl_event_source *timer;
+		uint32_t key;			/* 0 when not repeating */
+		struct timespec press_time;	/* timestamp of the press */
+		struct timespec start;		/* presentation clock */
+		uint32_t count;			/* repeats sent */
+	} repeat;
 };
 
 struct weston_seat {
@@ -1057,6 +1086,10 @@ struct weston_compositor {
 	uint32_t idle_inhibit;
 	int idle_time;			/* timeout, s */
 	struct wl_event_source *repaint_timer;
+	/* Runs the repaint on the next loop iteration, without the timer's
+	 * delay, for unthrottled outputs. */
+	struct wl_event_source *repaint_wakeup;
+	int repaint_wakeup_fd;
 
 	const struct weston_pointer_grab_interface *default_pointer_grab;
 
@@ -1083,6 +1116,10 @@ struct weston_compositor {
 	int32_t kb_repeat_rate;
 	int32_t kb_repeat_delay;
 
+	/* Whether the compositor sends the key repeats instead of clients
+	 * running repeat timers of their own. */
+	bool kb_repeat_in_compositor;
+
 	bool vt_switching;
 
 	clockid_t presentation_clock;
@@ -1100,6 +1137,20 @@ struct weston_compositor {
 	/* Whether to let the compositor run without any input device. */
 	bool require_input;
 
+	/* Whether the libinput backend merges the relative pointer motion of
+	 * one dispatch into a single motion event per device. */
+	bool coalesce_pointer_motion;
+
+	/* Whether the libinput backend reads input devices on a thread of
+	 * its own instead of on the main loop. */
+	bool input_thread;
+
+	/* Whether touch motion is delivered once per output refresh, and how
+	 * far ahead weston_touch_get_predicted_position() looks, in ms, or 0
+	 * to disable prediction. */
+	bool touch_resample;
+	uint32_t touch_predict_msec;
+
 	/* Signal for a backend to inform a frontend about possible changes
 	 * in head status.
 	 */
@@ -1115,7 +1166,13 @@ struct weston_compositor {
 
 	struct weston_log_context *weston_log_ctx;
 	struct weston_log_scope *debug_scene;
+	struct weston_log_scope *repaint_stats;
 	struct weston_log_scope *timeline;
+	struct weston_log_scope *timeline_binary;
+	struct weston_log_scope *timeline_trace;
+
+	struct weston_client_stats_context *client_stats;
+	struct weston_input_latency *input_latency;
 
 	struct content_protection *content_protection;
 };
@@ -84,6 +84,11 @@ int
 weston_log_scope_vprintf(struct weston_log_scope *scope,
 			   const char *fmt, va_list ap);
 
+int
+weston_log_scope_vprintf_prefixed(struct weston_log_scope *scope,
+				  const char *prefix,
+				  const char *fmt, va_list ap);
+
 int
 weston_log_scope_printf(struct weston_log_scope *scope,
 			  const char *fmt, ...)
@@ -116,12 +121,21 @@ weston_log_subscriber_destroy_log(struct weston_log_subscriber *sub);
 struct weston_log_subscriber *
 weston_log_subscriber_create_flight_rec(size_t size);
 
+struct weston_log_subscriber *
+weston_log_subscriber_create_flight_rec_deferred(size_t size);
+
 void
 weston_log_subscriber_destroy_flight_rec(struct weston_log_subscriber *sub);
 
 void
 weston_log_subscriber_display_flight_rec(struct weston_log_subscriber *sub);
 
+struct weston_log_subscriber *
+weston_log_subscriber_create_trace(FILE *dump_to, bool renderer_phases);
+
+void
+weston_log_subscriber_destroy_trace(struct weston_log_subscriber *sub);
+
 struct weston_log_subscription *
 weston_log_subscription_iterate(struct weston_log_scope *scope,
 				struct weston_log_subscription *sub_iter);
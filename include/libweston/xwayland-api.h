@@ -109,6 +109,19 @@ struct weston_xwayland_api {
 	 */
 	void
 	(*xserver_exited)(struct weston_xwayland *xwayland, int exit_status);
+
+	/** Start the Xwayland server without waiting for an X client.
+	 *
+	 * Calls the spawn function given to \a listen right away, as if an X
+	 * client had connected, so that the first client does not have to
+	 * wait for the server and the window manager to come up. Does
+	 * nothing if the server is already running or the module stopped
+	 * listening because the server crashed during its initialization.
+	 *
+	 * \param xwayland The Xwayland context object.
+	 */
+	void
+	(*spawn)(struct weston_xwayland *xwayland);
 };
 
 /** Retrieve the API object for the libweston Xwayland module.
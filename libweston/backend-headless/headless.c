@@ -27,16 +27,28 @@
 #include "config.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <stdatomic.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/un.h>
 #include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
 #include <drm_fourcc.h>
 
 #include <libweston/libweston.h>
 #include <libweston/backend-headless.h>
+#include <libweston/weston-log.h>
 #include "shared/helpers.h"
+#include "shared/os-compatibility.h"
+#include "shared/timespec-util.h"
 #include "linux-explicit-synchronization.h"
 #include "pixman-renderer.h"
 #include "renderer-gl/gl-renderer.h"
@@ -57,6 +69,10 @@ struct headless_backend {
 
 	struct weston_seat fake_seat;
 	enum headless_renderer_type renderer_type;
+	bool unthrottled;
+	char *frame_export_path;
+
+	struct weston_log_scope *debug;
 
 	struct gl_renderer_interface *glri;
 };
@@ -65,13 +81,59 @@ struct headless_head {
 	struct weston_head base;
 };
 
+struct headless_export_buffer {
+	int fd;
+	void *data;
+	pixman_image_t *image;
+	_Atomic uint64_t *seq;	/* in data, for readers to detect reuse */
+
+	/* Damage accumulated since this buffer was last drawn into. */
+	pixman_region32_t damage;
+};
+
+struct headless_export_client {
+	struct headless_output *output;
+	struct wl_list link;
+	int fd;
+	struct wl_event_source *source;
+};
+
 struct headless_output {
 	struct weston_output base;
 
 	struct weston_mode mode;
 	struct wl_event_source *finish_frame_timer;
+	/* unthrottled mode: finishes the frame on the next loop iteration */
+	struct wl_event_source *finish_frame_wakeup;
+	int finish_frame_fd;
 	uint32_t *image_buf;
 	pixman_image_t *image;
+
+	/* Shared memory frame export, pixman renderer only. */
+	struct {
+		bool enabled;
+		char *path;
+		int listen_fd;
+		struct wl_event_source *listen_source;
+		struct wl_list client_list;
+		struct headless_export_buffer
+			buffers[WESTON_HEADLESS_FRAME_EXPORT_BUFFERS];
+		unsigned int current;
+		size_t size;
+		size_t seq_offset;
+		uint64_t seq;
+	} export;
+
+	/* Frame rate and CPU cost accounting, reset every period. */
+	struct {
+		uint32_t frames;
+		struct timespec start;
+		struct timespec cpu_start;
+
+		uint64_t total_frames;
+		int64_t total_nsec;
+		int64_t total_cpu_nsec;
+	} stats;
 };
 
 static const uint32_t headless_formats[] = {
@@ -108,18 +170,472 @@ headless_output_start_repaint_loop(struct weston_output *output)
 	return 0;
 }
 
-static int
-finish_frame_handler(void *data)
+#define HEADLESS_STATS_PERIOD_NSEC 1000000000LL
+
+static void
+headless_output_stats_reset(struct headless_output *output,
+			    const struct timespec *now)
+{
+	output->stats.frames = 0;
+	output->stats.start = *now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &output->stats.cpu_start);
+}
+
+static void
+headless_output_stats_update(struct headless_output *output,
+			     const struct timespec *now)
+{
+	struct headless_backend *b = to_headless_backend(output->base.compositor);
+	struct timespec cpu_now;
+	int64_t period_nsec;
+	int64_t cpu_nsec;
+
+	output->stats.frames++;
+
+	period_nsec = timespec_sub_to_nsec(now, &output->stats.start);
+	if (period_nsec < HEADLESS_STATS_PERIOD_NSEC)
+		return;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_now);
+	cpu_nsec = timespec_sub_to_nsec(&cpu_now, &output->stats.cpu_start);
+
+	output->stats.total_frames += output->stats.frames;
+	output->stats.total_nsec += period_nsec;
+	output->stats.total_cpu_nsec += cpu_nsec;
+
+	weston_log_scope_printf(b->debug,
+				"%s: %u frames in %.3f s: %.1f fps, "
+				"%.3f ms CPU/frame\n",
+				output->base.name, output->stats.frames,
+				period_nsec / 1e9,
+				output->stats.frames * 1e9 / period_nsec,
+				cpu_nsec / 1e6 / output->stats.frames);
+
+	headless_output_stats_reset(output, now);
+}
+
+static void
+headless_output_stats_print_summary(struct headless_output *output)
+{
+	struct headless_backend *b = to_headless_backend(output->base.compositor);
+	struct timespec now;
+	int64_t nsec;
+	int64_t cpu_nsec;
+	uint64_t frames;
+	struct timespec cpu_now;
+
+	if (!b->unthrottled)
+		return;
+
+	weston_compositor_read_presentation_clock(output->base.compositor, &now);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_now);
+
+	frames = output->stats.total_frames + output->stats.frames;
+	nsec = output->stats.total_nsec +
+	       timespec_sub_to_nsec(&now, &output->stats.start);
+	cpu_nsec = output->stats.total_cpu_nsec +
+		   timespec_sub_to_nsec(&cpu_now, &output->stats.cpu_start);
+
+	if (frames == 0 || nsec <= 0)
+		return;
+
+	weston_log("headless output %s: %llu frames in %.3f s: "
+		   "%.1f fps, %.3f ms CPU/frame\n",
+		   output->base.name, (unsigned long long) frames, nsec / 1e9,
+		   frames * 1e9 / nsec, cpu_nsec / 1e6 / frames);
+}
+
+static void
+headless_output_finish_frame(struct headless_output *output)
 {
-	struct headless_output *output = data;
 	struct timespec ts;
 
 	weston_compositor_read_presentation_clock(output->base.compositor, &ts);
+	headless_output_stats_update(output, &ts);
 	weston_output_finish_frame(&output->base, &ts, 0);
+}
+
+static int
+finish_frame_handler(void *data)
+{
+	struct headless_output *output = data;
+
+	headless_output_finish_frame(output);
 
 	return 1;
 }
 
+static int
+finish_frame_wakeup_handler(int fd, uint32_t mask, void *data)
+{
+	struct headless_output *output = data;
+	uint64_t count;
+
+	if (read(fd, &count, sizeof count) < 0)
+		return 0;
+
+	headless_output_finish_frame(output);
+
+	return 0;
+}
+
+static void
+headless_export_client_destroy(struct headless_export_client *client)
+{
+	wl_list_remove(&client->link);
+	wl_event_source_remove(client->source);
+	close(client->fd);
+	free(client);
+}
+
+static int
+headless_export_client_handler(int fd, uint32_t mask, void *data)
+{
+	struct headless_export_client *client = data;
+	char buf[64];
+
+	/* Clients have nothing to tell us; we only watch for hangup. */
+	if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR) ||
+	    recv(fd, buf, sizeof buf, MSG_DONTWAIT) == 0)
+		headless_export_client_destroy(client);
+
+	return 0;
+}
+
+static int
+headless_export_send_buffers(struct headless_output *output, int fd)
+{
+	struct weston_headless_frame_export_buffers msg = {
+		.type = WESTON_HEADLESS_FRAME_EXPORT_TYPE_BUFFERS,
+		.n_buffers = WESTON_HEADLESS_FRAME_EXPORT_BUFFERS,
+		.format = DRM_FORMAT_XRGB8888,
+		.width = output->base.current_mode->width,
+		.height = output->base.current_mode->height,
+		.stride = output->base.current_mode->width * 4,
+		.size = output->export.size,
+		.seq_offset = output->export.seq_offset,
+	};
+	char control[CMSG_SPACE(sizeof(int) *
+				WESTON_HEADLESS_FRAME_EXPORT_BUFFERS)];
+	struct msghdr nmsg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	int fds[WESTON_HEADLESS_FRAME_EXPORT_BUFFERS];
+	unsigned int i;
+	ssize_t len;
+
+	for (i = 0; i < ARRAY_LENGTH(fds); i++)
+		fds[i] = output->export.buffers[i].fd;
+
+	memset(control, 0, sizeof control);
+	memset(&nmsg, 0, sizeof nmsg);
+	iov.iov_base = &msg;
+	iov.iov_len = sizeof msg;
+	nmsg.msg_iov = &iov;
+	nmsg.msg_iovlen = 1;
+	nmsg.msg_control = control;
+	nmsg.msg_controllen = sizeof control;
+
+	cmsg = CMSG_FIRSTHDR(&nmsg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof fds);
+	memcpy(CMSG_DATA(cmsg), fds, sizeof fds);
+
+	do {
+		len = sendmsg(fd, &nmsg, MSG_NOSIGNAL);
+	} while (len < 0 && errno == EINTR);
+
+	return len == sizeof msg ? 0 : -1;
+}
+
+static int
+headless_export_listen_handler(int listen_fd, uint32_t mask, void *data)
+{
+	struct headless_output *output = data;
+	struct headless_export_client *client;
+	struct wl_event_loop *loop;
+	int fd;
+
+	fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (fd < 0)
+		return 0;
+
+	client = zalloc(sizeof *client);
+	if (!client)
+		goto err_close;
+
+	if (headless_export_send_buffers(output, fd) < 0) {
+		weston_log("headless: failed to send export buffers: %s\n",
+			   strerror(errno));
+		goto err_free;
+	}
+
+	loop = wl_display_get_event_loop(output->base.compositor->wl_display);
+	client->source = wl_event_loop_add_fd(loop, fd, WL_EVENT_READABLE,
+					      headless_export_client_handler,
+					      client);
+	if (!client->source)
+		goto err_free;
+
+	client->output = output;
+	client->fd = fd;
+	wl_list_insert(&output->export.client_list, &client->link);
+
+	return 0;
+
+err_free:
+	free(client);
+err_close:
+	close(fd);
+	return 0;
+}
+
+static void
+headless_output_export_begin(struct headless_output *output)
+{
+	struct headless_export_buffer *buffer;
+
+	output->export.current = (output->export.current + 1) %
+				 WESTON_HEADLESS_FRAME_EXPORT_BUFFERS;
+	buffer = &output->export.buffers[output->export.current];
+
+	/* Readers that still copy the frame this buffer held see the stamp
+	 * change before any of its pixels do. */
+	atomic_store_explicit(buffer->seq, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	/* The pixman renderer only copies the new damage from the shadow;
+	 * also redraw whatever changed while this buffer was out of use. */
+	pixman_renderer_output_set_buffer(&output->base, buffer->image);
+	pixman_renderer_output_set_hw_extra_damage(&output->base,
+						   &buffer->damage);
+}
+
+static void
+headless_output_export_end(struct headless_output *output,
+			   pixman_region32_t *damage)
+{
+	struct weston_headless_frame_export_frame msg = {
+		.type = WESTON_HEADLESS_FRAME_EXPORT_TYPE_FRAME,
+	};
+	struct headless_export_client *client, *tmp;
+	pixman_region32_t output_damage;
+	pixman_box32_t *rects;
+	struct timespec now;
+	unsigned int i;
+	int n_rects;
+	ssize_t len;
+
+	for (i = 0; i < WESTON_HEADLESS_FRAME_EXPORT_BUFFERS; i++) {
+		struct headless_export_buffer *buffer =
+			&output->export.buffers[i];
+
+		if (i == output->export.current)
+			pixman_region32_clear(&buffer->damage);
+		else
+			pixman_region32_union(&buffer->damage,
+					      &buffer->damage, damage);
+	}
+
+	/* Stamp every frame, so that a reader connecting later can trust
+	 * the stamps it finds. */
+	msg.seq = ++output->export.seq;
+	atomic_store_explicit(output->export.buffers[output->export.current].seq,
+			      msg.seq, memory_order_release);
+
+	if (wl_list_empty(&output->export.client_list))
+		return;
+
+	pixman_region32_init(&output_damage);
+	pixman_region32_copy(&output_damage, damage);
+	pixman_region32_translate(&output_damage,
+				  -output->base.x, -output->base.y);
+	weston_transformed_region(output->base.width, output->base.height,
+				  output->base.transform,
+				  output->base.current_scale,
+				  &output_damage, &output_damage);
+
+	rects = pixman_region32_rectangles(&output_damage, &n_rects);
+	if (n_rects > WESTON_HEADLESS_FRAME_EXPORT_MAX_RECTS) {
+		rects = pixman_region32_extents(&output_damage);
+		n_rects = 1;
+	}
+	for (i = 0; i < (unsigned int) n_rects; i++) {
+		msg.rects[i].x1 = rects[i].x1;
+		msg.rects[i].y1 = rects[i].y1;
+		msg.rects[i].x2 = rects[i].x2;
+		msg.rects[i].y2 = rects[i].y2;
+	}
+	pixman_region32_fini(&output_damage);
+
+	weston_compositor_read_presentation_clock(output->base.compositor,
+						  &now);
+	msg.buffer = output->export.current;
+	msg.tv_sec = now.tv_sec;
+	msg.tv_nsec = now.tv_nsec;
+	msg.n_rects = n_rects;
+
+	/* Never block the repaint on a slow consumer. */
+	wl_list_for_each_safe(client, tmp, &output->export.client_list, link) {
+		len = send(client->fd, &msg, sizeof msg,
+			   MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+			headless_export_client_destroy(client);
+	}
+}
+
+static void
+headless_output_disable_export(struct headless_output *output)
+{
+	struct headless_export_client *client, *tmp;
+	unsigned int i;
+
+	wl_list_for_each_safe(client, tmp, &output->export.client_list, link)
+		headless_export_client_destroy(client);
+
+	if (output->export.listen_source)
+		wl_event_source_remove(output->export.listen_source);
+	output->export.listen_source = NULL;
+
+	if (output->export.listen_fd >= 0) {
+		close(output->export.listen_fd);
+		unlink(output->export.path);
+	}
+	output->export.listen_fd = -1;
+
+	free(output->export.path);
+	output->export.path = NULL;
+
+	for (i = 0; i < WESTON_HEADLESS_FRAME_EXPORT_BUFFERS; i++) {
+		struct headless_export_buffer *buffer =
+			&output->export.buffers[i];
+
+		if (buffer->image)
+			pixman_image_unref(buffer->image);
+		if (buffer->data)
+			munmap(buffer->data, output->export.size);
+		if (buffer->fd >= 0)
+			close(buffer->fd);
+		pixman_region32_fini(&buffer->damage);
+
+		buffer->image = NULL;
+		buffer->data = NULL;
+		buffer->fd = -1;
+	}
+
+	output->export.enabled = false;
+}
+
+static int
+headless_output_enable_export(struct headless_output *output)
+{
+	struct headless_backend *b = to_headless_backend(output->base.compositor);
+	int width = output->base.current_mode->width;
+	int height = output->base.current_mode->height;
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct wl_event_loop *loop;
+	unsigned int i;
+
+	/* The sequence stamp follows the pixels. */
+	output->export.seq_offset = ((size_t) width * height * 4 + 7) &
+				    ~(size_t) 7;
+	output->export.size = output->export.seq_offset + sizeof(uint64_t);
+	output->export.current = 0;
+	output->export.seq = 0;
+	output->export.listen_fd = -1;
+	wl_list_init(&output->export.client_list);
+	output->export.enabled = true;
+
+	for (i = 0; i < WESTON_HEADLESS_FRAME_EXPORT_BUFFERS; i++) {
+		struct headless_export_buffer *buffer =
+			&output->export.buffers[i];
+
+		pixman_region32_init_rect(&buffer->damage, output->base.x,
+					  output->base.y, output->base.width,
+					  output->base.height);
+		buffer->fd = -1;
+		buffer->data = NULL;
+		buffer->image = NULL;
+	}
+
+	for (i = 0; i < WESTON_HEADLESS_FRAME_EXPORT_BUFFERS; i++) {
+		struct headless_export_buffer *buffer =
+			&output->export.buffers[i];
+
+		buffer->fd = os_create_anonymous_file(output->export.size);
+		if (buffer->fd < 0)
+			goto err;
+
+		buffer->data = mmap(NULL, output->export.size,
+				    PROT_READ | PROT_WRITE, MAP_SHARED,
+				    buffer->fd, 0);
+		if (buffer->data == MAP_FAILED) {
+			buffer->data = NULL;
+			goto err;
+		}
+
+		buffer->image = pixman_image_create_bits(PIXMAN_x8r8g8b8,
+							 width, height,
+							 buffer->data,
+							 width * 4);
+		if (!buffer->image)
+			goto err;
+
+		buffer->seq = (_Atomic uint64_t *)
+			((char *) buffer->data + output->export.seq_offset);
+	}
+
+	if (asprintf(&output->export.path, "%s-%s", b->frame_export_path,
+		     output->base.name) < 0) {
+		output->export.path = NULL;
+		goto err;
+	}
+
+	if (strlen(output->export.path) >= sizeof addr.sun_path) {
+		weston_log("headless: frame export path too long: %s\n",
+			   output->export.path);
+		goto err;
+	}
+	strcpy(addr.sun_path, output->export.path);
+
+	output->export.listen_fd = socket(AF_UNIX,
+					  SOCK_SEQPACKET | SOCK_CLOEXEC |
+					  SOCK_NONBLOCK, 0);
+	if (output->export.listen_fd < 0)
+		goto err;
+
+	unlink(output->export.path);
+	if (bind(output->export.listen_fd, (struct sockaddr *) &addr,
+		 sizeof addr) < 0 ||
+	    listen(output->export.listen_fd, 4) < 0) {
+		weston_log("headless: failed to listen on %s: %s\n",
+			   output->export.path, strerror(errno));
+		close(output->export.listen_fd);
+		output->export.listen_fd = -1;
+		goto err;
+	}
+
+	loop = wl_display_get_event_loop(b->compositor->wl_display);
+	output->export.listen_source =
+		wl_event_loop_add_fd(loop, output->export.listen_fd,
+				     WL_EVENT_READABLE,
+				     headless_export_listen_handler, output);
+	if (!output->export.listen_source)
+		goto err;
+
+	weston_log("headless: exporting frames of %s on %s\n",
+		   output->base.name, output->export.path);
+
+	return 0;
+
+err:
+	weston_log("headless: failed to set up frame export for %s\n",
+		   output->base.name);
+	headless_output_disable_export(output);
+	return -1;
+}
+
 static int
 headless_output_repaint(struct weston_output *output_base,
 		       pixman_region32_t *damage,
@@ -127,13 +643,31 @@ headless_output_repaint(struct weston_output *output_base,
 {
 	struct headless_output *output = to_headless_output(output_base);
 	struct weston_compositor *ec = output->base.compositor;
+	uint64_t one = 1;
+
+	if (output->export.enabled)
+		headless_output_export_begin(output);
 
 	ec->renderer->repaint_output(&output->base, damage);
 
+	if (output->export.enabled)
+		headless_output_export_end(output, damage);
+
 	pixman_region32_subtract(&ec->primary_plane.damage,
 				 &ec->primary_plane.damage, damage);
 
-	wl_event_source_timer_update(output->finish_frame_timer, 16);
+	/* In unthrottled mode rendering is synchronous, so the frame is
+	 * complete already, but weston_output_finish_frame() cannot be called
+	 * from within repaint. The eventfd is polled together with the
+	 * clients, so they still get a turn in between frames, unlike with
+	 * an idle source. */
+	if (output->finish_frame_wakeup) {
+		while (write(output->finish_frame_fd, &one, sizeof one) < 0 &&
+		       errno == EINTR)
+			;
+	} else {
+		wl_event_source_timer_update(output->finish_frame_timer, 16);
+	}
 
 	return 0;
 }
@@ -151,10 +685,27 @@ static void
 headless_output_disable_pixman(struct headless_output *output)
 {
 	pixman_renderer_output_destroy(&output->base);
+
+	if (output->export.enabled) {
+		headless_output_disable_export(output);
+		return;
+	}
+
 	pixman_image_unref(output->image);
 	free(output->image_buf);
 }
 
+static void
+headless_output_remove_wakeup(struct headless_output *output)
+{
+	if (!output->finish_frame_wakeup)
+		return;
+
+	wl_event_source_remove(output->finish_frame_wakeup);
+	output->finish_frame_wakeup = NULL;
+	close(output->finish_frame_fd);
+}
+
 static int
 headless_output_disable(struct weston_output *base)
 {
@@ -164,7 +715,10 @@ headless_output_disable(struct weston_output *base)
 	if (!output->base.enabled)
 		return 0;
 
+	headless_output_stats_print_summary(output);
+
 	wl_event_source_remove(output->finish_frame_timer);
+	headless_output_remove_wakeup(output);
 
 	switch (b->renderer_type) {
 	case HEADLESS_GL:
@@ -212,6 +766,23 @@ headless_output_enable_gl(struct headless_output *output)
 static int
 headless_output_enable_pixman(struct headless_output *output)
 {
+	struct headless_backend *b = to_headless_backend(output->base.compositor);
+
+	if (b->frame_export_path) {
+		if (headless_output_enable_export(output) < 0)
+			return -1;
+
+		if (pixman_renderer_output_create(&output->base,
+						  PIXMAN_RENDERER_OUTPUT_USE_SHADOW) < 0) {
+			headless_output_disable_export(output);
+			return -1;
+		}
+
+		pixman_renderer_output_set_buffer(&output->base,
+						  output->export.buffers[0].image);
+		return 0;
+	}
+
 	output->image_buf = malloc(output->base.current_mode->width *
 				   output->base.current_mode->height * 4);
 	if (!output->image_buf)
@@ -244,12 +815,32 @@ headless_output_enable(struct weston_output *base)
 	struct headless_output *output = to_headless_output(base);
 	struct headless_backend *b = to_headless_backend(base->compositor);
 	struct wl_event_loop *loop;
+	struct timespec now;
 	int ret = 0;
 
 	loop = wl_display_get_event_loop(b->compositor->wl_display);
 	output->finish_frame_timer =
 		wl_event_loop_add_timer(loop, finish_frame_handler, output);
 
+	if (b->unthrottled) {
+		output->finish_frame_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (output->finish_frame_fd < 0) {
+			wl_event_source_remove(output->finish_frame_timer);
+			return -1;
+		}
+
+		output->finish_frame_wakeup =
+			wl_event_loop_add_fd(loop, output->finish_frame_fd,
+					     WL_EVENT_READABLE,
+					     finish_frame_wakeup_handler,
+					     output);
+		if (!output->finish_frame_wakeup) {
+			close(output->finish_frame_fd);
+			wl_event_source_remove(output->finish_frame_timer);
+			return -1;
+		}
+	}
+
 	switch (b->renderer_type) {
 	case HEADLESS_GL:
 		ret = headless_output_enable_gl(output);
@@ -263,9 +854,18 @@ headless_output_enable(struct weston_output *base)
 
 	if (ret < 0) {
 		wl_event_source_remove(output->finish_frame_timer);
+		headless_output_remove_wakeup(output);
 		return -1;
 	}
 
+	output->base.repaint_unthrottled = b->unthrottled;
+
+	weston_compositor_read_presentation_clock(b->compositor, &now);
+	headless_output_stats_reset(output, &now);
+	output->stats.total_frames = 0;
+	output->stats.total_nsec = 0;
+	output->stats.total_cpu_nsec = 0;
+
 	return 0;
 }
 
@@ -381,6 +981,8 @@ headless_destroy(struct weston_compositor *ec)
 	wl_list_for_each_safe(base, next, &ec->head_list, compositor_link)
 		headless_head_destroy(to_headless_head(base));
 
+	weston_compositor_log_scope_destroy(b->debug);
+	free(b->frame_export_path);
 	free(b);
 }
 
@@ -440,6 +1042,22 @@ headless_backend_create(struct weston_compositor *compositor,
 	else
 		b->renderer_type = HEADLESS_NOOP;
 
+	b->unthrottled = config->unthrottled;
+
+	if (config->frame_export_path) {
+		if (b->renderer_type != HEADLESS_PIXMAN) {
+			weston_log("Error: frame export requires the pixman "
+				   "renderer.\n");
+			goto err_free;
+		}
+		b->frame_export_path = strdup(config->frame_export_path);
+	}
+	b->debug = weston_compositor_add_log_scope(compositor->weston_log_ctx,
+						   "headless-backend",
+						   "Frame rate and CPU time per "
+						   "frame of headless outputs\n",
+						   NULL, NULL, NULL);
+
 	switch (b->renderer_type) {
 	case HEADLESS_GL:
 		ret = headless_gl_renderer_init(b);
@@ -480,6 +1098,8 @@ headless_backend_create(struct weston_compositor *compositor,
 err_input:
 	weston_compositor_shutdown(compositor);
 err_free:
+	weston_compositor_log_scope_destroy(b->debug);
+	free(b->frame_export_path);
 	free(b);
 	return NULL;
 }
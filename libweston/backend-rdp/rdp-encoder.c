@@ -0,0 +1,301 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <wayland-server-core.h>
+
+#include <libweston/zalloc.h>
+#include "shared/task-pool.h"
+#include "rdp-encoder.h"
+
+struct rdp_encoder {
+	struct weston_task_pool *pool;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool quit;
+
+	int done_fd;
+	struct wl_event_source *done_source;
+
+	/* Only touched by the compositor thread: a batch was submitted
+	 * and its done callback has not been called yet */
+	bool busy;
+
+	/* Protected by mutex */
+	bool queued;
+	bool encoded;
+
+	unsigned count;
+	rdp_encode_func_t encode;
+	rdp_encode_done_func_t done;
+	void *data;
+};
+
+static void *
+rdp_encoder_thread(void *data)
+{
+	struct rdp_encoder *encoder = data;
+	uint64_t one = 1;
+
+	pthread_mutex_lock(&encoder->mutex);
+	for (;;) {
+		while (!encoder->queued && !encoder->quit)
+			pthread_cond_wait(&encoder->cond, &encoder->mutex);
+
+		/* A batch queued before quitting is still finished */
+		if (!encoder->queued)
+			break;
+
+		encoder->queued = false;
+		pthread_mutex_unlock(&encoder->mutex);
+
+		weston_task_pool_run(encoder->pool, encoder->count,
+				     encoder->encode, encoder->data);
+
+		pthread_mutex_lock(&encoder->mutex);
+		encoder->encoded = true;
+		pthread_cond_broadcast(&encoder->cond);
+
+		while (write(encoder->done_fd, &one, sizeof one) < 0 &&
+		       errno == EINTR)
+			;
+	}
+	pthread_mutex_unlock(&encoder->mutex);
+
+	return NULL;
+}
+
+static void
+rdp_encoder_complete(struct rdp_encoder *encoder)
+{
+	bool encoded;
+
+	if (!encoder->busy)
+		return;
+
+	pthread_mutex_lock(&encoder->mutex);
+	encoded = encoder->encoded;
+	encoder->encoded = false;
+	pthread_mutex_unlock(&encoder->mutex);
+
+	if (!encoded)
+		return;
+
+	encoder->busy = false;
+	encoder->done(encoder->data);
+}
+
+static int
+rdp_encoder_done_dispatch(int fd, uint32_t mask, void *data)
+{
+	struct rdp_encoder *encoder = data;
+	uint64_t count;
+
+	/* Only a wakeup, a flush may already have completed the batch */
+	if (read(fd, &count, sizeof count) < 0 && errno != EAGAIN)
+		return 0;
+
+	rdp_encoder_complete(encoder);
+
+	return 0;
+}
+
+struct rdp_encoder *
+rdp_encoder_create(struct wl_event_loop *loop, unsigned threads)
+{
+	struct rdp_encoder *encoder;
+
+	encoder = zalloc(sizeof *encoder);
+	if (!encoder)
+		return NULL;
+
+	pthread_mutex_init(&encoder->mutex, NULL);
+	pthread_cond_init(&encoder->cond, NULL);
+
+	encoder->done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (encoder->done_fd < 0)
+		goto err_free;
+
+	encoder->done_source =
+		wl_event_loop_add_fd(loop, encoder->done_fd, WL_EVENT_READABLE,
+				     rdp_encoder_done_dispatch, encoder);
+	if (!encoder->done_source)
+		goto err_fd;
+
+	/* The encoder thread takes part in every batch itself */
+	encoder->pool = weston_task_pool_create(threads);
+	if (!encoder->pool)
+		goto err_source;
+
+	if (pthread_create(&encoder->thread, NULL,
+			   rdp_encoder_thread, encoder) != 0)
+		goto err_pool;
+
+	return encoder;
+
+err_pool:
+	weston_task_pool_destroy(encoder->pool);
+err_source:
+	wl_event_source_remove(encoder->done_source);
+err_fd:
+	close(encoder->done_fd);
+err_free:
+	pthread_cond_destroy(&encoder->cond);
+	pthread_mutex_destroy(&encoder->mutex);
+	free(encoder);
+	return NULL;
+}
+
+void
+rdp_encoder_destroy(struct rdp_encoder *encoder)
+{
+	pthread_mutex_lock(&encoder->mutex);
+	encoder->quit = true;
+	pthread_cond_signal(&encoder->cond);
+	pthread_mutex_unlock(&encoder->mutex);
+	pthread_join(encoder->thread, NULL);
+
+	weston_task_pool_destroy(encoder->pool);
+	wl_event_source_remove(encoder->done_source);
+	close(encoder->done_fd);
+	pthread_cond_destroy(&encoder->cond);
+	pthread_mutex_destroy(&encoder->mutex);
+	free(encoder);
+}
+
+int
+rdp_encoder_submit(struct rdp_encoder *encoder, unsigned count,
+		   rdp_encode_func_t encode, rdp_encode_done_func_t done,
+		   void *data)
+{
+	if (encoder->busy)
+		return -1;
+
+	encoder->busy = true;
+
+	pthread_mutex_lock(&encoder->mutex);
+	encoder->count = count;
+	encoder->encode = encode;
+	encoder->done = done;
+	encoder->data = data;
+	encoder->queued = true;
+	pthread_cond_signal(&encoder->cond);
+	pthread_mutex_unlock(&encoder->mutex);
+
+	return 0;
+}
+
+bool
+rdp_encoder_busy(struct rdp_encoder *encoder)
+{
+	return encoder->busy;
+}
+
+void
+rdp_encoder_wait(struct rdp_encoder *encoder)
+{
+	if (!encoder->busy)
+		return;
+
+	pthread_mutex_lock(&encoder->mutex);
+	while (!encoder->encoded)
+		pthread_cond_wait(&encoder->cond, &encoder->mutex);
+	pthread_mutex_unlock(&encoder->mutex);
+}
+
+void
+rdp_encoder_flush(struct rdp_encoder *encoder)
+{
+	rdp_encoder_wait(encoder);
+	rdp_encoder_complete(encoder);
+}
+
+int
+rdp_encode_jobs_add(struct rdp_encode_jobs *jobs, void *peer,
+		    pixman_region32_t *region)
+{
+	struct rdp_encode_job *array, *job;
+	unsigned alloc;
+
+	if (jobs->count == jobs->alloc) {
+		alloc = jobs->alloc ? jobs->alloc * 2 : 4;
+		array = realloc(jobs->jobs, alloc * sizeof *array);
+		if (!array)
+			return -1;
+		jobs->jobs = array;
+		jobs->alloc = alloc;
+	}
+
+	job = &jobs->jobs[jobs->count++];
+	job->peer = peer;
+	pixman_region32_init(&job->region);
+	pixman_region32_copy(&job->region, region);
+
+	return 0;
+}
+
+void
+rdp_encode_jobs_clear(struct rdp_encode_jobs *jobs)
+{
+	unsigned i;
+
+	for (i = 0; i < jobs->count; i++)
+		pixman_region32_fini(&jobs->jobs[i].region);
+	jobs->count = 0;
+}
+
+void
+rdp_encode_jobs_release(struct rdp_encode_jobs *jobs)
+{
+	rdp_encode_jobs_clear(jobs);
+	free(jobs->jobs);
+	jobs->jobs = NULL;
+	jobs->alloc = 0;
+}
+
+void
+rdp_encoder_drop_peer(struct rdp_encoder *encoder,
+		      struct rdp_encode_jobs *jobs, void *peer)
+{
+	unsigned i;
+
+	if (!encoder->busy)
+		return;
+
+	rdp_encoder_wait(encoder);
+	for (i = 0; i < jobs->count; i++) {
+		if (jobs->jobs[i].peer == peer)
+			jobs->jobs[i].peer = NULL;
+	}
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RDP_ENCODER_H
+#define RDP_ENCODER_H
+
+#include <stdbool.h>
+#include <pixman.h>
+
+struct wl_event_loop;
+
+/*
+ * Runs a batch of independent encodes, one per index, on a thread pool
+ * away from the compositor thread. When all of them have returned, the
+ * done callback is called from the event loop. Only one batch can be in
+ * flight at a time.
+ */
+
+struct rdp_encoder;
+
+typedef void (*rdp_encode_func_t)(void *data, unsigned index);
+typedef void (*rdp_encode_done_func_t)(void *data);
+
+struct rdp_encoder *
+rdp_encoder_create(struct wl_event_loop *loop, unsigned threads);
+
+/* Waits for a batch in flight, without calling its done callback */
+void
+rdp_encoder_destroy(struct rdp_encoder *encoder);
+
+/* Returns -1 if a batch is still in flight */
+int
+rdp_encoder_submit(struct rdp_encoder *encoder, unsigned count,
+		   rdp_encode_func_t encode, rdp_encode_done_func_t done,
+		   void *data);
+
+bool
+rdp_encoder_busy(struct rdp_encoder *encoder);
+
+/* Waits for the batch in flight to be encoded, the done callback is still
+ * to come */
+void
+rdp_encoder_wait(struct rdp_encoder *encoder);
+
+/* Waits for the batch in flight and calls its done callback right away */
+void
+rdp_encoder_flush(struct rdp_encoder *encoder);
+
+/* The jobs of a batch, one region to encode for each peer */
+struct rdp_encode_job {
+	void *peer;		/* NULL once the peer is gone */
+	pixman_region32_t region;
+};
+
+struct rdp_encode_jobs {
+	struct rdp_encode_job *jobs;
+	unsigned count, alloc;
+};
+
+/* Queues a copy of region for peer, returns -1 if out of memory */
+int
+rdp_encode_jobs_add(struct rdp_encode_jobs *jobs, void *peer,
+		    pixman_region32_t *region);
+
+/* Empties the list for the next batch */
+void
+rdp_encode_jobs_clear(struct rdp_encode_jobs *jobs);
+
+void
+rdp_encode_jobs_release(struct rdp_encode_jobs *jobs);
+
+/* Waits until the batch in flight is done with peer, and marks its jobs
+ * as gone so that the done callback skips them. The peer can be freed
+ * right after. */
+void
+rdp_encoder_drop_peer(struct rdp_encoder *encoder,
+		      struct rdp_encode_jobs *jobs, void *peer);
+
+#endif /* RDP_ENCODER_H */
@@ -0,0 +1,194 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shared/helpers.h"
+#include "rdp-tiles.h"
+
+#define RDP_TILE_HASH_LANES 16
+
+/* the XXH32 primes, for the rounds */
+#define PRIME32_1 0x9e3779b1U
+#define PRIME32_2 0x85ebca77U
+
+/* the XXH64 primes, for the merge and the final avalanche */
+#define PRIME64_1 0x9e3779b185ebca87ULL
+#define PRIME64_2 0xc2b2ae3d27d4eb4fULL
+#define PRIME64_3 0x165667b19e3779f9ULL
+#define PRIME64_4 0x85ebca77c2b2ae63ULL
+#define PRIME64_5 0x27d4eb2f165667c5ULL
+
+int
+rdp_tiles_init(struct rdp_tiles *tiles, int width, int height)
+{
+	free(tiles->hashes);
+
+	tiles->tiles_x = (width + RDP_TILE_SIZE - 1) / RDP_TILE_SIZE;
+	tiles->tiles_y = (height + RDP_TILE_SIZE - 1) / RDP_TILE_SIZE;
+	tiles->hashes = calloc(tiles->tiles_x * tiles->tiles_y,
+			       sizeof *tiles->hashes);
+
+	return tiles->hashes ? 0 : -1;
+}
+
+void
+rdp_tiles_release(struct rdp_tiles *tiles)
+{
+	free(tiles->hashes);
+	tiles->hashes = NULL;
+}
+
+void
+rdp_tiles_reset(struct rdp_tiles *tiles)
+{
+	if (tiles->hashes)
+		memset(tiles->hashes, 0,
+		       tiles->tiles_x * tiles->tiles_y * sizeof *tiles->hashes);
+}
+
+static inline uint32_t
+rotl32(uint32_t x, int r)
+{
+	return (x << r) | (x >> (32 - r));
+}
+
+static inline uint64_t
+rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint32_t
+hash_round32(uint32_t acc, uint32_t value)
+{
+	return rotl32(acc + value * PRIME32_2, 13) * PRIME32_1;
+}
+
+static inline uint64_t
+hash_round64(uint64_t acc, uint64_t value)
+{
+	return rotl64(acc + value * PRIME64_2, 31) * PRIME64_1;
+}
+
+/* XXH32's rounds, fed one pixel at a time into independent 32-bit lanes:
+ * a row updates all lanes with the same operations, which the compiler
+ * turns into SIMD multiplies even for baseline x86-64, where 64-bit ones
+ * stay scalar. Pairs of lanes are then merged as in XXH64, and XXH64's
+ * final avalanche makes a changed bit anywhere in the tile flip each bit
+ * of the result with about even odds; FNV over 32-bit words let a change
+ * in the top bit of two pixels of a lane cancel out. Never returns 0,
+ * which marks a tile that has not been hashed yet. */
+uint64_t
+rdp_tile_hash(const uint32_t *data, int stride, int width, int height)
+{
+	uint32_t lanes[RDP_TILE_HASH_LANES];
+	uint64_t hash;
+	int x, y, l;
+
+	for (l = 0; l < RDP_TILE_HASH_LANES; l++)
+		lanes[l] = PRIME32_1 + PRIME32_2 * (l + 1);
+
+	for (y = 0; y < height; y++, data += stride) {
+		for (x = 0; x + RDP_TILE_HASH_LANES <= width;
+		     x += RDP_TILE_HASH_LANES) {
+			for (l = 0; l < RDP_TILE_HASH_LANES; l++)
+				lanes[l] = hash_round32(lanes[l], data[x + l]);
+		}
+		for (l = 0; x < width; x++, l++)
+			lanes[l] = hash_round32(lanes[l], data[x]);
+	}
+
+	hash = PRIME64_5 + (uint64_t) width * height * sizeof *data;
+	for (l = 0; l < RDP_TILE_HASH_LANES; l += 2) {
+		hash ^= hash_round64(0, (uint64_t) lanes[l] << 32 |
+					lanes[l + 1]);
+		hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_4;
+	}
+
+	hash ^= hash >> 33;
+	hash *= PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= PRIME64_3;
+	hash ^= hash >> 32;
+
+	return hash | 1;
+}
+
+void
+rdp_tiles_filter_damage(struct rdp_tiles *tiles, pixman_image_t *image,
+			pixman_region32_t *damage, pixman_region32_t *changed)
+{
+	uint32_t *data = pixman_image_get_data(image);
+	int stride = pixman_image_get_stride(image) / sizeof(uint32_t);
+	int width = pixman_image_get_width(image);
+	int height = pixman_image_get_height(image);
+	pixman_box32_t *extents = pixman_region32_extents(damage);
+	pixman_box32_t tile;
+	uint64_t hash, *slot;
+	int tx, ty;
+
+	pixman_region32_init(changed);
+
+	if (!tiles->hashes) {
+		pixman_region32_copy(changed, damage);
+		return;
+	}
+
+	for (ty = MAX(extents->y1, 0) / RDP_TILE_SIZE;
+	     ty < tiles->tiles_y && ty * RDP_TILE_SIZE < extents->y2; ty++) {
+		for (tx = MAX(extents->x1, 0) / RDP_TILE_SIZE;
+		     tx < tiles->tiles_x && tx * RDP_TILE_SIZE < extents->x2;
+		     tx++) {
+			tile.x1 = tx * RDP_TILE_SIZE;
+			tile.y1 = ty * RDP_TILE_SIZE;
+			tile.x2 = MIN(tile.x1 + RDP_TILE_SIZE, width);
+			tile.y2 = MIN(tile.y1 + RDP_TILE_SIZE, height);
+
+			if (pixman_region32_contains_rectangle(damage, &tile) ==
+			    PIXMAN_REGION_OUT)
+				continue;
+
+			hash = rdp_tile_hash(data + tile.y1 * stride + tile.x1,
+					     stride, tile.x2 - tile.x1,
+					     tile.y2 - tile.y1);
+			slot = &tiles->hashes[ty * tiles->tiles_x + tx];
+			if (*slot == hash)
+				continue;
+
+			*slot = hash;
+			pixman_region32_union_rect(changed, changed,
+						   tile.x1, tile.y1,
+						   tile.x2 - tile.x1,
+						   tile.y2 - tile.y1);
+		}
+	}
+
+	pixman_region32_intersect(changed, changed, damage);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RDP_TILES_H
+#define RDP_TILES_H
+
+#include <stdint.h>
+#include <pixman.h>
+
+#define RDP_TILE_SIZE 64
+
+/*
+ * Remembers a hash of each 64x64 tile of an image, to tell which parts of
+ * the damage actually changed the pixels since the last time they were
+ * looked at.
+ */
+struct rdp_tiles {
+	uint64_t *hashes;	/* 0 for a tile that has not been hashed */
+	int tiles_x, tiles_y;
+};
+
+/* Returns -1 if the table could not be allocated; all damage is then
+ * reported as changed. */
+int
+rdp_tiles_init(struct rdp_tiles *tiles, int width, int height);
+
+void
+rdp_tiles_release(struct rdp_tiles *tiles);
+
+/* Forgets every hash, so that all damage is reported as changed */
+void
+rdp_tiles_reset(struct rdp_tiles *tiles);
+
+uint64_t
+rdp_tile_hash(const uint32_t *data, int stride, int width, int height);
+
+/* Initializes changed to the part of damage that lies in tiles whose
+ * pixels in image differ from the last call, and updates their hashes.
+ * The image may only have changed inside the damage since the last
+ * call. */
+void
+rdp_tiles_filter_damage(struct rdp_tiles *tiles, pixman_image_t *image,
+			pixman_region32_t *damage, pixman_region32_t *changed);
+
+#endif /* RDP_TILES_H */
@@ -97,14 +97,19 @@
 #endif
 
 #include "shared/helpers.h"
+#include "shared/task-pool.h"
 #include "shared/timespec-util.h"
 #include <libweston/libweston.h>
 #include <libweston/backend-rdp.h>
 #include "pixman-renderer.h"
+#include "rdp-encoder.h"
+#include "rdp-tiles.h"
 
 #define MAX_FREERDP_FDS 32
 #define DEFAULT_AXIS_STEP_DISTANCE 10
 #define RDP_MODE_FREQ 60 * 1000
+#define RDP_FRAME_MSEC 16
+#define RDP_ENCODER_MAX_THREADS 4
 
 #if FREERDP_VERSION_MAJOR >= 2 && defined(PIXEL_FORMAT_BGRA32) && !defined(PIXEL_FORMAT_B8G8R8A8)
 	/* The RDP API is truly wonderful: the pixel format definition changed
@@ -143,6 +148,8 @@ struct rdp_peers_item {
 	int flags;
 	freerdp_peer *peer;
 	struct weston_seat *seat;
+	/* changes not sent while output was suppressed */
+	pixman_region32_t pending;
 
 	struct wl_list link;
 };
@@ -156,6 +163,18 @@ struct rdp_output {
 	struct wl_event_source *finish_frame_timer;
 	pixman_image_t *shadow_surface;
 
+	/* hash of each tile of shadow_surface as of the last repaint */
+	struct rdp_tiles tiles;
+
+	/* RemoteFX and NSCodec peers are encoded off the compositor
+	 * thread. Nothing draws into shadow_surface until the frame
+	 * finishes, so the encoders read it in place; the reference only
+	 * keeps it alive over a mode switch. */
+	struct rdp_encoder *encoder;
+	pixman_image_t *encode_image;
+	struct rdp_encode_jobs encode_jobs;	/* peers are rdp_peers_item */
+	struct timespec frame_start;
+
 	struct wl_list peers;
 };
 
@@ -192,14 +211,12 @@ to_rdp_backend(struct weston_compositor *base)
 }
 
 static void
-rdp_peer_refresh_rfx(pixman_region32_t *damage, pixman_image_t *image, freerdp_peer *peer)
+rdp_peer_encode_rfx(pixman_region32_t *damage, pixman_image_t *image, freerdp_peer *peer)
 {
 	int width, height, nrects, i;
 	pixman_box32_t *region, *rects;
 	uint32_t *ptr;
 	RFX_RECT *rfxRect;
-	rdpUpdate *update = peer->update;
-	SURFACE_BITS_COMMAND cmd;
 	RdpPeerContext *context = (RdpPeerContext *)peer->context;
 
 	Stream_Clear(context->encode_stream);
@@ -208,20 +225,6 @@ rdp_peer_refresh_rfx(pixman_region32_t *damage, pixman_image_t *image, freerdp_p
 	width = (damage->extents.x2 - damage->extents.x1);
 	height = (damage->extents.y2 - damage->extents.y1);
 
-#ifdef HAVE_SKIP_COMPRESSION
-	cmd.skipCompression = TRUE;
-#else
-	memset(&cmd, 0, sizeof(*cmd));
-#endif
-	cmd.destLeft = damage->extents.x1;
-	cmd.destTop = damage->extents.y1;
-	cmd.destRight = damage->extents.x2;
-	cmd.destBottom = damage->extents.y2;
-	SURFACE_BPP(cmd) = 32;
-	SURFACE_CODECID(cmd) = peer->settings->RemoteFxCodecId;
-	SURFACE_WIDTH(cmd) = width;
-	SURFACE_HEIGHT(cmd) = height;
-
 	ptr = pixman_image_get_data(image) + damage->extents.x1 +
 				damage->extents.y1 * (pixman_image_get_stride(image) / sizeof(uint32_t));
 
@@ -242,21 +245,13 @@ rdp_peer_refresh_rfx(pixman_region32_t *damage, pixman_image_t *image, freerdp_p
 			(BYTE *)ptr, width, height,
 			pixman_image_get_stride(image)
 	);
-
-	SURFACE_BITMAP_DATA_LEN(cmd) = Stream_GetPosition(context->encode_stream);
-	SURFACE_BITMAP_DATA(cmd) = Stream_Buffer(context->encode_stream);
-
-	update->SurfaceBits(update->context, &cmd);
 }
 
-
 static void
-rdp_peer_refresh_nsc(pixman_region32_t *damage, pixman_image_t *image, freerdp_peer *peer)
+rdp_peer_encode_nsc(pixman_region32_t *damage, pixman_image_t *image, freerdp_peer *peer)
 {
 	int width, height;
 	uint32_t *ptr;
-	rdpUpdate *update = peer->update;
-	SURFACE_BITS_COMMAND cmd;
 	RdpPeerContext *context = (RdpPeerContext *)peer->context;
 
 	Stream_Clear(context->encode_stream);
@@ -265,34 +260,61 @@ rdp_peer_refresh_nsc(pixman_region32_t *damage, pixman_image_t *image, freerdp_p
 	width = (damage->extents.x2 - damage->extents.x1);
 	height = (damage->extents.y2 - damage->extents.y1);
 
+	ptr = pixman_image_get_data(image) + damage->extents.x1 +
+				damage->extents.y1 * (pixman_image_get_stride(image) / sizeof(uint32_t));
+
+	nsc_compose_message(context->nsc_context, context->encode_stream, (BYTE *)ptr,
+			width, height,
+			pixman_image_get_stride(image));
+}
+
+/* Sends what rdp_peer_encode_rfx() or rdp_peer_encode_nsc() left in the
+ * encode stream; only ever called from the compositor thread. */
+static void
+rdp_peer_send_encoded(pixman_region32_t *damage, freerdp_peer *peer, UINT32 codecId)
+{
+	int width, height;
+	rdpUpdate *update = peer->update;
+	SURFACE_BITS_COMMAND cmd;
+	RdpPeerContext *context = (RdpPeerContext *)peer->context;
+
+	width = (damage->extents.x2 - damage->extents.x1);
+	height = (damage->extents.y2 - damage->extents.y1);
+
 #ifdef HAVE_SKIP_COMPRESSION
 	cmd.skipCompression = TRUE;
 #else
-	memset(cmd, 0, sizeof(*cmd));
+	memset(&cmd, 0, sizeof(cmd));
 #endif
-
 	cmd.destLeft = damage->extents.x1;
 	cmd.destTop = damage->extents.y1;
 	cmd.destRight = damage->extents.x2;
 	cmd.destBottom = damage->extents.y2;
 	SURFACE_BPP(cmd) = 32;
-	SURFACE_CODECID(cmd) = peer->settings->NSCodecId;
+	SURFACE_CODECID(cmd) = codecId;
 	SURFACE_WIDTH(cmd) = width;
 	SURFACE_HEIGHT(cmd) = height;
 
-	ptr = pixman_image_get_data(image) + damage->extents.x1 +
-				damage->extents.y1 * (pixman_image_get_stride(image) / sizeof(uint32_t));
-
-	nsc_compose_message(context->nsc_context, context->encode_stream, (BYTE *)ptr,
-			width, height,
-			pixman_image_get_stride(image));
-
 	SURFACE_BITMAP_DATA_LEN(cmd) = Stream_GetPosition(context->encode_stream);
 	SURFACE_BITMAP_DATA(cmd) = Stream_Buffer(context->encode_stream);
 
 	update->SurfaceBits(update->context, &cmd);
 }
 
+static void
+rdp_peer_refresh_rfx(pixman_region32_t *damage, pixman_image_t *image, freerdp_peer *peer)
+{
+	rdp_peer_encode_rfx(damage, image, peer);
+	rdp_peer_send_encoded(damage, peer, peer->settings->RemoteFxCodecId);
+}
+
+static void
+rdp_peer_refresh_nsc(pixman_region32_t *damage, pixman_image_t *image, freerdp_peer *peer)
+{
+	rdp_peer_encode_nsc(damage, image, peer);
+	rdp_peer_send_encoded(damage, peer, peer->settings->NSCodecId);
+}
+
 static void
 pixman_image_flipped_subrect(const pixman_box32_t *rect, pixman_image_t *img, BYTE *dest)
 {
@@ -382,6 +404,102 @@ rdp_peer_refresh_region(pixman_region32_t *region, freerdp_peer *peer)
 		rdp_peer_refresh_raw(region, output->shadow_surface, peer);
 }
 
+static int
+rdp_output_init_tiles(struct rdp_output *output, int width, int height)
+{
+	if (rdp_tiles_init(&output->tiles, width, height) < 0) {
+		weston_log("failed to allocate tile hashes, "
+			   "sending all damage\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Queues the peer's pending region for the encoder, if it has a codec
+ * that is worth moving off the compositor thread. */
+static int
+rdp_output_add_encode_job(struct rdp_output *output,
+			  struct rdp_peers_item *item)
+{
+	rdpSettings *settings = item->peer->settings;
+
+	if (!output->encoder || !(settings->RemoteFxCodec || settings->NSCodec))
+		return -1;
+
+	return rdp_encode_jobs_add(&output->encode_jobs, item, &item->pending);
+}
+
+/* Runs on an encoder thread; each peer has its own codec contexts and
+ * encode stream, so peers are encoded concurrently. */
+static void
+rdp_output_encode_job(void *data, unsigned index)
+{
+	struct rdp_output *output = data;
+	struct rdp_encode_job *job = &output->encode_jobs.jobs[index];
+	struct rdp_peers_item *item = job->peer;
+	freerdp_peer *peer = item->peer;
+
+	if (peer->settings->RemoteFxCodec)
+		rdp_peer_encode_rfx(&job->region, output->encode_image, peer);
+	else
+		rdp_peer_encode_nsc(&job->region, output->encode_image, peer);
+}
+
+static void
+rdp_output_release_encode_jobs(struct rdp_output *output)
+{
+	rdp_encode_jobs_clear(&output->encode_jobs);
+
+	if (output->encode_image) {
+		pixman_image_unref(output->encode_image);
+		output->encode_image = NULL;
+	}
+}
+
+static void
+rdp_output_encode_done(void *data)
+{
+	struct rdp_output *output = data;
+	struct rdp_encode_job *job;
+	struct rdp_peers_item *item;
+	struct timespec now;
+	int64_t elapsed;
+	freerdp_peer *peer;
+	unsigned i;
+
+	for (i = 0; i < output->encode_jobs.count; i++) {
+		job = &output->encode_jobs.jobs[i];
+		item = job->peer;
+		if (!item)
+			continue;
+
+		peer = item->peer;
+		rdp_peer_send_encoded(&job->region, peer,
+				      peer->settings->RemoteFxCodec ?
+				      peer->settings->RemoteFxCodecId :
+				      peer->settings->NSCodecId);
+	}
+
+	rdp_output_release_encode_jobs(output);
+
+	/* Finish the frame now, but no sooner than the refresh rate */
+	weston_compositor_read_presentation_clock(output->base.compositor,
+						  &now);
+	elapsed = timespec_sub_to_msec(&now, &output->frame_start);
+	wl_event_source_timer_update(output->finish_frame_timer,
+				     MAX(RDP_FRAME_MSEC - elapsed, 1));
+}
+
+/* Anything that talks to a peer outside of the repaint has to let the
+ * frame being encoded go out first. */
+static void
+rdp_output_flush_encoder(struct rdp_output *output)
+{
+	if (output && output->encoder)
+		rdp_encoder_flush(output->encoder);
+}
+
 static int
 rdp_output_start_repaint_loop(struct weston_output *output)
 {
@@ -400,24 +518,57 @@ rdp_output_repaint(struct weston_output *output_base, pixman_region32_t *damage,
 	struct rdp_output *output = container_of(output_base, struct rdp_output, base);
 	struct weston_compositor *ec = output->base.compositor;
 	struct rdp_peers_item *outputPeer;
+	pixman_region32_t changed;
+
+	assert(!output->encoder || !rdp_encoder_busy(output->encoder));
+	weston_compositor_read_presentation_clock(ec, &output->frame_start);
 
 	pixman_renderer_output_set_buffer(output_base, output->shadow_surface);
 	ec->renderer->repaint_output(&output->base, damage);
 
-	if (pixman_region32_not_empty(damage)) {
+	if (wl_list_empty(&output->peers)) {
+		/* Nobody to compare against; the next peer starts with a
+		 * full refresh anyway. */
+		rdp_tiles_reset(&output->tiles);
+	} else if (pixman_region32_not_empty(damage)) {
+		/* Applications often repaint what they already showed; only
+		 * keep the damage in tiles whose contents changed. */
+		rdp_tiles_filter_damage(&output->tiles, output->shadow_surface,
+					damage, &changed);
+
 		wl_list_for_each(outputPeer, &output->peers, link) {
-			if ((outputPeer->flags & RDP_PEER_ACTIVATED) &&
-					(outputPeer->flags & RDP_PEER_OUTPUT_ENABLED))
-			{
-				rdp_peer_refresh_region(damage, outputPeer->peer);
-			}
+			if (!(outputPeer->flags & RDP_PEER_ACTIVATED))
+				continue;
+
+			pixman_region32_union(&outputPeer->pending,
+					      &outputPeer->pending, &changed);
+			if (!(outputPeer->flags & RDP_PEER_OUTPUT_ENABLED) ||
+			    !pixman_region32_not_empty(&outputPeer->pending))
+				continue;
+
+			if (rdp_output_add_encode_job(output, outputPeer) < 0)
+				rdp_peer_refresh_region(&outputPeer->pending,
+							outputPeer->peer);
+			pixman_region32_clear(&outputPeer->pending);
 		}
+
+		pixman_region32_fini(&changed);
 	}
 
 	pixman_region32_subtract(&ec->primary_plane.damage,
 				 &ec->primary_plane.damage, damage);
 
-	wl_event_source_timer_update(output->finish_frame_timer, 16);
+	/* The frame finishes once the encoders are done with it */
+	if (output->encode_jobs.count > 0) {
+		output->encode_image = pixman_image_ref(output->shadow_surface);
+		rdp_encoder_submit(output->encoder, output->encode_jobs.count,
+				   rdp_output_encode_job, rdp_output_encode_done,
+				   output);
+	} else {
+		wl_event_source_timer_update(output->finish_frame_timer,
+					     RDP_FRAME_MSEC);
+	}
+
 	return 0;
 }
 
@@ -478,6 +629,8 @@ rdp_switch_mode(struct weston_output *output, struct weston_mode *target_mode)
 	if (local_mode == output->current_mode)
 		return 0;
 
+	rdp_output_flush_encoder(rdpOutput);
+
 	output->current_mode->flags &= ~WL_OUTPUT_MODE_CURRENT;
 
 	output->current_mode = local_mode;
@@ -492,8 +645,11 @@ rdp_switch_mode(struct weston_output *output, struct weston_mode *target_mode)
 			0, 0, 0, 0, 0, 0, target_mode->width, target_mode->height);
 	pixman_image_unref(rdpOutput->shadow_surface);
 	rdpOutput->shadow_surface = new_shadow_buffer;
+	rdp_output_init_tiles(rdpOutput, target_mode->width, target_mode->height);
 
 	wl_list_for_each(rdpPeer, &rdpOutput->peers, link) {
+		pixman_region32_clear(&rdpPeer->pending);
+
 		settings = rdpPeer->peer->settings;
 		if (settings->DesktopWidth == (UINT32)target_mode->width &&
 				settings->DesktopHeight == (UINT32)target_mode->height)
@@ -577,9 +733,19 @@ rdp_output_enable(struct weston_output *base)
 		return -1;
 	}
 
+	rdp_output_init_tiles(output, output->base.current_mode->width,
+			      output->base.current_mode->height);
+
 	loop = wl_display_get_event_loop(b->compositor->wl_display);
 	output->finish_frame_timer = wl_event_loop_add_timer(loop, finish_frame_handler, output);
 
+	/* The encoder thread itself makes one more */
+	output->encoder = rdp_encoder_create(loop,
+		weston_task_pool_default_threads(RDP_ENCODER_MAX_THREADS - 1));
+	if (!output->encoder)
+		weston_log("failed to start RDP encoder threads, "
+			   "encoding on the compositor thread\n");
+
 	b->output = output;
 
 	return 0;
@@ -594,8 +760,16 @@ rdp_output_disable(struct weston_output *base)
 	if (!output->base.enabled)
 		return 0;
 
+	if (output->encoder) {
+		rdp_encoder_destroy(output->encoder);
+		output->encoder = NULL;
+	}
+	rdp_output_release_encode_jobs(output);
+	rdp_encode_jobs_release(&output->encode_jobs);
+
 	pixman_image_unref(output->shadow_surface);
 	pixman_renderer_output_destroy(&output->base);
+	rdp_tiles_release(&output->tiles);
 
 	wl_event_source_remove(output->finish_frame_timer);
 	b->output = NULL;
@@ -736,6 +910,7 @@ rdp_peer_context_new(freerdp_peer* client, RdpPeerContext* context)
 {
 	context->item.peer = client;
 	context->item.flags = RDP_PEER_OUTPUT_ENABLED;
+	pixman_region32_init(&context->item.pending);
 
 #if FREERDP_VERSION_MAJOR == 1 && FREERDP_VERSION_MINOR == 1
 	context->rfx_context = rfx_context_new();
@@ -773,10 +948,17 @@ out_error_stream:
 static void
 rdp_peer_context_free(freerdp_peer* client, RdpPeerContext* context)
 {
+	struct rdp_output *output;
 	int i;
 	if (!context)
 		return;
 
+	/* The encoders may still be using this peer's contexts */
+	output = context->rdpBackend ? context->rdpBackend->output : NULL;
+	if (output && output->encoder)
+		rdp_encoder_drop_peer(output->encoder, &output->encode_jobs,
+				      &context->item);
+
 	wl_list_remove(&context->item.link);
 	for (i = 0; i < MAX_FREERDP_FDS; i++) {
 		if (context->events[i])
@@ -794,6 +976,7 @@ rdp_peer_context_free(freerdp_peer* client, RdpPeerContext* context)
 	nsc_context_free(context->nsc_context);
 	rfx_context_free(context->rfx_context);
 	free(context->rfx_rects);
+	pixman_region32_fini(&context->item.pending);
 }
 
 
@@ -978,6 +1161,8 @@ xf_peer_activate(freerdp_peer* client)
 	output = b->output;
 	settings = client->settings;
 
+	rdp_output_flush_encoder(output);
+
 	if (!settings->SurfaceCommandsEnabled) {
 		weston_log("client doesn't support required SurfaceCommands\n");
 		return FALSE;
@@ -1082,6 +1267,7 @@ xf_peer_activate(freerdp_peer* client)
 	pixman_region32_init_with_extents(&damage, &box);
 
 	rdp_peer_refresh_region(&damage, client);
+	pixman_region32_clear(&peerCtx->item.pending);
 
 	pixman_region32_fini(&damage);
 
@@ -1185,6 +1371,8 @@ xf_input_synchronize_event(rdpInput *input, UINT32 flags)
 	pixman_box32_t box;
 	pixman_region32_t damage;
 
+	rdp_output_flush_encoder(output);
+
 	/* sends a full refresh */
 	box.x1 = 0;
 	box.y1 = 0;
@@ -1193,6 +1381,7 @@ xf_input_synchronize_event(rdpInput *input, UINT32 flags)
 	pixman_region32_init_with_extents(&damage, &box);
 
 	rdp_peer_refresh_region(&damage, client);
+	pixman_region32_clear(&peerCtx->item.pending);
 
 	pixman_region32_fini(&damage);
 	FREERDP_CB_RETURN(TRUE);
@@ -1252,11 +1441,20 @@ static FREERDP_CB_RET_TYPE
 xf_suppress_output(rdpContext *context, BYTE allow, const RECTANGLE_16 *area)
 {
 	RdpPeerContext *peerContext = (RdpPeerContext *)context;
+	struct rdp_peers_item *item = &peerContext->item;
 
 	if (allow)
-		peerContext->item.flags |= RDP_PEER_OUTPUT_ENABLED;
+		item->flags |= RDP_PEER_OUTPUT_ENABLED;
 	else
-		peerContext->item.flags &= (~RDP_PEER_OUTPUT_ENABLED);
+		item->flags &= (~RDP_PEER_OUTPUT_ENABLED);
+
+	/* catch up with what changed while suppressed */
+	if (allow && (item->flags & RDP_PEER_ACTIVATED) &&
+	    pixman_region32_not_empty(&item->pending)) {
+		rdp_output_flush_encoder(peerContext->rdpBackend->output);
+		rdp_peer_refresh_region(&item->pending, item->peer);
+		pixman_region32_clear(&item->pending);
+	}
 
 	FREERDP_CB_RETURN(TRUE);
 }
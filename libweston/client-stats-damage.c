@@ -0,0 +1,86 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "client-stats-damage.h"
+
+static uint64_t
+region_area(pixman_region32_t *region)
+{
+	pixman_box32_t *boxes;
+	uint64_t area = 0;
+	int n, i;
+
+	boxes = pixman_region32_rectangles(region, &n);
+	for (i = 0; i < n; i++)
+		area += (uint64_t)(boxes[i].x2 - boxes[i].x1) *
+			(boxes[i].y2 - boxes[i].y1);
+
+	return area;
+}
+
+/** The area of damage within a width x height rectangle at the origin
+ *
+ * Clients may damage far beyond their surface, up to INT32_MAX in both
+ * directions, which is clipped away here so the counters stay meaningful.
+ */
+uint64_t
+client_stats_damage_area(pixman_region32_t *damage,
+			 int32_t width, int32_t height)
+{
+	pixman_region32_t clipped;
+	uint64_t area;
+
+	if (width <= 0 || height <= 0)
+		return 0;
+
+	pixman_region32_init(&clipped);
+	pixman_region32_intersect_rect(&clipped, damage, 0, 0, width, height);
+	area = region_area(&clipped);
+	pixman_region32_fini(&clipped);
+
+	return area;
+}
+
+/** Estimate the bytes uploaded for the surface damage of an SHM buffer
+ *
+ * damage is in surface coordinates and within the surface; the renderers
+ * upload whole damaged rectangles of the buffer, scale times as wide and
+ * as high.
+ */
+uint64_t
+client_stats_upload_bytes(pixman_region32_t *damage, int32_t stride,
+			  int32_t width, int32_t scale)
+{
+	uint64_t bpp;
+
+	if (width <= 0 || stride <= 0 || scale <= 0)
+		return 0;
+
+	bpp = stride / width;
+
+	return region_area(damage) * bpp * scale * scale;
+}
@@ -0,0 +1,613 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+#include "libweston-internal.h"
+#include "client-stats-damage.h"
+#include "linux-dmabuf.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+
+#define CLIENT_STATS_PERIOD_MS 1000
+
+/*
+ * Per-client accounting
+ *
+ * Counters are kept for every client that sent a request, and looked up
+ * through the client's destroy listener, so nothing needs to hold on to
+ * them. Time spent in request handlers is measured with a protocol logger,
+ * installed only while the 'client-stats' scope has subscribers: an
+ * interval opens when a client's request is about to be dispatched and
+ * closes at the next request, when the compositor gets to repaint or to
+ * process input, see weston_client_stats_dispatch_end(), or at the latest
+ * once the event loop goes idle. Buffer
+ * memory, outstanding frame callbacks and the client's name are collected
+ * when a report is made.
+ */
+
+struct weston_client_stats_sample {
+	struct timespec time;
+	uint64_t commits;
+	uint64_t damage_pixels;
+	uint64_t flush_bytes;
+	uint64_t handler_nsec;
+};
+
+struct weston_client_stats {
+	struct weston_client_stats_context *ctx;
+	struct wl_client *client;
+	struct wl_listener destroy_listener;
+	struct wl_list link; /* weston_client_stats_context::client_list */
+
+	pid_t pid;
+	char name[32]; /* empty until the first report */
+
+	uint64_t commits;
+	uint64_t damage_pixels;
+	uint64_t flush_bytes;
+	uint64_t handler_nsec;
+
+	/* totals at the previous report, for the rates */
+	struct weston_client_stats_sample sample;
+};
+
+struct weston_client_stats_context {
+	struct weston_compositor *compositor;
+	struct wl_list client_list; /* weston_client_stats::link */
+
+	struct weston_log_scope *scope;
+	int subscriptions;
+	struct wl_event_source *report_timer;
+	bool report_timer_armed;
+
+	struct wl_protocol_logger *logger;
+	struct weston_client_stats *dispatch;
+	struct timespec dispatch_start;
+	struct wl_event_source *dispatch_idle;
+};
+
+static void
+client_stats_destroy(struct weston_client_stats *stats)
+{
+	struct weston_client_stats_context *ctx = stats->ctx;
+	struct timespec now;
+
+	if (ctx->dispatch == stats) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		stats->handler_nsec += timespec_sub_to_nsec(&now,
+							    &ctx->dispatch_start);
+		ctx->dispatch = NULL;
+	}
+
+	wl_list_remove(&stats->destroy_listener.link);
+	wl_list_remove(&stats->link);
+	free(stats);
+}
+
+static void
+client_stats_client_destroyed(struct wl_listener *listener, void *data)
+{
+	struct weston_client_stats *stats =
+		container_of(listener, struct weston_client_stats,
+			     destroy_listener);
+
+	client_stats_destroy(stats);
+}
+
+static void
+client_stats_read_name(struct weston_client_stats *stats)
+{
+	char path[64];
+	FILE *fp;
+
+	strcpy(stats->name, "?");
+
+	snprintf(path, sizeof(path), "/proc/%d/comm", (int)stats->pid);
+	fp = fopen(path, "r");
+	if (!fp)
+		return;
+
+	if (fgets(stats->name, sizeof(stats->name), fp))
+		stats->name[strcspn(stats->name, "\n")] = '\0';
+	fclose(fp);
+}
+
+static struct weston_client_stats *
+client_stats_get(struct weston_client_stats_context *ctx,
+		 struct wl_client *client)
+{
+	struct weston_client_stats *stats;
+	struct wl_listener *listener;
+
+	listener = wl_client_get_destroy_listener(client,
+						  client_stats_client_destroyed);
+	if (listener)
+		return container_of(listener, struct weston_client_stats,
+				    destroy_listener);
+
+	stats = zalloc(sizeof(*stats));
+	if (!stats)
+		return NULL;
+
+	stats->ctx = ctx;
+	stats->client = client;
+	wl_client_get_credentials(client, &stats->pid, NULL, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &stats->sample.time);
+
+	stats->destroy_listener.notify = client_stats_client_destroyed;
+	wl_client_add_destroy_listener(client, &stats->destroy_listener);
+	wl_list_insert(ctx->client_list.prev, &stats->link);
+
+	return stats;
+}
+
+static struct weston_client_stats *
+client_stats_from_surface(struct weston_surface *surface)
+{
+	struct weston_client_stats_context *ctx =
+		surface->compositor->client_stats;
+
+	if (!ctx || !surface->resource)
+		return NULL;
+
+	return client_stats_get(ctx, wl_resource_get_client(surface->resource));
+}
+
+/* The size of a buffer that may not have been attached to a renderer yet,
+ * or 0x0 if it can not be told. */
+static void
+buffer_size(struct weston_buffer *buffer, int32_t *width, int32_t *height)
+{
+	struct linux_dmabuf_buffer *dmabuf;
+	struct wl_shm_buffer *shm;
+
+	*width = buffer->width;
+	*height = buffer->height;
+	if (*width > 0 && *height > 0)
+		return;
+
+	shm = wl_shm_buffer_get(buffer->resource);
+	if (shm) {
+		*width = wl_shm_buffer_get_width(shm);
+		*height = wl_shm_buffer_get_height(shm);
+		return;
+	}
+
+	dmabuf = linux_dmabuf_buffer_get(buffer->resource);
+	if (dmabuf) {
+		*width = dmabuf->attributes.width;
+		*height = dmabuf->attributes.height;
+	}
+}
+
+/** Account a wl_surface.commit
+ *
+ * Called before the pending state is applied. Damage is clipped to the
+ * buffer it applies to, and to the surface, which is taken to be at least
+ * as large as a newly attached buffer.
+ */
+void
+weston_client_stats_commit(struct weston_surface *surface)
+{
+	struct weston_client_stats *stats = client_stats_from_surface(surface);
+	struct weston_surface_state *pending = &surface->pending;
+	struct weston_buffer *buffer = surface->buffer_ref.buffer;
+	int32_t scale = pending->buffer_viewport.buffer.scale;
+	int32_t width = surface->width;
+	int32_t height = surface->height;
+	int32_t buffer_width = 0;
+	int32_t buffer_height = 0;
+
+	if (!stats)
+		return;
+
+	if (pending->newly_attached)
+		buffer = pending->buffer;
+	if (buffer)
+		buffer_size(buffer, &buffer_width, &buffer_height);
+	if (scale > 0) {
+		width = MAX(width, buffer_width / scale);
+		height = MAX(height, buffer_height / scale);
+	}
+
+	stats->commits++;
+	stats->damage_pixels +=
+		client_stats_damage_area(&pending->damage_surface,
+					 width, height) +
+		client_stats_damage_area(&pending->damage_buffer,
+					 buffer_width, buffer_height);
+}
+
+/** Account the upload of the surface damage of an SHM buffer
+ *
+ * The amount is estimated from the damaged area and the buffer stride, as
+ * the renderers upload whole damaged rectangles.
+ */
+void
+weston_client_stats_flush_damage(struct weston_surface *surface)
+{
+	struct weston_client_stats *stats;
+	struct wl_shm_buffer *shm;
+
+	if (!surface->buffer_ref.buffer)
+		return;
+
+	shm = wl_shm_buffer_get(surface->buffer_ref.buffer->resource);
+	if (!shm)
+		return;
+
+	stats = client_stats_from_surface(surface);
+	if (!stats)
+		return;
+
+	stats->flush_bytes +=
+		client_stats_upload_bytes(&surface->damage,
+					  wl_shm_buffer_get_stride(shm),
+					  wl_shm_buffer_get_width(shm),
+					  surface->buffer_viewport.buffer.scale);
+}
+
+static uint64_t
+buffer_bytes(struct weston_buffer *buffer)
+{
+	struct linux_dmabuf_buffer *dmabuf;
+	struct wl_shm_buffer *shm;
+	uint64_t bytes = 0;
+	int i;
+
+	shm = wl_shm_buffer_get(buffer->resource);
+	if (shm)
+		return (uint64_t)wl_shm_buffer_get_stride(shm) *
+		       wl_shm_buffer_get_height(shm);
+
+	dmabuf = linux_dmabuf_buffer_get(buffer->resource);
+	if (dmabuf) {
+		for (i = 0; i < dmabuf->attributes.n_planes; i++)
+			bytes += (uint64_t)dmabuf->attributes.stride[i] *
+				 dmabuf->attributes.height;
+		return bytes;
+	}
+
+	/* EGL buffers, assuming 32 bpp */
+	return (uint64_t)buffer->width * buffer->height * 4;
+}
+
+struct client_stats_surfaces {
+	uint64_t buffer_bytes;
+	unsigned int frame_callbacks;
+};
+
+static enum wl_iterator_result
+client_stats_collect_surface(struct wl_resource *resource, void *data)
+{
+	struct client_stats_surfaces *surfaces = data;
+	struct weston_surface *surface;
+
+	if (strcmp(wl_resource_get_class(resource), "wl_surface") != 0)
+		return WL_ITERATOR_CONTINUE;
+
+	surface = wl_resource_get_user_data(resource);
+	if (!surface)
+		return WL_ITERATOR_CONTINUE;
+
+	if (surface->buffer_ref.buffer)
+		surfaces->buffer_bytes += buffer_bytes(surface->buffer_ref.buffer);
+
+	surfaces->frame_callbacks +=
+		wl_list_length(&surface->frame_callback_list) +
+		wl_list_length(&surface->pending.frame_callback_list);
+
+	return WL_ITERATOR_CONTINUE;
+}
+
+static void
+client_stats_print_client(struct weston_client_stats *stats, FILE *fp,
+			  const char *prefix, const struct timespec *now)
+{
+	struct weston_client_stats_sample *s = &stats->sample;
+	struct client_stats_surfaces surfaces = { 0 };
+	double secs;
+
+	/* read here rather than on the first request, off the client's
+	 * critical path */
+	if (stats->name[0] == '\0')
+		client_stats_read_name(stats);
+
+	wl_client_for_each_resource(stats->client,
+				    client_stats_collect_surface, &surfaces);
+
+	secs = timespec_sub_to_nsec(now, &s->time) / 1e9;
+	if (secs <= 0.0)
+		secs = 1.0;
+
+	fprintf(fp, "%sclient %d (%s): %.1f commits/s, "
+		"%.0f damage px/s, %.1f KiB/s flushed, "
+		"%.2f ms/s in handlers, %" PRIu64 " KiB buffers, "
+		"%u frame callbacks\n",
+		prefix, (int)stats->pid, stats->name,
+		(stats->commits - s->commits) / secs,
+		(stats->damage_pixels - s->damage_pixels) / secs,
+		(stats->flush_bytes - s->flush_bytes) / 1024.0 / secs,
+		(stats->handler_nsec - s->handler_nsec) / 1e6 / secs,
+		surfaces.buffer_bytes / 1024,
+		surfaces.frame_callbacks);
+
+	s->time = *now;
+	s->commits = stats->commits;
+	s->damage_pixels = stats->damage_pixels;
+	s->flush_bytes = stats->flush_bytes;
+	s->handler_nsec = stats->handler_nsec;
+}
+
+/** Print one line per client to fp
+ *
+ * Rates are computed over the time since the previous report, which is
+ * shared between the 'client-stats' scope and the scene-graph dump.
+ */
+void
+weston_client_stats_print(struct weston_compositor *compositor, FILE *fp,
+			  const char *prefix)
+{
+	struct weston_client_stats_context *ctx = compositor->client_stats;
+	struct weston_client_stats *stats;
+	struct timespec now;
+
+	if (!ctx)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	wl_list_for_each(stats, &ctx->client_list, link)
+		client_stats_print_client(stats, fp, prefix, &now);
+}
+
+static void
+client_stats_report(struct weston_client_stats_context *ctx)
+{
+	char *str;
+	size_t len;
+	FILE *fp;
+
+	fp = open_memstream(&str, &len);
+	if (!fp)
+		return;
+
+	weston_client_stats_print(ctx->compositor, fp, "");
+	if (fclose(fp) == 0 && len > 0)
+		weston_log_scope_write(ctx->scope, str, len);
+	free(str);
+}
+
+static int
+client_stats_report_handler(void *data)
+{
+	struct weston_client_stats_context *ctx = data;
+
+	ctx->report_timer_armed = false;
+	if (!weston_log_scope_is_enabled(ctx->scope))
+		return 0;
+
+	client_stats_report(ctx);
+
+	wl_event_source_timer_update(ctx->report_timer, CLIENT_STATS_PERIOD_MS);
+	ctx->report_timer_armed = true;
+
+	return 0;
+}
+
+static void
+client_stats_dispatch_end(struct weston_client_stats_context *ctx,
+			  const struct timespec *now)
+{
+	if (!ctx->dispatch)
+		return;
+
+	ctx->dispatch->handler_nsec += timespec_sub_to_nsec(now,
+							    &ctx->dispatch_start);
+	ctx->dispatch = NULL;
+}
+
+/** Stop charging the client whose requests were dispatched last
+ *
+ * libwayland does not tell when it is done with a client's requests, so
+ * the interval opened for the last request would otherwise run on until
+ * the event loop goes idle, and include whatever other sources were
+ * dispatched in the same loop iteration. Entry points for work that is
+ * not done on behalf of a client, like repaints and input, call this
+ * first.
+ */
+WL_EXPORT void
+weston_client_stats_dispatch_end(struct weston_compositor *compositor)
+{
+	struct weston_client_stats_context *ctx = compositor->client_stats;
+	struct timespec now;
+
+	if (!ctx || !ctx->dispatch)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	client_stats_dispatch_end(ctx, &now);
+}
+
+static void
+client_stats_dispatch_idle(void *data)
+{
+	struct weston_client_stats_context *ctx = data;
+	struct timespec now;
+
+	ctx->dispatch_idle = NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	client_stats_dispatch_end(ctx, &now);
+}
+
+static void
+client_stats_protocol_logger(void *data,
+			     enum wl_protocol_logger_type direction,
+			     const struct wl_protocol_logger_message *message)
+{
+	struct weston_client_stats_context *ctx = data;
+	struct wl_event_loop *loop;
+	struct timespec now;
+
+	if (direction != WL_PROTOCOL_LOGGER_REQUEST)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	client_stats_dispatch_end(ctx, &now);
+
+	ctx->dispatch = client_stats_get(ctx,
+			wl_resource_get_client(message->resource));
+	ctx->dispatch_start = now;
+
+	if (!ctx->dispatch_idle) {
+		loop = wl_display_get_event_loop(ctx->compositor->wl_display);
+		ctx->dispatch_idle =
+			wl_event_loop_add_idle(loop, client_stats_dispatch_idle,
+					       ctx);
+	}
+}
+
+static void
+client_stats_subscribe(struct weston_log_subscription *sub, void *data)
+{
+	struct weston_client_stats_context *ctx = data;
+	struct wl_display *display = ctx->compositor->wl_display;
+
+	weston_log_subscription_printf(sub,
+		"Per-client activity, reported every %d ms\n",
+		CLIENT_STATS_PERIOD_MS);
+
+	ctx->subscriptions++;
+	if (!ctx->logger)
+		ctx->logger =
+			wl_display_add_protocol_logger(display,
+						       client_stats_protocol_logger,
+						       ctx);
+
+	if (ctx->report_timer_armed)
+		return;
+
+	wl_event_source_timer_update(ctx->report_timer, CLIENT_STATS_PERIOD_MS);
+	ctx->report_timer_armed = true;
+}
+
+/* Stops measuring handler time, closing the interval that is open. */
+static void
+client_stats_remove_logger(struct weston_client_stats_context *ctx)
+{
+	struct timespec now;
+
+	if (!ctx->logger)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	client_stats_dispatch_end(ctx, &now);
+
+	wl_protocol_logger_destroy(ctx->logger);
+	ctx->logger = NULL;
+	if (ctx->dispatch_idle) {
+		wl_event_source_remove(ctx->dispatch_idle);
+		ctx->dispatch_idle = NULL;
+	}
+}
+
+static void
+client_stats_unsubscribe(struct weston_log_subscription *sub, void *data)
+{
+	struct weston_client_stats_context *ctx = data;
+
+	if (--ctx->subscriptions == 0)
+		client_stats_remove_logger(ctx);
+}
+
+/** Set up per-client accounting and the 'client-stats' scope */
+int
+weston_client_stats_init(struct weston_compositor *compositor)
+{
+	struct weston_client_stats_context *ctx;
+	struct wl_event_loop *loop;
+
+	ctx = zalloc(sizeof(*ctx));
+	if (!ctx)
+		return -1;
+
+	ctx->compositor = compositor;
+	wl_list_init(&ctx->client_list);
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+	ctx->report_timer = wl_event_loop_add_timer(loop,
+						    client_stats_report_handler,
+						    ctx);
+	if (!ctx->report_timer) {
+		free(ctx);
+		return -1;
+	}
+
+	ctx->scope =
+		weston_compositor_add_log_scope(compositor->weston_log_ctx,
+						"client-stats",
+						"Per-client commits, damage, "
+						"uploads, buffer memory and "
+						"request handling time\n",
+						client_stats_subscribe,
+						client_stats_unsubscribe,
+						ctx);
+
+	compositor->client_stats = ctx;
+
+	return 0;
+}
+
+void
+weston_client_stats_fini(struct weston_compositor *compositor)
+{
+	struct weston_client_stats_context *ctx = compositor->client_stats;
+	struct weston_client_stats *stats, *tmp;
+
+	if (!ctx)
+		return;
+
+	client_stats_remove_logger(ctx);
+
+	wl_list_for_each_safe(stats, tmp, &ctx->client_list, link)
+		client_stats_destroy(stats);
+
+	weston_compositor_log_scope_destroy(ctx->scope);
+	wl_event_source_remove(ctx->report_timer);
+	free(ctx);
+
+	compositor->client_stats = NULL;
+}
@@ -25,22 +25,38 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <linux/input.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/uio.h>
 
 #include <libweston/libweston.h>
 #include "shared/helpers.h"
+#include "shared/os-compatibility.h"
 
+/* The most we move between file descriptors per dispatch */
+#define CLIPBOARD_CHUNK_SIZE (1024 * 1024)
+
+/*
+ * The selection is kept in an anonymous file, a sealed memfd when
+ * available, which is filled with splice() from the source pipe. Every
+ * paste reads from that file at its own offset with splice(), or
+ * sendfile() when the receiving end is not a pipe, so the contents are
+ * never copied through user space and concurrent pastes share them.
+ */
 struct clipboard_source {
 	struct weston_data_source base;
-	struct wl_array contents;
+	int contents_fd;
+	size_t size;
 	struct clipboard *clipboard;
 	struct wl_event_source *event_source;
+	struct wl_list client_list; /* clipboard_client::link */
 	uint32_t serial;
 	int refcount;
 	int fd;
@@ -53,6 +69,13 @@ struct clipboard {
 	struct clipboard_source *source;
 };
 
+struct clipboard_client {
+	struct wl_event_source *event_source;
+	struct wl_list link; /* clipboard_source::client_list */
+	size_t offset;
+	struct clipboard_source *source;
+};
+
 static void clipboard_client_create(struct clipboard_source *source, int fd);
 
 static void
@@ -73,35 +96,101 @@ clipboard_source_unref(struct clipboard_source *source)
 	s = source->base.mime_types.data;
 	free(*s);
 	wl_array_release(&source->base.mime_types);
-	wl_array_release(&source->contents);
+	close(source->contents_fd);
 	free(source);
 }
 
+static int
+clipboard_create_contents_file(void)
+{
+	int fd;
+
+#ifdef HAVE_MEMFD_CREATE
+	fd = memfd_create("weston-clipboard", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd >= 0)
+		return fd;
+#endif
+
+	/* The size only matters for sealing, which is not available here;
+	 * the file grows as it is written. */
+	fd = os_create_anonymous_file(1);
+
+	return fd;
+}
+
+/* Append what is available in the source pipe to the contents file */
+static ssize_t
+clipboard_source_fill(struct clipboard_source *source, int fd)
+{
+	loff_t offset = source->size;
+	char buf[4096];
+	ssize_t len, written, ret;
+
+	len = splice(fd, NULL, source->contents_fd, &offset,
+		     CLIPBOARD_CHUNK_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (len >= 0 || errno != EINVAL)
+		return len;
+
+	/* The contents file system does not support splice */
+	len = read(fd, buf, sizeof buf);
+	for (written = 0; written < len; written += ret) {
+		ret = pwrite(source->contents_fd, buf + written,
+			     len - written, source->size + written);
+		if (ret < 0)
+			return -1;
+	}
+
+	return len;
+}
+
+static void
+clipboard_source_wake_clients(struct clipboard_source *source)
+{
+	struct clipboard_client *client;
+
+	wl_list_for_each(client, &source->client_list, link)
+		wl_event_source_fd_update(client->event_source,
+					  WL_EVENT_WRITABLE);
+}
+
+static void
+clipboard_source_finish(struct clipboard_source *source)
+{
+	wl_event_source_remove(source->event_source);
+	close(source->fd);
+	source->event_source = NULL;
+
+#ifdef HAVE_MEMFD_CREATE
+	/* Nothing writes to it anymore; there is no need to check for the
+	 * return value, the seals are only a safeguard. */
+	fcntl(source->contents_fd, F_ADD_SEALS,
+	      F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE);
+#endif
+
+	/* Let readers that caught up finish */
+	clipboard_source_wake_clients(source);
+}
+
 static int
 clipboard_source_data(int fd, uint32_t mask, void *data)
 {
 	struct clipboard_source *source = data;
 	struct clipboard *clipboard = source->clipboard;
-	char *p;
-	int len, size;
-
-	if (source->contents.alloc - source->contents.size < 1024) {
-		wl_array_add(&source->contents, 1024);
-		source->contents.size -= 1024;
-	}
+	ssize_t len;
 
-	p = source->contents.data + source->contents.size;
-	size = source->contents.alloc - source->contents.size;
-	len = read(fd, p, size);
+	len = clipboard_source_fill(source, fd);
 	if (len == 0) {
-		wl_event_source_remove(source->event_source);
-		close(fd);
-		source->event_source = NULL;
+		clipboard_source_finish(source);
 	} else if (len < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 1;
+
+		clipboard_source_finish(source);
 		clipboard_source_unref(source);
 		clipboard->source = NULL;
 	} else {
-		source->contents.size += len;
+		source->size += len;
+		clipboard_source_wake_clients(source);
 	}
 
 	return 1;
@@ -146,7 +235,11 @@ clipboard_source_create(struct clipboard *clipboard,
 	if (source == NULL)
 		return NULL;
 
-	wl_array_init(&source->contents);
+	source->contents_fd = clipboard_create_contents_file();
+	if (source->contents_fd < 0)
+		goto err_contents;
+
+	wl_list_init(&source->client_list);
 	wl_array_init(&source->base.mime_types);
 	source->base.resource = NULL;
 	source->base.accept = clipboard_source_accept;
@@ -177,38 +270,93 @@ clipboard_source_create(struct clipboard *clipboard,
  err_strdup:
 	wl_array_release(&source->base.mime_types);
  err_add:
+	close(source->contents_fd);
+ err_contents:
 	free(source);
 
 	return NULL;
 }
 
-struct clipboard_client {
-	struct wl_event_source *event_source;
-	size_t offset;
-	struct clipboard_source *source;
-};
+/* Send up to count bytes of the contents file from offset to fd */
+static ssize_t
+clipboard_client_send(struct clipboard_client *client, int fd, size_t count)
+{
+	int contents_fd = client->source->contents_fd;
+	loff_t offset = client->offset;
+	off_t file_offset;
+	char buf[4096];
+	ssize_t len;
+
+	count = MIN(count, CLIPBOARD_CHUNK_SIZE);
+
+	len = splice(contents_fd, &offset, fd, NULL, count,
+		     SPLICE_F_NONBLOCK);
+	if (len < 0 && errno == EINVAL) {
+		/* fd is not a pipe */
+		file_offset = client->offset;
+		len = sendfile(fd, contents_fd, &file_offset, count);
+	}
+	if (len < 0 && errno == EINVAL) {
+		/* sendfile() does not support fds opened for appending */
+		len = pread(contents_fd, buf, MIN(count, sizeof buf),
+			    client->offset);
+		if (len > 0)
+			len = write(fd, buf, len);
+	}
+
+	if (len > 0)
+		client->offset += len;
+
+	return len;
+}
+
+static void
+clipboard_client_destroy(struct clipboard_client *client, int fd)
+{
+	close(fd);
+	wl_event_source_remove(client->event_source);
+	wl_list_remove(&client->link);
+	clipboard_source_unref(client->source);
+	free(client);
+}
 
 static int
 clipboard_client_data(int fd, uint32_t mask, void *data)
 {
 	struct clipboard_client *client = data;
-	char *p;
-	size_t size;
-	int len;
+	struct clipboard_source *source = client->source;
+	ssize_t len = 0;
+
+	/* The reader went away; this is reported even while waiting for
+	 * the source with no events selected. */
+	if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+		clipboard_client_destroy(client, fd);
+		return 1;
+	}
 
-	size = client->source->contents.size;
-	p = client->source->contents.data;
-	len = write(fd, p + client->offset, size - client->offset);
-	if (len > 0)
-		client->offset += len;
+	if (client->offset < source->size) {
+		len = clipboard_client_send(client, fd,
+					    source->size - client->offset);
+		if (len < 0 && (errno == EAGAIN || errno == EINTR))
+			return 1;
 
-	if (client->offset == size || len <= 0) {
-		close(fd);
-		wl_event_source_remove(client->event_source);
-		clipboard_source_unref(client->source);
-		free(client);
+		if (len <= 0) {
+			clipboard_client_destroy(client, fd);
+			return 1;
+		}
+	}
+
+	if (client->offset < source->size)
+		return 1;
+
+	if (source->event_source) {
+		/* Caught up with the source; wait for more */
+		wl_event_source_fd_update(client->event_source, 0);
+		return 1;
 	}
 
+	clipboard_client_destroy(client, fd);
+
 	return 1;
 }
 
@@ -219,16 +367,34 @@ clipboard_client_create(struct clipboard_source *source, int fd)
 	struct clipboard_client *client;
 	struct wl_event_loop *loop =
 		wl_display_get_event_loop(seat->compositor->wl_display);
+	int flags;
+
+	/* The file description may be shared with the client, keep its
+	 * other flags. */
+	flags = fcntl(fd, F_GETFL);
+	if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		close(fd);
+		return;
+	}
 
 	client = zalloc(sizeof *client);
-	if (client == NULL)
+	if (client == NULL) {
+		close(fd);
 		return;
+	}
 
 	client->source = source;
-	source->refcount++;
 	client->event_source =
 		wl_event_loop_add_fd(loop, fd, WL_EVENT_WRITABLE,
 				     clipboard_client_data, client);
+	if (client->event_source == NULL) {
+		close(fd);
+		free(client);
+		return;
+	}
+
+	source->refcount++;
+	wl_list_insert(&source->client_list, &client->link);
 }
 
 static void
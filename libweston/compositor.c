@@ -41,6 +41,7 @@
 #include <sys/wait.h>
 #include <sys/socket.h>
 #include <sys/utsname.h>
+#include <sys/eventfd.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <math.h>
@@ -65,6 +66,7 @@
 #include "linux-explicit-synchronization.h"
 #include "shared/fd-util.h"
 #include "shared/helpers.h"
+#include "shared/histogram.h"
 #include "shared/os-compatibility.h"
 #include "shared/string-helpers.h"
 #include "shared/timespec-util.h"
@@ -1322,9 +1324,9 @@ weston_view_transfer_scissor(struct weston_view *from, struct weston_view *to)
 	pixman_region32_init_with_extents(&to->geometry.scissor, &b);
 }
 
-static void
-view_compute_bbox(struct weston_view *view, const pixman_box32_t *inbox,
-		  pixman_region32_t *bbox)
+WL_EXPORT void
+weston_view_compute_bbox(struct weston_view *view, const pixman_box32_t *inbox,
+			 pixman_region32_t *bbox)
 {
 	float min_x = HUGE_VALF,  min_y = HUGE_VALF;
 	float max_x = -HUGE_VALF, max_y = -HUGE_VALF;
@@ -1450,7 +1452,7 @@ weston_view_update_transform_enable(struct weston_view *view)
 					  &view->geometry.scissor);
 	surfbox = pixman_region32_extents(&surfregion);
 
-	view_compute_bbox(view, surfbox, &view->transform.boundingbox);
+	weston_view_compute_bbox(view, surfbox, &view->transform.boundingbox);
 	pixman_region32_fini(&surfregion);
 
 	return 0;
@@ -2399,8 +2401,10 @@ static void
 surface_flush_damage(struct weston_surface *surface)
 {
 	if (surface->buffer_ref.buffer &&
-	    wl_shm_buffer_get(surface->buffer_ref.buffer->resource))
+	    wl_shm_buffer_get(surface->buffer_ref.buffer->resource)) {
+		weston_client_stats_flush_damage(surface);
 		surface->compositor->renderer->flush_damage(surface);
+	}
 
 	if (pixman_region32_not_empty(&surface->damage))
 		TL_POINT(surface->compositor, "core_flush_damage", TLP_SURFACE(surface),
@@ -2420,7 +2424,7 @@ view_accumulate_damage(struct weston_view *view,
 		pixman_box32_t *extents;
 
 		extents = pixman_region32_extents(&view->surface->damage);
-		view_compute_bbox(view, extents, &damage);
+		weston_view_compute_bbox(view, extents, &damage);
 	} else {
 		pixman_region32_copy(&damage, &view->surface->damage);
 		pixman_region32_translate(&damage,
@@ -2649,6 +2653,126 @@ weston_output_take_feedback_list(struct weston_output *output,
 	wl_list_init(&surface->feedback_list);
 }
 
+/** Frame timing of an output
+ *
+ * All durations are in microseconds. Recording costs a few clock reads per
+ * frame, so this is always on; the 'repaint-stats' scope prints it.
+ */
+struct weston_output_repaint_stats {
+	/** whole of weston_output_repaint() */
+	struct weston_histogram repaint;
+	/** from next_repaint to the repaint actually starting */
+	struct weston_histogram lateness;
+	/** weston_output::repaint(), i.e. rendering and backend submission */
+	struct weston_histogram submit;
+	/** from the presentation timestamp to weston_output_finish_frame() */
+	struct weston_histogram finish_delay;
+
+	uint64_t frames;
+	uint64_t frames_missed;
+	uint64_t missed_vblanks;
+	uint64_t skipped;
+
+	/* next_repaint was derived from a presentation timestamp */
+	bool next_repaint_from_vblank;
+	/* expected presentation time of the frame in flight */
+	bool target_valid;
+	struct timespec target;
+};
+
+static struct weston_output_repaint_stats *
+weston_output_repaint_stats_create(void)
+{
+	struct weston_output_repaint_stats *stats;
+
+	stats = zalloc(sizeof(*stats));
+	if (!stats)
+		return NULL;
+
+	weston_histogram_init(&stats->repaint);
+	weston_histogram_init(&stats->lateness);
+	weston_histogram_init(&stats->submit);
+	weston_histogram_init(&stats->finish_delay);
+
+	return stats;
+}
+
+static void
+weston_output_repaint_stats_begin(struct weston_output *output,
+				  const struct timespec *now)
+{
+	struct weston_output_repaint_stats *stats = output->repaint_stats;
+	int64_t late_nsec;
+
+	late_nsec = timespec_sub_to_nsec(now, &output->next_repaint);
+	weston_histogram_record(&stats->lateness, MAX(late_nsec, 0) / 1000);
+
+	/* The repaint deadline is repaint_msec before the vblank the frame
+	 * is meant for. */
+	stats->target_valid = stats->next_repaint_from_vblank;
+	if (stats->target_valid)
+		timespec_add_msec(&stats->target, &output->next_repaint,
+				  output->compositor->repaint_msec);
+}
+
+static void
+weston_output_repaint_stats_finish(struct weston_output *output,
+				   const struct timespec *stamp,
+				   uint32_t presented_flags,
+				   const struct timespec *now)
+{
+	struct weston_output_repaint_stats *stats = output->repaint_stats;
+	bool target_valid = stats->target_valid;
+	int64_t refresh_nsec;
+	int64_t late_nsec;
+
+	stats->next_repaint_from_vblank = false;
+	stats->target_valid = false;
+
+	/* Restarting the repaint loop, not a frame */
+	if (!stamp || (presented_flags & WP_PRESENTATION_FEEDBACK_INVALID))
+		return;
+
+	stats->frames++;
+	weston_histogram_record(&stats->finish_delay,
+				MAX(timespec_sub_to_nsec(now, stamp), 0) / 1000);
+
+	refresh_nsec = millihz_to_nsec(output->current_mode->refresh);
+	if (!target_valid || refresh_nsec <= 0)
+		return;
+
+	late_nsec = timespec_sub_to_nsec(stamp, &stats->target);
+	if (late_nsec <= refresh_nsec / 2)
+		return;
+
+	stats->frames_missed++;
+	stats->missed_vblanks += (late_nsec + refresh_nsec / 2) / refresh_nsec;
+}
+
+static void
+weston_output_repaint_stats_print(struct weston_output *output, FILE *fp)
+{
+	struct weston_output_repaint_stats *stats = output->repaint_stats;
+
+	fprintf(fp, "Output %d (%s):\n", output->id, output->name);
+	if (!stats) {
+		fprintf(fp, "\t[no statistics]\n");
+		return;
+	}
+
+	fprintf(fp, "\tframes: %" PRIu64 ", late: %" PRIu64
+		" (%" PRIu64 " missed vblanks), skipped repaints: %" PRIu64 "\n",
+		stats->frames, stats->frames_missed, stats->missed_vblanks,
+		stats->skipped);
+	weston_histogram_print_usec(&stats->repaint, fp, "\t", "repaint");
+	weston_histogram_print_usec(&stats->lateness, fp, "\t",
+				    "repaint start after deadline");
+	weston_histogram_print_usec(&stats->submit, fp, "\t",
+				    "backend submit");
+	weston_histogram_print_usec(&stats->finish_delay, fp, "\t",
+				    "finish-frame delay");
+}
+
 static int
 weston_output_repaint(struct weston_output *output, void *repaint_data)
 {
@@ -2661,11 +2785,14 @@ weston_output_repaint(struct weston_output *output, void *repaint_data)
 	int r;
 	uint32_t frame_time_msec;
 	enum weston_hdcp_protection highest_requested = WESTON_HDCP_DISABLE;
+	struct weston_output_repaint_stats *stats = output->repaint_stats;
+	struct timespec begin, submit, end;
 
 	if (output->destroying)
 		return 0;
 
 	TL_POINT(ec, "core_repaint_begin", TLP_OUTPUT(output), TLP_END);
+	weston_compositor_read_presentation_clock(ec, &begin);
 
 	/* Rebuild the surface list and update surface transforms up front. */
 	weston_compositor_build_view_list(ec);
@@ -2718,13 +2845,22 @@ weston_output_repaint(struct weston_output *output, void *repaint_data)
 	pixman_region32_subtract(&output_damage,
 				 &output_damage, &ec->primary_plane.clip);
 
+	weston_compositor_read_presentation_clock(ec, &submit);
 	r = output->repaint(output, &output_damage, repaint_data);
+	weston_compositor_read_presentation_clock(ec, &end);
 
 	pixman_region32_fini(&output_damage);
 
+	if (stats) {
+		weston_histogram_record(&stats->submit,
+					timespec_sub_to_nsec(&end, &submit) / 1000);
+	}
+
 	output->repaint_needed = false;
-	if (r == 0)
+	if (r == 0) {
 		output->repaint_status = REPAINT_AWAITING_COMPLETION;
+		weston_input_latency_repaint(output);
+	}
 
 	weston_compositor_repick(ec);
 
@@ -2742,6 +2878,12 @@ weston_output_repaint(struct weston_output *output, void *repaint_data)
 
 	TL_POINT(ec, "core_repaint_posted", TLP_OUTPUT(output), TLP_END);
 
+	if (stats) {
+		weston_compositor_read_presentation_clock(ec, &end);
+		weston_histogram_record(&stats->repaint,
+					timespec_sub_to_nsec(&end, &begin) / 1000);
+	}
+
 	return r;
 }
 
@@ -2777,8 +2919,14 @@ weston_output_maybe_repaint(struct weston_output *output, struct timespec *now,
 
 	/* We don't actually need to repaint this output; drop it from
 	 * repaint until something causes damage. */
-	if (!output->repaint_needed)
+	if (!output->repaint_needed) {
+		if (output->repaint_stats)
+			output->repaint_stats->skipped++;
 		goto err;
+	}
+
+	if (output->repaint_stats)
+		weston_output_repaint_stats_begin(output, now);
 
 	/* If repaint fails, we aren't going to get weston_output_finish_frame
 	 * to trigger a new repaint, so drop it from repaint and hope
@@ -2803,8 +2951,10 @@ output_repaint_timer_arm(struct weston_compositor *compositor)
 {
 	struct weston_output *output;
 	bool any_should_repaint = false;
+	bool any_unthrottled_due = false;
 	struct timespec now;
 	int64_t msec_to_next = INT64_MAX;
+	uint64_t one = 1;
 
 	weston_compositor_read_presentation_clock(compositor, &now);
 
@@ -2819,12 +2969,26 @@ output_repaint_timer_arm(struct weston_compositor *compositor)
 		if (!any_should_repaint || msec_to_this < msec_to_next)
 			msec_to_next = msec_to_this;
 
+		if (output->repaint_unthrottled && msec_to_this < 1)
+			any_unthrottled_due = true;
+
 		any_should_repaint = true;
 	}
 
 	if (!any_should_repaint)
 		return;
 
+	/* Unthrottled outputs repaint as soon as the event loop has polled
+	 * the clients once. The wakeup goes through epoll like the client
+	 * fds, unlike an idle source, and without the timer's delay. The
+	 * handler arms the timer again for the other outputs. */
+	if (any_unthrottled_due && compositor->repaint_wakeup) {
+		while (write(compositor->repaint_wakeup_fd,
+			     &one, sizeof one) < 0 && errno == EINTR)
+			;
+		return;
+	}
+
 	/* Even if we should repaint immediately, add the minimum 1 ms delay.
 	 * This is a workaround to allow coalescing multiple output repaints
 	 * particularly from weston_output_finish_frame()
@@ -2846,6 +3010,7 @@ output_repaint_timer_handler(void *data)
 	void *repaint_data = NULL;
 	int ret = 0;
 
+	weston_client_stats_dispatch_end(compositor);
 	weston_compositor_read_presentation_clock(compositor, &now);
 
 	if (compositor->backend->repaint_begin)
@@ -2882,6 +3047,18 @@ output_repaint_timer_handler(void *data)
 	return 0;
 }
 
+static int
+output_repaint_wakeup_handler(int fd, uint32_t mask, void *data)
+{
+	struct weston_compositor *compositor = data;
+	uint64_t count;
+
+	if (read(fd, &count, sizeof count) < 0)
+		return 0;
+
+	return output_repaint_timer_handler(compositor);
+}
+
 /**
  * \ingroup output
  */
@@ -2899,8 +3076,15 @@ weston_output_finish_frame(struct weston_output *output,
 	assert(output->repaint_status == REPAINT_AWAITING_COMPLETION);
 	assert(stamp || (presented_flags & WP_PRESENTATION_FEEDBACK_INVALID));
 
+	weston_client_stats_dispatch_end(compositor);
 	weston_compositor_read_presentation_clock(compositor, &now);
 
+	if (output->repaint_stats)
+		weston_output_repaint_stats_finish(output, stamp, presented_flags,
+						   &now);
+
+	weston_input_latency_presented(output, stamp ? stamp : &now);
+
 	/* If we haven't been supplied any timestamp at all, we don't have a
 	 * timebase to work against, so any delay just wastes time. Push a
 	 * repaint as soon as possible so we can get on with it. */
@@ -2920,6 +3104,11 @@ weston_output_finish_frame(struct weston_output *output,
 
 	output->frame_time = *stamp;
 
+	if (output->repaint_unthrottled) {
+		output->next_repaint = now;
+		goto out;
+	}
+
 	timespec_add_nsec(&output->next_repaint, stamp, refresh_nsec);
 	timespec_add_msec(&output->next_repaint, &output->next_repaint,
 			  -compositor->repaint_msec);
@@ -2934,6 +3123,8 @@ weston_output_finish_frame(struct weston_output *output,
 		warned = true;
 
 		output->next_repaint = now;
+	} else if (output->repaint_stats) {
+		output->repaint_stats->next_repaint_from_vblank = true;
 	}
 
 	/* Called from restart_repaint_loop and restart happens already after
@@ -3698,6 +3889,9 @@ surface_commit(struct wl_client *client, struct wl_resource *resource)
 		return;
 	}
 
+	weston_client_stats_commit(surface);
+	weston_input_latency_commit(surface);
+
 	if (sub) {
 		weston_subsurface_commit(sub);
 		return;
@@ -5866,6 +6060,8 @@ weston_compositor_add_output(struct weston_compositor *compositor,
 	wl_list_insert(compositor->output_list.prev, &output->link);
 	output->enabled = true;
 
+	output->repaint_stats = weston_output_repaint_stats_create();
+
 	wl_list_for_each(head, &output->head_list, output_link)
 		weston_head_add_global(head);
 
@@ -5957,6 +6153,9 @@ weston_compositor_remove_output(struct weston_output *output)
 	wl_list_insert(compositor->pending_output_list.prev, &output->link);
 	output->enabled = false;
 
+	free(output->repaint_stats);
+	output->repaint_stats = NULL;
+
 	wl_signal_emit(&compositor->output_destroyed_signal, output);
 	wl_signal_emit(&output->destroy_signal, output);
 
@@ -7176,6 +7375,9 @@ weston_compositor_print_scene_graph(struct weston_compositor *ec)
 		fprintf(fp, "\n");
 	}
 
+	fprintf(fp, "Clients:\n");
+	weston_client_stats_print(ec, fp, "\t");
+
 	err = fclose(fp);
 	assert(err == 0);
 
@@ -7198,6 +7400,33 @@ debug_scene_graph_cb(struct weston_log_subscription *sub, void *data)
 	weston_log_subscription_complete(sub);
 }
 
+/**
+ * Called when the 'repaint-stats' debug scope is bound by a client. This
+ * one-shot weston-debug scope prints the frame timing statistics of every
+ * output since it was enabled, and then terminates the stream.
+ */
+static void
+debug_repaint_stats_cb(struct weston_log_subscription *sub, void *data)
+{
+	struct weston_compositor *ec = data;
+	struct weston_output *output;
+	FILE *fp;
+	char *str;
+	size_t len;
+
+	fp = open_memstream(&str, &len);
+	if (fp) {
+		wl_list_for_each(output, &ec->output_list, link)
+			weston_output_repaint_stats_print(output, fp);
+
+		if (fclose(fp) == 0)
+			weston_log_subscription_printf(sub, "%s", str);
+		free(str);
+	}
+
+	weston_log_subscription_complete(sub);
+}
+
 /** Create the compositor.
  *
  * This functions creates and initializes a compositor instance.
@@ -7308,6 +7537,14 @@ weston_compositor_create(struct wl_display *display,
 		wl_event_loop_add_timer(loop, output_repaint_timer_handler,
 					ec);
 
+	ec->repaint_wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (ec->repaint_wakeup_fd >= 0)
+		ec->repaint_wakeup =
+			wl_event_loop_add_fd(loop, ec->repaint_wakeup_fd,
+					     WL_EVENT_READABLE,
+					     output_repaint_wakeup_handler,
+					     ec);
+
 	weston_layer_init(&ec->fade_layer, ec);
 	weston_layer_init(&ec->cursor_layer, ec);
 
@@ -7321,12 +7558,46 @@ weston_compositor_create(struct wl_display *display,
 						debug_scene_graph_cb, NULL,
 						ec);
 
+	ec->repaint_stats =
+		weston_compositor_add_log_scope(ec->weston_log_ctx,
+						"repaint-stats",
+						"Per-output frame timing "
+						"histograms and missed vblanks\n",
+						debug_repaint_stats_cb, NULL,
+						ec);
+
 	ec->timeline =
 		weston_compositor_add_log_scope(ec->weston_log_ctx, "timeline",
 						"Timeline event points\n",
 						weston_timeline_create_subscription,
 						weston_timeline_destroy_subscription,
 						ec);
+
+	ec->timeline_binary =
+		weston_compositor_add_log_scope(ec->weston_log_ctx,
+						"timeline-binary",
+						"Timeline event points, binary "
+						"encoding for weston-timeline-decode\n",
+						weston_timeline_binary_create_subscription,
+						weston_timeline_binary_destroy_subscription,
+						ec);
+
+	ec->timeline_trace =
+		weston_compositor_add_log_scope(ec->weston_log_ctx,
+						"timeline-trace",
+						"Timeline event points as Chrome "
+						"trace-event JSON (chrome://tracing, "
+						"Perfetto)\n",
+						weston_timeline_trace_create_subscription,
+						weston_timeline_binary_destroy_subscription,
+						ec);
+
+	if (weston_client_stats_init(ec) < 0)
+		weston_log("Failed to set up per-client accounting.\n");
+
+	if (weston_input_latency_init(ec) < 0)
+		weston_log("Failed to set up input latency tracking.\n");
+
 	return ec;
 
 fail:
@@ -7343,6 +7614,12 @@ weston_compositor_shutdown(struct weston_compositor *ec)
 	struct weston_output *output, *next;
 
 	wl_event_source_remove(ec->idle_source);
+	if (ec->repaint_wakeup)
+		wl_event_source_remove(ec->repaint_wakeup);
+	ec->repaint_wakeup = NULL;
+	if (ec->repaint_wakeup_fd >= 0)
+		close(ec->repaint_wakeup_fd);
+	ec->repaint_wakeup_fd = -1;
 
 	/* Destroy all outputs associated with this compositor */
 	wl_list_for_each_safe(output, next, &ec->output_list, link)
@@ -7697,8 +7974,20 @@ weston_compositor_tear_down(struct weston_compositor *compositor)
 	weston_compositor_log_scope_destroy(compositor->debug_scene);
 	compositor->debug_scene = NULL;
 
+	weston_compositor_log_scope_destroy(compositor->repaint_stats);
+	compositor->repaint_stats = NULL;
+
 	weston_compositor_log_scope_destroy(compositor->timeline);
 	compositor->timeline = NULL;
+
+	weston_compositor_log_scope_destroy(compositor->timeline_binary);
+	compositor->timeline_binary = NULL;
+
+	weston_compositor_log_scope_destroy(compositor->timeline_trace);
+	compositor->timeline_trace = NULL;
+
+	weston_client_stats_fini(compositor);
+	weston_input_latency_fini(compositor);
 }
 
 /** Destroys the compositor.
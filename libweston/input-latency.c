@@ -0,0 +1,514 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+#include "libweston-internal.h"
+#include "timeline.h"
+#include "shared/helpers.h"
+#include "shared/histogram.h"
+#include "shared/timespec-util.h"
+
+/* Give up on a response that has not been presented after this long */
+#define INPUT_LATENCY_TIMEOUT_MS 1000
+
+/* Upper bound on the number of responses waited for at once */
+#define INPUT_LATENCY_MAX_WAITERS 64
+
+/* Interval of the summaries printed to "input-latency" subscribers */
+#define INPUT_LATENCY_REPORT_MS 10000
+
+/*
+ * End-to-end input latency
+ *
+ * Every input event read by the libinput backend gets an id between
+ * weston_input_latency_begin() and _end(). Grabs and notify_*() run
+ * synchronously in between, so whatever they deliver to a client is
+ * attributed to the current event without passing the id around. The
+ * first client commit after a delivery is taken as the response to it,
+ * and the response is followed to the first repaint of an output the
+ * surface is on and to that frame's presentation:
+ *
+ *   event -> client   input_event .. input_deliver, compositor side
+ *   client -> commit  input_deliver .. input_commit, client side
+ *   commit -> present input_commit .. input_present, display pipeline
+ *
+ * All steps are timeline points carrying the event id, and the three
+ * intervals are collected in histograms printed by the "input-latency"
+ * scope. The first interval starts at the kernel timestamp of the event,
+ * so it includes the time the event waited to be read.
+ *
+ * Nothing is tracked unless the "input-latency" scope or one of the
+ * timeline scopes has a subscriber.
+ */
+
+enum input_latency_state {
+	INPUT_LATENCY_WAIT_COMMIT,
+	INPUT_LATENCY_WAIT_REPAINT,
+	INPUT_LATENCY_WAIT_PRESENT,
+};
+
+struct input_latency_waiter {
+	struct weston_input_latency *ctx;
+	struct wl_list link; /* weston_input_latency::waiter_list */
+	enum input_latency_state state;
+	uint64_t id;
+
+	struct wl_client *client;
+	struct wl_listener client_destroy_listener;
+	struct weston_surface *surface;
+	struct wl_listener surface_destroy_listener;
+	/* only compared against, never dereferenced */
+	struct weston_output *output;
+
+	struct timespec delivered;
+	struct timespec committed;
+};
+
+struct weston_input_latency {
+	struct weston_compositor *compositor;
+	struct weston_log_scope *scope;
+	struct wl_event_source *report_timer;
+	uint64_t reported_events;
+
+	uint64_t next_id;
+	uint64_t current_id; /* 0 outside of event processing */
+	int depth; /* nesting of weston_input_latency_begin() */
+	struct timespec current_time; /* CLOCK_MONOTONIC, as from evdev */
+	struct wl_client *current_client;
+
+	struct wl_list waiter_list; /* input_latency_waiter::link */
+	unsigned int n_waiters;
+
+	uint64_t events, delivered, committed, presented, expired;
+	struct weston_histogram to_client;
+	struct weston_histogram to_commit;
+	struct weston_histogram to_present;
+};
+
+static void
+input_latency_waiter_destroy(struct input_latency_waiter *waiter)
+{
+	wl_list_remove(&waiter->link);
+	wl_list_remove(&waiter->client_destroy_listener.link);
+	if (waiter->surface)
+		wl_list_remove(&waiter->surface_destroy_listener.link);
+	waiter->ctx->n_waiters--;
+	free(waiter);
+}
+
+static void
+input_latency_client_destroyed(struct wl_listener *listener, void *data)
+{
+	struct input_latency_waiter *waiter =
+		container_of(listener, struct input_latency_waiter,
+			     client_destroy_listener);
+
+	input_latency_waiter_destroy(waiter);
+}
+
+static void
+input_latency_surface_destroyed(struct wl_listener *listener, void *data)
+{
+	struct input_latency_waiter *waiter =
+		container_of(listener, struct input_latency_waiter,
+			     surface_destroy_listener);
+
+	input_latency_waiter_destroy(waiter);
+}
+
+static void
+input_latency_expire(struct weston_input_latency *ctx,
+		     const struct timespec *now)
+{
+	struct input_latency_waiter *waiter, *tmp;
+
+	wl_list_for_each_safe(waiter, tmp, &ctx->waiter_list, link) {
+		if (timespec_sub_to_msec(now, &waiter->delivered) <
+		    INPUT_LATENCY_TIMEOUT_MS)
+			continue;
+
+		ctx->expired++;
+		input_latency_waiter_destroy(waiter);
+	}
+}
+
+static struct input_latency_waiter *
+input_latency_find_commit_waiter(struct weston_input_latency *ctx,
+				 struct wl_client *client)
+{
+	struct input_latency_waiter *waiter;
+
+	wl_list_for_each(waiter, &ctx->waiter_list, link) {
+		if (waiter->client == client &&
+		    waiter->state == INPUT_LATENCY_WAIT_COMMIT)
+			return waiter;
+	}
+
+	return NULL;
+}
+
+static bool
+input_latency_enabled(struct weston_input_latency *ctx)
+{
+	struct weston_compositor *compositor = ctx->compositor;
+
+	return weston_log_scope_is_enabled(ctx->scope) ||
+	       weston_log_scope_is_enabled(compositor->timeline) ||
+	       weston_log_scope_is_enabled(compositor->timeline_binary) ||
+	       weston_log_scope_is_enabled(compositor->timeline_trace);
+}
+
+/** Start attributing deliveries to a new input event
+ *
+ * Calls nest: deliveries up to the outermost weston_input_latency_end()
+ * are attributed to the event of the outermost call.
+ *
+ * \param compositor The compositor.
+ * \param time The time the event was generated, in CLOCK_MONOTONIC.
+ */
+WL_EXPORT void
+weston_input_latency_begin(struct weston_compositor *compositor,
+			   const struct timespec *time)
+{
+	struct weston_input_latency *ctx = compositor->input_latency;
+
+	if (!ctx || ctx->depth++ > 0 || !input_latency_enabled(ctx))
+		return;
+
+	ctx->current_id = ++ctx->next_id;
+	ctx->current_client = NULL;
+	ctx->current_time = *time;
+	ctx->events++;
+
+	TL_POINT(compositor, "input_event", TLP_INPUT(&ctx->current_id),
+		 TLP_END);
+}
+
+/** Stop attributing deliveries to the current input event
+ *
+ * \param compositor The compositor.
+ */
+WL_EXPORT void
+weston_input_latency_end(struct weston_compositor *compositor)
+{
+	struct weston_input_latency *ctx = compositor->input_latency;
+
+	if (!ctx)
+		return;
+
+	assert(ctx->depth > 0);
+	if (--ctx->depth == 0)
+		ctx->current_id = 0;
+}
+
+/** Note that the current input event was sent to a client
+ *
+ * Only the first delivery to a client per event counts, and a client that
+ * has not responded to an earlier event yet keeps waiting for that one.
+ *
+ * \param compositor The compositor.
+ * \param client The client the event was sent to.
+ */
+void
+weston_input_latency_deliver(struct weston_compositor *compositor,
+			     struct wl_client *client)
+{
+	struct weston_input_latency *ctx = compositor->input_latency;
+	struct input_latency_waiter *waiter;
+	struct timespec sent, now;
+
+	if (!ctx || ctx->current_id == 0 || !client ||
+	    ctx->current_client == client)
+		return;
+
+	ctx->current_client = client;
+	ctx->delivered++;
+
+	clock_gettime(CLOCK_MONOTONIC, &sent);
+	weston_histogram_record(&ctx->to_client,
+		MAX(timespec_sub_to_nsec(&sent, &ctx->current_time), 0) / 1000);
+
+	/* The rest of the way is measured against the presentation clock */
+	weston_compositor_read_presentation_clock(compositor, &now);
+	TL_POINT(compositor, "input_deliver", TLP_INPUT(&ctx->current_id),
+		 TLP_END);
+
+	input_latency_expire(ctx, &now);
+
+	if (input_latency_find_commit_waiter(ctx, client) ||
+	    ctx->n_waiters >= INPUT_LATENCY_MAX_WAITERS)
+		return;
+
+	waiter = zalloc(sizeof *waiter);
+	if (!waiter)
+		return;
+
+	waiter->ctx = ctx;
+	waiter->state = INPUT_LATENCY_WAIT_COMMIT;
+	waiter->id = ctx->current_id;
+	waiter->client = client;
+	waiter->delivered = now;
+	waiter->client_destroy_listener.notify = input_latency_client_destroyed;
+	wl_client_add_destroy_listener(client,
+				       &waiter->client_destroy_listener);
+	wl_list_insert(ctx->waiter_list.prev, &waiter->link);
+	ctx->n_waiters++;
+}
+
+/** Match a surface commit to the input event its client responds to
+ *
+ * \param surface The surface being committed.
+ */
+void
+weston_input_latency_commit(struct weston_surface *surface)
+{
+	struct weston_input_latency *ctx = surface->compositor->input_latency;
+	struct input_latency_waiter *waiter;
+
+	if (!ctx || wl_list_empty(&ctx->waiter_list) || !surface->resource)
+		return;
+
+	waiter = input_latency_find_commit_waiter(ctx,
+			wl_resource_get_client(surface->resource));
+	if (!waiter)
+		return;
+
+	ctx->committed++;
+	weston_compositor_read_presentation_clock(surface->compositor,
+						  &waiter->committed);
+	weston_histogram_record(&ctx->to_commit,
+				timespec_sub_to_nsec(&waiter->committed,
+						     &waiter->delivered) / 1000);
+	TL_POINT(surface->compositor, "input_commit", TLP_INPUT(&waiter->id),
+		 TLP_SURFACE(surface), TLP_END);
+
+	waiter->state = INPUT_LATENCY_WAIT_REPAINT;
+	waiter->surface = surface;
+	waiter->surface_destroy_listener.notify =
+		input_latency_surface_destroyed;
+	wl_signal_add(&surface->destroy_signal,
+		      &waiter->surface_destroy_listener);
+}
+
+/** Mark responses that go out with the output's current repaint
+ *
+ * \param output The output being repainted.
+ */
+void
+weston_input_latency_repaint(struct weston_output *output)
+{
+	struct weston_input_latency *ctx = output->compositor->input_latency;
+	struct input_latency_waiter *waiter;
+
+	if (!ctx)
+		return;
+
+	wl_list_for_each(waiter, &ctx->waiter_list, link) {
+		if (waiter->state != INPUT_LATENCY_WAIT_REPAINT ||
+		    !(waiter->surface->output_mask & (1u << output->id)))
+			continue;
+
+		waiter->state = INPUT_LATENCY_WAIT_PRESENT;
+		waiter->output = output;
+	}
+}
+
+/** Complete the responses shown by the frame that was just presented
+ *
+ * \param output The output that finished a frame.
+ * \param stamp The presentation timestamp of the frame.
+ */
+void
+weston_input_latency_presented(struct weston_output *output,
+			       const struct timespec *stamp)
+{
+	struct weston_input_latency *ctx = output->compositor->input_latency;
+	struct input_latency_waiter *waiter, *tmp;
+
+	if (!ctx)
+		return;
+
+	wl_list_for_each_safe(waiter, tmp, &ctx->waiter_list, link) {
+		if (waiter->state != INPUT_LATENCY_WAIT_PRESENT ||
+		    waiter->output != output)
+			continue;
+
+		ctx->presented++;
+		weston_histogram_record(&ctx->to_present,
+			MAX(timespec_sub_to_nsec(stamp, &waiter->committed),
+			    0) / 1000);
+		TL_POINT(output->compositor, "input_present",
+			 TLP_INPUT(&waiter->id), TLP_OUTPUT(output), TLP_END);
+
+		input_latency_waiter_destroy(waiter);
+	}
+}
+
+static void
+input_latency_print(struct weston_input_latency *ctx, FILE *fp)
+{
+	fprintf(fp, "Input latency:\n");
+	fprintf(fp, "\tevents: %" PRIu64 ", delivered: %" PRIu64
+		", committed: %" PRIu64 ", presented: %" PRIu64
+		", expired: %" PRIu64 "\n",
+		ctx->events, ctx->delivered, ctx->committed, ctx->presented,
+		ctx->expired);
+	weston_histogram_print_usec(&ctx->to_client, fp, "\t",
+				    "event -> client (compositor)");
+	weston_histogram_print_usec(&ctx->to_commit, fp, "\t",
+				    "client -> commit (client)");
+	weston_histogram_print_usec(&ctx->to_present, fp, "\t",
+				    "commit -> present (display)");
+}
+
+/* Returns the summary as a string to be freed, or NULL */
+static char *
+input_latency_format(struct weston_input_latency *ctx)
+{
+	FILE *fp;
+	char *str;
+	size_t len;
+
+	fp = open_memstream(&str, &len);
+	if (!fp)
+		return NULL;
+
+	input_latency_print(ctx, fp);
+
+	if (fclose(fp) != 0) {
+		free(str);
+		return NULL;
+	}
+
+	return str;
+}
+
+static int
+input_latency_report(void *data)
+{
+	struct weston_input_latency *ctx = data;
+	char *str;
+
+	if (!weston_log_scope_is_enabled(ctx->scope))
+		return 0;
+
+	if (ctx->events != ctx->reported_events) {
+		ctx->reported_events = ctx->events;
+		str = input_latency_format(ctx);
+		if (str)
+			weston_log_scope_printf(ctx->scope, "%s", str);
+		free(str);
+	}
+
+	wl_event_source_timer_update(ctx->report_timer,
+				     INPUT_LATENCY_REPORT_MS);
+
+	return 0;
+}
+
+/* Subscribers get what was collected so far right away, then a new
+ * summary every INPUT_LATENCY_REPORT_MS while there is new input. */
+static void
+input_latency_subscribe(struct weston_log_subscription *sub, void *data)
+{
+	struct weston_input_latency *ctx = data;
+	char *str;
+
+	str = input_latency_format(ctx);
+	if (str)
+		weston_log_subscription_printf(sub, "%s", str);
+	free(str);
+
+	ctx->reported_events = ctx->events;
+	if (ctx->report_timer)
+		wl_event_source_timer_update(ctx->report_timer,
+					     INPUT_LATENCY_REPORT_MS);
+}
+
+int
+weston_input_latency_init(struct weston_compositor *compositor)
+{
+	struct weston_input_latency *ctx;
+	struct wl_event_loop *loop;
+
+	ctx = zalloc(sizeof *ctx);
+	if (!ctx)
+		return -1;
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+	ctx->report_timer = wl_event_loop_add_timer(loop, input_latency_report,
+						    ctx);
+	if (!ctx->report_timer) {
+		free(ctx);
+		return -1;
+	}
+
+	ctx->compositor = compositor;
+	wl_list_init(&ctx->waiter_list);
+	weston_histogram_init(&ctx->to_client);
+	weston_histogram_init(&ctx->to_commit);
+	weston_histogram_init(&ctx->to_present);
+
+	ctx->scope =
+		weston_compositor_add_log_scope(compositor->weston_log_ctx,
+						"input-latency",
+						"End-to-end input latency "
+						"percentiles, tracked while "
+						"subscribed\n",
+						input_latency_subscribe, NULL,
+						ctx);
+
+	compositor->input_latency = ctx;
+
+	return 0;
+}
+
+void
+weston_input_latency_fini(struct weston_compositor *compositor)
+{
+	struct weston_input_latency *ctx = compositor->input_latency;
+	struct input_latency_waiter *waiter, *tmp;
+
+	if (!ctx)
+		return;
+
+	wl_list_for_each_safe(waiter, tmp, &ctx->waiter_list, link)
+		input_latency_waiter_destroy(waiter);
+
+	wl_event_source_remove(ctx->report_timer);
+	weston_compositor_log_scope_destroy(ctx->scope);
+	free(ctx);
+	compositor->input_latency = NULL;
+}
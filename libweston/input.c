@@ -178,6 +178,10 @@ weston_touch_create_touch_device(struct weston_touch *touch,
 WL_EXPORT void
 weston_touch_device_destroy(struct weston_touch_device *device)
 {
+	if (device->aggregate->resampler)
+		weston_touch_resampler_device_destroyed(
+				device->aggregate->resampler, device);
+
 	wl_list_remove(&device->link);
 	wl_signal_emit(&device->destroy_signal, device);
 	free(device->syspath);
@@ -520,6 +524,9 @@ pointer_send_motion(struct weston_pointer *pointer,
 	if (!pointer->focus_client)
 		return;
 
+	weston_input_latency_deliver(pointer->seat->compositor,
+				     pointer->focus_client->client);
+
 	resource_list = &pointer->focus_client->pointer_resources;
 	msecs = timespec_to_msec(time);
 	wl_resource_for_each(resource, resource_list) {
@@ -605,6 +612,9 @@ weston_pointer_send_button(struct weston_pointer *pointer,
 	if (!weston_pointer_has_focus_resource(pointer))
 		return;
 
+	weston_input_latency_deliver(pointer->seat->compositor,
+				     pointer->focus_client->client);
+
 	resource_list = &pointer->focus_client->pointer_resources;
 	serial = wl_display_next_serial(display);
 	msecs = timespec_to_msec(time);
@@ -660,6 +670,9 @@ weston_pointer_send_axis(struct weston_pointer *pointer,
 	if (!weston_pointer_has_focus_resource(pointer))
 		return;
 
+	weston_input_latency_deliver(pointer->seat->compositor,
+				     pointer->focus_client->client);
+
 	resource_list = &pointer->focus_client->pointer_resources;
 	msecs = timespec_to_msec(time);
 	wl_resource_for_each(resource, resource_list) {
@@ -826,6 +839,9 @@ weston_touch_send_down(struct weston_touch *touch, const struct timespec *time,
 	if (!weston_touch_has_focus_resource(touch))
 		return;
 
+	weston_input_latency_deliver(touch->seat->compositor,
+			wl_resource_get_client(touch->focus->surface->resource));
+
 	weston_view_from_global_fixed(touch->focus, x, y, &sx, &sy);
 
 	resource_list = &touch->focus_resource_list;
@@ -872,6 +888,9 @@ weston_touch_send_up(struct weston_touch *touch, const struct timespec *time,
 	if (!weston_touch_has_focus_resource(touch))
 		return;
 
+	weston_input_latency_deliver(touch->seat->compositor,
+			wl_resource_get_client(touch->focus->surface->resource));
+
 	resource_list = &touch->focus_resource_list;
 	serial = wl_display_next_serial(display);
 	msecs = timespec_to_msec(time);
@@ -915,6 +934,9 @@ weston_touch_send_motion(struct weston_touch *touch,
 	if (!weston_touch_has_focus_resource(touch))
 		return;
 
+	weston_input_latency_deliver(touch->seat->compositor,
+			wl_resource_get_client(touch->focus->surface->resource));
+
 	weston_view_from_global_fixed(touch->focus, x, y, &sx, &sy);
 
 	resource_list = &touch->focus_resource_list;
@@ -993,6 +1015,152 @@ weston_keyboard_has_focus_resource(struct weston_keyboard *keyboard)
 	return true;
 }
 
+enum keyboard_batch_type {
+	KEYBOARD_BATCH_KEY,
+	KEYBOARD_BATCH_MODIFIERS,
+};
+
+/* A wl_keyboard event held back during a batch, in the order it was sent */
+struct keyboard_batch_event {
+	enum keyboard_batch_type type;
+	uint32_t serial;
+	struct timespec time;
+	uint32_t key;
+	uint32_t state;
+	uint32_t mods_depressed;
+	uint32_t mods_latched;
+	uint32_t mods_locked;
+	uint32_t group;
+};
+
+static void
+keyboard_batch_add_key(struct weston_keyboard *keyboard, uint32_t serial,
+		       const struct timespec *time, uint32_t key,
+		       enum wl_keyboard_key_state state)
+{
+	struct keyboard_batch_event *ev;
+
+	ev = wl_array_add(&keyboard->batch, sizeof *ev);
+	if (!ev) {
+		weston_log("out of memory, dropping key %u\n", key);
+		return;
+	}
+
+	ev->type = KEYBOARD_BATCH_KEY;
+	ev->serial = serial;
+	ev->time = *time;
+	ev->key = key;
+	ev->state = state;
+}
+
+static void
+keyboard_batch_add_modifiers(struct weston_keyboard *keyboard,
+			     uint32_t serial, uint32_t mods_depressed,
+			     uint32_t mods_latched, uint32_t mods_locked,
+			     uint32_t group)
+{
+	struct keyboard_batch_event *ev = NULL;
+
+	/* Modifier updates that no key event separates supersede each
+	 * other, only the last state needs to reach the client. */
+	if (keyboard->batch.size > 0) {
+		ev = (struct keyboard_batch_event *)
+			((char *) keyboard->batch.data +
+			 keyboard->batch.size - sizeof *ev);
+		if (ev->type != KEYBOARD_BATCH_MODIFIERS)
+			ev = NULL;
+	}
+
+	if (!ev)
+		ev = wl_array_add(&keyboard->batch, sizeof *ev);
+	if (!ev) {
+		weston_log("out of memory, dropping modifiers\n");
+		return;
+	}
+
+	ev->type = KEYBOARD_BATCH_MODIFIERS;
+	ev->serial = serial;
+	ev->mods_depressed = mods_depressed;
+	ev->mods_latched = mods_latched;
+	ev->mods_locked = mods_locked;
+	ev->group = group;
+}
+
+static void
+keyboard_batch_send(struct weston_keyboard *keyboard,
+		    struct wl_resource *resource)
+{
+	struct keyboard_batch_event *ev;
+
+	wl_array_for_each(ev, &keyboard->batch) {
+		switch (ev->type) {
+		case KEYBOARD_BATCH_KEY:
+			send_timestamps_for_input_resource(resource,
+						&keyboard->timestamps_list,
+						&ev->time);
+			wl_keyboard_send_key(resource, ev->serial,
+					     timespec_to_msec(&ev->time),
+					     ev->key, ev->state);
+			break;
+		case KEYBOARD_BATCH_MODIFIERS:
+			wl_keyboard_send_modifiers(resource, ev->serial,
+						   ev->mods_depressed,
+						   ev->mods_latched,
+						   ev->mods_locked,
+						   ev->group);
+			break;
+		}
+	}
+}
+
+/** Start holding back wl_keyboard events
+ *
+ * \param keyboard The keyboard.
+ *
+ * Until weston_keyboard_end_batch(), key and modifier events for the
+ * focused client are queued instead of sent. The queue is then delivered
+ * one resource at a time, with consecutive modifier updates merged. The
+ * backend must flush the batch before it delivers any other input that
+ * could be ordered against the queued keys; focus changes flush it
+ * themselves.
+ */
+WL_EXPORT void
+weston_keyboard_begin_batch(struct weston_keyboard *keyboard)
+{
+	keyboard->batching = true;
+}
+
+/** Send the wl_keyboard events queued so far
+ *
+ * \param keyboard The keyboard.
+ *
+ * The keyboard stays in batching mode.
+ */
+WL_EXPORT void
+weston_keyboard_flush_batch(struct weston_keyboard *keyboard)
+{
+	struct wl_resource *resource;
+
+	if (keyboard->batch.size == 0)
+		return;
+
+	wl_resource_for_each(resource, &keyboard->focus_resource_list)
+		keyboard_batch_send(keyboard, resource);
+
+	keyboard->batch.size = 0;
+}
+
+/** Stop holding back wl_keyboard events and send the queued ones
+ *
+ * \param keyboard The keyboard.
+ */
+WL_EXPORT void
+weston_keyboard_end_batch(struct weston_keyboard *keyboard)
+{
+	weston_keyboard_flush_batch(keyboard);
+	keyboard->batching = false;
+}
+
 /** Send wl_keyboard.key events to focused resources.
  *
  * \param keyboard The keyboard where the key events originates from.
@@ -1018,8 +1186,17 @@ weston_keyboard_send_key(struct weston_keyboard *keyboard,
 	if (!weston_keyboard_has_focus_resource(keyboard))
 		return;
 
-	resource_list = &keyboard->focus_resource_list;
+	weston_input_latency_deliver(keyboard->seat->compositor,
+			wl_resource_get_client(keyboard->focus->resource));
+
 	serial = wl_display_next_serial(display);
+
+	if (keyboard->batching) {
+		keyboard_batch_add_key(keyboard, serial, time, key, state);
+		return;
+	}
+
+	resource_list = &keyboard->focus_resource_list;
 	msecs = timespec_to_msec(time);
 	wl_resource_for_each(resource, resource_list) {
 		send_timestamps_for_input_resource(resource,
@@ -1128,7 +1305,11 @@ weston_keyboard_send_modifiers(struct weston_keyboard *keyboard,
 	struct weston_pointer *pointer =
 		weston_seat_get_pointer(keyboard->seat);
 
-	if (weston_keyboard_has_focus_resource(keyboard)) {
+	if (weston_keyboard_has_focus_resource(keyboard) &&
+	    keyboard->batching) {
+		keyboard_batch_add_modifiers(keyboard, serial, mods_depressed,
+					     mods_latched, mods_locked, group);
+	} else if (weston_keyboard_has_focus_resource(keyboard)) {
 		struct wl_list *resource_list;
 		struct wl_resource *resource;
 
@@ -1301,6 +1482,7 @@ weston_keyboard_create(void)
 	keyboard->grab = &keyboard->default_grab;
 	wl_signal_init(&keyboard->focus_signal);
 	wl_list_init(&keyboard->timestamps_list);
+	wl_array_init(&keyboard->batch);
 
 	return keyboard;
 }
@@ -1332,6 +1514,9 @@ weston_keyboard_destroy(struct weston_keyboard *keyboard)
 	wl_array_release(&keyboard->keys);
 	wl_list_remove(&keyboard->focus_resource_listener.link);
 	wl_list_remove(&keyboard->timestamps_list);
+	wl_array_release(&keyboard->batch);
+	if (keyboard->repeat.timer)
+		wl_event_source_remove(keyboard->repeat.timer);
 	free(keyboard);
 }
 
@@ -1339,6 +1524,8 @@ static void
 weston_touch_reset_state(struct weston_touch *touch)
 {
 	touch->num_tp = 0;
+	if (touch->resampler)
+		weston_touch_resampler_reset(touch->resampler);
 }
 
 static struct weston_touch *
@@ -1386,6 +1573,7 @@ weston_touch_destroy(struct weston_touch *touch)
 	wl_list_remove(&touch->focus_view_listener.link);
 	wl_list_remove(&touch->focus_resource_listener.link);
 	wl_list_remove(&touch->timestamps_list);
+	weston_touch_resampler_destroy(touch->resampler);
 	free(touch);
 }
 
@@ -1526,6 +1714,9 @@ send_enter_to_resource_list(struct wl_list *list,
 	}
 }
 
+static void
+keyboard_repeat_stop(struct weston_keyboard *keyboard);
+
 WL_EXPORT void
 weston_keyboard_set_focus(struct weston_keyboard *keyboard,
 			  struct weston_surface *surface)
@@ -1544,6 +1735,12 @@ weston_keyboard_set_focus(struct weston_keyboard *keyboard,
 	if (surface && !surface->resource)
 		surface = NULL;
 
+	/* Whatever the old focus was sent so far goes out before leave */
+	weston_keyboard_flush_batch(keyboard);
+
+	if (keyboard->focus != surface)
+		keyboard_repeat_stop(keyboard);
+
 	focus_resource_list = &keyboard->focus_resource_list;
 
 	if (!wl_list_empty(focus_resource_list) && keyboard->focus != surface) {
@@ -2185,6 +2382,147 @@ update_keymap(struct weston_seat *seat)
 		send_modifiers(resource, wl_display_get_serial(seat->compositor->wl_display), keyboard);
 }
 
+/* Repeats that may be sent at once to catch up after a stall; beyond
+ * that, missed repeats are dropped rather than flooding the client. */
+#define KEY_REPEAT_MAX_BURST 3
+
+static void
+keyboard_repeat_stop(struct weston_keyboard *keyboard)
+{
+	if (!keyboard->repeat.timer || keyboard->repeat.key == 0)
+		return;
+
+	keyboard->repeat.key = 0;
+	wl_event_source_timer_update(keyboard->repeat.timer, 0);
+}
+
+/* Schedules the next repeat, delayed to the next vblank of the output
+ * showing the focus so that repeats land at the same phase of every
+ * frame. */
+static void
+keyboard_repeat_arm(struct weston_keyboard *keyboard)
+{
+	struct weston_compositor *compositor = keyboard->seat->compositor;
+	struct weston_output *output = NULL;
+	struct timespec now, due;
+	int64_t interval, delay, period, since_frame;
+
+	interval = 1000000000LL / compositor->kb_repeat_rate;
+	timespec_add_nsec(&due, &keyboard->repeat.start,
+			  compositor->kb_repeat_delay * 1000000LL +
+			  keyboard->repeat.count * interval);
+
+	if (keyboard->focus)
+		output = keyboard->focus->output;
+	if (output && output->current_mode &&
+	    output->current_mode->refresh > 0) {
+		period = millihz_to_nsec(output->current_mode->refresh);
+		since_frame = timespec_sub_to_nsec(&due, &output->frame_time);
+		if (since_frame > 0) {
+			since_frame = (since_frame + period - 1) / period *
+				      period;
+			timespec_add_nsec(&due, &output->frame_time,
+					  since_frame);
+		}
+	}
+
+	weston_compositor_read_presentation_clock(compositor, &now);
+	delay = timespec_sub_to_nsec(&due, &now);
+
+	/* A zero timeout would disarm the timer */
+	wl_event_source_timer_update(keyboard->repeat.timer,
+				     MAX(1, (delay + 999999) / 1000000));
+}
+
+static void
+keyboard_repeat_start(struct weston_keyboard *keyboard,
+		      const struct timespec *time, uint32_t key)
+{
+	struct weston_compositor *compositor = keyboard->seat->compositor;
+
+	keyboard_repeat_stop(keyboard);
+
+	if (!keyboard->repeat.timer || compositor->kb_repeat_rate <= 0)
+		return;
+
+	/* evdev key codes are offset by 8 in XKB */
+	if (!xkb_keymap_key_repeats(keyboard->xkb_info->keymap, key + 8))
+		return;
+
+	keyboard->repeat.key = key;
+	keyboard->repeat.press_time = *time;
+	keyboard->repeat.count = 0;
+	weston_compositor_read_presentation_clock(compositor,
+						  &keyboard->repeat.start);
+
+	keyboard_repeat_arm(keyboard);
+}
+
+static void
+keyboard_send_repeat(struct weston_keyboard *keyboard,
+		     const struct timespec *time)
+{
+	struct wl_display *display = keyboard->seat->compositor->wl_display;
+	struct wl_resource *resource;
+	uint32_t serial;
+
+	serial = wl_display_next_serial(display);
+	wl_resource_for_each(resource, &keyboard->focus_resource_list) {
+		/* Older clients were not told to leave repeating to us */
+		if (wl_resource_get_version(resource) <
+		    WL_KEYBOARD_REPEAT_INFO_SINCE_VERSION)
+			continue;
+
+		send_timestamps_for_input_resource(resource,
+						   &keyboard->timestamps_list,
+						   time);
+		wl_keyboard_send_key(resource, serial, timespec_to_msec(time),
+				     keyboard->repeat.key,
+				     WL_KEYBOARD_KEY_STATE_PRESSED);
+	}
+}
+
+static int
+keyboard_repeat_timer_handler(void *data)
+{
+	struct weston_keyboard *keyboard = data;
+	struct weston_compositor *compositor = keyboard->seat->compositor;
+	struct timespec now, time;
+	int64_t interval, elapsed, due;
+
+	/* Grabs like the input method or shell bindings get no repeats */
+	if (keyboard->repeat.key == 0 ||
+	    keyboard->grab != &keyboard->default_grab ||
+	    !weston_keyboard_has_focus_resource(keyboard))
+		return 0;
+
+	interval = 1000000000LL / compositor->kb_repeat_rate;
+	weston_compositor_read_presentation_clock(compositor, &now);
+	elapsed = timespec_sub_to_nsec(&now, &keyboard->repeat.start) -
+		  compositor->kb_repeat_delay * 1000000LL;
+
+	if (elapsed >= 0) {
+		/* Repeats follow the schedule from the key press, however
+		 * late the timer fires, so the rate stays steady. */
+		due = elapsed / interval + 1;
+		if (due - keyboard->repeat.count > KEY_REPEAT_MAX_BURST)
+			keyboard->repeat.count = due - KEY_REPEAT_MAX_BURST;
+
+		while (keyboard->repeat.count < due) {
+			timespec_add_nsec(&time, &keyboard->repeat.press_time,
+					  compositor->kb_repeat_delay *
+					  1000000LL +
+					  keyboard->repeat.count * interval);
+			keyboard_send_repeat(keyboard, &time);
+			keyboard->repeat.count++;
+		}
+	}
+
+	keyboard_repeat_arm(keyboard);
+
+	return 0;
+}
+
 WL_EXPORT void
 notify_key(struct weston_seat *seat, const struct timespec *time, uint32_t key,
 	   enum wl_keyboard_key_state state,
@@ -2225,6 +2563,11 @@ notify_key(struct weston_seat *seat, const struct timespec *time, uint32_t key,
 
 	grab->interface->key(grab, time, key, state);
 
+	if (state == WL_KEYBOARD_KEY_STATE_PRESSED)
+		keyboard_repeat_start(keyboard, time, key);
+	else if (key == keyboard->repeat.key)
+		keyboard_repeat_stop(keyboard);
+
 	if (keyboard->pending_keymap &&
 	    keyboard->keys.size == 0)
 		update_keymap(seat);
@@ -2433,6 +2776,15 @@ process_touch_normal(struct weston_touch_device *device,
 	}
 }
 
+/** Deliver a touch motion the resampler held back */
+void
+weston_touch_process_motion(struct weston_touch_device *device,
+			    const struct timespec *time, int touch_id,
+			    double x, double y)
+{
+	process_touch_normal(device, time, touch_id, x, y, WL_TOUCH_MOTION);
+}
+
 static enum weston_touch_mode
 get_next_touch_mode(enum weston_touch_mode from)
 {
@@ -2451,6 +2803,21 @@ get_next_touch_mode(enum weston_touch_mode from)
 	return WESTON_TOUCH_MODE_NORMAL;
 }
 
+/* Delivers the motion resamplers hold back for clients, before touch
+ * events go to the calibrator */
+static void
+weston_compositor_flush_touch_resamplers(struct weston_compositor *compositor)
+{
+	struct weston_seat *seat;
+	struct weston_touch *touch;
+
+	wl_list_for_each(seat, &compositor->seat_list, link) {
+		touch = weston_seat_get_touch(seat);
+		if (touch && touch->resampler)
+			weston_touch_resampler_flush(touch->resampler);
+	}
+}
+
 /** Global touch mode update
  *
  * If no seat has a touch down and the compositor is in a PREP touch mode,
@@ -2476,6 +2843,8 @@ weston_compositor_update_touch_mode(struct weston_compositor *compositor)
 
 	goal = get_next_touch_mode(compositor->touch_mode);
 	if (compositor->touch_mode != goal) {
+		if (goal == WESTON_TOUCH_MODE_CALIB)
+			weston_compositor_flush_touch_resamplers(compositor);
 		compositor->touch_mode = goal;
 		touch_calibrator_mode_changed(compositor);
 	}
@@ -2532,6 +2901,31 @@ weston_compositor_set_touch_mode_calib(struct weston_compositor *compositor)
 	weston_compositor_update_touch_mode(compositor);
 }
 
+/* Returns true if the resampler holds the event back */
+static bool
+notify_touch_resample(struct weston_touch_resampler *resampler,
+		      struct weston_touch_device *device,
+		      const struct timespec *time, int touch_id,
+		      double x, double y, int touch_type)
+{
+	switch (touch_type) {
+	case WL_TOUCH_DOWN:
+		weston_touch_resampler_flush(resampler);
+		weston_touch_resampler_down(resampler, device, time,
+					    touch_id, x, y);
+		break;
+	case WL_TOUCH_MOTION:
+		return weston_touch_resampler_motion(resampler, time,
+						     touch_id, x, y);
+	case WL_TOUCH_UP:
+		weston_touch_resampler_flush(resampler);
+		weston_touch_resampler_up(resampler, touch_id);
+		break;
+	}
+
+	return false;
+}
+
 /** Feed in touch down, motion, and up events, calibratable device.
  *
  * It assumes always the correct cycle sequence until it gets here: touch_down
@@ -2603,6 +2997,10 @@ notify_touch_normalized(struct weston_touch_device *device,
 	switch (weston_touch_device_get_mode(device)) {
 	case WESTON_TOUCH_MODE_NORMAL:
 	case WESTON_TOUCH_MODE_PREP_CALIB:
+		if (touch->resampler &&
+		    notify_touch_resample(touch->resampler, device, time,
+					  touch_id, x, y, touch_type))
+			break;
 		process_touch_normal(device, time, touch_id, x, y, touch_type);
 		break;
 	case WESTON_TOUCH_MODE_CALIB:
@@ -2621,6 +3019,9 @@ notify_touch_frame(struct weston_touch_device *device)
 	switch (weston_touch_device_get_mode(device)) {
 	case WESTON_TOUCH_MODE_NORMAL:
 	case WESTON_TOUCH_MODE_PREP_CALIB:
+		if (device->aggregate->resampler &&
+		    !weston_touch_resampler_frame(device->aggregate->resampler))
+			break;
 		grab = device->aggregate->grab;
 		grab->interface->frame(grab);
 		break;
@@ -2641,6 +3042,9 @@ notify_touch_cancel(struct weston_touch_device *device)
 	switch (weston_touch_device_get_mode(device)) {
 	case WESTON_TOUCH_MODE_NORMAL:
 	case WESTON_TOUCH_MODE_PREP_CALIB:
+		if (device->aggregate->resampler)
+			weston_touch_resampler_reset(
+					device->aggregate->resampler);
 		grab = device->aggregate->grab;
 		grab->interface->cancel(grab);
 		break;
@@ -2947,8 +3351,10 @@ seat_get_keyboard(struct wl_client *client, struct wl_resource *resource,
 	wl_list_insert(&keyboard->resource_list, wl_resource_get_link(cr));
 
 	if (wl_resource_get_version(cr) >= WL_KEYBOARD_REPEAT_INFO_SINCE_VERSION) {
+		/* A rate of 0 tells the client not to repeat by itself */
 		wl_keyboard_send_repeat_info(cr,
-					     seat->compositor->kb_repeat_rate,
+					     keyboard->repeat.timer ?
+					     0 : seat->compositor->kb_repeat_rate,
 					     seat->compositor->kb_repeat_delay);
 	}
 
@@ -3350,6 +3756,15 @@ weston_seat_init_keyboard(struct weston_seat *seat, struct xkb_keymap *keymap)
 	seat->keyboard_device_count = 1;
 	keyboard->seat = seat;
 
+	if (seat->compositor->kb_repeat_in_compositor) {
+		keyboard->repeat.timer = wl_event_loop_add_timer(
+			wl_display_get_event_loop(seat->compositor->wl_display),
+			keyboard_repeat_timer_handler, keyboard);
+		if (!keyboard->repeat.timer)
+			weston_log("failed to create key repeat timer, "
+				   "leaving repeats to clients\n");
+	}
+
 	seat_send_updated_caps(seat);
 
 	return 0;
@@ -3459,6 +3874,7 @@ weston_seat_init_touch(struct weston_seat *seat)
 	seat->touch_state = touch;
 	seat->touch_device_count = 1;
 	touch->seat = seat;
+	touch->resampler = weston_touch_resampler_create(touch);
 
 	seat_send_updated_caps(seat);
 }
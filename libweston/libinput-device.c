@@ -36,12 +36,14 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <assert.h>
+#include <time.h>
 #include <libinput.h>
 
 #include <libweston/libweston.h>
 #include "backend.h"
 #include "libweston-internal.h"
 #include "libinput-device.h"
+#include "libinput-seat.h"
 #include "shared/helpers.h"
 #include "shared/timespec-util.h"
 
@@ -87,6 +89,44 @@ handle_keyboard_key(struct libinput_device *libinput_device,
 		   key_state, STATE_UPDATE_AUTOMATIC);
 }
 
+static bool
+evdev_device_coalesce_motion(struct evdev_device *device)
+{
+	struct weston_pointer *pointer = weston_seat_get_pointer(device->seat);
+
+	if (!device->seat->compositor->coalesce_pointer_motion)
+		return false;
+
+	/* A client using relative pointer events, typically a game with a
+	 * locked pointer, gets every event as it came from the device. */
+	if (pointer && pointer->focus_client &&
+	    !wl_list_empty(&pointer->focus_client->relative_pointer_resources))
+		return false;
+
+	return true;
+}
+
+/** Deliver the relative motion accumulated while coalescing
+ *
+ * Sends one motion event with the summed deltas and the timestamp of the
+ * last libinput event, followed by a pointer frame. The seat repicks its
+ * focus once for the whole batch.
+ */
+void
+evdev_device_flush_motion(struct evdev_device *device)
+{
+	struct weston_pointer_motion_event *event = &device->pending_motion;
+
+	if (!device->motion_pending)
+		return;
+
+	device->motion_pending = false;
+	weston_input_latency_begin(device->seat->compositor, &event->time);
+	notify_motion(device->seat, &event->time, event);
+	notify_pointer_frame(device->seat);
+	weston_input_latency_end(device->seat->compositor);
+}
+
 static bool
 handle_pointer_motion(struct libinput_device *libinput_device,
 		      struct libinput_event_pointer *pointer_event)
@@ -94,6 +134,7 @@ handle_pointer_motion(struct libinput_device *libinput_device,
 	struct evdev_device *device =
 		libinput_device_get_user_data(libinput_device);
 	struct weston_pointer_motion_event event = { 0 };
+	struct weston_pointer_motion_event *pending = &device->pending_motion;
 	struct timespec time;
 	double dx_unaccel, dy_unaccel;
 
@@ -112,6 +153,24 @@ handle_pointer_motion(struct libinput_device *libinput_device,
 		.dy_unaccel = dy_unaccel,
 	};
 
+	if (evdev_device_coalesce_motion(device)) {
+		/* Delivered by evdev_device_flush_motion() before the next
+		 * other event, or when the dispatch is done. The sums keep
+		 * the unaccelerated deltas exact. */
+		if (device->motion_pending) {
+			pending->time = event.time;
+			pending->dx += event.dx;
+			pending->dy += event.dy;
+			pending->dx_unaccel += event.dx_unaccel;
+			pending->dy_unaccel += event.dy_unaccel;
+		} else {
+			*pending = event;
+			device->motion_pending = true;
+		}
+		return false;
+	}
+
+	evdev_device_flush_motion(device);
 	notify_motion(device->seat, &time, &event);
 
 	return true;
@@ -337,9 +396,12 @@ touch_get_calibration(struct weston_touch_device *device,
 		      struct weston_touch_device_matrix *cal)
 {
 	struct evdev_device *evdev_device = device->backend_data;
+	struct udev_seat *seat = (struct udev_seat *) evdev_device->seat;
 
+	udev_input_lock(seat->input);
 	libinput_device_config_calibration_get_matrix(evdev_device->device,
 						      cal->m);
+	udev_input_unlock(seat->input);
 }
 
 static void
@@ -366,13 +428,16 @@ touch_set_calibration(struct weston_touch_device *device,
 		      const struct weston_touch_device_matrix *cal)
 {
 	struct evdev_device *evdev_device = device->backend_data;
+	struct udev_seat *seat = (struct udev_seat *) evdev_device->seat;
 
 	/* Stop output hotplug from reloading the WL_CALIBRATION values.
 	 * libinput will maintain the latest calibration for us.
 	 */
 	evdev_device->override_wl_calibration = true;
 
+	udev_input_lock(seat->input);
 	do_set_calibration(evdev_device, cal);
+	udev_input_unlock(seat->input);
 }
 
 static const struct weston_touch_device_ops touch_calibration_ops = {
@@ -490,6 +555,40 @@ handle_touch_frame(struct libinput_device *libinput_device,
 	notify_touch_frame(device->touch_device);
 }
 
+/* The kernel timestamp of an event, in CLOCK_MONOTONIC as libinput sets
+ * up evdev; events without one are stamped with the current time. */
+static void
+evdev_event_get_time(struct libinput_event *event, struct timespec *time)
+{
+	uint64_t usec;
+
+	switch (libinput_event_get_type(event)) {
+	case LIBINPUT_EVENT_KEYBOARD_KEY:
+		usec = libinput_event_keyboard_get_time_usec(
+				libinput_event_get_keyboard_event(event));
+		break;
+	case LIBINPUT_EVENT_POINTER_MOTION:
+	case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
+	case LIBINPUT_EVENT_POINTER_BUTTON:
+	case LIBINPUT_EVENT_POINTER_AXIS:
+		usec = libinput_event_pointer_get_time_usec(
+				libinput_event_get_pointer_event(event));
+		break;
+	case LIBINPUT_EVENT_TOUCH_DOWN:
+	case LIBINPUT_EVENT_TOUCH_MOTION:
+	case LIBINPUT_EVENT_TOUCH_UP:
+	case LIBINPUT_EVENT_TOUCH_FRAME:
+		usec = libinput_event_touch_get_time_usec(
+				libinput_event_get_touch_event(event));
+		break;
+	default:
+		clock_gettime(CLOCK_MONOTONIC, time);
+		return;
+	}
+
+	timespec_from_usec(time, usec);
+}
+
 int
 evdev_device_process_event(struct libinput_event *event)
 {
@@ -499,6 +598,10 @@ evdev_device_process_event(struct libinput_event *event)
 		libinput_device_get_user_data(libinput_device);
 	int handled = 1;
 	bool need_frame = false;
+	struct timespec time;
+
+	evdev_event_get_time(event, &time);
+	weston_input_latency_begin(device->seat->compositor, &time);
 
 	switch (libinput_event_get_type(event)) {
 	case LIBINPUT_EVENT_KEYBOARD_KEY:
@@ -548,6 +651,8 @@ evdev_device_process_event(struct libinput_event *event)
 	if (need_frame)
 		notify_pointer_frame(device->seat);
 
+	weston_input_latency_end(device->seat->compositor);
+
 	return handled;
 }
 
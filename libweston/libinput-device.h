@@ -52,6 +52,10 @@ struct evdev_device {
 	char *output_name;
 	int fd;
 	bool override_wl_calibration;
+
+	/* Relative motion not delivered yet, see evdev_device_flush_motion() */
+	bool motion_pending;
+	struct weston_pointer_motion_event pending_motion;
 };
 
 void
@@ -64,6 +68,9 @@ evdev_device_create(struct libinput_device *libinput_device,
 int
 evdev_device_process_event(struct libinput_event *event);
 
+void
+evdev_device_flush_motion(struct evdev_device *device);
+
 void
 evdev_device_set_output(struct evdev_device *device,
 			struct weston_output *output);
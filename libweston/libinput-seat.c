@@ -27,10 +27,15 @@
 #include "config.h"
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/eventfd.h>
 #include <libinput.h>
 #include <libudev.h>
 
@@ -49,6 +54,8 @@ static struct udev_seat *
 udev_seat_create(struct udev_input *input, const char *seat_name);
 static void
 udev_seat_destroy(struct udev_seat *seat);
+static void
+udev_input_stop_thread(struct udev_input *input);
 
 static struct udev_seat *
 get_udev_seat(struct udev_input *input, struct libinput_device *device)
@@ -164,8 +171,12 @@ udev_input_disable(struct udev_input *input)
 	if (input->suspended)
 		return;
 
-	wl_event_source_remove(input->libinput_source);
-	input->libinput_source = NULL;
+	if (input->thread_running) {
+		udev_input_stop_thread(input);
+	} else {
+		wl_event_source_remove(input->libinput_source);
+		input->libinput_source = NULL;
+	}
 	libinput_suspend(input->libinput);
 	process_events(input);
 	input->suspended = 1;
@@ -194,6 +205,49 @@ udev_input_process_event(struct libinput_event *event)
 	return handled;
 }
 
+static void
+udev_input_flush_motion(struct udev_input *input)
+{
+	struct udev_seat *seat;
+	struct evdev_device *device;
+
+	wl_list_for_each(seat, &input->compositor->seat_list, base.link)
+		wl_list_for_each(device, &seat->devices_list, link)
+			evdev_device_flush_motion(device);
+}
+
+/* Key events of one dispatch are delivered per wl_keyboard resource at
+ * the end of the dispatch, see weston_keyboard_begin_batch(). */
+static void
+udev_input_begin_key_batch(struct udev_input *input)
+{
+	struct weston_seat *seat;
+
+	wl_list_for_each(seat, &input->compositor->seat_list, link)
+		if (seat->keyboard_state)
+			weston_keyboard_begin_batch(seat->keyboard_state);
+}
+
+static void
+udev_input_flush_keys(struct udev_input *input)
+{
+	struct weston_seat *seat;
+
+	wl_list_for_each(seat, &input->compositor->seat_list, link)
+		if (seat->keyboard_state)
+			weston_keyboard_flush_batch(seat->keyboard_state);
+}
+
+static void
+udev_input_end_key_batch(struct udev_input *input)
+{
+	struct weston_seat *seat;
+
+	wl_list_for_each(seat, &input->compositor->seat_list, link)
+		if (seat->keyboard_state)
+			weston_keyboard_end_batch(seat->keyboard_state);
+}
+
 static void
 process_event(struct libinput_event *event)
 {
@@ -203,20 +257,43 @@ process_event(struct libinput_event *event)
 		return;
 }
 
+static void
+handle_event(struct udev_input *input, struct libinput_event *event)
+{
+	enum libinput_event_type type = libinput_event_get_type(event);
+
+	/* Coalesced motion must not be reordered with anything else, like
+	 * the button press that ends a drag. */
+	if (type != LIBINPUT_EVENT_POINTER_MOTION)
+		udev_input_flush_motion(input);
+
+	/* Likewise for batched keys, e.g. a modifier held for a click */
+	if (type != LIBINPUT_EVENT_KEYBOARD_KEY)
+		udev_input_flush_keys(input);
+
+	process_event(event);
+	libinput_event_destroy(event);
+}
+
 static void
 process_events(struct udev_input *input)
 {
 	struct libinput_event *event;
 
-	while ((event = libinput_get_event(input->libinput))) {
-		process_event(event);
-		libinput_event_destroy(event);
-	}
+	udev_input_begin_key_batch(input);
+
+	while ((event = libinput_get_event(input->libinput)))
+		handle_event(input, event);
+
+	udev_input_flush_motion(input);
+	udev_input_end_key_batch(input);
 }
 
 static int
 udev_input_dispatch(struct udev_input *input)
 {
+	weston_client_stats_dispatch_end(input->compositor);
+
 	if (libinput_dispatch(input->libinput) != 0)
 		weston_log("libinput: Failed to dispatch libinput\n");
 
@@ -233,12 +310,349 @@ libinput_source_dispatch(int fd, uint32_t mask, void *data)
 	return udev_input_dispatch(input) != 0;
 }
 
+/* Serves the request of the input thread, if any, with request_lock held */
+static void
+udev_input_serve_request_locked(struct udev_input *input)
+{
+	struct weston_launcher *launcher = input->compositor->launcher;
+	struct udev_input_request *request = &input->request;
+
+	if (!request->pending)
+		return;
+
+	if (request->path)
+		request->fd = weston_launcher_open(launcher, request->path,
+						   request->flags);
+	else
+		weston_launcher_close(launcher, request->fd);
+
+	request->pending = false;
+	pthread_cond_broadcast(&input->request_cond);
+}
+
+static void
+udev_input_serve_request(struct udev_input *input)
+{
+	pthread_mutex_lock(&input->request_lock);
+	udev_input_serve_request_locked(input);
+	pthread_mutex_unlock(&input->request_lock);
+}
+
+/* Serializes the use of the libinput context with the input thread. The
+ * lock is recursive, as e.g. LED updates can happen both from within
+ * event processing and from elsewhere.
+ *
+ * The input thread holds the lock while libinput is dispatched, which is
+ * also when it may wait for the main thread to open or close a device, so
+ * the main thread serves such requests while it waits for the lock. */
+void
+udev_input_lock(struct udev_input *input)
+{
+	uint64_t seq;
+
+	if (!pthread_equal(pthread_self(), input->main_thread) ||
+	    !input->thread_running) {
+		pthread_mutex_lock(&input->lock);
+		return;
+	}
+
+	for (;;) {
+		pthread_mutex_lock(&input->request_lock);
+		seq = input->unlock_seq;
+		pthread_mutex_unlock(&input->request_lock);
+
+		if (pthread_mutex_trylock(&input->lock) == 0)
+			return;
+
+		pthread_mutex_lock(&input->request_lock);
+		while (!input->request.pending && seq == input->unlock_seq)
+			pthread_cond_wait(&input->request_cond,
+					  &input->request_lock);
+		udev_input_serve_request_locked(input);
+		pthread_mutex_unlock(&input->request_lock);
+	}
+}
+
+void
+udev_input_unlock(struct udev_input *input)
+{
+	pthread_mutex_unlock(&input->lock);
+
+	if (pthread_equal(pthread_self(), input->main_thread))
+		return;
+
+	/* Have a main thread waiting in udev_input_lock() try again */
+	pthread_mutex_lock(&input->request_lock);
+	input->unlock_seq++;
+	pthread_cond_broadcast(&input->request_cond);
+	pthread_mutex_unlock(&input->request_lock);
+}
+
+/* Size of the queue from the input thread, in events */
+#define UDEV_INPUT_QUEUE_SIZE 1024
+
+/* Size of the queue of libinput log messages from the input thread */
+#define UDEV_INPUT_LOG_QUEUE_SIZE 64
+
+/* Reads the devices as soon as they have data, independently of how busy
+ * the main loop is with repaints and client requests. Events are only
+ * taken out of libinput here; processing them touches compositor state
+ * and stays on the main loop. libinput also reads udev from the same fd,
+ * but the devices it then opens or closes are handed over to the main
+ * thread, see open_restricted(), and device added and removed events are
+ * processed there like any other. */
+static void *
+udev_input_thread(void *data)
+{
+	struct udev_input *input = data;
+	struct libinput_event *event = NULL;
+	struct pollfd fds[2];
+	uint64_t one = 1;
+	sigset_t mask;
+	bool queued;
+
+	/* Signals are for the main loop's signalfds */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+	fds[0].fd = libinput_get_fd(input->libinput);
+	fds[0].events = POLLIN;
+	fds[1].fd = input->thread_stop_fd;
+	fds[1].events = POLLIN;
+
+	for (;;) {
+		/* While the queue is full, retry shortly even without new
+		 * input; libinput buffers what is read in the meantime. */
+		if (poll(fds, ARRAY_LENGTH(fds), event ? 1 : -1) < 0 &&
+		    errno != EINTR)
+			break;
+		if (fds[1].revents)
+			break;
+
+		queued = false;
+
+		udev_input_lock(input);
+		libinput_dispatch(input->libinput);
+		for (;;) {
+			if (!event)
+				event = libinput_get_event(input->libinput);
+			if (!event)
+				break;
+			if (!weston_spsc_ring_push(&input->queue, event))
+				break;
+			event = NULL;
+			queued = true;
+		}
+		udev_input_unlock(input);
+
+		if (queued &&
+		    write(input->queue_fd, &one, sizeof one) != sizeof one)
+			break;
+	}
+
+	if (event) {
+		udev_input_lock(input);
+		libinput_event_destroy(event);
+		udev_input_unlock(input);
+	}
+
+	pthread_mutex_lock(&input->request_lock);
+	input->thread_done = true;
+	pthread_cond_broadcast(&input->request_cond);
+	pthread_mutex_unlock(&input->request_lock);
+
+	return NULL;
+}
+
+static void
+process_queued_events(struct udev_input *input)
+{
+	struct libinput_event *event;
+
+	udev_input_lock(input);
+	udev_input_begin_key_batch(input);
+
+	while ((event = weston_spsc_ring_pop(&input->queue)))
+		handle_event(input, event);
+
+	udev_input_flush_motion(input);
+	udev_input_end_key_batch(input);
+
+	udev_input_unlock(input);
+}
+
+/* Logs what libinput had to say while dispatched on the input thread */
+static void
+process_queued_logs(struct udev_input *input)
+{
+	unsigned int dropped;
+	char *message;
+
+	while ((message = weston_spsc_ring_pop(&input->log_queue))) {
+		weston_log("%s", message);
+		free(message);
+	}
+
+	dropped = atomic_exchange(&input->log_dropped, 0);
+	if (dropped > 0)
+		weston_log("libinput: %u log messages dropped\n", dropped);
+}
+
+static int
+udev_input_queue_dispatch(int fd, uint32_t mask, void *data)
+{
+	struct udev_input *input = data;
+	uint64_t count;
+
+	weston_client_stats_dispatch_end(input->compositor);
+
+	/* Only a wakeup, the queues themselves say how much there is to do */
+	if (read(fd, &count, sizeof count) < 0 && errno != EAGAIN)
+		weston_log("libinput: failed to read input queue eventfd: %s\n",
+			   strerror(errno));
+
+	udev_input_serve_request(input);
+	process_queued_logs(input);
+	process_queued_events(input);
+
+	return 0;
+}
+
+static void
+udev_input_close_thread_fds(struct udev_input *input)
+{
+	if (input->queue_fd >= 0)
+		close(input->queue_fd);
+	if (input->thread_stop_fd >= 0)
+		close(input->thread_stop_fd);
+	input->queue_fd = -1;
+	input->thread_stop_fd = -1;
+	input->main_thread = pthread_self();
+}
+
+static int
+udev_input_start_thread(struct udev_input *input)
+{
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(input->compositor->wl_display);
+
+	input->queue_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	input->thread_stop_fd = eventfd(0, EFD_CLOEXEC);
+	if (input->queue_fd < 0 || input->thread_stop_fd < 0)
+		goto err_fds;
+
+	if (!weston_spsc_ring_init(&input->queue, UDEV_INPUT_QUEUE_SIZE))
+		goto err_fds;
+
+	input->request.pending = false;
+	input->thread_done = false;
+
+	if (!weston_spsc_ring_init(&input->log_queue,
+				   UDEV_INPUT_LOG_QUEUE_SIZE))
+		goto err_queue;
+
+	input->libinput_source =
+		wl_event_loop_add_fd(loop, input->queue_fd, WL_EVENT_READABLE,
+				     udev_input_queue_dispatch, input);
+	if (!input->libinput_source)
+		goto err_log_queue;
+
+	if (pthread_create(&input->thread, NULL, udev_input_thread,
+			   input) != 0)
+		goto err_source;
+
+	input->thread_running = true;
+
+	return 0;
+
+err_source:
+	wl_event_source_remove(input->libinput_source);
+	input->libinput_source = NULL;
+err_log_queue:
+	weston_spsc_ring_release(&input->log_queue);
+err_queue:
+	weston_spsc_ring_release(&input->queue);
+err_fds:
+	udev_input_close_thread_fds(input);
+	return -1;
+}
+
+static void
+udev_input_stop_thread(struct udev_input *input)
+{
+	uint64_t one = 1;
+
+	if (write(input->thread_stop_fd, &one, sizeof one) != sizeof one)
+		weston_log("libinput: failed to stop the input thread: %s\n",
+			   strerror(errno));
+
+	/* The thread may be waiting for a device to be opened or closed */
+	pthread_mutex_lock(&input->request_lock);
+	while (!input->thread_done) {
+		if (input->request.pending)
+			udev_input_serve_request_locked(input);
+		else
+			pthread_cond_wait(&input->request_cond,
+					  &input->request_lock);
+	}
+	pthread_mutex_unlock(&input->request_lock);
+
+	pthread_join(input->thread, NULL);
+	input->thread_running = false;
+
+	/* Whatever the thread read last still needs to be processed */
+	process_queued_logs(input);
+	process_queued_events(input);
+
+	wl_event_source_remove(input->libinput_source);
+	input->libinput_source = NULL;
+	weston_spsc_ring_release(&input->log_queue);
+	weston_spsc_ring_release(&input->queue);
+	udev_input_close_thread_fds(input);
+}
+
+/* Has the main thread open path, or close fd if path is NULL, and waits
+ * for it to be done. The main loop is woken up through the queue eventfd,
+ * and a main thread waiting for the libinput lock by request_cond. */
+static int
+udev_input_request_from_thread(struct udev_input *input, const char *path,
+			       int flags, int fd)
+{
+	uint64_t one = 1;
+
+	pthread_mutex_lock(&input->request_lock);
+	input->request.path = path;
+	input->request.flags = flags;
+	input->request.fd = fd;
+	input->request.pending = true;
+	pthread_cond_broadcast(&input->request_cond);
+	pthread_mutex_unlock(&input->request_lock);
+
+	if (write(input->queue_fd, &one, sizeof one) != sizeof one)
+		weston_log("libinput: failed to wake up the main loop: %s\n",
+			   strerror(errno));
+
+	pthread_mutex_lock(&input->request_lock);
+	while (input->request.pending)
+		pthread_cond_wait(&input->request_cond, &input->request_lock);
+	fd = input->request.fd;
+	pthread_mutex_unlock(&input->request_lock);
+
+	return fd;
+}
+
+/* Neither logind's D-Bus connection nor the weston-launch socket may be
+ * used off the main thread, so devices are always opened and closed
+ * there. */
 static int
 open_restricted(const char *path, int flags, void *user_data)
 {
 	struct udev_input *input = user_data;
 	struct weston_launcher *launcher = input->compositor->launcher;
 
+	if (!pthread_equal(pthread_self(), input->main_thread))
+		return udev_input_request_from_thread(input, path, flags, -1);
+
 	return weston_launcher_open(launcher, path, flags);
 }
 
@@ -248,6 +662,11 @@ close_restricted(int fd, void *user_data)
 	struct udev_input *input = user_data;
 	struct weston_launcher *launcher = input->compositor->launcher;
 
+	if (!pthread_equal(pthread_self(), input->main_thread)) {
+		udev_input_request_from_thread(input, NULL, 0, fd);
+		return;
+	}
+
 	weston_launcher_close(launcher, fd);
 }
 
@@ -265,25 +684,27 @@ udev_input_enable(struct udev_input *input)
 	struct udev_seat *seat;
 	int devices_found = 0;
 
-	loop = wl_display_get_event_loop(c->wl_display);
-	fd = libinput_get_fd(input->libinput);
-	input->libinput_source =
-		wl_event_loop_add_fd(loop, fd, WL_EVENT_READABLE,
-				     libinput_source_dispatch, input);
-	if (!input->libinput_source) {
-		return -1;
-	}
-
 	if (input->suspended) {
-		if (libinput_resume(input->libinput) != 0) {
-			wl_event_source_remove(input->libinput_source);
-			input->libinput_source = NULL;
+		if (libinput_resume(input->libinput) != 0)
 			return -1;
-		}
 		input->suspended = 0;
 		process_events(input);
 	}
 
+	if (c->input_thread && udev_input_start_thread(input) < 0)
+		weston_log("libinput: failed to start the input thread, "
+			   "reading input on the main loop\n");
+
+	if (!input->thread_running) {
+		loop = wl_display_get_event_loop(c->wl_display);
+		fd = libinput_get_fd(input->libinput);
+		input->libinput_source =
+			wl_event_loop_add_fd(loop, fd, WL_EVENT_READABLE,
+					     libinput_source_dispatch, input);
+		if (!input->libinput_source)
+			return -1;
+	}
+
 	wl_list_for_each(seat, &input->compositor->seat_list, base.link) {
 		evdev_notify_keyboard_focus(&seat->base, &seat->devices_list);
 
@@ -311,12 +732,36 @@ udev_input_enable(struct udev_input *input)
 	return 0;
 }
 
+/* libinput logs from whichever thread dispatches it. The log scopes may
+ * only be used on the main thread, so messages from the input thread are
+ * formatted there and logged by the main loop. */
 static void
 libinput_log_func(struct libinput *libinput,
 		  enum libinput_log_priority priority,
 		  const char *format, va_list args)
 {
-	weston_vlog(format, args);
+	struct udev_input *input = libinput_get_user_data(libinput);
+	uint64_t one = 1;
+	char *message;
+
+	if (pthread_equal(pthread_self(), input->main_thread)) {
+		weston_vlog(format, args);
+		return;
+	}
+
+	if (vasprintf(&message, format, args) < 0) {
+		atomic_fetch_add(&input->log_dropped, 1);
+		return;
+	}
+
+	if (!weston_spsc_ring_push(&input->log_queue, message)) {
+		free(message);
+		atomic_fetch_add(&input->log_dropped, 1);
+		return;
+	}
+
+	if (write(input->queue_fd, &one, sizeof one) != sizeof one)
+		return; /* the event queue wakes the main loop up anyway */
 }
 
 int
@@ -327,10 +772,22 @@ udev_input_init(struct udev_input *input, struct weston_compositor *c,
 	enum libinput_log_priority priority = LIBINPUT_LOG_PRIORITY_INFO;
 	const char *log_priority = NULL;
 
+	pthread_mutexattr_t attr;
+
 	memset(input, 0, sizeof *input);
 
 	input->compositor = c;
 	input->configure_device = configure_device;
+	input->queue_fd = -1;
+	input->thread_stop_fd = -1;
+	input->main_thread = pthread_self();
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&input->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	pthread_mutex_init(&input->request_lock, NULL);
+	pthread_cond_init(&input->request_cond, NULL);
 
 	log_priority = getenv("WESTON_LIBINPUT_LOG_PRIORITY");
 
@@ -369,11 +826,16 @@ udev_input_destroy(struct udev_input *input)
 {
 	struct udev_seat *seat, *next;
 
-	if (input->libinput_source)
+	if (input->thread_running)
+		udev_input_stop_thread(input);
+	else if (input->libinput_source)
 		wl_event_source_remove(input->libinput_source);
 	wl_list_for_each_safe(seat, next, &input->compositor->seat_list, base.link)
 		udev_seat_destroy(seat);
 	libinput_unref(input->libinput);
+	pthread_cond_destroy(&input->request_cond);
+	pthread_mutex_destroy(&input->request_lock);
+	pthread_mutex_destroy(&input->lock);
 }
 
 static void
@@ -382,8 +844,10 @@ udev_seat_led_update(struct weston_seat *seat_base, enum weston_led leds)
 	struct udev_seat *seat = (struct udev_seat *) seat_base;
 	struct evdev_device *device;
 
+	udev_input_lock(seat->input);
 	wl_list_for_each(device, &seat->devices_list, link)
 		evdev_led_update(device, leds);
+	udev_input_unlock(seat->input);
 }
 
 static void
@@ -392,6 +856,7 @@ udev_seat_output_changed(struct udev_seat *seat, struct weston_output *output)
 	struct evdev_device *device;
 	struct weston_output *found;
 
+	udev_input_lock(seat->input);
 	wl_list_for_each(device, &seat->devices_list, link) {
 		/* If we find any input device without an associated output
 		 * or an output name to associate with, just tie it with the
@@ -411,6 +876,7 @@ udev_seat_output_changed(struct udev_seat *seat, struct weston_output *output)
 						 device->output_name);
 		evdev_device_set_output(device, found);
 	}
+	udev_input_unlock(seat->input);
 }
 
 static void
@@ -445,6 +911,7 @@ udev_seat_create(struct udev_input *input, const char *seat_name)
 
 	weston_seat_init(&seat->base, c, seat_name);
 	seat->base.led_update = udev_seat_led_update;
+	seat->input = input;
 
 	seat->output_create_listener.notify = notify_output_create;
 	wl_signal_add(&c->output_created_signal,
@@ -30,13 +30,18 @@
 #include "config.h"
 
 #include <libudev.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 #include <libweston/libweston.h>
+#include "shared/spsc-ring.h"
 
 struct libinput_device;
 
 struct udev_seat {
 	struct weston_seat base;
+	struct udev_input *input;
 	struct wl_list devices_list;
 	struct wl_listener output_create_listener;
 	struct wl_listener output_heads_listener;
@@ -45,12 +50,46 @@ struct udev_seat {
 typedef void (*udev_configure_device_t)(struct weston_compositor *compositor,
 					struct libinput_device *device);
 
+/* A device to open, or to close if path is NULL, for the input thread */
+struct udev_input_request {
+	bool pending;
+	const char *path;
+	int flags;
+	int fd;		/* to close, or the result of opening */
+};
+
 struct udev_input {
 	struct libinput *libinput;
 	struct wl_event_source *libinput_source;
 	struct weston_compositor *compositor;
 	int suspended;
 	udev_configure_device_t configure_device;
+
+	/* With compositor->input_thread, a thread reads libinput and passes
+	 * the events on through queue, waking the main loop up through
+	 * queue_fd. libinput is not thread-safe, so the context is only used
+	 * with lock held, see udev_input_lock(). What libinput logs on the
+	 * thread goes through log_queue the same way.
+	 *
+	 * The launcher may only be used on the main thread, so when libinput
+	 * opens or closes a device while dispatched on the input thread, the
+	 * thread posts request and waits until the main thread has served it,
+	 * see open_restricted(). request, unlock_seq and thread_done are
+	 * protected by request_lock. */
+	bool thread_running;
+	pthread_t thread;
+	pthread_t main_thread;
+	pthread_mutex_t lock;
+	struct weston_spsc_ring queue;
+	struct weston_spsc_ring log_queue;
+	_Atomic unsigned int log_dropped;
+	int queue_fd;
+	int thread_stop_fd;
+	pthread_mutex_t request_lock;
+	pthread_cond_t request_cond;
+	struct udev_input_request request;
+	uint64_t unlock_seq;
+	bool thread_done;
 };
 
 int
@@ -66,6 +105,11 @@ udev_input_init(struct udev_input *input,
 void
 udev_input_destroy(struct udev_input *input);
 
+void
+udev_input_lock(struct udev_input *input);
+void
+udev_input_unlock(struct udev_input *input);
+
 struct udev_seat *
 udev_seat_get_named(struct udev_input *u,
 		    const char *seat_name);
@@ -226,6 +226,15 @@ weston_pointer_constraint_destroy(struct weston_pointer_constraint *constraint);
 bool
 weston_keyboard_has_focus_resource(struct weston_keyboard *keyboard);
 
+void
+weston_keyboard_begin_batch(struct weston_keyboard *keyboard);
+
+void
+weston_keyboard_flush_batch(struct weston_keyboard *keyboard);
+
+void
+weston_keyboard_end_batch(struct weston_keyboard *keyboard);
+
 /* weston_touch */
 
 struct weston_touch_device *
@@ -247,6 +256,46 @@ weston_touch_start_drag(struct weston_touch *touch,
 			struct wl_client *client);
 
 
+/* touch resampling */
+
+struct weston_touch_resampler *
+weston_touch_resampler_create(struct weston_touch *touch);
+
+void
+weston_touch_resampler_destroy(struct weston_touch_resampler *r);
+
+void
+weston_touch_resampler_reset(struct weston_touch_resampler *r);
+
+void
+weston_touch_resampler_device_destroyed(struct weston_touch_resampler *r,
+					struct weston_touch_device *device);
+
+void
+weston_touch_resampler_flush(struct weston_touch_resampler *r);
+
+void
+weston_touch_resampler_down(struct weston_touch_resampler *r,
+			    struct weston_touch_device *device,
+			    const struct timespec *time, int touch_id,
+			    double x, double y);
+
+void
+weston_touch_resampler_up(struct weston_touch_resampler *r, int touch_id);
+
+bool
+weston_touch_resampler_motion(struct weston_touch_resampler *r,
+			      const struct timespec *time, int touch_id,
+			      double x, double y);
+
+bool
+weston_touch_resampler_frame(struct weston_touch_resampler *r);
+
+void
+weston_touch_process_motion(struct weston_touch_device *device,
+			    const struct timespec *time, int touch_id,
+			    double x, double y);
+
 /* weston_touch_device */
 
 bool
@@ -319,6 +368,59 @@ void
 weston_matrix_transform_region(pixman_region32_t *dest,
 			       struct weston_matrix *matrix,
 			       pixman_region32_t *src);
+void
+weston_view_compute_bbox(struct weston_view *view, const pixman_box32_t *inbox,
+			 pixman_region32_t *bbox);
+
+/* client stats */
+
+int
+weston_client_stats_init(struct weston_compositor *compositor);
+
+void
+weston_client_stats_fini(struct weston_compositor *compositor);
+
+void
+weston_client_stats_commit(struct weston_surface *surface);
+
+void
+weston_client_stats_flush_damage(struct weston_surface *surface);
+
+void
+weston_client_stats_dispatch_end(struct weston_compositor *compositor);
+
+void
+weston_client_stats_print(struct weston_compositor *compositor, FILE *fp,
+			  const char *prefix);
+
+/* input latency */
+
+int
+weston_input_latency_init(struct weston_compositor *compositor);
+
+void
+weston_input_latency_fini(struct weston_compositor *compositor);
+
+void
+weston_input_latency_begin(struct weston_compositor *compositor,
+			   const struct timespec *time);
+
+void
+weston_input_latency_end(struct weston_compositor *compositor);
+
+void
+weston_input_latency_deliver(struct weston_compositor *compositor,
+			     struct wl_client *client);
+
+void
+weston_input_latency_commit(struct weston_surface *surface);
+
+void
+weston_input_latency_repaint(struct weston_output *output);
+
+void
+weston_input_latency_presented(struct weston_output *output,
+			       const struct timespec *stamp);
 
 /* protected_surface */
 void
@@ -294,7 +294,7 @@ timeline_submit_render_sync(struct gl_renderer *gr,
 	int fd;
 	struct timeline_render_point *trp;
 
-	if (!weston_log_scope_is_enabled(ec->timeline) ||
+	if (!TL_ENABLED(ec) ||
 	    !gr->has_native_fence_sync ||
 	    sync == EGL_NO_SYNC_KHR)
 		return;
@@ -3029,16 +3029,21 @@ log_extensions(const char *name, const char *extensions)
 	int l;
 	int len;
 
-	l = weston_log("%s:", name);
+	/* Count the line width here: weston_log() does not format the
+	 * message when it is only recorded, and then returns 0. */
+	weston_log("%s:", name);
+	l = strlen(STAMP_SPACE) + strlen(name) + 1;
 	p = extensions;
 	while (*p) {
 		end = strchrnul(p, ' ');
 		len = end - p;
-		if (l + len > 78)
-			l = weston_log_continue("\n" STAMP_SPACE "%.*s",
-						len, p);
-		else
-			l += weston_log_continue(" %.*s", len, p);
+		if (l + len > 78) {
+			weston_log_continue("\n" STAMP_SPACE "%.*s", len, p);
+			l = strlen(STAMP_SPACE) + len;
+		} else {
+			weston_log_continue(" %.*s", len, p);
+			l += len + 1;
+		}
 		for (p = end; isspace(*p); p++)
 			;
 	}
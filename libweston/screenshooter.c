@@ -34,14 +34,16 @@
 #include <unistd.h>
 #include <errno.h>
 #include <sys/uio.h>
+#include <pthread.h>
 
 #include <libweston/libweston.h>
 #include "shared/helpers.h"
+#include "shared/task-pool.h"
 #include "shared/timespec-util.h"
 #include "backend.h"
 #include "libweston-internal.h"
 
-#include "wcap/wcap-decode.h"
+#include "wcap-encode.h"
 
 struct screenshooter_frame_listener {
 	struct wl_listener listener;
@@ -214,45 +216,292 @@ weston_screenshooter_shoot(struct weston_output *output,
 	return 0;
 }
 
+/* Frames waiting for the encoder before the compositor starts dropping
+ * them; a dropped frame's damage is recorded with the next one. */
+#define RECORDER_MAX_QUEUED_FRAMES 3
+#define RECORDER_MAX_WORKERS 4
+/* Recorded frames between keyframes, which decoders can seek to */
+#define RECORDER_KEYFRAME_INTERVAL 60
+/* Height of the bands a keyframe is encoded in, in parallel */
+#define RECORDER_KEYFRAME_BAND 64
+
 struct weston_recorder {
 	struct weston_output *output;
-	uint32_t *frame, *rect;
-	uint32_t *tmpbuf;
-	uint32_t total;
+	/* size of the output when recording started; the encoder thread
+	 * must not look at the output, whose mode may change */
+	int width, height;
+	uint32_t *frame;
+	uint64_t total;
 	int fd;
 	struct wl_listener frame_listener;
-	int count, destroying;
+	int count, dropped, destroying;
+	int do_yflip;
+	pixman_region32_t missed;
+
+	/* Snapshots are encoded and written by the encoder thread; the
+	 * frame it diffs against is only touched there. */
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct wl_list queue;
+	int queued;
+	bool quit;
+	struct weston_task_pool *pool;
+	struct wl_array index;
+	bool index_failed;
+};
+
+struct recorder_rect {
+	uint32_t *pixels;
+	uint32_t *out;
+	size_t out_len;
 };
 
-static uint32_t *
-output_run(uint32_t *p, uint32_t delta, int run)
+struct recorder_frame {
+	struct wl_list link;
+	struct weston_recorder *recorder;
+	uint32_t msecs;
+	uint32_t flags;
+	int nrects;
+	struct wcap_rectangle *boxes;
+	struct recorder_rect *rects;
+	uint32_t *pixels;
+	uint32_t *out;
+};
+
+static void
+recorder_frame_free(struct recorder_frame *frame)
+{
+	free(frame->out);
+	free(frame->pixels);
+	free(frame->rects);
+	free(frame->boxes);
+	free(frame);
+}
+
+/* Runs on the encoder thread or a pool worker. The rectangles of a frame
+ * never overlap, so they update disjoint parts of recorder->frame. */
+static void
+recorder_encode_rect(void *data, unsigned index)
+{
+	struct recorder_frame *frame = data;
+	struct weston_recorder *recorder = frame->recorder;
+	struct recorder_rect *rect = &frame->rects[index];
+
+	rect->out_len = wcap_encode_rect(recorder->frame, recorder->width,
+					 &frame->boxes[index], rect->pixels,
+					 recorder->do_yflip, rect->out);
+}
+
+static void
+recorder_encode_key_rect(void *data, unsigned index)
+{
+	struct recorder_frame *frame = data;
+	struct weston_recorder *recorder = frame->recorder;
+	struct recorder_rect *rect = &frame->rects[index];
+
+	rect->out_len = wcap_encode_key_rect(recorder->frame, recorder->width,
+					     &frame->boxes[index], rect->out);
+}
+
+/* Replaces the damage of a keyframe, already applied to recorder->frame,
+ * with bands covering the whole picture. The compositor only reads the
+ * damage back from the renderer, even for keyframes, and the rest comes
+ * from the encoder's own copy. Returns -1 if out of memory, leaving the
+ * frame as it is. */
+static int
+recorder_frame_make_key(struct weston_recorder *recorder,
+			struct recorder_frame *frame)
+{
+	struct wcap_rectangle *boxes;
+	struct recorder_rect *rects;
+	uint32_t *out;
+	int i, n;
+
+	n = (recorder->height + RECORDER_KEYFRAME_BAND - 1) /
+	    RECORDER_KEYFRAME_BAND;
+	boxes = malloc(n * sizeof *boxes);
+	rects = malloc(n * sizeof *rects);
+	out = malloc((size_t) recorder->width * recorder->height * 4);
+	if (!boxes || !rects || !out) {
+		free(boxes);
+		free(rects);
+		free(out);
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		boxes[i].x1 = 0;
+		boxes[i].x2 = recorder->width;
+		boxes[i].y1 = i * RECORDER_KEYFRAME_BAND;
+		boxes[i].y2 = MIN(boxes[i].y1 + RECORDER_KEYFRAME_BAND,
+				  recorder->height);
+		rects[i].pixels = NULL;
+		rects[i].out = out + (size_t) recorder->width * boxes[i].y1;
+		rects[i].out_len = 0;
+	}
+
+	free(frame->boxes);
+	free(frame->rects);
+	free(frame->out);
+	frame->boxes = boxes;
+	frame->rects = rects;
+	frame->out = out;
+	frame->nrects = n;
+
+	return 0;
+}
+
+static void
+recorder_write_frame(struct weston_recorder *recorder,
+		     struct recorder_frame *frame)
 {
+	struct wcap_frame_header_v2 header;
+	struct wcap_index_entry *entry;
+	struct wcap_checksum checksum;
+	struct iovec v[2];
 	int i;
 
-	while (run > 0) {
-		if (run <= 0xe0) {
-			*p++ = delta | ((run - 1) << 24);
+	header.msecs = frame->msecs;
+	header.nrects = frame->nrects;
+	header.flags = frame->flags;
+	header.size = frame->nrects * sizeof *frame->boxes;
+	wcap_checksum_init(&checksum);
+	wcap_checksum_update(&checksum, frame->boxes, header.size);
+	for (i = 0; i < frame->nrects; i++) {
+		header.size += frame->rects[i].out_len * 4;
+		wcap_checksum_update(&checksum, frame->rects[i].out,
+				     frame->rects[i].out_len * 4);
+	}
+	header.checksum = wcap_checksum_final(&checksum);
+
+	entry = wl_array_add(&recorder->index, sizeof *entry);
+	if (entry) {
+		entry->offset = recorder->total;
+		entry->msecs = frame->msecs;
+		entry->flags = frame->flags;
+	} else {
+		recorder->index_failed = true;
+	}
+
+	v[0].iov_base = &header;
+	v[0].iov_len = sizeof header;
+	v[1].iov_base = frame->boxes;
+	v[1].iov_len = frame->nrects * sizeof *frame->boxes;
+	recorder->total += writev(recorder->fd, v, 2);
+
+	for (i = 0; i < frame->nrects; i++)
+		recorder->total += write(recorder->fd, frame->rects[i].out,
+					 frame->rects[i].out_len * 4);
+}
+
+static void *
+recorder_thread(void *data)
+{
+	struct weston_recorder *recorder = data;
+	struct recorder_frame *frame;
+
+	pthread_mutex_lock(&recorder->mutex);
+	for (;;) {
+		while (wl_list_empty(&recorder->queue) && !recorder->quit)
+			pthread_cond_wait(&recorder->cond, &recorder->mutex);
+
+		/* Only stop once everything queued has been written */
+		if (wl_list_empty(&recorder->queue))
 			break;
+
+		frame = container_of(recorder->queue.next,
+				     struct recorder_frame, link);
+		wl_list_remove(&frame->link);
+		pthread_mutex_unlock(&recorder->mutex);
+
+		weston_task_pool_run(recorder->pool, frame->nrects,
+				     recorder_encode_rect, frame);
+
+		/* A keyframe covers the whole output and is encoded against
+		 * black, so that it decodes without the frames before it.
+		 * Without memory for it, the frame is an ordinary one. */
+		if (frame->flags & WCAP_FRAME_KEYFRAME) {
+			if (recorder_frame_make_key(recorder, frame) == 0)
+				weston_task_pool_run(recorder->pool,
+						     frame->nrects,
+						     recorder_encode_key_rect,
+						     frame);
+			else
+				frame->flags &= ~WCAP_FRAME_KEYFRAME;
 		}
 
-		i = 24 - __builtin_clz(run);
-		*p++ = delta | ((i + 0xe0) << 24);
-		run -= 1 << (7 + i);
+		recorder_write_frame(recorder, frame);
+		recorder_frame_free(frame);
+
+		pthread_mutex_lock(&recorder->mutex);
+		recorder->queued--;
 	}
+	pthread_mutex_unlock(&recorder->mutex);
 
-	return p;
+	return NULL;
 }
 
-static uint32_t
-component_delta(uint32_t next, uint32_t prev)
+/* Copies the damaged rectangles out of the renderer. This is the only
+ * part of recording that stays on the compositor thread. */
+static struct recorder_frame *
+recorder_frame_create(struct weston_recorder *recorder, uint32_t msecs,
+		      uint32_t flags, pixman_box32_t *r, int n)
 {
-	unsigned char dr, dg, db;
+	struct weston_output *output = recorder->output;
+	struct weston_compositor *compositor = output->compositor;
+	struct recorder_frame *frame;
+	size_t size = 0, offset = 0;
+	int i, width, height, y_orig;
+
+	for (i = 0; i < n; i++)
+		size += (size_t) (r[i].x2 - r[i].x1) * (r[i].y2 - r[i].y1);
+
+	frame = zalloc(sizeof *frame);
+	if (frame == NULL)
+		return NULL;
+
+	frame->recorder = recorder;
+	frame->msecs = msecs;
+	frame->flags = flags;
+	frame->nrects = n;
+	frame->boxes = malloc(n * sizeof *frame->boxes);
+	frame->rects = malloc(n * sizeof *frame->rects);
+	frame->pixels = malloc(size * 4);
+	/* The RLE output never takes more than a word per pixel */
+	frame->out = malloc(size * 4);
+	if (!frame->boxes || !frame->rects || !frame->pixels || !frame->out) {
+		recorder_frame_free(frame);
+		return NULL;
+	}
+
+	for (i = 0; i < n; i++) {
+		frame->boxes[i].x1 = r[i].x1;
+		frame->boxes[i].y1 = r[i].y1;
+		frame->boxes[i].x2 = r[i].x2;
+		frame->boxes[i].y2 = r[i].y2;
+	}
 
-	dr = (next >> 16) - (prev >> 16);
-	dg = (next >>  8) - (prev >>  8);
-	db = (next >>  0) - (prev >>  0);
+	for (i = 0; i < n; i++) {
+		width = r[i].x2 - r[i].x1;
+		height = r[i].y2 - r[i].y1;
 
-	return (dr << 16) | (dg << 8) | (db << 0);
+		if (recorder->do_yflip)
+			y_orig = recorder->height - r[i].y2;
+		else
+			y_orig = r[i].y1;
+
+		frame->rects[i].pixels = frame->pixels + offset;
+		frame->rects[i].out = frame->out + offset;
+		offset += (size_t) width * height;
+
+		compositor->renderer->read_pixels(output,
+				compositor->read_format,
+				frame->rects[i].pixels,
+				r[i].x1, y_orig, width, height);
+	}
+
+	return frame;
 }
 
 static void
@@ -264,26 +513,12 @@ weston_recorder_frame_notify(struct wl_listener *listener, void *data)
 	struct weston_recorder *recorder =
 		container_of(listener, struct weston_recorder, frame_listener);
 	struct weston_output *output = recorder->output;
-	struct weston_compositor *compositor = output->compositor;
 	uint32_t msecs = timespec_to_msec(&output->frame_time);
+	struct recorder_frame *frame;
 	pixman_box32_t *r;
 	pixman_region32_t damage, transformed_damage;
-	int i, j, k, n, width, height, run, stride;
-	uint32_t delta, prev, *d, *s, *p, next;
-	struct {
-		uint32_t msecs;
-		uint32_t nrects;
-	} header;
-	struct iovec v[2];
-	int do_yflip;
-	int y_orig;
-	uint32_t *outbuf;
-
-	do_yflip = !!(compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
-	if (do_yflip)
-		outbuf = recorder->rect;
-	else
-		outbuf = recorder->tmpbuf;
+	uint32_t flags = 0;
+	int n, queued;
 
 	pixman_region32_init(&damage);
 	pixman_region32_init(&transformed_damage);
@@ -294,76 +529,62 @@ weston_recorder_frame_notify(struct wl_listener *listener, void *data)
 				 &damage, &transformed_damage);
 	pixman_region32_fini(&damage);
 
-	r = pixman_region32_rectangles(&transformed_damage, &n);
-	if (n == 0) {
-		pixman_region32_fini(&transformed_damage);
-		return;
-	}
-
-	header.msecs = msecs;
-	header.nrects = n;
-	v[0].iov_base = &header;
-	v[0].iov_len = sizeof header;
-	v[1].iov_base = r;
-	v[1].iov_len = n * sizeof *r;
-	recorder->total += writev(recorder->fd, v, 2);
-	stride = output->current_mode->width;
+	/* The recording keeps the size it started with */
+	pixman_region32_intersect_rect(&transformed_damage,
+				       &transformed_damage, 0, 0,
+				       recorder->width, recorder->height);
 
-	for (i = 0; i < n; i++) {
-		width = r[i].x2 - r[i].x1;
-		height = r[i].y2 - r[i].y1;
+	pthread_mutex_lock(&recorder->mutex);
+	queued = recorder->queued;
+	pthread_mutex_unlock(&recorder->mutex);
 
-		if (do_yflip)
-			y_orig = output->current_mode->height - r[i].y2;
-		else
-			y_orig = r[i].y1;
+	/* The encoder is behind: skip this frame rather than stall the
+	 * repaint loop, and record what changed with the next one. */
+	if (queued >= RECORDER_MAX_QUEUED_FRAMES) {
+		pixman_region32_union(&recorder->missed, &recorder->missed,
+				      &transformed_damage);
+		pixman_region32_fini(&transformed_damage);
+		recorder->dropped++;
+		goto out;
+	}
 
-		compositor->renderer->read_pixels(output,
-				compositor->read_format, recorder->rect,
-				r[i].x1, y_orig, width, height);
+	pixman_region32_union(&transformed_damage, &transformed_damage,
+			      &recorder->missed);
+	pixman_region32_clear(&recorder->missed);
 
-		p = outbuf;
-		run = prev = 0; /* quiet gcc */
-		for (j = 0; j < height; j++) {
-			if (do_yflip)
-				s = recorder->rect + width * j;
-			else
-				s = recorder->rect + width * (height - j - 1);
-			y_orig = r[i].y2 - j - 1;
-			d = recorder->frame + stride * y_orig + r[i].x1;
-
-			for (k = 0; k < width; k++) {
-				next = *s++;
-				delta = component_delta(next, *d);
-				*d++ = next;
-				if (run == 0 || delta == prev) {
-					run++;
-				} else {
-					p = output_run(p, prev, run);
-					run = 1;
-				}
-				prev = delta;
-			}
-		}
+	/* The encoder thread completes a keyframe from its copy of the
+	 * picture, only the damage is read here as usual */
+	if (recorder->count % RECORDER_KEYFRAME_INTERVAL == 0)
+		flags |= WCAP_FRAME_KEYFRAME;
 
-		p = output_run(p, prev, run);
-
-		recorder->total += write(recorder->fd,
-					 outbuf, (p - outbuf) * 4);
+	r = pixman_region32_rectangles(&transformed_damage, &n);
+	if (n == 0) {
+		pixman_region32_fini(&transformed_damage);
+		goto out;
+	}
 
-#if 0
-		fprintf(stderr,
-			"%dx%d at %d,%d rle from %d to %d bytes (%f) total %dM\n",
-			width, height, r[i].x1, r[i].y1,
-			width * height * 4, (int) (p - outbuf) * 4,
-			(float) (p - outbuf) / (width * height),
-			recorder->total / 1024 / 1024);
-#endif
+	frame = recorder_frame_create(recorder, msecs, flags, r, n);
+	if (frame == NULL) {
+		weston_log("%s: out of memory, frame not recorded\n",
+			   __func__);
+		pixman_region32_union(&recorder->missed, &recorder->missed,
+				      &transformed_damage);
+		pixman_region32_fini(&transformed_damage);
+		recorder->dropped++;
+		goto out;
 	}
 
 	pixman_region32_fini(&transformed_damage);
+
+	pthread_mutex_lock(&recorder->mutex);
+	wl_list_insert(recorder->queue.prev, &frame->link);
+	recorder->queued++;
+	pthread_cond_signal(&recorder->cond);
+	pthread_mutex_unlock(&recorder->mutex);
+
 	recorder->count++;
 
+out:
 	if (recorder->destroying)
 		weston_recorder_destroy(recorder);
 }
@@ -374,8 +595,12 @@ weston_recorder_free(struct weston_recorder *recorder)
 	if (recorder == NULL)
 		return;
 
-	free(recorder->tmpbuf);
-	free(recorder->rect);
+	if (recorder->pool)
+		weston_task_pool_destroy(recorder->pool);
+	pthread_cond_destroy(&recorder->cond);
+	pthread_mutex_destroy(&recorder->mutex);
+	pixman_region32_fini(&recorder->missed);
+	wl_array_release(&recorder->index);
 	free(recorder->frame);
 	free(recorder);
 }
@@ -387,9 +612,6 @@ weston_recorder_create(struct weston_output *output, const char *filename)
 	struct weston_recorder *recorder;
 	int stride, size;
 	struct { uint32_t magic, format, width, height; } header;
-	int do_yflip;
-
-	do_yflip = !!(compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
 
 	recorder = zalloc(sizeof *recorder);
 	if (recorder == NULL) {
@@ -397,26 +619,35 @@ weston_recorder_create(struct weston_output *output, const char *filename)
 		return NULL;
 	}
 
-	stride = output->current_mode->width;
-	size = stride * 4 * output->current_mode->height;
+	recorder->do_yflip =
+		!!(compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
+	pixman_region32_init(&recorder->missed);
+	pthread_mutex_init(&recorder->mutex, NULL);
+	pthread_cond_init(&recorder->cond, NULL);
+	wl_list_init(&recorder->queue);
+	wl_array_init(&recorder->index);
+
+	recorder->width = output->current_mode->width;
+	recorder->height = output->current_mode->height;
+	stride = recorder->width;
+	size = stride * 4 * recorder->height;
 	recorder->frame = zalloc(size);
-	recorder->rect = malloc(size);
 	recorder->output = output;
 
-	if ((recorder->frame == NULL) || (recorder->rect == NULL)) {
+	if (recorder->frame == NULL) {
 		weston_log("%s: out of memory\n", __func__);
 		goto err_recorder;
 	}
 
-	if (!do_yflip) {
-		recorder->tmpbuf = malloc(size);
-		if (recorder->tmpbuf == NULL) {
-			weston_log("%s: out of memory\n", __func__);
-			goto err_recorder;
-		}
+	/* The encoder thread takes part in every job itself */
+	recorder->pool = weston_task_pool_create(
+		weston_task_pool_default_threads(RECORDER_MAX_WORKERS - 1));
+	if (recorder->pool == NULL) {
+		weston_log("%s: failed to create encoder threads\n", __func__);
+		goto err_recorder;
 	}
 
-	header.magic = WCAP_HEADER_MAGIC;
+	header.magic = WCAP_HEADER_MAGIC_V2;
 
 	switch (compositor->read_format) {
 	case PIXMAN_x8r8g8b8:
@@ -440,10 +671,17 @@ weston_recorder_create(struct weston_output *output, const char *filename)
 		goto err_recorder;
 	}
 
-	header.width = output->current_mode->width;
-	header.height = output->current_mode->height;
+	header.width = recorder->width;
+	header.height = recorder->height;
 	recorder->total += write(recorder->fd, &header, sizeof header);
 
+	if (pthread_create(&recorder->thread, NULL,
+			   recorder_thread, recorder) != 0) {
+		weston_log("%s: failed to create encoder thread\n", __func__);
+		close(recorder->fd);
+		goto err_recorder;
+	}
+
 	recorder->frame_listener.notify = weston_recorder_frame_notify;
 	wl_signal_add(&output->frame_signal, &recorder->frame_listener);
 	weston_output_disable_planes_incr(output);
@@ -456,12 +694,49 @@ err_recorder:
 	return NULL;
 }
 
+/* The index lets decoders seek without reading every frame. Recordings
+ * that end without it can still be decoded, just not as quickly. */
+static void
+recorder_write_index(struct weston_recorder *recorder)
+{
+	struct wcap_index_trailer trailer;
+	struct iovec v[2];
+
+	if (recorder->index_failed)
+		return;
+
+	trailer.magic = WCAP_INDEX_MAGIC;
+	trailer.nframes = recorder->index.size /
+		sizeof (struct wcap_index_entry);
+	trailer.offset = recorder->total;
+
+	v[0].iov_base = recorder->index.data;
+	v[0].iov_len = recorder->index.size;
+	v[1].iov_base = &trailer;
+	v[1].iov_len = sizeof trailer;
+	recorder->total += writev(recorder->fd, v, 2);
+}
+
 static void
 weston_recorder_destroy(struct weston_recorder *recorder)
 {
 	wl_list_remove(&recorder->frame_listener.link);
-	close(recorder->fd);
 	weston_output_disable_planes_decr(recorder->output);
+
+	/* Let the encoder finish what is queued before closing the file */
+	pthread_mutex_lock(&recorder->mutex);
+	recorder->quit = true;
+	pthread_cond_signal(&recorder->cond);
+	pthread_mutex_unlock(&recorder->mutex);
+	pthread_join(recorder->thread, NULL);
+
+	recorder_write_index(recorder);
+
+	weston_log("recorder stopped, total file size %dM, %d frames, "
+		   "%d dropped\n", (int) (recorder->total / (1024 * 1024)),
+		   recorder->count, recorder->dropped);
+
+	close(recorder->fd);
 	weston_recorder_free(recorder);
 }
 
@@ -486,8 +761,7 @@ weston_recorder_start(struct weston_output *output, const char *filename)
 WL_EXPORT void
 weston_recorder_stop(struct weston_recorder *recorder)
 {
-	weston_log("stopping recorder, total file size %dM, %d frames\n",
-		   recorder->total / (1024 * 1024), recorder->count);
+	weston_log("stopping recorder, %d frames\n", recorder->count);
 
 	recorder->destroying = 1;
 	weston_output_schedule_repaint(recorder->output);
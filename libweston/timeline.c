@@ -29,14 +29,21 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 #include <assert.h>
 
 #include <libweston/libweston.h>
 #include <libweston/weston-log.h>
+#include "shared/helpers.h"
+#include "shared/timeline-binary.h"
 #include "timeline.h"
 #include "weston-log-internal.h"
 
+#define TIMELINE_BINARY_RING_SIZE	4096	/* records, power of two */
+#define TIMELINE_BINARY_FLUSH_MS	250
+#define TIMELINE_BINARY_MAX_STRING	1024
+
 /**
  * Timeline itself is not a subscriber but a scope (a producer of data), and it
  * re-routes the data it produces to all the subscriptions (and implicitly
@@ -106,6 +113,16 @@ weston_timeline_destroy_subscription_object(struct weston_timeline_subscription_
 	free(sub_obj);
 }
 
+static void
+weston_timeline_subscription_release(struct weston_timeline_subscription *tl_sub)
+{
+	struct weston_timeline_subscription_object *sub_obj, *tmp_sub_obj;
+
+	wl_list_for_each_safe(sub_obj, tmp_sub_obj,
+			      &tl_sub->objects, subscription_link)
+		weston_timeline_destroy_subscription_object(sub_obj);
+}
+
 /** Destroy the timeline subscription and all timeline subscription objects
  * associated with it.
  *
@@ -119,15 +136,11 @@ weston_timeline_destroy_subscription(struct weston_log_subscription *sub,
 {
 	struct weston_timeline_subscription *tl_sub =
 		weston_log_subscription_get_data(sub);
-	struct weston_timeline_subscription_object *sub_obj, *tmp_sub_obj;
 
 	if (!tl_sub)
 		return;
 
-	wl_list_for_each_safe(sub_obj, tmp_sub_obj,
-			      &tl_sub->objects, subscription_link)
-		weston_timeline_destroy_subscription_object(sub_obj);
-
+	weston_timeline_subscription_release(tl_sub);
 	free(tl_sub);
 }
 
@@ -341,6 +354,16 @@ emit_gpu_timestamp(struct timeline_emit_context *ctx, void *obj)
 	return 1;
 }
 
+static int
+emit_input_id(struct timeline_emit_context *ctx, void *obj)
+{
+	uint64_t *id = obj;
+
+	fprintf(ctx->cur, "\"input\":%" PRIu64, *id);
+
+	return 1;
+}
+
 static struct weston_timeline_subscription_object *
 weston_timeline_get_subscription_object(struct weston_log_subscription *sub,
 		void *object)
@@ -354,6 +377,22 @@ weston_timeline_get_subscription_object(struct weston_log_subscription *sub,
 	return weston_timeline_subscription_search(tl_sub, object);
 }
 
+static void
+weston_timeline_binary_refresh_object(struct weston_log_subscription *sub,
+				      void *object)
+{
+	struct weston_timeline_binary_subscription *bin;
+	struct weston_timeline_subscription_object *sub_obj;
+
+	bin = weston_log_subscription_get_data(sub);
+	if (!bin)
+		return;
+
+	sub_obj = weston_timeline_subscription_search(&bin->base, object);
+	if (sub_obj)
+		sub_obj->force_refresh = true;
+}
+
 /** Sets (on) the timeline subscription object refresh status.
  *
  * This function 'notifies' timeline to print the object ID. The timeline code
@@ -379,6 +418,12 @@ weston_timeline_refresh_subscription_objects(struct weston_compositor *wc,
 		if (sub_obj)
 			sub_obj->force_refresh = true;
 	}
+
+	while ((sub = weston_log_subscription_iterate(wc->timeline_binary, sub)))
+		weston_timeline_binary_refresh_object(sub, object);
+
+	while ((sub = weston_log_subscription_iterate(wc->timeline_trace, sub)))
+		weston_timeline_binary_refresh_object(sub, object);
 }
 
 typedef int (*type_func)(struct timeline_emit_context *ctx, void *obj);
@@ -388,6 +433,7 @@ static const type_func type_dispatch[] = {
 	[TLT_SURFACE] = emit_weston_surface,
 	[TLT_VBLANK] = emit_vblank_timestamp,
 	[TLT_GPU] = emit_gpu_timestamp,
+	[TLT_INPUT] = emit_input_id,
 };
 
 /** Disseminates the message to all subscriptions of the scope \c
@@ -459,3 +505,371 @@ weston_timeline_point(struct weston_log_scope *timeline_scope,
 
 	}
 }
+
+static void
+timeline_binary_flush(struct weston_timeline_binary_subscription *bin)
+{
+	const uint32_t mask = TIMELINE_BINARY_RING_SIZE - 1;
+
+	while (bin->tail != bin->head) {
+		uint32_t start = bin->tail & mask;
+		uint32_t count = bin->head - bin->tail;
+
+		/* the used part of the ring may wrap around */
+		if (count > TIMELINE_BINARY_RING_SIZE - start)
+			count = TIMELINE_BINARY_RING_SIZE - start;
+
+		if (bin->trace)
+			weston_trace_writer_feed(bin->trace,
+						 (const char *)&bin->ring[start],
+						 count * sizeof(*bin->ring));
+		else
+			weston_log_subscription_write(bin->subscription,
+						      (const char *)&bin->ring[start],
+						      count * sizeof(*bin->ring));
+		bin->tail += count;
+	}
+}
+
+static struct weston_timeline_binary_record *
+timeline_binary_reserve(struct weston_timeline_binary_subscription *bin)
+{
+	const uint32_t mask = TIMELINE_BINARY_RING_SIZE - 1;
+
+	if (bin->head - bin->tail == TIMELINE_BINARY_RING_SIZE)
+		timeline_binary_flush(bin);
+
+	/* Only wake up to write out records that are actually there. */
+	if (!bin->flush_armed) {
+		wl_event_source_timer_update(bin->flush_timer,
+					     TIMELINE_BINARY_FLUSH_MS);
+		bin->flush_armed = true;
+	}
+
+	return &bin->ring[bin->head++ & mask];
+}
+
+static void
+timeline_binary_emit_definition(struct weston_timeline_binary_subscription *bin,
+				enum weston_timeline_binary_type type,
+				uint32_t id, uint32_t ref, const char *str)
+{
+	struct weston_timeline_binary_record *rec;
+	size_t len = 0;
+	size_t off;
+
+	if (str)
+		len = strnlen(str, TIMELINE_BINARY_MAX_STRING);
+
+	rec = timeline_binary_reserve(bin);
+	memset(rec, 0, sizeof(*rec));
+	rec->type = type;
+	rec->flags = str ? 0 : WESTON_TIMELINE_BINARY_FLAG_NULL;
+	rec->len = len;
+	rec->id = id;
+	rec->surface = ref;
+
+	for (off = 0; off < len; off += sizeof(*rec)) {
+		rec = timeline_binary_reserve(bin);
+		memset(rec, 0, sizeof(*rec));
+		memcpy(rec, str + off, MIN(len - off, sizeof(*rec)));
+	}
+}
+
+static uint32_t
+timeline_binary_name_id(struct weston_timeline_binary_subscription *bin,
+			const char *name)
+{
+	unsigned int i;
+
+	/* Point names are string literals, so comparing pointers is enough;
+	 * a duplicate literal just ends up with a second id. */
+	for (i = 0; i < bin->n_names; i++)
+		if (bin->names[i] == name)
+			return i + 1;
+
+	if (bin->n_names == bin->names_size) {
+		unsigned int size = bin->names_size ? bin->names_size * 2 : 32;
+		const char **names;
+
+		names = realloc(bin->names, size * sizeof(*names));
+		if (!names)
+			return 0;
+
+		bin->names = names;
+		bin->names_size = size;
+	}
+
+	bin->names[bin->n_names++] = name;
+	timeline_binary_emit_definition(bin, WESTON_TIMELINE_BINARY_NAME,
+					bin->n_names, 0, name);
+
+	return bin->n_names;
+}
+
+static uint32_t
+timeline_binary_output_id(struct weston_timeline_binary_subscription *bin,
+			  struct weston_output *output)
+{
+	struct weston_timeline_subscription_object *sub_obj;
+
+	sub_obj = weston_timeline_subscription_output_ensure(&bin->base, output);
+	if (weston_timeline_check_object_refresh(sub_obj))
+		timeline_binary_emit_definition(bin,
+						WESTON_TIMELINE_BINARY_OUTPUT,
+						sub_obj->id, 0, output->name);
+
+	return sub_obj->id;
+}
+
+static uint32_t
+timeline_binary_surface_id(struct weston_timeline_binary_subscription *bin,
+			   struct weston_surface *surface)
+{
+	struct weston_timeline_subscription_object *sub_obj;
+	struct weston_surface *mains;
+	uint32_t main_id = 0;
+	char d[512];
+
+	sub_obj = weston_timeline_subscription_surface_ensure(&bin->base, surface);
+	if (!weston_timeline_check_object_refresh(sub_obj))
+		return sub_obj->id;
+
+	mains = weston_surface_get_main_surface(surface);
+	if (mains != surface)
+		main_id = timeline_binary_surface_id(bin, mains);
+
+	if (!surface->get_label || surface->get_label(surface, d, sizeof(d)) < 0)
+		d[0] = '\0';
+
+	timeline_binary_emit_definition(bin, WESTON_TIMELINE_BINARY_SURFACE,
+					sub_obj->id, main_id,
+					d[0] ? d : NULL);
+
+	return sub_obj->id;
+}
+
+static uint64_t
+timeline_binary_timestamp(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static int
+timeline_binary_flush_handler(void *data)
+{
+	struct weston_timeline_binary_subscription *bin = data;
+
+	bin->flush_armed = false;
+	timeline_binary_flush(bin);
+
+	return 0;
+}
+
+/** Create a binary timeline subscription and hang it off the subscription
+ *
+ * Called when the subscription is created. The stream starts with a header
+ * record, see shared/timeline-binary.h for the format.
+ *
+ * @ingroup internal-log
+ */
+void
+weston_timeline_binary_create_subscription(struct weston_log_subscription *sub,
+					   void *user_data)
+{
+	struct weston_compositor *compositor = user_data;
+	struct weston_timeline_binary_subscription *bin;
+	struct weston_timeline_binary_record *rec;
+	struct wl_event_loop *loop;
+
+	bin = zalloc(sizeof(*bin));
+	if (!bin)
+		return;
+
+	bin->ring = calloc(TIMELINE_BINARY_RING_SIZE, sizeof(*bin->ring));
+	if (!bin->ring) {
+		free(bin);
+		return;
+	}
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+	bin->flush_timer = wl_event_loop_add_timer(loop,
+						   timeline_binary_flush_handler,
+						   bin);
+	if (!bin->flush_timer) {
+		free(bin->ring);
+		free(bin);
+		return;
+	}
+
+	wl_list_init(&bin->base.objects);
+	bin->subscription = sub;
+
+	rec = timeline_binary_reserve(bin);
+	rec->type = WESTON_TIMELINE_BINARY_HEADER;
+	rec->id = WESTON_TIMELINE_BINARY_VERSION;
+	rec->aux = WESTON_TIMELINE_BINARY_MAGIC;
+
+	weston_log_subscription_set_data(sub, bin);
+}
+
+/** Flush and destroy the binary timeline subscription
+ *
+ * Called when (before) the subscription is destroyed.
+ *
+ * @ingroup internal-log
+ */
+void
+weston_timeline_binary_destroy_subscription(struct weston_log_subscription *sub,
+					    void *user_data)
+{
+	struct weston_timeline_binary_subscription *bin =
+		weston_log_subscription_get_data(sub);
+
+	if (!bin)
+		return;
+
+	timeline_binary_flush(bin);
+	if (bin->trace)
+		weston_trace_writer_destroy(bin->trace);
+	wl_event_source_remove(bin->flush_timer);
+	weston_timeline_subscription_release(&bin->base);
+	free(bin->names);
+	free(bin->ring);
+	free(bin);
+}
+
+static void
+timeline_trace_write(void *data, const char *buf, size_t len)
+{
+	struct weston_timeline_binary_subscription *bin = data;
+
+	weston_log_subscription_write(bin->subscription, buf, len);
+}
+
+/** Create a subscription of the trace-event timeline scope
+ *
+ * Points are recorded exactly like for the binary timeline; the records are
+ * only converted to trace-event JSON when the ring is flushed, keeping the
+ * formatting out of the timeline points themselves. The subscription is
+ * destroyed with weston_timeline_binary_destroy_subscription().
+ *
+ * @ingroup internal-log
+ */
+void
+weston_timeline_trace_create_subscription(struct weston_log_subscription *sub,
+					  void *user_data)
+{
+	struct weston_timeline_binary_subscription *bin;
+
+	weston_timeline_binary_create_subscription(sub, user_data);
+
+	bin = weston_log_subscription_get_data(sub);
+	if (!bin)
+		return;
+
+	bin->trace = weston_trace_writer_create(timeline_trace_write, bin, true);
+	if (!bin->trace)
+		weston_log("Timeline error creating trace writer.\n");
+}
+
+/** Binary counterpart of weston_timeline_point()
+ *
+ * Appends one fixed-size record per subscription to the subscription's ring,
+ * preceded by definition records for names and objects seen for the first
+ * time (or refreshed). No formatting happens here; records are written out
+ * in batches and decoded offline with weston-timeline-decode.
+ *
+ * @param timeline_scope the binary timeline scope
+ * @param name the name of the timeline point, must be a string literal
+ *
+ * @ingroup log
+ */
+WL_EXPORT void
+weston_timeline_binary_point(struct weston_log_scope *timeline_scope,
+			     const char *name, ...)
+{
+	struct weston_log_subscription *sub = NULL;
+	struct timespec ts;
+	uint64_t now;
+
+	if (!weston_log_scope_is_enabled(timeline_scope))
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = timeline_binary_timestamp(&ts);
+
+	while ((sub = weston_log_subscription_iterate(timeline_scope, sub))) {
+		struct weston_timeline_binary_subscription *bin;
+		struct weston_timeline_binary_record point = {
+			.type = WESTON_TIMELINE_BINARY_POINT,
+			.t = now,
+		};
+		struct weston_timeline_binary_record *rec;
+		uint64_t aux[WESTON_TIMELINE_BINARY_AUX_SLOTS] = { 0 };
+		enum timeline_type otype;
+		unsigned int aux_flags;
+		unsigned int bit;
+		va_list argp;
+		void *obj;
+
+		bin = weston_log_subscription_get_data(sub);
+		if (!bin)
+			continue;
+
+		point.id = timeline_binary_name_id(bin, name);
+		if (point.id == 0)
+			continue;
+
+		va_start(argp, name);
+		while ((otype = va_arg(argp, enum timeline_type)) != TLT_END) {
+			obj = va_arg(argp, void *);
+
+			switch (otype) {
+			case TLT_OUTPUT:
+				point.output = timeline_binary_output_id(bin, obj);
+				break;
+			case TLT_SURFACE:
+				point.surface = timeline_binary_surface_id(bin, obj);
+				break;
+			case TLT_VBLANK:
+				point.flags |= WESTON_TIMELINE_BINARY_FLAG_VBLANK;
+				aux[1] = timeline_binary_timestamp(obj);
+				break;
+			case TLT_GPU:
+				point.flags |= WESTON_TIMELINE_BINARY_FLAG_GPU;
+				aux[2] = timeline_binary_timestamp(obj);
+				break;
+			case TLT_INPUT:
+				point.flags |= WESTON_TIMELINE_BINARY_FLAG_INPUT;
+				aux[3] = *(uint64_t *)obj;
+				break;
+			case TLT_END:
+				break;
+			}
+		}
+		va_end(argp);
+
+		/* aux[] is indexed by flag bit. The point carries the value
+		 * of its lowest aux flag, aux records in front of it the
+		 * values of the others. */
+		aux_flags = point.flags & WESTON_TIMELINE_BINARY_AUX_FLAGS;
+		if (aux_flags) {
+			bit = ffs(aux_flags) - 1;
+			point.aux = aux[bit];
+			aux_flags &= ~(1u << bit);
+		}
+		while (aux_flags) {
+			bit = ffs(aux_flags) - 1;
+			aux_flags &= ~(1u << bit);
+
+			rec = timeline_binary_reserve(bin);
+			memset(rec, 0, sizeof(*rec));
+			rec->type = WESTON_TIMELINE_BINARY_AUX;
+			rec->flags = 1u << bit;
+			rec->aux = aux[bit];
+		}
+
+		*timeline_binary_reserve(bin) = point;
+	}
+}
@@ -29,6 +29,7 @@
 
 #include <wayland-util.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <libweston/weston-log.h>
 #include <wayland-server-core.h>
@@ -39,6 +40,7 @@ enum timeline_type {
 	TLT_SURFACE,
 	TLT_VBLANK,
 	TLT_GPU,
+	TLT_INPUT,
 };
 
 /** Timeline subscription created for each subscription
@@ -53,6 +55,35 @@ struct weston_timeline_subscription {
 	struct wl_list objects; /**< weston_timeline_subscription_object::subscription_link */
 };
 
+struct weston_timeline_binary_record;
+struct weston_trace_writer;
+
+/** Timeline subscription of the binary timeline scope
+ *
+ * Records are appended to a ring and written out to the subscription in
+ * batches, either from a timer or when the ring fills up.
+ *
+ * @ingroup internal-log
+ */
+struct weston_timeline_binary_subscription {
+	struct weston_timeline_subscription base;
+	struct weston_log_subscription *subscription;
+
+	struct weston_timeline_binary_record *ring;
+	uint32_t head;	/**< free-running write position */
+	uint32_t tail;	/**< free-running flush position */
+	struct wl_event_source *flush_timer;
+	bool flush_armed;	/**< records are waiting for the timer */
+
+	const char **names;	/**< interned point names, id = index + 1 */
+	unsigned int n_names;
+	unsigned int names_size;
+
+	/** converts the records to trace-event JSON before writing them
+	 * out, for the 'timeline-trace' scope; NULL otherwise */
+	struct weston_trace_writer *trace;
+};
+
 /**
  * Created when object is first seen for a particular timeline subscription
  * Destroyed when the subscription got destroyed or object was destroyed
@@ -83,6 +114,7 @@ struct weston_timeline_subscription_object {
 #define TLP_SURFACE(s) TLT_SURFACE, TYPEVERIFY(struct weston_surface *, (s))
 #define TLP_VBLANK(t) TLT_VBLANK, TYPEVERIFY(const struct timespec *, (t))
 #define TLP_GPU(t) TLT_GPU, TYPEVERIFY(const struct timespec *, (t))
+#define TLP_INPUT(id) TLT_INPUT, TYPEVERIFY(const uint64_t *, (id))
 
 /** This macro is used to add timeline points.
  *
@@ -94,10 +126,27 @@ struct weston_timeline_subscription_object {
  */
 #define TL_POINT(ec, ...) do { \
 	weston_timeline_point(ec->timeline, __VA_ARGS__); \
+	weston_timeline_binary_point(ec->timeline_binary, __VA_ARGS__); \
+	weston_timeline_binary_point(ec->timeline_trace, __VA_ARGS__); \
 } while (0)
 
+/** Whether any of the timeline scopes has a subscription
+ *
+ * @param ec weston_compositor instance
+ *
+ * @ingroup log
+ */
+#define TL_ENABLED(ec) \
+	(weston_log_scope_is_enabled(ec->timeline) || \
+	 weston_log_scope_is_enabled(ec->timeline_binary) || \
+	 weston_log_scope_is_enabled(ec->timeline_trace))
+
 void
 weston_timeline_point(struct weston_log_scope *timeline_scope,
 		      const char *name, ...);
 
+void
+weston_timeline_binary_point(struct weston_log_scope *timeline_scope,
+			     const char *name, ...);
+
 #endif /* WESTON_TIMELINE_H */
@@ -0,0 +1,182 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "touch-history.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+
+/* Bounds for extrapolating past the newest sample when resampling */
+#define TOUCH_RESAMPLE_MAX_EXTRAPOLATE_NSEC 8000000
+
+/* Samples older than this do not count for the velocity estimate */
+#define TOUCH_PREDICT_WINDOW_NSEC 50000000
+
+void
+touch_history_reset(struct touch_history *history)
+{
+	history->head = 0;
+	history->count = 0;
+}
+
+void
+touch_history_record(struct touch_history *history,
+		     const struct timespec *time, double x, double y)
+{
+	struct touch_sample *sample;
+
+	if (history->count > 0)
+		history->head = (history->head + 1) % TOUCH_HISTORY;
+	if (history->count < TOUCH_HISTORY)
+		history->count++;
+
+	sample = &history->samples[history->head];
+	sample->time = *time;
+	sample->x = x;
+	sample->y = y;
+}
+
+/* The sample recorded age samples before the newest one */
+const struct touch_sample *
+touch_history_sample(const struct touch_history *history, unsigned age)
+{
+	return &history->samples[(history->head + TOUCH_HISTORY - age) %
+				 TOUCH_HISTORY];
+}
+
+/** Position of a touch point at the given time
+ *
+ * Interpolated between the two samples around the target, or
+ * extrapolated a bounded amount past the newest sample. Targets before
+ * the oldest sample give the oldest sample. The history must not be
+ * empty.
+ */
+void
+touch_history_resample(const struct touch_history *history,
+		       const struct timespec *target,
+		       struct timespec *time, double *x, double *y)
+{
+	const struct touch_sample *a, *b = touch_history_sample(history, 0);
+	int64_t span, offset, limit;
+	unsigned age;
+
+	*time = b->time;
+	*x = b->x;
+	*y = b->y;
+
+	if (history->count < 2)
+		return;
+
+	offset = timespec_sub_to_nsec(target, &b->time);
+	if (offset > 0) {
+		a = touch_history_sample(history, 1);
+		span = timespec_sub_to_nsec(&b->time, &a->time);
+		if (span <= 0)
+			return;
+
+		limit = MIN(span / 2, TOUCH_RESAMPLE_MAX_EXTRAPOLATE_NSEC);
+		offset = MIN(offset, limit);
+	} else {
+		/* Find the newest sample not after the target. */
+		for (age = 1; age < history->count; age++) {
+			a = touch_history_sample(history, age);
+			if (timespec_sub_to_nsec(target, &a->time) >= 0)
+				break;
+			b = a;
+		}
+		if (age == history->count) {
+			*time = b->time;
+			*x = b->x;
+			*y = b->y;
+			return;
+		}
+
+		span = timespec_sub_to_nsec(&b->time, &a->time);
+		if (span <= 0)
+			return;
+
+		offset = timespec_sub_to_nsec(target, &b->time);
+	}
+
+	timespec_add_nsec(time, &b->time, offset);
+	*x = b->x + (b->x - a->x) * offset / span;
+	*y = b->y + (b->y - a->y) * offset / span;
+}
+
+/** Predict where a touch point will be ahead_nsec after now
+ *
+ * The velocity is a least squares fit of the samples of the last
+ * TOUCH_PREDICT_WINDOW_NSEC, so it does not follow sensor noise. Returns
+ * false, leaving x and y untouched, if there are not enough samples.
+ */
+bool
+touch_history_predict(const struct touch_history *history,
+		      const struct timespec *now, int64_t ahead_nsec,
+		      double *x, double *y)
+{
+	const struct touch_sample *newest, *s;
+	double st = 0, sx = 0, sy = 0, stt = 0, stx = 0, sty = 0;
+	double vx, vy, t, denom;
+	unsigned age, n = 0;
+	int64_t ahead;
+
+	if (history->count < 2)
+		return false;
+
+	newest = touch_history_sample(history, 0);
+
+	/* Times are relative to the newest sample */
+	for (age = 0; age < history->count; age++) {
+		s = touch_history_sample(history, age);
+		if (timespec_sub_to_nsec(&newest->time, &s->time) >
+		    TOUCH_PREDICT_WINDOW_NSEC)
+			break;
+
+		t = timespec_sub_to_nsec(&s->time, &newest->time) * 1e-9;
+		st += t;
+		sx += s->x;
+		sy += s->y;
+		stt += t * t;
+		stx += t * s->x;
+		sty += t * s->y;
+		n++;
+	}
+
+	denom = n * stt - st * st;
+	if (n < 2 || denom <= 0.0)
+		return false;
+
+	vx = (n * stx - st * sx) / denom;
+	vy = (n * sty - st * sy) / denom;
+
+	ahead = timespec_sub_to_nsec(now, &newest->time) + ahead_nsec;
+	t = MIN(ahead, TOUCH_PREDICT_WINDOW_NSEC + ahead_nsec) * 1e-9;
+
+	*x = newest->x + vx * t;
+	*y = newest->y + vy * t;
+
+	return true;
+}
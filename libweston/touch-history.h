@@ -0,0 +1,68 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _WESTON_TOUCH_HISTORY_H
+#define _WESTON_TOUCH_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Samples kept per touch point */
+#define TOUCH_HISTORY 8
+
+struct touch_sample {
+	struct timespec time;
+	double x, y;
+};
+
+/* The recent samples of one touch point, as a ring where
+ * samples[head] is the newest one */
+struct touch_history {
+	struct touch_sample samples[TOUCH_HISTORY];
+	unsigned head;
+	unsigned count;
+};
+
+void
+touch_history_reset(struct touch_history *history);
+
+void
+touch_history_record(struct touch_history *history,
+		     const struct timespec *time, double x, double y);
+
+const struct touch_sample *
+touch_history_sample(const struct touch_history *history, unsigned age);
+
+void
+touch_history_resample(const struct touch_history *history,
+		       const struct timespec *target,
+		       struct timespec *time, double *x, double *y);
+
+bool
+touch_history_predict(const struct touch_history *history,
+		      const struct timespec *now, int64_t ahead_nsec,
+		      double *x, double *y);
+
+#endif /* _WESTON_TOUCH_HISTORY_H */
@@ -0,0 +1,413 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Touch motion resampling and prediction
+ *
+ * High-rate touchscreens report a few hundred samples per second, and
+ * forwarding each one wakes the focused client that many times although
+ * it can only draw once per refresh. With resampling enabled, motion is
+ * held back and delivered once per refresh of the output under the touch,
+ * at the vblank, so that clients get one wl_touch.motion per slot per
+ * frame at a consistent phase and have a whole frame to draw. The position
+ * sent is resampled from the recent samples to shortly before the delivery
+ * time, which keeps the motion steady when the sample and refresh rates
+ * beat against each other.
+ *
+ * The same sample history feeds a linear predictor, which shells can query
+ * with weston_touch_get_predicted_position() to move things under the
+ * finger without the lag of the input-to-present pipeline.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "touch-history.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+
+/* Touch points tracked at once; further ones are not resampled */
+#define TOUCH_MAX_SLOTS 10
+
+/* The resampled position lags the delivery by this much, so that it can
+ * usually be interpolated between two real samples. */
+#define TOUCH_RESAMPLE_LATENCY_NSEC 5000000
+
+/* Used when the output has no known refresh rate */
+#define TOUCH_DEFAULT_REFRESH_NSEC 16666667
+
+struct touch_slot {
+	bool active;
+	int touch_id;
+	struct weston_touch_device *device;
+
+	struct touch_history history;
+
+	/* motion received but not delivered yet */
+	bool pending;
+};
+
+struct weston_touch_resampler {
+	struct weston_touch *touch;
+	struct wl_event_source *timer;
+	bool timer_armed;
+
+	bool resample;
+	int64_t predict_nsec;
+
+	/* an event was delivered as it came since the last frame */
+	bool need_frame;
+
+	struct touch_slot slots[TOUCH_MAX_SLOTS];
+};
+
+static struct touch_slot *
+find_slot(struct weston_touch_resampler *r, int touch_id)
+{
+	unsigned i;
+
+	for (i = 0; i < ARRAY_LENGTH(r->slots); i++) {
+		if (r->slots[i].active && r->slots[i].touch_id == touch_id)
+			return &r->slots[i];
+	}
+
+	return NULL;
+}
+
+static void
+deliver_pending(struct weston_touch_resampler *r, bool resample)
+{
+	enum weston_touch_mode mode = r->touch->seat->compositor->touch_mode;
+	const struct touch_sample *newest;
+	struct weston_touch_grab *grab;
+	struct timespec now, target, time;
+	struct touch_slot *slot;
+	bool delivered = false;
+	double x, y;
+	unsigned i;
+
+	/* Touch points go to the calibrator now, the held back motion was
+	 * meant for clients and is dropped */
+	if (mode == WESTON_TOUCH_MODE_CALIB ||
+	    mode == WESTON_TOUCH_MODE_PREP_NORMAL) {
+		for (i = 0; i < ARRAY_LENGTH(r->slots); i++)
+			r->slots[i].pending = false;
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	timespec_add_nsec(&target, &now, -TOUCH_RESAMPLE_LATENCY_NSEC);
+
+	for (i = 0; i < ARRAY_LENGTH(r->slots); i++) {
+		slot = &r->slots[i];
+		if (!slot->active || !slot->pending)
+			continue;
+
+		slot->pending = false;
+
+		if (resample) {
+			touch_history_resample(&slot->history, &target,
+					       &time, &x, &y);
+		} else {
+			newest = touch_history_sample(&slot->history, 0);
+			time = newest->time;
+			x = newest->x;
+			y = newest->y;
+		}
+
+		weston_touch_process_motion(slot->device, &time,
+					    slot->touch_id, x, y);
+		delivered = true;
+	}
+
+	if (delivered) {
+		grab = r->touch->grab;
+		grab->interface->frame(grab);
+	}
+}
+
+static int
+resample_timer_handler(void *data)
+{
+	struct weston_touch_resampler *r = data;
+
+	r->timer_armed = false;
+	deliver_pending(r, true);
+
+	return 0;
+}
+
+/* Arms the timer for the next vblank of the output under the touch.
+ * Returns false if there is no output to follow. */
+static bool
+arm_timer(struct weston_touch_resampler *r)
+{
+	struct weston_touch *touch = r->touch;
+	struct weston_output *output;
+	struct timespec now;
+	int64_t period, elapsed, delay;
+
+	if (r->timer_armed)
+		return true;
+
+	if (!touch->focus || !touch->focus->output)
+		return false;
+	output = touch->focus->output;
+
+	if (output->current_mode && output->current_mode->refresh > 0)
+		period = millihz_to_nsec(output->current_mode->refresh);
+	else
+		period = TOUCH_DEFAULT_REFRESH_NSEC;
+
+	weston_compositor_read_presentation_clock(touch->seat->compositor,
+						  &now);
+	elapsed = timespec_sub_to_nsec(&now, &output->frame_time);
+	if (elapsed < 0)
+		elapsed = 0;
+	delay = period - elapsed % period;
+
+	/* A zero timeout would disarm the timer */
+	wl_event_source_timer_update(r->timer,
+				     MAX(1, (delay + 999999) / 1000000));
+	r->timer_armed = true;
+
+	return true;
+}
+
+static void
+disarm_timer(struct weston_touch_resampler *r)
+{
+	if (!r->timer_armed)
+		return;
+
+	wl_event_source_timer_update(r->timer, 0);
+	r->timer_armed = false;
+}
+
+/** Create the resampler of a weston_touch
+ *
+ * \param touch The touch.
+ * \return The resampler, or NULL if neither resampling nor prediction is
+ * enabled in the compositor or on failure.
+ */
+struct weston_touch_resampler *
+weston_touch_resampler_create(struct weston_touch *touch)
+{
+	struct weston_compositor *compositor = touch->seat->compositor;
+	struct weston_touch_resampler *r;
+	struct wl_event_loop *loop;
+
+	if (!compositor->touch_resample && compositor->touch_predict_msec == 0)
+		return NULL;
+
+	r = zalloc(sizeof *r);
+	if (!r)
+		return NULL;
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+	r->timer = wl_event_loop_add_timer(loop, resample_timer_handler, r);
+	if (!r->timer) {
+		free(r);
+		return NULL;
+	}
+
+	r->touch = touch;
+	r->resample = compositor->touch_resample;
+	r->predict_nsec = compositor->touch_predict_msec * 1000000LL;
+
+	return r;
+}
+
+void
+weston_touch_resampler_destroy(struct weston_touch_resampler *r)
+{
+	if (!r)
+		return;
+
+	wl_event_source_remove(r->timer);
+	free(r);
+}
+
+/** Forget all touch points without delivering anything */
+void
+weston_touch_resampler_reset(struct weston_touch_resampler *r)
+{
+	unsigned i;
+
+	disarm_timer(r);
+	for (i = 0; i < ARRAY_LENGTH(r->slots); i++)
+		r->slots[i].active = false;
+	r->need_frame = false;
+}
+
+/** Forget the touch points of a device that goes away */
+void
+weston_touch_resampler_device_destroyed(struct weston_touch_resampler *r,
+					struct weston_touch_device *device)
+{
+	unsigned i;
+
+	for (i = 0; i < ARRAY_LENGTH(r->slots); i++) {
+		if (r->slots[i].device == device)
+			r->slots[i].active = false;
+	}
+}
+
+/** Deliver the held back motion right away, without resampling
+ *
+ * Needed before anything that must not be reordered with the motion, like
+ * a touch point going down or up.
+ */
+void
+weston_touch_resampler_flush(struct weston_touch_resampler *r)
+{
+	disarm_timer(r);
+	deliver_pending(r, false);
+}
+
+void
+weston_touch_resampler_down(struct weston_touch_resampler *r,
+			    struct weston_touch_device *device,
+			    const struct timespec *time, int touch_id,
+			    double x, double y)
+{
+	struct touch_slot *slot = find_slot(r, touch_id);
+	unsigned i;
+
+	r->need_frame = true;
+
+	for (i = 0; !slot && i < ARRAY_LENGTH(r->slots); i++) {
+		if (!r->slots[i].active)
+			slot = &r->slots[i];
+	}
+	if (!slot)
+		return;
+
+	slot->active = true;
+	slot->touch_id = touch_id;
+	slot->device = device;
+	slot->pending = false;
+	touch_history_reset(&slot->history);
+	touch_history_record(&slot->history, time, x, y);
+}
+
+void
+weston_touch_resampler_up(struct weston_touch_resampler *r, int touch_id)
+{
+	struct touch_slot *slot = find_slot(r, touch_id);
+
+	r->need_frame = true;
+
+	if (slot)
+		slot->active = false;
+}
+
+/** Record a motion sample
+ *
+ * \return True if the motion is held back for delivery at the next
+ * refresh, false if it must be delivered now.
+ */
+bool
+weston_touch_resampler_motion(struct weston_touch_resampler *r,
+			      const struct timespec *time, int touch_id,
+			      double x, double y)
+{
+	struct touch_slot *slot = find_slot(r, touch_id);
+
+	if (slot)
+		touch_history_record(&slot->history, time, x, y);
+
+	if (slot && r->resample && arm_timer(r)) {
+		slot->pending = true;
+		return true;
+	}
+
+	r->need_frame = true;
+
+	return false;
+}
+
+/** Whether a device frame has anything to terminate
+ *
+ * Frames that only follow held back motion are dropped, the resampled
+ * motion comes with a frame of its own.
+ */
+bool
+weston_touch_resampler_frame(struct weston_touch_resampler *r)
+{
+	bool need_frame = r->need_frame;
+
+	r->need_frame = false;
+
+	return need_frame;
+}
+
+/** Predict where a touch point will be
+ *
+ * \param touch The touch.
+ * \param touch_id The touch point.
+ * \param[out] x Predicted X coordinate in global space.
+ * \param[out] y Predicted Y coordinate in global space.
+ * \return True on success, false if prediction is disabled or there is
+ * not enough history for the touch point, leaving x and y untouched.
+ *
+ * The position is extrapolated from the velocity of the recent samples
+ * to the configured prediction interval after the current time. Shells
+ * can use it for drag and pan operations to make up for the latency from
+ * the touchscreen to the screen.
+ */
+WL_EXPORT bool
+weston_touch_get_predicted_position(struct weston_touch *touch, int touch_id,
+				    wl_fixed_t *x, wl_fixed_t *y)
+{
+	struct weston_touch_resampler *r = touch->resampler;
+	const struct touch_slot *slot;
+	struct timespec now;
+	double px, py;
+
+	if (!r || r->predict_nsec == 0)
+		return false;
+
+	slot = find_slot(r, touch_id);
+	if (!slot)
+		return false;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (!touch_history_predict(&slot->history, &now, r->predict_nsec,
+				   &px, &py))
+		return false;
+
+	*x = wl_fixed_from_double(px);
+	*y = wl_fixed_from_double(py);
+
+	return true;
+}
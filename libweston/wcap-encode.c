@@ -0,0 +1,198 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "wcap-encode.h"
+
+static uint32_t *
+output_run(uint32_t *p, uint32_t delta, int run)
+{
+	int i;
+
+	while (run > 0) {
+		if (run <= 0xe0) {
+			*p++ = delta | ((run - 1) << 24);
+			break;
+		}
+
+		i = 24 - __builtin_clz(run);
+		*p++ = delta | ((i + 0xe0) << 24);
+		run -= 1 << (7 + i);
+	}
+
+	return p;
+}
+
+/* Per-byte difference of the R, G and B channels, without carries
+ * between them. */
+static inline uint32_t
+component_delta(uint32_t next, uint32_t prev)
+{
+	uint32_t d;
+
+	d = (next | 0x80808080) - (prev & 0x7f7f7f7f);
+	d ^= (next ^ ~prev) & 0x80808080;
+
+	return d & 0x00ffffff;
+}
+
+/* Replaces s with its delta against d, and d with the old s. gcc only
+ * vectorizes the scalar loop at -O3, so four pixels at a time are done
+ * with SSE2 or NEON explicitly, where their per-byte subtraction is the
+ * same as component_delta(). */
+static void
+delta_row(uint32_t * restrict s, uint32_t * restrict d, int width)
+{
+	uint32_t next;
+	int k = 0;
+
+#if defined(__SSE2__)
+	const __m128i mask = _mm_set1_epi32(0x00ffffff);
+	__m128i next4, prev4;
+
+	for (; k + 4 <= width; k += 4) {
+		next4 = _mm_loadu_si128((const __m128i *)&s[k]);
+		prev4 = _mm_loadu_si128((const __m128i *)&d[k]);
+		_mm_storeu_si128((__m128i *)&s[k],
+				 _mm_and_si128(_mm_sub_epi8(next4, prev4), mask));
+		_mm_storeu_si128((__m128i *)&d[k], next4);
+	}
+#elif defined(__ARM_NEON)
+	const uint32x4_t mask = vdupq_n_u32(0x00ffffff);
+	uint32x4_t next4, prev4;
+	uint8x16_t delta;
+
+	for (; k + 4 <= width; k += 4) {
+		next4 = vld1q_u32(&s[k]);
+		prev4 = vld1q_u32(&d[k]);
+		delta = vsubq_u8(vreinterpretq_u8_u32(next4),
+				 vreinterpretq_u8_u32(prev4));
+		vst1q_u32(&s[k], vandq_u32(vreinterpretq_u32_u8(delta), mask));
+		vst1q_u32(&d[k], next4);
+	}
+#endif
+
+	/* the end of the row, or all of it without SIMD */
+	for (; k < width; k++) {
+		next = s[k];
+		s[k] = component_delta(next, d[k]);
+		d[k] = next;
+	}
+}
+
+/** Encode the new contents of a rectangle against the previous frame
+ *
+ * \param frame The previous frame, updated with the new contents.
+ * \param stride The width of frame, in pixels.
+ * \param rect The rectangle to encode.
+ * \param pixels The new contents of rect as read from the renderer, bottom
+ * row first unless yflip is set. Overwritten with the deltas.
+ * \param yflip Whether pixels is top row first.
+ * \param out Where to write the encoded rectangle, which takes at most
+ * one word per pixel.
+ * \return The number of words written to out.
+ */
+size_t
+wcap_encode_rect(uint32_t *frame, int stride,
+		 const struct wcap_rectangle *rect,
+		 uint32_t *pixels, int yflip, uint32_t *out)
+{
+	int j, k, width, height, run;
+	uint32_t prev, *d, *s, *p;
+
+	width = rect->x2 - rect->x1;
+	height = rect->y2 - rect->y1;
+
+	p = out;
+	run = prev = 0; /* quiet gcc */
+	for (j = 0; j < height; j++) {
+		if (yflip)
+			s = pixels + width * j;
+		else
+			s = pixels + width * (height - j - 1);
+		d = frame + stride * (rect->y2 - j - 1) + rect->x1;
+
+		delta_row(s, d, width);
+
+		for (k = 0; k < width; k++) {
+			if (run == 0 || s[k] == prev) {
+				run++;
+			} else {
+				p = output_run(p, prev, run);
+				run = 1;
+			}
+			prev = s[k];
+		}
+	}
+
+	p = output_run(p, prev, run);
+
+	return p - out;
+}
+
+/** Encode a rectangle of a frame against black, for a keyframe
+ *
+ * \param frame The frame to encode, which is not changed.
+ * \param stride The width of frame, in pixels.
+ * \param rect The rectangle to encode.
+ * \param out Where to write the encoded rectangle, which takes at most
+ * one word per pixel.
+ * \return The number of words written to out.
+ */
+size_t
+wcap_encode_key_rect(const uint32_t *frame, int stride,
+		     const struct wcap_rectangle *rect, uint32_t *out)
+{
+	int j, k, run;
+	uint32_t prev, next, *p;
+	const uint32_t *d;
+
+	p = out;
+	run = prev = 0; /* quiet gcc */
+	for (j = rect->y2 - 1; j >= rect->y1; j--) {
+		d = frame + stride * j;
+		for (k = rect->x1; k < rect->x2; k++) {
+			next = d[k] & 0x00ffffff;
+			if (run == 0 || next == prev) {
+				run++;
+			} else {
+				p = output_run(p, prev, run);
+				run = 1;
+			}
+			prev = next;
+		}
+	}
+
+	p = output_run(p, prev, run);
+
+	return p - out;
+}
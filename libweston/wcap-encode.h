@@ -0,0 +1,42 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _WESTON_WCAP_ENCODE_H
+#define _WESTON_WCAP_ENCODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wcap/wcap-decode.h"
+
+size_t
+wcap_encode_rect(uint32_t *frame, int stride,
+		 const struct wcap_rectangle *rect,
+		 uint32_t *pixels, int yflip, uint32_t *out);
+
+size_t
+wcap_encode_key_rect(const uint32_t *frame, int stride,
+		     const struct wcap_rectangle *rect, uint32_t *out);
+
+#endif /* _WESTON_WCAP_ENCODE_H */
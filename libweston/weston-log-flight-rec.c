@@ -34,6 +34,9 @@
 #include <assert.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/time.h>
@@ -44,6 +47,12 @@ struct weston_ring_buffer {
 	char *buf;		/**< the buffer itself */
 	FILE *file;		/**< where to write in case we need to dump the buf */
 	bool overlap;		/**< in case buff overlaps, hint from where to print buf contents */
+
+	/* deferred formatting mode, see weston_log_subscriber_create_flight_rec_deferred() */
+	bool deferred;		/**< buf holds entries rather than text */
+	bool empty;		/**< no entries stored yet */
+	uint32_t tail;		/**< oldest entry */
+	uint32_t last;		/**< newest entry */
 };
 
 /** allows easy access to the ring buffer in case of a core dump
@@ -177,6 +186,612 @@ weston_log_flight_recorder_write(struct weston_log_subscriber *sub,
 
 }
 
+/*
+ * Deferred formatting mode
+ *
+ * Instead of text, the ring holds a sequence of entries. For printf-style
+ * messages an entry stores the format string pointer and a copy of the
+ * arguments, read according to the format string; the text is produced only
+ * when the ring is displayed. Strings passed for %s are copied, as they are
+ * unlikely to outlive the call. Format strings are expected to be string
+ * literals. Anything the argument reader does not handle (positional
+ * arguments, wide strings) is formatted right away and stored as text, as
+ * is data written to the scope directly.
+ *
+ * Entries are aligned to FLIGHT_REC_ALIGN and never wrap around the end of
+ * the buffer; a FLIGHT_REC_ENTRY_WRAP entry marks the unused space at the
+ * end instead. The oldest entries are dropped to make room for new ones.
+ */
+
+#define FLIGHT_REC_ALIGN	8
+#define FLIGHT_REC_MAX_ENTRY	4096
+#define FLIGHT_REC_MAX_STRING	1024
+
+enum flight_rec_entry_type {
+	FLIGHT_REC_ENTRY_WRAP = 1,
+	FLIGHT_REC_ENTRY_TEXT,
+	FLIGHT_REC_ENTRY_FORMAT,
+	FLIGHT_REC_ENTRY_FORMAT_PREFIXED,
+};
+
+struct flight_rec_entry {
+	uint32_t size;		/**< whole entry, aligned */
+	uint32_t type;		/**< enum flight_rec_entry_type */
+	uint32_t len;		/**< bytes of text or of arguments */
+	uint32_t padding;
+	const char *fmt;	/**< FLIGHT_REC_ENTRY_FORMAT(_PREFIXED) only */
+};
+
+enum flight_rec_arg {
+	FLIGHT_REC_ARG_NONE,	/* %% and %n */
+	FLIGHT_REC_ARG_INT,
+	FLIGHT_REC_ARG_LONG,
+	FLIGHT_REC_ARG_LLONG,
+	FLIGHT_REC_ARG_INTMAX,
+	FLIGHT_REC_ARG_SIZE,
+	FLIGHT_REC_ARG_PTRDIFF,
+	FLIGHT_REC_ARG_DOUBLE,
+	FLIGHT_REC_ARG_LDOUBLE,
+	FLIGHT_REC_ARG_STRING,	/* also %m, stored as the string */
+	FLIGHT_REC_ARG_POINTER,
+	FLIGHT_REC_ARG_UNSUPPORTED,
+};
+
+struct flight_rec_spec {
+	const char *start;	/**< the '%' */
+	const char *end;	/**< one past the conversion */
+	int n_star;		/**< '*' width and precision arguments */
+	int precision;		/**< literal precision, or -1 */
+	bool precision_star;	/**< the last '*' argument is the precision */
+	enum flight_rec_arg arg;
+	char conversion;
+};
+
+union flight_rec_value {
+	int i;
+	long l;
+	long long ll;
+	intmax_t j;
+	size_t z;
+	ptrdiff_t t;
+	double d;
+	long double ld;
+	void *p;
+};
+
+#define FLIGHT_REC_VALUE_SIZE \
+	((sizeof(union flight_rec_value) + FLIGHT_REC_ALIGN - 1) & \
+	 ~(FLIGHT_REC_ALIGN - 1))
+
+static size_t
+flight_rec_align(size_t len)
+{
+	return (len + FLIGHT_REC_ALIGN - 1) & ~(size_t)(FLIGHT_REC_ALIGN - 1);
+}
+
+/* Parses the conversion specification starting at p, which points at '%'. */
+static void
+flight_rec_parse_spec(const char *p, struct flight_rec_spec *spec)
+{
+	bool dot = false;
+	int longs = 0;
+
+	spec->start = p++;
+	spec->n_star = 0;
+	spec->precision = -1;
+	spec->precision_star = false;
+	spec->arg = FLIGHT_REC_ARG_INT;
+
+	while (*p && strchr("-+ #0'I", *p))
+		p++;
+
+	/* width and precision */
+	while (*p && (strchr("0123456789.*$", *p))) {
+		if (*p == '*') {
+			spec->n_star++;
+			spec->precision_star = dot;
+		} else if (*p == '$') {
+			spec->arg = FLIGHT_REC_ARG_UNSUPPORTED;
+		} else if (*p == '.') {
+			dot = true;
+			spec->precision = 0;
+		} else if (dot && spec->precision < FLIGHT_REC_MAX_STRING) {
+			spec->precision = spec->precision * 10 + *p - '0';
+		}
+		p++;
+	}
+
+	/* length modifier */
+	for (;; p++) {
+		if (*p == 'h')
+			continue;
+		if (*p == 'l')
+			longs++;
+		else if (*p == 'q' || *p == 'L')
+			longs = 2;
+		else if (*p == 'j')
+			longs = 'j';
+		else if (*p == 'z' || *p == 'Z')
+			longs = 'z';
+		else if (*p == 't')
+			longs = 't';
+		else
+			break;
+	}
+
+	spec->conversion = *p;
+	spec->end = *p ? p + 1 : p;
+
+	if (spec->arg == FLIGHT_REC_ARG_UNSUPPORTED)
+		return;
+
+	switch (*p) {
+	case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+		if (longs == 1)
+			spec->arg = FLIGHT_REC_ARG_LONG;
+		else if (longs == 2)
+			spec->arg = FLIGHT_REC_ARG_LLONG;
+		else if (longs == 'j')
+			spec->arg = FLIGHT_REC_ARG_INTMAX;
+		else if (longs == 'z')
+			spec->arg = FLIGHT_REC_ARG_SIZE;
+		else if (longs == 't')
+			spec->arg = FLIGHT_REC_ARG_PTRDIFF;
+		break;
+	case 'c':
+		if (longs)
+			spec->arg = FLIGHT_REC_ARG_UNSUPPORTED;
+		break;
+	case 'e': case 'E': case 'f': case 'F':
+	case 'g': case 'G': case 'a': case 'A':
+		if (longs == 2)
+			spec->arg = FLIGHT_REC_ARG_LDOUBLE;
+		else
+			spec->arg = FLIGHT_REC_ARG_DOUBLE;
+		break;
+	case 's':
+		if (longs)
+			spec->arg = FLIGHT_REC_ARG_UNSUPPORTED;
+		else
+			spec->arg = FLIGHT_REC_ARG_STRING;
+		break;
+	case 'm':
+		spec->arg = FLIGHT_REC_ARG_STRING;
+		break;
+	case 'p':
+		spec->arg = FLIGHT_REC_ARG_POINTER;
+		break;
+	case '%':
+		spec->arg = FLIGHT_REC_ARG_NONE;
+		break;
+	default:
+		/* %n and unknown conversions */
+		spec->arg = FLIGHT_REC_ARG_UNSUPPORTED;
+		break;
+	}
+}
+
+static bool
+flight_rec_put(char *blob, size_t *pos, const void *data, size_t len)
+{
+	if (*pos + flight_rec_align(len) > FLIGHT_REC_MAX_ENTRY)
+		return false;
+
+	memcpy(blob + *pos, data, len);
+	*pos += flight_rec_align(len);
+
+	return true;
+}
+
+/* Stores at most precision bytes of str, if precision is not negative;
+ * str need not be NUL-terminated within them. */
+static bool
+flight_rec_put_string(char *blob, size_t *pos, const char *str, int precision)
+{
+	size_t max = FLIGHT_REC_MAX_STRING;
+	uint32_t len = UINT32_MAX;
+
+	if (precision >= 0 && (size_t)precision < max)
+		max = precision;
+	if (str)
+		len = strnlen(str, max);
+
+	if (!flight_rec_put(blob, pos, &len, sizeof(len)))
+		return false;
+
+	if (!str)
+		return true;
+
+	/* stored NUL-terminated, possibly truncated */
+	if (*pos + flight_rec_align(len + 1) > FLIGHT_REC_MAX_ENTRY)
+		return false;
+
+	memcpy(blob + *pos, str, len);
+	blob[*pos + len] = '\0';
+	*pos += flight_rec_align(len + 1);
+
+	return true;
+}
+
+/* Copies the arguments described by fmt into blob, from pos on. Returns the
+ * number of bytes used in total, or -1 if the arguments could not be
+ * stored. */
+static int
+flight_rec_store_args(char *blob, size_t pos, const char *fmt, va_list ap,
+		      int saved_errno)
+{
+	struct flight_rec_spec spec;
+	union flight_rec_value v;
+	const char *p;
+	bool ok = true;
+	int i;
+
+	for (p = strchr(fmt, '%'); p && ok; p = strchr(spec.end, '%')) {
+		flight_rec_parse_spec(p, &spec);
+
+		for (i = 0; i < spec.n_star && ok; i++) {
+			memset(&v, 0, sizeof(v));
+			v.i = va_arg(ap, int);
+			ok = flight_rec_put(blob, &pos, &v, FLIGHT_REC_VALUE_SIZE);
+
+			/* a negative precision is taken as if omitted */
+			if (spec.precision_star && i == spec.n_star - 1)
+				spec.precision = v.i < 0 ? -1 : v.i;
+		}
+		if (!ok)
+			break;
+
+		memset(&v, 0, sizeof(v));
+		switch (spec.arg) {
+		case FLIGHT_REC_ARG_NONE:
+			continue;
+		case FLIGHT_REC_ARG_INT:
+			v.i = va_arg(ap, int);
+			break;
+		case FLIGHT_REC_ARG_LONG:
+			v.l = va_arg(ap, long);
+			break;
+		case FLIGHT_REC_ARG_LLONG:
+			v.ll = va_arg(ap, long long);
+			break;
+		case FLIGHT_REC_ARG_INTMAX:
+			v.j = va_arg(ap, intmax_t);
+			break;
+		case FLIGHT_REC_ARG_SIZE:
+			v.z = va_arg(ap, size_t);
+			break;
+		case FLIGHT_REC_ARG_PTRDIFF:
+			v.t = va_arg(ap, ptrdiff_t);
+			break;
+		case FLIGHT_REC_ARG_DOUBLE:
+			v.d = va_arg(ap, double);
+			break;
+		case FLIGHT_REC_ARG_LDOUBLE:
+			v.ld = va_arg(ap, long double);
+			break;
+		case FLIGHT_REC_ARG_STRING:
+			if (spec.conversion == 'm')
+				ok = flight_rec_put_string(blob, &pos,
+							   strerror(saved_errno),
+							   spec.precision);
+			else
+				ok = flight_rec_put_string(blob, &pos,
+							   va_arg(ap, const char *),
+							   spec.precision);
+			continue;
+		case FLIGHT_REC_ARG_POINTER:
+			v.p = va_arg(ap, void *);
+			break;
+		case FLIGHT_REC_ARG_UNSUPPORTED:
+			return -1;
+		}
+
+		ok = flight_rec_put(blob, &pos, &v, FLIGHT_REC_VALUE_SIZE);
+	}
+
+	return ok ? (int)pos : -1;
+}
+
+/* Position of the entry following the one at pos. */
+static uint32_t
+flight_rec_next(struct weston_ring_buffer *rb, uint32_t pos)
+{
+	const struct flight_rec_entry *entry =
+		(const struct flight_rec_entry *)&rb->buf[pos];
+
+	if (entry->type == FLIGHT_REC_ENTRY_WRAP)
+		return 0;
+
+	pos += entry->size;
+
+	/* no room for a wrap marker at the end */
+	if (pos + sizeof(*entry) > rb->size)
+		return 0;
+
+	return pos;
+}
+
+/* Drops the oldest entries overlapping [start, end). */
+static void
+flight_rec_evict(struct weston_ring_buffer *rb, uint32_t start, uint32_t end)
+{
+	while (!rb->empty && rb->tail >= start && rb->tail < end) {
+		if (rb->tail == rb->last) {
+			rb->empty = true;
+			break;
+		}
+
+		rb->tail = flight_rec_next(rb, rb->tail);
+	}
+}
+
+static struct flight_rec_entry *
+flight_rec_reserve(struct weston_ring_buffer *rb, uint32_t size)
+{
+	struct flight_rec_entry *entry;
+	uint32_t head = rb->append_pos;
+
+	if (head + size > rb->size) {
+		flight_rec_evict(rb, head, rb->size);
+		if (head + sizeof(*entry) <= rb->size) {
+			entry = (struct flight_rec_entry *)&rb->buf[head];
+			entry->size = rb->size - head;
+			entry->type = FLIGHT_REC_ENTRY_WRAP;
+		}
+		head = 0;
+	}
+
+	flight_rec_evict(rb, head, head + size);
+
+	entry = (struct flight_rec_entry *)&rb->buf[head];
+	if (rb->empty)
+		rb->tail = head;
+	rb->empty = false;
+	rb->last = head;
+	rb->append_pos = head + size;
+
+	entry->size = size;
+
+	return entry;
+}
+
+static void
+flight_rec_store_text(struct weston_ring_buffer *rb, const char *data, size_t len)
+{
+	struct flight_rec_entry *entry;
+	size_t max = FLIGHT_REC_MAX_ENTRY - sizeof(*entry);
+
+	while (len > 0) {
+		size_t n = MIN(len, max);
+
+		entry = flight_rec_reserve(rb, flight_rec_align(sizeof(*entry) + n));
+		entry->type = FLIGHT_REC_ENTRY_TEXT;
+		entry->len = n;
+		memcpy(entry + 1, data, n);
+
+		data += n;
+		len -= n;
+	}
+}
+
+static void
+weston_log_flight_recorder_deferred_write(struct weston_log_subscriber *sub,
+					  const char *data, size_t len)
+{
+	struct weston_debug_log_flight_recorder *flight_rec =
+		to_flight_recorder(sub);
+
+	flight_rec_store_text(&flight_rec->rb, data, len);
+}
+
+/* Formats the message right away, as a single text entry. */
+static void
+flight_rec_store_formatted(struct weston_ring_buffer *rb, const char *prefix,
+			   const char *fmt, va_list ap)
+{
+	size_t prefix_len;
+	char *text, *str;
+	int len;
+
+	len = vasprintf(&text, fmt, ap);
+	if (len < 0)
+		return;
+
+	if (!prefix) {
+		flight_rec_store_text(rb, text, len);
+		free(text);
+		return;
+	}
+
+	prefix_len = strlen(prefix);
+	str = malloc(prefix_len + len);
+	if (str) {
+		memcpy(str, prefix, prefix_len);
+		memcpy(str + prefix_len, text, len);
+		flight_rec_store_text(rb, str, prefix_len + len);
+		free(str);
+	}
+	free(text);
+}
+
+static void
+weston_log_flight_recorder_deferred_vprintf(struct weston_log_subscriber *sub,
+					    const char *prefix,
+					    const char *fmt, va_list ap)
+{
+	struct weston_debug_log_flight_recorder *flight_rec =
+		to_flight_recorder(sub);
+	struct weston_ring_buffer *rb = &flight_rec->rb;
+	struct flight_rec_entry *entry;
+	int saved_errno = errno;
+	char blob[FLIGHT_REC_MAX_ENTRY];
+	size_t pos = 0;
+	va_list aq;
+	int len = -1;
+
+	/* the prefix goes first, stored like a %s argument */
+	if (!prefix || flight_rec_put_string(blob, &pos, prefix, -1)) {
+		va_copy(aq, ap);
+		len = flight_rec_store_args(blob, pos, fmt, aq, saved_errno);
+		va_end(aq);
+	}
+
+	if (len < 0 || sizeof(*entry) + len > FLIGHT_REC_MAX_ENTRY) {
+		/* cannot be deferred, format it now */
+		errno = saved_errno;
+		flight_rec_store_formatted(rb, prefix, fmt, ap);
+		return;
+	}
+
+	entry = flight_rec_reserve(rb, flight_rec_align(sizeof(*entry) + len));
+	entry->type = prefix ? FLIGHT_REC_ENTRY_FORMAT_PREFIXED :
+			       FLIGHT_REC_ENTRY_FORMAT;
+	entry->len = len;
+	entry->fmt = fmt;
+	memcpy(entry + 1, blob, len);
+}
+
+static const void *
+flight_rec_get(const char **pos, size_t len)
+{
+	const char *p = *pos;
+
+	*pos += flight_rec_align(len);
+
+	return p;
+}
+
+static void
+flight_rec_display_string(const char **pos, const char *spec, FILE *file)
+{
+	const char *str = NULL;
+	uint32_t len;
+
+	memcpy(&len, flight_rec_get(pos, sizeof(len)), sizeof(len));
+	if (len != UINT32_MAX)
+		str = flight_rec_get(pos, len + 1);
+
+	fprintf(file, spec, str);
+}
+
+static void
+flight_rec_display_format(const struct flight_rec_entry *entry, FILE *file)
+{
+	const char *pos = (const char *)(entry + 1);
+	struct flight_rec_spec spec;
+	union flight_rec_value v;
+	const char *p = entry->fmt;
+	const char *next;
+	char buf[64];
+	size_t len;
+
+	if (entry->type == FLIGHT_REC_ENTRY_FORMAT_PREFIXED)
+		flight_rec_display_string(&pos, "%s", file);
+
+	while ((next = strchr(p, '%'))) {
+		fwrite(p, 1, next - p, file);
+		flight_rec_parse_spec(next, &spec);
+		p = spec.end;
+
+		if (spec.arg == FLIGHT_REC_ARG_NONE) {
+			if (spec.conversion == '%')
+				fputc('%', file);
+			continue;
+		}
+
+		/* rebuild the specification with '*' replaced by the stored
+		 * values */
+		len = 0;
+		for (next = spec.start; next < spec.end - 1 &&
+		     len < sizeof(buf) - 16; next++) {
+			if (*next != '*') {
+				buf[len++] = *next;
+				continue;
+			}
+
+			memcpy(&v, flight_rec_get(&pos, FLIGHT_REC_VALUE_SIZE),
+			       sizeof(v));
+
+			/* ".-1" is not a valid precision, drop the '.' */
+			if (v.i < 0 && len > 0 && buf[len - 1] == '.')
+				len--;
+			else
+				len += snprintf(buf + len, sizeof(buf) - len,
+						"%d", v.i);
+		}
+
+		/* %m was stored as a string */
+		buf[len++] = spec.conversion == 'm' ? 's' : spec.conversion;
+		buf[len] = '\0';
+
+		if (spec.arg == FLIGHT_REC_ARG_STRING) {
+			flight_rec_display_string(&pos, buf, file);
+			continue;
+		}
+
+		memcpy(&v, flight_rec_get(&pos, FLIGHT_REC_VALUE_SIZE), sizeof(v));
+		switch (spec.arg) {
+		case FLIGHT_REC_ARG_INT:
+			fprintf(file, buf, v.i);
+			break;
+		case FLIGHT_REC_ARG_LONG:
+			fprintf(file, buf, v.l);
+			break;
+		case FLIGHT_REC_ARG_LLONG:
+			fprintf(file, buf, v.ll);
+			break;
+		case FLIGHT_REC_ARG_INTMAX:
+			fprintf(file, buf, v.j);
+			break;
+		case FLIGHT_REC_ARG_SIZE:
+			fprintf(file, buf, v.z);
+			break;
+		case FLIGHT_REC_ARG_PTRDIFF:
+			fprintf(file, buf, v.t);
+			break;
+		case FLIGHT_REC_ARG_DOUBLE:
+			fprintf(file, buf, v.d);
+			break;
+		case FLIGHT_REC_ARG_LDOUBLE:
+			fprintf(file, buf, v.ld);
+			break;
+		case FLIGHT_REC_ARG_POINTER:
+			fprintf(file, buf, v.p);
+			break;
+		default:
+			break;
+		}
+	}
+
+	fputs(p, file);
+}
+
+static void
+weston_log_subscriber_display_flight_rec_entries(struct weston_ring_buffer *rb,
+						 FILE *file)
+{
+	const struct flight_rec_entry *entry;
+	uint32_t pos = rb->tail;
+
+	if (rb->empty)
+		return;
+
+	while (1) {
+		entry = (const struct flight_rec_entry *)&rb->buf[pos];
+
+		if (entry->type == FLIGHT_REC_ENTRY_TEXT)
+			fwrite(entry + 1, 1, entry->len, file);
+		else if (entry->type == FLIGHT_REC_ENTRY_FORMAT ||
+			 entry->type == FLIGHT_REC_ENTRY_FORMAT_PREFIXED)
+			flight_rec_display_format(entry, file);
+
+		if (pos == rb->last)
+			break;
+
+		pos = flight_rec_next(rb, pos);
+	}
+}
+
 static void
 weston_log_flight_recorder_map_memory(struct weston_debug_log_flight_recorder *flight_rec)
 {
@@ -194,6 +809,11 @@ weston_log_subscriber_display_flight_rec_data(struct weston_ring_buffer *rb,
 	if (file)
 		file_d = file;
 
+	if (rb->deferred) {
+		weston_log_subscriber_display_flight_rec_entries(rb, file_d);
+		return;
+	}
+
 	if (!rb->overlap) {
 		if (rb->append_pos)
 			fwrite(rb->buf, sizeof(char), rb->append_pos, file_d);
@@ -260,6 +880,46 @@ weston_log_subscriber_create_flight_rec(size_t size)
 	return &flight_rec->base;
 }
 
+/** Create a flight recorder type of subscriber with deferred formatting
+ *
+ * Works like weston_log_subscriber_create_flight_rec(), except that
+ * printf-style messages are not formatted when they are logged: the ring
+ * stores the format string pointer and a copy of the arguments, and the text
+ * is produced only when the ring is displayed, see
+ * weston_log_flight_recorder_display_buffer(). This makes it cheap enough to
+ * keep the recorder subscribed to busy scopes all the time.
+ *
+ * The format strings must outlive the recorder, which holds for string
+ * literals. Use weston_log_subscriber_destroy_flight_rec() to clean-up.
+ *
+ * @param size specify the maximum size (in bytes) of the backing storage
+ * for the flight recorder
+ * @returns a weston_log_subscriber object or NULL in case of failure
+ */
+WL_EXPORT struct weston_log_subscriber *
+weston_log_subscriber_create_flight_rec_deferred(size_t size)
+{
+	struct weston_log_subscriber *sub;
+	struct weston_debug_log_flight_recorder *flight_rec;
+
+	if (size < 4 * FLIGHT_REC_MAX_ENTRY)
+		return NULL;
+
+	sub = weston_log_subscriber_create_flight_rec(size);
+	if (!sub)
+		return NULL;
+
+	flight_rec = to_flight_recorder(sub);
+	flight_rec->base.write = weston_log_flight_recorder_deferred_write;
+	flight_rec->base.vprintf = weston_log_flight_recorder_deferred_vprintf;
+
+	flight_rec->rb.size = size & ~(FLIGHT_REC_ALIGN - 1);
+	flight_rec->rb.deferred = true;
+	flight_rec->rb.empty = true;
+
+	return sub;
+}
+
 /** Destroys the weston_log_subscriber object created with
  * weston_log_subscriber_create_flight_rec()
  *
@@ -270,6 +930,10 @@ WL_EXPORT void
 weston_log_subscriber_destroy_flight_rec(struct weston_log_subscriber *sub)
 {
 	struct weston_debug_log_flight_recorder *flight_rec = to_flight_recorder(sub);
+
+	if (weston_primary_flight_recorder_ring_buffer == &flight_rec->rb)
+		weston_primary_flight_recorder_ring_buffer = NULL;
+
 	free(flight_rec->rb.buf);
 	free(flight_rec);
 }
@@ -26,6 +26,8 @@
 #define WESTON_LOG_INTERNAL_H
 
 #include "wayland-util.h"
+#include <stdarg.h>
+#include <stdbool.h>
 
 struct weston_log_subscription;
 
@@ -60,6 +62,12 @@ struct weston_log_subscriber {
 	 * stream.
 	 */
 	void (*complete)(struct weston_log_subscriber *sub);
+	/** Optional; for the type of streams that rather store the format
+	 * string and its arguments than the formatted text. When set, it is
+	 * used instead of \c write for printf-style messages, which come with
+	 * an optional prefix of plain text. */
+	void (*vprintf)(struct weston_log_subscriber *sub, const char *prefix,
+			const char *fmt, va_list ap);
 	struct wl_list subscription_list;       /**< weston_log_subscription::owner_link */
 };
 
@@ -79,6 +87,10 @@ weston_log_subscription_add(struct weston_log_scope *scope,
 void
 weston_log_subscription_remove(struct weston_log_subscription *sub);
 
+void
+weston_log_subscription_write(struct weston_log_subscription *sub,
+			      const char *data, size_t len);
+
 
 void
 weston_log_bind_weston_debug(struct wl_client *client,
@@ -116,4 +128,32 @@ void
 weston_timeline_destroy_subscription(struct weston_log_subscription *sub,
 				     void *user_data);
 
+void
+weston_timeline_binary_create_subscription(struct weston_log_subscription *sub,
+					   void *user_data);
+
+void
+weston_timeline_binary_destroy_subscription(struct weston_log_subscription *sub,
+					    void *user_data);
+
+void
+weston_timeline_trace_create_subscription(struct weston_log_subscription *sub,
+					  void *user_data);
+
+struct weston_trace_writer;
+
+typedef void (*weston_trace_write_func_t)(void *data,
+					  const char *buf, size_t len);
+
+struct weston_trace_writer *
+weston_trace_writer_create(weston_trace_write_func_t write, void *data,
+			   bool renderer_phases);
+
+void
+weston_trace_writer_feed(struct weston_trace_writer *tw,
+			 const char *data, size_t len);
+
+void
+weston_trace_writer_destroy(struct weston_trace_writer *tw);
+
 #endif /* WESTON_LOG_INTERNAL_H */
@@ -0,0 +1,576 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <libweston/weston-log.h>
+#include "shared/helpers.h"
+#include "shared/timeline-binary.h"
+#include <libweston/libweston.h>
+
+#include "weston-log-internal.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Converts the record stream of the binary timeline (see
+ * shared/timeline-binary.h) into Chrome trace-event JSON, which can be
+ * loaded in chrome://tracing and in the Perfetto UI.
+ *
+ * Outputs are put in one trace process with a track per output and one
+ * per output for GPU timestamps; surfaces get their own process with a
+ * track per surface. Known timeline points are paired into duration
+ * slices, anything else becomes an instant event on the matching track.
+ */
+
+#define TRACE_PID_OUTPUTS	1
+#define TRACE_PID_SURFACES	2
+#define TRACE_MAX_STRING	1024
+
+struct trace_output_state {
+	bool repaint;
+	bool vblank_wait;
+	bool gpu;
+};
+
+struct trace_surface_state {
+	bool damage;
+};
+
+struct weston_trace_writer {
+	weston_trace_write_func_t write;
+	void *data;
+	bool renderer_phases;
+	bool started;
+
+	/* record being assembled from the byte stream */
+	struct weston_timeline_binary_record rec;
+	size_t rec_fill;
+
+	/* values of the aux records read so far, by flag bit */
+	uint64_t aux[WESTON_TIMELINE_BINARY_AUX_SLOTS];
+
+	/* definition whose payload is being read */
+	struct weston_timeline_binary_record def;
+	bool in_payload;
+	size_t payload_size;
+	size_t payload_fill;
+	char payload[TRACE_MAX_STRING + 1];
+
+	char **names;
+	uint32_t names_size;
+
+	struct trace_output_state *outputs;
+	uint32_t outputs_size;
+
+	struct trace_surface_state *surfaces;
+	uint32_t surfaces_size;
+};
+
+static void *
+trace_array_ensure(void *array, uint32_t *size, uint32_t index, size_t elem)
+{
+	uint32_t new_size = *size ? *size : 16;
+	char *p;
+
+	if (index < *size)
+		return array;
+
+	while (new_size <= index)
+		new_size *= 2;
+
+	p = realloc(array, new_size * elem);
+	if (!p)
+		return NULL;
+
+	memset(p + *size * elem, 0, (new_size - *size) * elem);
+	*size = new_size;
+
+	return p;
+}
+
+static struct trace_output_state *
+trace_output(struct weston_trace_writer *tw, uint32_t id)
+{
+	struct trace_output_state *outputs;
+
+	outputs = trace_array_ensure(tw->outputs, &tw->outputs_size, id,
+				     sizeof(*outputs));
+	if (!outputs)
+		return NULL;
+
+	tw->outputs = outputs;
+	return &tw->outputs[id];
+}
+
+static struct trace_surface_state *
+trace_surface(struct weston_trace_writer *tw, uint32_t id)
+{
+	struct trace_surface_state *surfaces;
+
+	surfaces = trace_array_ensure(tw->surfaces, &tw->surfaces_size, id,
+				      sizeof(*surfaces));
+	if (!surfaces)
+		return NULL;
+
+	tw->surfaces = surfaces;
+	return &tw->surfaces[id];
+}
+
+static void
+trace_printf(struct weston_trace_writer *tw, const char *fmt, ...)
+{
+	char buf[1024];
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+
+	if (len < 0)
+		return;
+	if ((size_t)len >= sizeof(buf))
+		len = sizeof(buf) - 1;
+
+	tw->write(tw->data, buf, len);
+}
+
+/* Copies str into buf, dropping what would need escaping in JSON. */
+static const char *
+trace_sanitize(char *buf, size_t size, const char *str)
+{
+	size_t i = 0;
+
+	for (; *str && i < size - 1; str++)
+		if (*str != '"' && *str != '\\' && (unsigned char)*str >= 0x20)
+			buf[i++] = *str;
+	buf[i] = '\0';
+
+	return buf;
+}
+
+static void
+trace_event(struct weston_trace_writer *tw, char phase, const char *name,
+	    int pid, uint32_t tid, uint64_t nsec)
+{
+	trace_printf(tw, ",\n{\"ph\":\"%c\",\"name\":\"%s\",\"pid\":%d,"
+		     "\"tid\":%u,\"ts\":%" PRIu64 ".%03u%s}",
+		     phase, name, pid, tid, nsec / 1000,
+		     (unsigned int)(nsec % 1000),
+		     phase == 'i' ? ",\"s\":\"t\"" : "");
+}
+
+static void
+trace_thread_name(struct weston_trace_writer *tw, int pid, uint32_t tid,
+		  const char *prefix, const char *name)
+{
+	trace_printf(tw, ",\n{\"ph\":\"M\",\"name\":\"thread_name\","
+		     "\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s %s\"}}",
+		     pid, tid, prefix, name);
+}
+
+static void
+trace_process_name(struct weston_trace_writer *tw, int pid, const char *name)
+{
+	trace_printf(tw, ",\n{\"ph\":\"M\",\"name\":\"process_name\","
+		     "\"pid\":%d,\"args\":{\"name\":\"%s\"}}", pid, name);
+}
+
+static uint32_t
+output_tid(uint32_t id)
+{
+	return id * 2;
+}
+
+static uint32_t
+output_gpu_tid(uint32_t id)
+{
+	return id * 2 + 1;
+}
+
+/* Closes an open slice, or opens one that is not open yet; repeated
+ * begins without an end are collapsed into the first. */
+static void
+trace_slice(struct weston_trace_writer *tw, bool *open, bool begin,
+	    const char *name, int pid, uint32_t tid, uint64_t nsec)
+{
+	if (*open == begin)
+		return;
+
+	trace_event(tw, begin ? 'B' : 'E', name, pid, tid, nsec);
+	*open = begin;
+}
+
+static void
+trace_output_point(struct weston_trace_writer *tw, const char *name,
+		   const struct weston_timeline_binary_record *rec)
+{
+	struct trace_output_state *out = trace_output(tw, rec->output);
+	uint32_t tid = output_tid(rec->output);
+
+	if (!out)
+		return;
+
+	if (strcmp(name, "core_repaint_begin") == 0) {
+		trace_slice(tw, &out->repaint, true, "repaint",
+			    TRACE_PID_OUTPUTS, tid, rec->t);
+	} else if (strcmp(name, "core_repaint_posted") == 0) {
+		trace_slice(tw, &out->repaint, false, "repaint",
+			    TRACE_PID_OUTPUTS, tid, rec->t);
+		trace_slice(tw, &out->vblank_wait, true, "wait for vblank",
+			    TRACE_PID_OUTPUTS, tid, rec->t);
+	} else if (strcmp(name, "core_repaint_finished") == 0) {
+		trace_slice(tw, &out->vblank_wait, false, "wait for vblank",
+			    TRACE_PID_OUTPUTS, tid, rec->t);
+		if (rec->flags & WESTON_TIMELINE_BINARY_FLAG_VBLANK)
+			trace_event(tw, 'i', "vblank", TRACE_PID_OUTPUTS, tid,
+				    weston_timeline_binary_aux(rec, tw->aux,
+					WESTON_TIMELINE_BINARY_FLAG_VBLANK));
+	} else if (rec->flags & WESTON_TIMELINE_BINARY_FLAG_GPU) {
+		uint64_t gpu = weston_timeline_binary_aux(rec, tw->aux,
+					WESTON_TIMELINE_BINARY_FLAG_GPU);
+
+		if (!tw->renderer_phases)
+			return;
+
+		tid = output_gpu_tid(rec->output);
+		if (strcmp(name, "renderer_gpu_begin") == 0)
+			trace_slice(tw, &out->gpu, true, "gpu",
+				    TRACE_PID_OUTPUTS, tid, gpu);
+		else if (strcmp(name, "renderer_gpu_end") == 0)
+			trace_slice(tw, &out->gpu, false, "gpu",
+				    TRACE_PID_OUTPUTS, tid, gpu);
+		else
+			trace_event(tw, 'i', name, TRACE_PID_OUTPUTS, tid,
+				    gpu);
+	} else {
+		trace_event(tw, 'i', name, TRACE_PID_OUTPUTS, tid, rec->t);
+	}
+}
+
+static void
+trace_surface_point(struct weston_trace_writer *tw, const char *name,
+		    const struct weston_timeline_binary_record *rec)
+{
+	struct trace_surface_state *surf = trace_surface(tw, rec->surface);
+
+	if (!surf)
+		return;
+
+	/* damage committed by the client until the compositor flushes it */
+	if (strcmp(name, "core_commit_damage") == 0)
+		trace_slice(tw, &surf->damage, true, "damage pending",
+			    TRACE_PID_SURFACES, rec->surface, rec->t);
+	else if (strcmp(name, "core_flush_damage") == 0)
+		trace_slice(tw, &surf->damage, false, "damage pending",
+			    TRACE_PID_SURFACES, rec->surface, rec->t);
+
+	trace_event(tw, 'i', name, TRACE_PID_SURFACES, rec->surface, rec->t);
+}
+
+static void
+trace_point(struct weston_trace_writer *tw,
+	    const struct weston_timeline_binary_record *rec)
+{
+	const char *name = NULL;
+
+	if (rec->id < tw->names_size)
+		name = tw->names[rec->id];
+	if (!name)
+		return;
+
+	if (rec->output)
+		trace_output_point(tw, name, rec);
+	else if (rec->surface)
+		trace_surface_point(tw, name, rec);
+	else
+		trace_event(tw, 'i', name, TRACE_PID_OUTPUTS, 0, rec->t);
+}
+
+static void
+trace_definition(struct weston_trace_writer *tw,
+		 const struct weston_timeline_binary_record *def,
+		 char *str)
+{
+	char name[256];
+	char **names;
+
+	switch (def->type) {
+	case WESTON_TIMELINE_BINARY_NAME:
+		names = trace_array_ensure(tw->names, &tw->names_size, def->id,
+					   sizeof(*names));
+		if (!names)
+			break;
+		tw->names = names;
+		free(tw->names[def->id]);
+		tw->names[def->id] = strdup(trace_sanitize(name, sizeof(name),
+							   str));
+		break;
+	case WESTON_TIMELINE_BINARY_OUTPUT:
+		trace_sanitize(name, sizeof(name), str);
+		trace_thread_name(tw, TRACE_PID_OUTPUTS, output_tid(def->id),
+				  "output", name);
+		trace_thread_name(tw, TRACE_PID_OUTPUTS,
+				  output_gpu_tid(def->id), "GPU", name);
+		break;
+	case WESTON_TIMELINE_BINARY_SURFACE:
+		if (str[0] != '\0')
+			trace_sanitize(name, sizeof(name), str);
+		else
+			snprintf(name, sizeof(name), "%u", def->id);
+		trace_thread_name(tw, TRACE_PID_SURFACES, def->id,
+				  "surface", name);
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+trace_record(struct weston_trace_writer *tw,
+	     const struct weston_timeline_binary_record *rec)
+{
+	switch (rec->type) {
+	case WESTON_TIMELINE_BINARY_HEADER:
+		if (tw->started)
+			break;
+
+		tw->started = true;
+		trace_printf(tw, "[{\"ph\":\"M\",\"name\":\"process_name\","
+			     "\"pid\":%d,\"args\":{\"name\":\"weston outputs\"}}",
+			     TRACE_PID_OUTPUTS);
+		trace_process_name(tw, TRACE_PID_SURFACES, "weston surfaces");
+		break;
+	case WESTON_TIMELINE_BINARY_NAME:
+	case WESTON_TIMELINE_BINARY_OUTPUT:
+	case WESTON_TIMELINE_BINARY_SURFACE:
+		tw->def = *rec;
+		tw->payload_fill = 0;
+		tw->payload_size = (rec->len + sizeof(*rec) - 1) /
+				   sizeof(*rec) * sizeof(*rec);
+		if (tw->payload_size == 0)
+			trace_definition(tw, &tw->def, "");
+		else
+			tw->in_payload = true;
+		break;
+	case WESTON_TIMELINE_BINARY_AUX:
+		if (rec->flags != 0)
+			tw->aux[ffs(rec->flags) - 1] = rec->aux;
+		break;
+	case WESTON_TIMELINE_BINARY_POINT:
+		if (tw->started)
+			trace_point(tw, rec);
+		break;
+	default:
+		break;
+	}
+}
+
+/** Feed binary timeline records to a trace writer
+ *
+ * Records may be split arbitrarily across calls.
+ *
+ * @ingroup internal-log
+ */
+void
+weston_trace_writer_feed(struct weston_trace_writer *tw,
+			 const char *data, size_t len)
+{
+	size_t n;
+
+	while (len > 0) {
+		if (tw->in_payload) {
+			n = MIN(len, tw->payload_size - tw->payload_fill);
+
+			/* anything beyond TRACE_MAX_STRING is dropped */
+			if (tw->payload_fill < TRACE_MAX_STRING)
+				memcpy(tw->payload + tw->payload_fill, data,
+				       MIN(n, TRACE_MAX_STRING - tw->payload_fill));
+			tw->payload_fill += n;
+			data += n;
+			len -= n;
+
+			if (tw->payload_fill == tw->payload_size) {
+				tw->payload[MIN(tw->def.len, TRACE_MAX_STRING)] = '\0';
+				trace_definition(tw, &tw->def, tw->payload);
+				tw->in_payload = false;
+			}
+			continue;
+		}
+
+		n = MIN(len, sizeof(tw->rec) - tw->rec_fill);
+		memcpy((char *)&tw->rec + tw->rec_fill, data, n);
+		tw->rec_fill += n;
+		data += n;
+		len -= n;
+
+		if (tw->rec_fill == sizeof(tw->rec)) {
+			tw->rec_fill = 0;
+			trace_record(tw, &tw->rec);
+		}
+	}
+}
+
+/** Create a converter from binary timeline records to trace-event JSON
+ *
+ * @param write called with the JSON text as it gets produced
+ * @param data passed to \c write
+ * @param renderer_phases whether to include renderer (GPU) slices
+ *
+ * @ingroup internal-log
+ */
+struct weston_trace_writer *
+weston_trace_writer_create(weston_trace_write_func_t write, void *data,
+			   bool renderer_phases)
+{
+	struct weston_trace_writer *tw;
+
+	tw = zalloc(sizeof(*tw));
+	if (!tw)
+		return NULL;
+
+	tw->write = write;
+	tw->data = data;
+	tw->renderer_phases = renderer_phases;
+
+	return tw;
+}
+
+/** Terminate the JSON array and destroy the trace writer
+ *
+ * @ingroup internal-log
+ */
+void
+weston_trace_writer_destroy(struct weston_trace_writer *tw)
+{
+	uint32_t i;
+
+	if (tw->started)
+		trace_printf(tw, "\n]\n");
+
+	for (i = 0; i < tw->names_size; i++)
+		free(tw->names[i]);
+	free(tw->names);
+	free(tw->outputs);
+	free(tw->surfaces);
+	free(tw);
+}
+
+/** Trace-event type of subscriber
+ */
+struct weston_debug_log_trace {
+	struct weston_log_subscriber base;
+	struct weston_trace_writer *writer;
+	FILE *file;
+};
+
+static struct weston_debug_log_trace *
+to_weston_debug_log_trace(struct weston_log_subscriber *sub)
+{
+	return container_of(sub, struct weston_debug_log_trace, base);
+}
+
+static void
+weston_log_trace_file_write(void *data, const char *buf, size_t len)
+{
+	struct weston_debug_log_trace *trace = data;
+
+	fwrite(buf, len, 1, trace->file);
+}
+
+static void
+weston_log_trace_write(struct weston_log_subscriber *sub,
+		       const char *data, size_t len)
+{
+	struct weston_debug_log_trace *trace = to_weston_debug_log_trace(sub);
+
+	weston_trace_writer_feed(trace->writer, data, len);
+}
+
+/** Creates a trace-event type of subscriber
+ *
+ * The subscriber expects the data of the 'timeline-binary' scope and writes
+ * it out as Chrome trace-event JSON, viewable in chrome://tracing or
+ * the Perfetto UI.
+ *
+ * Should be destroyed using weston_log_subscriber_destroy_trace()
+ *
+ * @param dump_to the file to write to
+ * @param renderer_phases whether to include renderer (GPU) slices
+ * @returns a weston_log_subscriber object or NULL in case of failure
+ *
+ * @sa weston_log_subscriber_destroy_trace
+ */
+WL_EXPORT struct weston_log_subscriber *
+weston_log_subscriber_create_trace(FILE *dump_to, bool renderer_phases)
+{
+	struct weston_debug_log_trace *trace;
+
+	assert(dump_to);
+
+	trace = zalloc(sizeof(*trace));
+	if (!trace)
+		return NULL;
+
+	trace->file = dump_to;
+	trace->writer = weston_trace_writer_create(weston_log_trace_file_write,
+						   trace, renderer_phases);
+	if (!trace->writer) {
+		free(trace);
+		return NULL;
+	}
+
+	trace->base.write = weston_log_trace_write;
+	trace->base.destroy = NULL;
+	trace->base.complete = NULL;
+
+	wl_list_init(&trace->base.subscription_list);
+
+	return &trace->base;
+}
+
+/** Destroy the subscriber created with weston_log_subscriber_create_trace
+ *
+ * Terminates the trace. The file is not closed.
+ *
+ * @param subscriber the weston_log_subscriber object to destroy
+ *
+ */
+WL_EXPORT void
+weston_log_subscriber_destroy_trace(struct weston_log_subscriber *subscriber)
+{
+	struct weston_debug_log_trace *trace =
+		to_weston_debug_log_trace(subscriber);
+
+	weston_trace_writer_destroy(trace->writer);
+	fflush(trace->file);
+	free(trace);
+}
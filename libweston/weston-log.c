@@ -36,6 +36,7 @@
 #include <assert.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/time.h>
@@ -178,7 +179,7 @@ weston_log_subscription_destroy_pending(struct weston_log_subscription *sub)
  *
  * @memberof weston_log_subscription
  */
-static void
+void
 weston_log_subscription_write(struct weston_log_subscription *sub,
 			      const char *data, size_t len)
 {
@@ -201,6 +202,11 @@ weston_log_subscription_vprintf(struct weston_log_subscription *sub,
 	if (!weston_log_scope_is_enabled(sub->source))
 		return;
 
+	if (sub->owner && sub->owner->vprintf) {
+		sub->owner->vprintf(sub->owner, NULL, fmt, ap);
+		return;
+	}
+
 	len = vasprintf(&str, fmt, ap);
 	if (len >= 0) {
 		weston_log_subscription_write(sub, str, len);
@@ -764,42 +770,126 @@ weston_log_scope_write(struct weston_log_scope *scope,
 		weston_log_subscription_write(sub, data, len);
 }
 
-/** Write a formatted string for a scope (varargs)
+/* Formats fmt after prefix, which may be NULL, into a newly allocated
+ * string. Returns its length, or -1 on failure. */
+static int
+weston_log_format(char **str, const char *prefix, const char *fmt, va_list ap)
+{
+	size_t prefix_len;
+	char *text;
+	int len;
+
+	len = vasprintf(&text, fmt, ap);
+	if (len < 0 || !prefix) {
+		*str = len < 0 ? NULL : text;
+		return len;
+	}
+
+	prefix_len = strlen(prefix);
+	*str = malloc(prefix_len + len + 1);
+	if (!*str) {
+		free(text);
+		return -1;
+	}
+
+	memcpy(*str, prefix, prefix_len);
+	memcpy(*str + prefix_len, text, len + 1);
+	free(text);
+
+	return prefix_len + len;
+}
+
+/** Write a prefixed, formatted string for a scope (varargs)
  *
  * \param scope The log scope to write for; may be NULL, in which case
  *              nothing will be written.
+ * \param prefix Text to write before the formatted string, as part of the
+ *               same message; may be NULL.
  * \param fmt Printf-style format string.
  * \param ap Formatting arguments.
  *
- * Writes to formatted string to all subscribed clients' streams.
- *
- * The behavioral details for each stream are the same as for
- * weston_debug_stream_write().
+ * Works like weston_log_scope_vprintf(), except that the prefix, say a
+ * timestamp, and the formatted string end up as a single message, and a
+ * single flight recorder entry.
  *
  * \memberof weston_log_scope
  */
 WL_EXPORT int
-weston_log_scope_vprintf(struct weston_log_scope *scope,
-			 const char *fmt, va_list ap)
+weston_log_scope_vprintf_prefixed(struct weston_log_scope *scope,
+				  const char *prefix,
+				  const char *fmt, va_list ap)
 {
 	static const char oom[] = "Out of memory";
-	char *str;
+	struct weston_log_subscription *sub;
+	int saved_errno = errno;
+	bool formatted = false;
+	char *str = NULL;
+	va_list aq;
 	int len = 0;
 
 	if (!weston_log_scope_is_enabled(scope))
 		return len;
 
-	len = vasprintf(&str, fmt, ap);
-	if (len >= 0) {
-		weston_log_scope_write(scope, str, len);
-		free(str);
-	} else {
-		weston_log_scope_write(scope, oom, sizeof oom - 1);
+	wl_list_for_each(sub, &scope->subscription_list, source_link) {
+		if (sub->owner && sub->owner->vprintf) {
+			va_copy(aq, ap);
+			errno = saved_errno;
+			sub->owner->vprintf(sub->owner, prefix, fmt, aq);
+			va_end(aq);
+			continue;
+		}
+
+		if (!formatted) {
+			va_copy(aq, ap);
+			errno = saved_errno;
+			len = weston_log_format(&str, prefix, fmt, aq);
+			va_end(aq);
+			formatted = true;
+		}
+
+		if (len >= 0)
+			weston_log_subscription_write(sub, str, len);
+		else
+			weston_log_subscription_write(sub, oom, sizeof oom - 1);
 	}
 
+	free(str);
+	errno = saved_errno;
+
 	return len;
 }
 
+/** Write a formatted string for a scope (varargs)
+ *
+ * \param scope The log scope to write for; may be NULL, in which case
+ *              nothing will be written.
+ * \param fmt Printf-style format string.
+ * \param ap Formatting arguments.
+ *
+ * Writes to formatted string to all subscribed clients' streams.
+ *
+ * The behavioral details for each stream are the same as for
+ * weston_debug_stream_write().
+ *
+ * The string is formatted once, and only if at least one of the subscribers
+ * needs the formatted text; subscribers that defer formatting get the format
+ * string and arguments instead. All subscribers see the errno of the caller,
+ * for %m.
+ *
+ * Returns the length of the formatted string, or 0 if the scope is not
+ * enabled or if only subscribers deferring the formatting are subscribed, in
+ * which case the string is never formatted. Callers that need the length
+ * must format the string themselves.
+ *
+ * \memberof weston_log_scope
+ */
+WL_EXPORT int
+weston_log_scope_vprintf(struct weston_log_scope *scope,
+			 const char *fmt, va_list ap)
+{
+	return weston_log_scope_vprintf_prefixed(scope, NULL, fmt, ap);
+}
+
 /** Write a formatted string for a scope
  *
  * \param scope The log scope to write for; may be NULL, in which case
@@ -77,6 +77,13 @@ theme_render_frame(struct theme *t,
 		   cairo_t *cr, int width, int height,
 		   const char *title, cairo_rectangle_int_t *title_rect,
 		   struct wl_list *buttons, uint32_t flags);
+void
+theme_render_frame_background(struct theme *t, cairo_t *cr,
+			      int width, int height, uint32_t flags);
+void
+theme_render_frame_title(struct theme *t, cairo_t *cr, int width,
+			 const char *title, cairo_rectangle_int_t *title_rect,
+			 uint32_t flags);
 
 enum theme_location {
 	THEME_LOCATION_INTERIOR = 0,
@@ -227,7 +234,27 @@ frame_double_touch_down(struct frame *frame, void *data, int32_t id,
 void
 frame_double_touch_up(struct frame *frame, void *data, int32_t id);
 
+/* Returns the THEME_FRAME_* flags the frame is rendered with */
+uint32_t
+frame_theme_flags(struct frame *frame);
+
+void
+frame_title_rect(struct frame *frame, int32_t *x, int32_t *y,
+		 int32_t *width, int32_t *height);
+
 void
 frame_repaint(struct frame *frame, cairo_t *cr);
 
+/* The pieces of frame_repaint(), for callers that cache some of them.
+ * Painting background, title and buttons in this order is equivalent to
+ * frame_repaint() except that FRAME_STATUS_REPAINT is left alone. */
+void
+frame_repaint_background(struct frame *frame, cairo_t *cr);
+
+void
+frame_repaint_title(struct frame *frame, cairo_t *cr);
+
+void
+frame_repaint_buttons(struct frame *frame, cairo_t *cr);
+
 #endif
@@ -994,28 +994,84 @@ frame_double_touch_up(struct frame *frame, void *data, int32_t id)
 	}
 }
 
-void
-frame_repaint(struct frame *frame, cairo_t *cr)
+uint32_t
+frame_theme_flags(struct frame *frame)
 {
-	struct frame_button *button;
 	uint32_t flags = 0;
 
-	frame_refresh_geometry(frame);
-
 	if (frame->flags & FRAME_FLAG_MAXIMIZED)
 		flags |= THEME_FRAME_MAXIMIZED;
 
 	if (frame->flags & FRAME_FLAG_ACTIVE)
 		flags |= THEME_FRAME_ACTIVE;
 
+	if (!frame->title && wl_list_empty(&frame->buttons))
+		flags |= THEME_FRAME_NO_TITLE;
+
+	return flags;
+}
+
+void
+frame_title_rect(struct frame *frame, int32_t *x, int32_t *y,
+		 int32_t *width, int32_t *height)
+{
+	frame_refresh_geometry(frame);
+
+	if (x)
+		*x = frame->title_rect.x;
+	if (y)
+		*y = frame->title_rect.y;
+	if (width)
+		*width = frame->title_rect.width;
+	if (height)
+		*height = frame->title_rect.height;
+}
+
+void
+frame_repaint_background(struct frame *frame, cairo_t *cr)
+{
+	frame_refresh_geometry(frame);
+
 	cairo_save(cr);
-	theme_render_frame(frame->theme, cr, frame->width, frame->height,
-			   frame->title, &frame->title_rect,
-			   &frame->buttons, flags);
+	theme_render_frame_background(frame->theme, cr,
+				      frame->width, frame->height,
+				      frame_theme_flags(frame));
+	cairo_restore(cr);
+}
+
+void
+frame_repaint_title(struct frame *frame, cairo_t *cr)
+{
+	uint32_t flags = frame_theme_flags(frame);
+
+	if (flags & THEME_FRAME_NO_TITLE)
+		return;
+
+	frame_refresh_geometry(frame);
+
+	cairo_save(cr);
+	theme_render_frame_title(frame->theme, cr, frame->width,
+				 frame->title, &frame->title_rect, flags);
 	cairo_restore(cr);
+}
+
+void
+frame_repaint_buttons(struct frame *frame, cairo_t *cr)
+{
+	struct frame_button *button;
+
+	frame_refresh_geometry(frame);
 
 	wl_list_for_each(button, &frame->buttons, link)
 		frame_button_repaint(button, cr);
+}
+
+void
+frame_repaint(struct frame *frame, cairo_t *cr)
+{
+	frame_repaint_background(frame, cr);
+	frame_repaint_title(frame, cr);
+	frame_repaint_buttons(frame, cr);
 
 	frame_status_clear(frame, FRAME_STATUS_REPAINT);
 }
@@ -0,0 +1,143 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "histogram.h"
+
+static unsigned int
+histogram_index(uint64_t value)
+{
+	unsigned int shift;
+
+	if (value < 2 * WESTON_HISTOGRAM_SUB)
+		return value;
+
+	shift = 63 - __builtin_clzll(value) - WESTON_HISTOGRAM_SUB_BITS;
+
+	return (shift + 1) * WESTON_HISTOGRAM_SUB +
+	       (unsigned int)(value >> shift) - WESTON_HISTOGRAM_SUB;
+}
+
+/* The largest value that falls into bucket i */
+static uint64_t
+histogram_bucket_max(unsigned int i)
+{
+	unsigned int shift;
+	uint64_t base;
+
+	if (i < 2 * WESTON_HISTOGRAM_SUB)
+		return i;
+
+	shift = i / WESTON_HISTOGRAM_SUB - 1;
+	base = WESTON_HISTOGRAM_SUB + i % WESTON_HISTOGRAM_SUB;
+
+	return ((base + 1) << shift) - 1;
+}
+
+void
+weston_histogram_init(struct weston_histogram *h)
+{
+	memset(h, 0, sizeof(*h));
+	h->min = UINT64_MAX;
+}
+
+void
+weston_histogram_record(struct weston_histogram *h, uint64_t value)
+{
+	h->buckets[histogram_index(value)]++;
+	h->count++;
+	h->sum += value;
+
+	if (value < h->min)
+		h->min = value;
+	if (value > h->max)
+		h->max = value;
+}
+
+/** Return the value below which fraction p (0..1) of the samples fall
+ *
+ * The result is the upper bound of the bucket holding the sample, clamped
+ * to the largest recorded value.
+ */
+uint64_t
+weston_histogram_percentile(const struct weston_histogram *h, double p)
+{
+	uint64_t rank, seen = 0;
+	unsigned int i;
+
+	if (h->count == 0)
+		return 0;
+
+	if (p <= 0.0)
+		return h->min;
+
+	rank = (uint64_t)(p * h->count + 0.5);
+	if (rank < 1)
+		rank = 1;
+	if (rank > h->count)
+		rank = h->count;
+
+	for (i = 0; i < WESTON_HISTOGRAM_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+
+	if (i == WESTON_HISTOGRAM_BUCKETS)
+		return h->max;
+
+	if (histogram_bucket_max(i) > h->max)
+		return h->max;
+
+	return histogram_bucket_max(i);
+}
+
+/** Print a one-line summary of a histogram of microsecond values */
+void
+weston_histogram_print_usec(const struct weston_histogram *h, FILE *fp,
+			    const char *prefix, const char *name)
+{
+	if (h->count == 0) {
+		fprintf(fp, "%s%s: no samples\n", prefix, name);
+		return;
+	}
+
+	fprintf(fp, "%s%s: n=%" PRIu64 " min=%.3f avg=%.3f p50=%.3f "
+		"p90=%.3f p99=%.3f p99.9=%.3f max=%.3f ms\n",
+		prefix, name, h->count,
+		h->min / 1000.0,
+		(double)h->sum / h->count / 1000.0,
+		weston_histogram_percentile(h, 0.50) / 1000.0,
+		weston_histogram_percentile(h, 0.90) / 1000.0,
+		weston_histogram_percentile(h, 0.99) / 1000.0,
+		weston_histogram_percentile(h, 0.999) / 1000.0,
+		h->max / 1000.0);
+}
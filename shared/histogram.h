@@ -0,0 +1,75 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_HISTOGRAM_H
+#define WESTON_HISTOGRAM_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A log-linear histogram in the spirit of HdrHistogram: values below
+ * 2 * WESTON_HISTOGRAM_SUB are counted exactly, larger values land in one of
+ * WESTON_HISTOGRAM_SUB linear sub-buckets per power of two, so the relative
+ * error stays below 1 / WESTON_HISTOGRAM_SUB over the whole range. Recording
+ * is a handful of integer operations and the storage is fixed, which makes
+ * it cheap enough to keep running all the time.
+ */
+
+#define WESTON_HISTOGRAM_SUB_BITS 3
+#define WESTON_HISTOGRAM_SUB (1 << WESTON_HISTOGRAM_SUB_BITS)
+#define WESTON_HISTOGRAM_BUCKETS ((65 - WESTON_HISTOGRAM_SUB_BITS) * \
+				  WESTON_HISTOGRAM_SUB)
+
+struct weston_histogram {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint32_t buckets[WESTON_HISTOGRAM_BUCKETS];
+};
+
+void
+weston_histogram_init(struct weston_histogram *h);
+
+void
+weston_histogram_record(struct weston_histogram *h, uint64_t value);
+
+uint64_t
+weston_histogram_percentile(const struct weston_histogram *h, double p);
+
+void
+weston_histogram_print_usec(const struct weston_histogram *h, FILE *fp,
+			    const char *prefix, const char *name);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* WESTON_HISTOGRAM_H */
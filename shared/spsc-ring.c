@@ -0,0 +1,90 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include "shared/spsc-ring.h"
+
+bool
+weston_spsc_ring_init(struct weston_spsc_ring *ring, uint32_t size)
+{
+	if (size == 0 || (size & (size - 1)) != 0)
+		return false;
+
+	ring->slots = calloc(size, sizeof ring->slots[0]);
+	if (!ring->slots)
+		return false;
+
+	ring->mask = size - 1;
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+
+	return true;
+}
+
+void
+weston_spsc_ring_release(struct weston_spsc_ring *ring)
+{
+	free(ring->slots);
+	ring->slots = NULL;
+}
+
+bool
+weston_spsc_ring_push(struct weston_spsc_ring *ring, void *item)
+{
+	uint32_t tail = atomic_load_explicit(&ring->tail,
+					     memory_order_relaxed);
+	uint32_t head = atomic_load_explicit(&ring->head,
+					     memory_order_acquire);
+
+	/* The indices wrap around, only their difference matters */
+	if (tail - head > ring->mask)
+		return false;
+
+	ring->slots[tail & ring->mask] = item;
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+	return true;
+}
+
+void *
+weston_spsc_ring_pop(struct weston_spsc_ring *ring)
+{
+	uint32_t head = atomic_load_explicit(&ring->head,
+					     memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(&ring->tail,
+					     memory_order_acquire);
+	void *item;
+
+	if (head == tail)
+		return NULL;
+
+	item = ring->slots[head & ring->mask];
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+	return item;
+}
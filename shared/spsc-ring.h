@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_SPSC_RING_H
+#define WESTON_SPSC_RING_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * A bounded queue of pointers between exactly one producer thread and one
+ * consumer thread. Neither side takes a lock: each owns one index and only
+ * reads the other's, with acquire/release ordering making the slot contents
+ * visible. Waking the consumer up is left to the caller, e.g. an eventfd.
+ */
+
+struct weston_spsc_ring {
+	void **slots;
+	uint32_t mask;
+	_Atomic uint32_t head; /* next slot to pop, owned by the consumer */
+	_Atomic uint32_t tail; /* next slot to push, owned by the producer */
+};
+
+/* size must be a power of two */
+bool
+weston_spsc_ring_init(struct weston_spsc_ring *ring, uint32_t size);
+
+void
+weston_spsc_ring_release(struct weston_spsc_ring *ring);
+
+/* Producer side. Returns false if the ring is full. */
+bool
+weston_spsc_ring_push(struct weston_spsc_ring *ring, void *item);
+
+/* Consumer side. Returns NULL if the ring is empty. */
+void *
+weston_spsc_ring_pop(struct weston_spsc_ring *ring);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* WESTON_SPSC_RING_H */
@@ -0,0 +1,206 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <libweston/zalloc.h>
+#include "shared/task-pool.h"
+#include "shared/helpers.h"
+
+struct weston_task_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+
+	pthread_t *threads;
+	unsigned n_threads;
+	bool quit;
+
+	/* the job being run, valid while remaining > 0 */
+	weston_task_func_t func;
+	void *data;
+	unsigned count;
+	unsigned next;
+	unsigned remaining;
+};
+
+/* Runs indices of the current job until none are left to claim. Called
+ * and returns with the lock held. */
+static void
+run_tasks_locked(struct weston_task_pool *pool)
+{
+	unsigned index;
+
+	while (pool->next < pool->count) {
+		index = pool->next++;
+
+		pthread_mutex_unlock(&pool->lock);
+		pool->func(pool->data, index);
+		pthread_mutex_lock(&pool->lock);
+
+		if (--pool->remaining == 0)
+			pthread_cond_signal(&pool->done_cond);
+	}
+}
+
+static void *
+worker_thread(void *data)
+{
+	struct weston_task_pool *pool = data;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (!pool->quit && pool->next >= pool->count)
+			pthread_cond_wait(&pool->work_cond, &pool->lock);
+		if (pool->quit)
+			break;
+
+		run_tasks_locked(pool);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+static void
+stop_threads(struct weston_task_pool *pool, unsigned n)
+{
+	unsigned i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < n; i++)
+		pthread_join(pool->threads[i], NULL);
+}
+
+struct weston_task_pool *
+weston_task_pool_create(unsigned threads)
+{
+	struct weston_task_pool *pool;
+	unsigned i;
+
+	pool = zalloc(sizeof *pool);
+	if (!pool)
+		return NULL;
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	if (threads > 0) {
+		pool->threads = calloc(threads, sizeof *pool->threads);
+		if (!pool->threads)
+			goto err;
+	}
+
+	for (i = 0; i < threads; i++) {
+		if (pthread_create(&pool->threads[i], NULL,
+				   worker_thread, pool) != 0) {
+			stop_threads(pool, i);
+			goto err;
+		}
+	}
+	pool->n_threads = threads;
+
+	return pool;
+
+err:
+	free(pool->threads);
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+
+	return NULL;
+}
+
+void
+weston_task_pool_destroy(struct weston_task_pool *pool)
+{
+	if (!pool)
+		return;
+
+	stop_threads(pool, pool->n_threads);
+
+	free(pool->threads);
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+}
+
+void
+weston_task_pool_run(struct weston_task_pool *pool, unsigned count,
+		     weston_task_func_t func, void *data)
+{
+	unsigned i;
+
+	if (count == 0)
+		return;
+
+	if (pool->n_threads == 0 || count == 1) {
+		for (i = 0; i < count; i++)
+			func(data, i);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+
+	pool->func = func;
+	pool->data = data;
+	pool->count = count;
+	pool->next = 0;
+	pool->remaining = count;
+	pthread_cond_broadcast(&pool->work_cond);
+
+	run_tasks_locked(pool);
+
+	while (pool->remaining > 0)
+		pthread_cond_wait(&pool->done_cond, &pool->lock);
+
+	pool->count = 0;
+	pool->next = 0;
+
+	pthread_mutex_unlock(&pool->lock);
+}
+
+unsigned
+weston_task_pool_default_threads(unsigned max)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (cpus <= 1)
+		return 0;
+
+	return MIN((unsigned long) cpus - 1, max);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_TASK_POOL_H
+#define WESTON_TASK_POOL_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A fixed set of worker threads to spread independent pieces of one job
+ * over, like the rectangles of a frame. weston_task_pool_run() calls the
+ * function once per index, on the workers and on the calling thread, and
+ * returns when all calls have returned. One thread at a time may run jobs
+ * on a pool.
+ */
+
+struct weston_task_pool;
+
+typedef void (*weston_task_func_t)(void *data, unsigned index);
+
+/* A pool with no threads runs everything on the caller */
+struct weston_task_pool *
+weston_task_pool_create(unsigned threads);
+
+void
+weston_task_pool_destroy(struct weston_task_pool *pool);
+
+void
+weston_task_pool_run(struct weston_task_pool *pool, unsigned count,
+		     weston_task_func_t func, void *data);
+
+/* Worker threads that leave one CPU to the caller, at most max */
+unsigned
+weston_task_pool_default_threads(unsigned max);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* WESTON_TASK_POOL_H */
@@ -0,0 +1,111 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_TIMELINE_BINARY_H
+#define WESTON_TIMELINE_BINARY_H
+
+#include <stdint.h>
+#include <strings.h>
+
+/*
+ * Wire format of the "timeline-binary" log scope.
+ *
+ * The stream is a sequence of fixed-size records. Point names and objects
+ * are interned: the first time a subscription sees a name, an output or a
+ * surface, a definition record carrying the string is written, and every
+ * later point refers to it by id only. A definition record is followed by
+ * ceil(len / sizeof(record)) records holding the raw string bytes.
+ *
+ * A point record has one aux field, holding the value that belongs to the
+ * lowest aux flag it has set. The values of any further aux flags are
+ * carried by aux records written right before the point, one per flag.
+ *
+ * All timestamps are CLOCK_MONOTONIC nanoseconds. The stream starts with a
+ * header record; weston-timeline-decode turns the stream back into the JSON
+ * format produced by the "timeline" scope (as read by wesgr).
+ */
+
+#define WESTON_TIMELINE_BINARY_MAGIC	0x57544c42	/* "WTLB" */
+#define WESTON_TIMELINE_BINARY_VERSION	2
+
+enum weston_timeline_binary_type {
+	WESTON_TIMELINE_BINARY_HEADER = 1,	/* id = version, aux = magic */
+	WESTON_TIMELINE_BINARY_NAME,		/* id, len + payload */
+	WESTON_TIMELINE_BINARY_OUTPUT,		/* id, len + payload */
+	WESTON_TIMELINE_BINARY_SURFACE,		/* id, surface = main surface id */
+	WESTON_TIMELINE_BINARY_POINT,		/* id = name id, t, output, surface */
+	WESTON_TIMELINE_BINARY_AUX,		/* flags = one aux flag, aux */
+};
+
+enum weston_timeline_binary_flags {
+	/* definition records: the string is NULL */
+	WESTON_TIMELINE_BINARY_FLAG_NULL = 1 << 0,
+	/* point records: aux holds a vblank timestamp */
+	WESTON_TIMELINE_BINARY_FLAG_VBLANK = 1 << 1,
+	/* point records: aux holds a GPU timestamp */
+	WESTON_TIMELINE_BINARY_FLAG_GPU = 1 << 2,
+	/* point records: aux holds an input event id */
+	WESTON_TIMELINE_BINARY_FLAG_INPUT = 1 << 3,
+};
+
+#define WESTON_TIMELINE_BINARY_AUX_FLAGS	\
+	(WESTON_TIMELINE_BINARY_FLAG_VBLANK |	\
+	 WESTON_TIMELINE_BINARY_FLAG_GPU |	\
+	 WESTON_TIMELINE_BINARY_FLAG_INPUT)
+
+struct weston_timeline_binary_record {
+	uint8_t type;		/* enum weston_timeline_binary_type */
+	uint8_t flags;		/* enum weston_timeline_binary_flags */
+	uint16_t len;		/* payload length in bytes, definitions only */
+	uint32_t id;
+	uint32_t output;	/* output id, 0 if none */
+	uint32_t surface;	/* surface id, 0 if none */
+	uint64_t t;
+	uint64_t aux;
+};
+
+/** Number of slots a reader needs to remember aux records, by flag bit */
+#define WESTON_TIMELINE_BINARY_AUX_SLOTS	8
+
+/** Look up the value of one aux flag of a point record
+ *
+ * \param point the point record, which must have flag set
+ * \param aux the values of the aux records read so far, indexed by the bit
+ * number of their flag
+ * \param flag one of WESTON_TIMELINE_BINARY_AUX_FLAGS
+ */
+static inline uint64_t
+weston_timeline_binary_aux(const struct weston_timeline_binary_record *point,
+			   const uint64_t *aux, unsigned int flag)
+{
+	unsigned int flags = point->flags & WESTON_TIMELINE_BINARY_AUX_FLAGS;
+
+	if ((flags & -flags) == flag)
+		return point->aux;
+
+	return aux[ffs(flag) - 1];
+}
+
+#endif /* WESTON_TIMELINE_BINARY_H */
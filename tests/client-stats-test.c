@@ -0,0 +1,117 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <pixman.h>
+
+#include "client-stats-damage.h"
+
+#include "shared/helpers.h"
+#include "zunitc/zunitc.h"
+
+ZUC_TEST(client_stats_test, damage_area_empty)
+{
+	pixman_region32_t damage;
+
+	pixman_region32_init(&damage);
+	ZUC_ASSERT_EQ(0, client_stats_damage_area(&damage, 100, 100));
+	pixman_region32_fini(&damage);
+}
+
+ZUC_TEST(client_stats_test, damage_area_inside)
+{
+	pixman_region32_t damage;
+
+	pixman_region32_init_rect(&damage, 10, 20, 30, 40);
+	ZUC_ASSERT_EQ(30 * 40, client_stats_damage_area(&damage, 100, 100));
+	pixman_region32_fini(&damage);
+}
+
+ZUC_TEST(client_stats_test, damage_area_overlap_counted_once)
+{
+	pixman_region32_t damage;
+
+	pixman_region32_init_rect(&damage, 0, 0, 20, 20);
+	pixman_region32_union_rect(&damage, &damage, 10, 10, 20, 20);
+	ZUC_ASSERT_EQ(2 * 20 * 20 - 10 * 10,
+		      client_stats_damage_area(&damage, 100, 100));
+	pixman_region32_fini(&damage);
+}
+
+ZUC_TEST(client_stats_test, damage_area_clipped)
+{
+	pixman_region32_t damage;
+
+	/* partly outside on every side */
+	pixman_region32_init_rect(&damage, -10, -10, 40, 40);
+	ZUC_ASSERT_EQ(20 * 20, client_stats_damage_area(&damage, 20, 20));
+	pixman_region32_fini(&damage);
+
+	/* entirely outside */
+	pixman_region32_init_rect(&damage, 200, 200, 10, 10);
+	ZUC_ASSERT_EQ(0, client_stats_damage_area(&damage, 100, 100));
+	pixman_region32_fini(&damage);
+}
+
+ZUC_TEST(client_stats_test, damage_area_whole_plane)
+{
+	pixman_region32_t damage;
+
+	/* what clients send to damage everything */
+	pixman_region32_init_rect(&damage, 0, 0, INT32_MAX, INT32_MAX);
+	ZUC_ASSERT_EQ(1920 * 1080,
+		      client_stats_damage_area(&damage, 1920, 1080));
+	pixman_region32_fini(&damage);
+}
+
+ZUC_TEST(client_stats_test, damage_area_no_size)
+{
+	pixman_region32_t damage;
+
+	pixman_region32_init_rect(&damage, 0, 0, 10, 10);
+	ZUC_ASSERT_EQ(0, client_stats_damage_area(&damage, 0, 0));
+	ZUC_ASSERT_EQ(0, client_stats_damage_area(&damage, -1, 10));
+	pixman_region32_fini(&damage);
+}
+
+ZUC_TEST(client_stats_test, upload_bytes)
+{
+	pixman_region32_t damage;
+
+	pixman_region32_init_rect(&damage, 0, 0, 10, 5);
+
+	/* 4 bytes per pixel, stride padded */
+	ZUC_ASSERT_EQ(10 * 5 * 4, client_stats_upload_bytes(&damage, 4 * 100 + 12,
+							      100, 1));
+	/* scale 2 uploads four times the buffer pixels */
+	ZUC_ASSERT_EQ(10 * 5 * 4 * 4,
+		      client_stats_upload_bytes(&damage, 4 * 100, 100, 2));
+	ZUC_ASSERT_EQ(0, client_stats_upload_bytes(&damage, 400, 0, 1));
+	ZUC_ASSERT_EQ(0, client_stats_upload_bytes(&damage, 400, 100, 0));
+
+	pixman_region32_fini(&damage);
+}
@@ -0,0 +1,252 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "shared/helpers.h"
+#include "shared/os-compatibility.h"
+#include "shared/timespec-util.h"
+
+/*
+ * Hands a selection to the clipboard of a seat, lets the source go away
+ * while it is still being read, and pastes from the clipboard: into a pipe
+ * that is read to the end, into a pipe whose reader goes away while the
+ * paste waits for the source, and into a file opened for appending.
+ */
+
+#define MIME_TYPE "text/plain;charset=utf-8"
+#define FIRST "first part, "
+#define SECOND "second part"
+
+/* A paste waiting for the source with nobody reading must not keep the
+ * compositor busy; the wait below is CHECK_IDLE_MS long. */
+#define CHECK_IDLE_MS 300
+#define MAX_BUSY_MS 100
+
+struct clipboard_test {
+	struct weston_compositor *compositor;
+	struct weston_seat seat;
+	struct weston_data_source source;
+	int source_fd;
+
+	int paste_fd;		/* read end of the paste read to the end */
+	int hangup_fd;		/* read end of the paste that goes away */
+	int file_fd;		/* the paste appended to a file */
+
+	struct timespec cpu_start;
+	struct wl_event_source *timer;
+	int step;
+};
+
+static void
+test_source_accept(struct weston_data_source *source,
+		   uint32_t serial, const char *mime_type)
+{
+}
+
+static void
+test_source_send(struct weston_data_source *source,
+		 const char *mime_type, int32_t fd)
+{
+	struct clipboard_test *test =
+		container_of(source, struct clipboard_test, source);
+
+	assert(strcmp(mime_type, MIME_TYPE) == 0);
+	assert(test->source_fd == -1);
+	test->source_fd = fd;
+}
+
+static void
+test_source_cancel(struct weston_data_source *source)
+{
+}
+
+static void
+write_all(int fd, const char *str)
+{
+	assert(write(fd, str, strlen(str)) == (ssize_t)strlen(str));
+}
+
+static void
+check_read(int fd, const char *expected)
+{
+	char buf[256];
+	ssize_t len;
+
+	len = read(fd, buf, sizeof(buf) - 1);
+	assert(len >= 0);
+	buf[len] = '\0';
+	assert(strcmp(buf, expected) == 0);
+}
+
+static void
+paste(struct clipboard_test *test, int fd)
+{
+	struct weston_data_source *selection = test->seat.selection_data_source;
+
+	assert(selection && selection != &test->source);
+	selection->send(selection, MIME_TYPE, fd);
+}
+
+static void
+start(struct clipboard_test *test)
+{
+	char **mime_type;
+	int p[2];
+
+	test->source_fd = -1;
+	test->source.accept = test_source_accept;
+	test->source.send = test_source_send;
+	test->source.cancel = test_source_cancel;
+	wl_signal_init(&test->source.destroy_signal);
+	wl_array_init(&test->source.mime_types);
+	mime_type = wl_array_add(&test->source.mime_types, sizeof *mime_type);
+	assert(mime_type);
+	*mime_type = strdup(MIME_TYPE);
+
+	/* the clipboard starts reading the selection right away */
+	weston_seat_set_selection(&test->seat, &test->source,
+				  wl_display_next_serial(test->compositor->wl_display));
+	assert(test->source_fd >= 0);
+	write_all(test->source_fd, FIRST);
+
+	/* the source client goes away, the clipboard takes over */
+	wl_signal_emit(&test->source.destroy_signal, &test->source);
+	free(*mime_type);
+	wl_array_release(&test->source.mime_types);
+
+	assert(pipe2(p, O_CLOEXEC | O_NONBLOCK) == 0);
+	test->paste_fd = p[0];
+	paste(test, p[1]);
+
+	assert(pipe2(p, O_CLOEXEC) == 0);
+	test->hangup_fd = p[0];
+	paste(test, p[1]);
+
+	test->file_fd = os_create_anonymous_file(0);
+	assert(test->file_fd >= 0);
+	assert(fcntl(test->file_fd, F_SETFL, O_APPEND) == 0);
+	paste(test, fcntl(test->file_fd, F_DUPFD_CLOEXEC, 0));
+
+	/* the paste fd shares the file description, whose other flags
+	 * must be kept */
+	assert(fcntl(test->file_fd, F_GETFL) & O_APPEND);
+}
+
+static void
+close_reader(struct clipboard_test *test)
+{
+	check_read(test->hangup_fd, FIRST);
+	close(test->hangup_fd);
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &test->cpu_start);
+}
+
+static void
+finish_source(struct clipboard_test *test)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	assert(timespec_sub_to_msec(&now, &test->cpu_start) < MAX_BUSY_MS);
+
+	write_all(test->source_fd, SECOND);
+	close(test->source_fd);
+}
+
+static void
+check_pastes(struct clipboard_test *test)
+{
+	char buf[256];
+
+	/* the clipboard closes the pipe once everything is pasted */
+	check_read(test->paste_fd, FIRST SECOND);
+	assert(read(test->paste_fd, buf, sizeof(buf)) == 0);
+	close(test->paste_fd);
+
+	assert(pread(test->file_fd, buf, sizeof(buf), 0) ==
+	       (ssize_t)strlen(FIRST SECOND));
+	assert(memcmp(buf, FIRST SECOND, strlen(FIRST SECOND)) == 0);
+	close(test->file_fd);
+}
+
+static int
+next_step(void *data)
+{
+	struct clipboard_test *test = data;
+
+	switch (test->step++) {
+	case 0:
+		start(test);
+		wl_event_source_timer_update(test->timer, 100);
+		break;
+	case 1:
+		close_reader(test);
+		wl_event_source_timer_update(test->timer, CHECK_IDLE_MS);
+		break;
+	case 2:
+		finish_source(test);
+		wl_event_source_timer_update(test->timer, 100);
+		break;
+	default:
+		check_pastes(test);
+		wl_event_source_remove(test->timer);
+		weston_seat_release(&test->seat);
+		weston_compositor_exit(test->compositor);
+		break;
+	}
+
+	return 0;
+}
+
+WL_EXPORT int
+wet_module_init(struct weston_compositor *compositor,
+		int *argc, char *argv[])
+{
+	static struct clipboard_test test;
+	struct wl_event_loop *loop;
+
+	test.compositor = compositor;
+	weston_seat_init(&test.seat, compositor, "clipboard-test");
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+	test.timer = wl_event_loop_add_timer(loop, next_step, &test);
+	assert(test.timer);
+	wl_event_source_timer_update(test.timer, 1);
+
+	return 0;
+}
@@ -0,0 +1,291 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+
+#include "shared/helpers.h"
+#include "zunitc/zunitc.h"
+
+/*
+ * Logs through a flight recorder with deferred formatting and checks that
+ * displaying the ring gives the same text as formatting right away.
+ */
+
+#define RING_SIZE (64 * 1024)
+
+static struct weston_log_scope *
+test_scope(void)
+{
+	static struct weston_log_scope *scope;
+	struct weston_log_context *log_ctx;
+	struct weston_log_subscriber *flight_rec;
+
+	if (scope)
+		return scope;
+
+	log_ctx = weston_log_ctx_compositor_create();
+	ZUC_ASSERTG_NOT_NULL(log_ctx, out);
+	scope = weston_compositor_add_log_scope(log_ctx, "test",
+						"flight recorder test",
+						NULL, NULL, NULL);
+	ZUC_ASSERTG_NOT_NULL(scope, out);
+	flight_rec = weston_log_subscriber_create_flight_rec_deferred(RING_SIZE);
+	ZUC_ASSERTG_NOT_NULL(flight_rec, out);
+	weston_log_subscribe(log_ctx, flight_rec, "test");
+
+out:
+	return scope;
+}
+
+/* The text the recorder displays for everything logged so far. */
+static char *
+display_ring(void)
+{
+	char *text = NULL;
+	size_t size = 0;
+	FILE *fp;
+
+	fp = open_memstream(&text, &size);
+	if (!fp)
+		return NULL;
+
+	weston_log_flight_recorder_display_buffer(fp);
+	fclose(fp);
+
+	return text;
+}
+
+/* Logs fmt after prefix, which may be NULL, and checks that the ring ends
+ * with what vsnprintf() gives. Nothing is formatted when logging, so no
+ * length is returned. */
+static void
+check_vformat(const char *prefix, const char *fmt, va_list ap)
+{
+	struct weston_log_scope *scope = test_scope();
+	char expected[1024];
+	size_t prefix_len = prefix ? strlen(prefix) : 0;
+	int saved_errno = errno;
+	va_list aq;
+	char *text;
+	size_t len;
+	int ret;
+
+	ZUC_ASSERT_NOT_NULL(scope);
+
+	if (prefix)
+		memcpy(expected, prefix, prefix_len);
+	va_copy(aq, ap);
+	vsnprintf(expected + prefix_len, sizeof(expected) - prefix_len, fmt, aq);
+	va_end(aq);
+
+	errno = saved_errno;
+	ret = weston_log_scope_vprintf_prefixed(scope, prefix, fmt, ap);
+	ZUC_ASSERT_EQ(0, ret);
+
+	text = display_ring();
+	ZUC_ASSERT_NOT_NULL(text);
+
+	len = strlen(text);
+	ZUC_ASSERTG_TRUE(len >= strlen(expected), out);
+	ZUC_ASSERTG_STREQ(expected, text + len - strlen(expected), out);
+
+out:
+	free(text);
+}
+
+static void
+check_format(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	check_vformat(NULL, fmt, ap);
+	va_end(ap);
+}
+
+static void
+check_prefixed(const char *prefix, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	check_vformat(prefix, fmt, ap);
+	va_end(ap);
+}
+
+ZUC_TEST(flight_rec_test, plain_text)
+{
+	check_format("no conversions\n");
+	check_format("100%%\n");
+}
+
+ZUC_TEST(flight_rec_test, signed_integers)
+{
+	check_format("%d %i\n", -42, 42);
+	check_format("%hd %hhd\n", (short)-3, (signed char)-4);
+	check_format("%ld\n", -1234567890L);
+	check_format("%lld\n", -1234567890123LL);
+	check_format("%jd\n", (intmax_t)INT64_MIN);
+	check_format("%zd %td\n", (ssize_t)-5, (ptrdiff_t)-6);
+}
+
+ZUC_TEST(flight_rec_test, unsigned_integers)
+{
+	check_format("%u %o %x %X\n", 42u, 8u, 0xbeefu, 0xbeefu);
+	check_format("%lu %lx\n", 4000000000UL, 0xdeadbeefUL);
+	check_format("%llu %llx\n", 18446744073709551615ULL, 0xcafeULL);
+	check_format("%ju\n", (uintmax_t)UINT64_MAX);
+	check_format("%zu %zx\n", (size_t)4096, (size_t)255);
+	check_format("%#x %#o\n", 255u, 8u);
+}
+
+ZUC_TEST(flight_rec_test, flags_and_width)
+{
+	check_format("[%5d] [%-5d] [%05d] [%+d] [% d]\n", 1, 2, 3, 4, 5);
+	check_format("[%*d] [%-*d]\n", 6, 7, 6, 8);
+	check_format("[%*d]\n", -6, 9);
+	check_format("[%.3d] [%*.*d]\n", 1, 8, 4, 2);
+}
+
+ZUC_TEST(flight_rec_test, characters)
+{
+	check_format("%c%c%c\n", 'a', 'b', 'c');
+	check_format("[%3c]\n", 'x');
+}
+
+ZUC_TEST(flight_rec_test, floating_point)
+{
+	check_format("%f %.2f %10.3f\n", 3.14159, 2.71828, -1.5);
+	check_format("%e %E\n", 12345.678, 0.000123);
+	check_format("%g %G\n", 0.0001, 1e20);
+	check_format("%a %A\n", 1.0, 0.5);
+	check_format("%Lf %Le\n", (long double)1.25, (long double)1e-10);
+	check_format("%*.*f\n", 9, 3, 1.0 / 3.0);
+}
+
+ZUC_TEST(flight_rec_test, strings)
+{
+	check_format("%s %s\n", "hello", "world");
+	check_format("[%10s] [%-10s]\n", "right", "left");
+	check_format("%s\n", "");
+}
+
+ZUC_TEST(flight_rec_test, string_precision)
+{
+	/* not NUL-terminated within the precision */
+	static const char unterminated[4] = { 'a', 'b', 'c', 'd' };
+
+	check_format("[%.3s]\n", "abcdef");
+	check_format("[%.*s]\n", 2, "abcdef");
+	check_format("[%.*s]\n", (int)sizeof(unterminated), unterminated);
+	check_format("[%.*s]\n", 0, unterminated);
+	check_format("[%.*s]\n", -1, "negative means none");
+	check_format("[%*.*s]\n", 8, 3, "abcdef");
+}
+
+ZUC_TEST(flight_rec_test, long_string_truncated)
+{
+	struct weston_log_scope *scope = test_scope();
+	char str[2048];
+	char *text;
+
+	ZUC_ASSERT_NOT_NULL(scope);
+
+	memset(str, 'x', sizeof(str) - 1);
+	str[sizeof(str) - 1] = '\0';
+	weston_log_scope_printf(scope, "[%s]\n", str);
+
+	text = display_ring();
+	ZUC_ASSERT_NOT_NULL(text);
+	ZUC_ASSERTG_NOT_NULL(strstr(text, "[xxx"), out);
+	ZUC_ASSERTG_NOT_NULL(strstr(text, "x]\n"), out);
+
+out:
+	free(text);
+}
+
+ZUC_TEST(flight_rec_test, errno_string)
+{
+	struct weston_log_scope *scope = test_scope();
+	char expected[256];
+	char *text;
+
+	ZUC_ASSERT_NOT_NULL(scope);
+
+	snprintf(expected, sizeof(expected), "failed: %s\n",
+		 strerror(ENOENT));
+
+	/* captured when logging, not when displaying */
+	errno = ENOENT;
+	weston_log_scope_printf(scope, "failed: %m\n");
+	errno = EBUSY;
+
+	text = display_ring();
+	ZUC_ASSERT_NOT_NULL(text);
+	ZUC_ASSERTG_NOT_NULL(strstr(text, expected), out);
+
+out:
+	free(text);
+}
+
+ZUC_TEST(flight_rec_test, pointer)
+{
+	int x;
+
+	check_format("%p\n", (void *)&x);
+	check_format("%p\n", NULL);
+}
+
+ZUC_TEST(flight_rec_test, positional_falls_back)
+{
+	/* formatted when logged */
+	check_format("%2$s %1$s\n", "world", "hello");
+}
+
+ZUC_TEST(flight_rec_test, mixed)
+{
+	check_format("%s: %d/%u %.1f%% %c %p\n", "mixed", -1, 2u, 99.5, 'z',
+		     (void *)0x1234);
+}
+
+ZUC_TEST(flight_rec_test, prefixed)
+{
+	check_prefixed("[12:34:56.789] ", "%s %d\n", "prefixed", 42);
+	check_prefixed("100% ", "literal prefix\n");
+	/* formatted when logged */
+	check_prefixed("[12:34:56.789] ", "%2$s %1$s\n", "world", "hello");
+}
@@ -0,0 +1,282 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <libweston/backend-headless.h>
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+#include "weston-test-client-helper.h"
+
+/* The socket path is passed in WESTON_TEST_FRAME_EXPORT_SOCKET, see
+ * tests/meson.build. */
+char *server_parameters = "--use-pixman --width=320 --height=240"
+	" --shell=weston-test-desktop-shell.so";
+
+struct export_connection {
+	int fd;
+	struct weston_headless_frame_export_buffers info;
+	void *data[WESTON_HEADLESS_FRAME_EXPORT_BUFFERS];
+};
+
+static void
+export_connect(struct export_connection *conn)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	char control[CMSG_SPACE(sizeof(int) *
+				WESTON_HEADLESS_FRAME_EXPORT_BUFFERS)];
+	struct iovec iov = {
+		.iov_base = &conn->info,
+		.iov_len = sizeof conn->info,
+	};
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control,
+		.msg_controllen = sizeof control,
+	};
+	struct cmsghdr *cmsg;
+	const char *path;
+	int fds[WESTON_HEADLESS_FRAME_EXPORT_BUFFERS];
+	unsigned int i;
+
+	path = getenv("WESTON_TEST_FRAME_EXPORT_SOCKET");
+	assert(path);
+	assert(strlen(path) < sizeof addr.sun_path);
+	strcpy(addr.sun_path, path);
+
+	conn->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	assert(conn->fd >= 0);
+	assert(connect(conn->fd, (struct sockaddr *) &addr, sizeof addr) == 0);
+
+	assert(recvmsg(conn->fd, &msg, MSG_CMSG_CLOEXEC) ==
+	       sizeof conn->info);
+	assert(conn->info.type == WESTON_HEADLESS_FRAME_EXPORT_TYPE_BUFFERS);
+	assert(conn->info.n_buffers == WESTON_HEADLESS_FRAME_EXPORT_BUFFERS);
+	assert(conn->info.width == 320);
+	assert(conn->info.height == 240);
+	assert(conn->info.seq_offset % sizeof(uint64_t) == 0);
+	assert(conn->info.seq_offset >=
+	       (uint64_t) conn->info.stride * conn->info.height);
+	assert(conn->info.seq_offset + sizeof(uint64_t) <= conn->info.size);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	assert(cmsg);
+	assert(cmsg->cmsg_level == SOL_SOCKET);
+	assert(cmsg->cmsg_type == SCM_RIGHTS);
+	assert(cmsg->cmsg_len == CMSG_LEN(sizeof fds));
+	memcpy(fds, CMSG_DATA(cmsg), sizeof fds);
+
+	for (i = 0; i < ARRAY_LENGTH(fds); i++) {
+		conn->data[i] = mmap(NULL, conn->info.size, PROT_READ,
+				     MAP_SHARED, fds[i], 0);
+		assert(conn->data[i] != MAP_FAILED);
+		close(fds[i]);
+	}
+}
+
+static void
+export_disconnect(struct export_connection *conn)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(conn->data); i++)
+		munmap(conn->data[i], conn->info.size);
+	close(conn->fd);
+}
+
+/* Reads all frame messages received so far and keeps the last max of
+ * them in order, returns how many were kept. */
+static int
+export_drain(struct export_connection *conn,
+	     struct weston_headless_frame_export_frame *frames, int max)
+{
+	struct weston_headless_frame_export_frame msg;
+	ssize_t len;
+	int n = 0;
+
+	for (;;) {
+		len = recv(conn->fd, &msg, sizeof msg, MSG_DONTWAIT);
+		if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		assert(len == sizeof msg);
+		assert(msg.type == WESTON_HEADLESS_FRAME_EXPORT_TYPE_FRAME);
+		assert(msg.buffer < WESTON_HEADLESS_FRAME_EXPORT_BUFFERS);
+		assert(msg.n_rects <= WESTON_HEADLESS_FRAME_EXPORT_MAX_RECTS);
+
+		if (n == max) {
+			memmove(frames, frames + 1, (max - 1) * sizeof *frames);
+			n--;
+		}
+		frames[n++] = msg;
+	}
+
+	return n;
+}
+
+static uint64_t
+export_buffer_seq(struct export_connection *conn, unsigned int index)
+{
+	_Atomic uint64_t *seq = (_Atomic uint64_t *)
+		((char *) conn->data[index] + conn->info.seq_offset);
+
+	return atomic_load_explicit(seq, memory_order_acquire);
+}
+
+/* The exported buffers are x8r8g8b8, the screenshot a8r8g8b8. Copies the
+ * frame out the way a reader has to, and compares the copy only if the
+ * compositor did not reuse the buffer meanwhile. */
+static bool
+export_frame_matches(struct export_connection *conn,
+		     const struct weston_headless_frame_export_frame *frame,
+		     pixman_image_t *image)
+{
+	uint32_t *shot = pixman_image_get_data(image);
+	int shot_stride = pixman_image_get_stride(image) / 4;
+	int stride = conn->info.stride / 4;
+	size_t size = (size_t) conn->info.stride * conn->info.height;
+	uint32_t *copy;
+	bool intact;
+	int x, y;
+
+	if (export_buffer_seq(conn, frame->buffer) != frame->seq)
+		return false;
+
+	copy = xmalloc(size);
+	memcpy(copy, conn->data[frame->buffer], size);
+	atomic_thread_fence(memory_order_acquire);
+	intact = export_buffer_seq(conn, frame->buffer) == frame->seq;
+
+	for (y = 0; y < conn->info.height && intact; y++)
+		for (x = 0; x < conn->info.width && intact; x++)
+			if ((copy[y * stride + x] & 0xffffff) !=
+			    (shot[y * shot_stride + x] & 0xffffff))
+				intact = false;
+
+	free(copy);
+
+	return intact;
+}
+
+static bool
+surface_matches(pixman_image_t *shot, const struct rectangle *where,
+		pixman_image_t *image)
+{
+	uint32_t *dst = pixman_image_get_data(shot);
+	int dst_stride = pixman_image_get_stride(shot) / 4;
+	uint32_t *src = pixman_image_get_data(image);
+	int src_stride = pixman_image_get_stride(image) / 4;
+	int x, y;
+
+	for (y = 0; y < where->height; y++)
+		for (x = 0; x < where->width; x++)
+			if (dst[(where->y + y) * dst_stride + where->x + x] !=
+			    src[y * src_stride + x])
+				return false;
+
+	return true;
+}
+
+static void
+fill_pattern(pixman_image_t *image)
+{
+	uint32_t *pixels = pixman_image_get_data(image);
+	int stride = pixman_image_get_stride(image) / 4;
+	int w = pixman_image_get_width(image);
+	int h = pixman_image_get_height(image);
+	int x, y;
+
+	for (y = 0; y < h; y++)
+		for (x = 0; x < w; x++)
+			pixels[y * stride + x] = 0xff000000 |
+						 (y * 2) << 16 |
+						 (x + y) << 8 | x * 2;
+}
+
+TEST(exported_frame_matches_rendered_output)
+{
+	struct weston_headless_frame_export_frame
+		frames[WESTON_HEADLESS_FRAME_EXPORT_BUFFERS - 1];
+	struct export_connection conn;
+	struct client *client;
+	struct buffer *buf;
+	struct buffer *screenshot;
+	struct rectangle where = { 40, 30, 100, 100 };
+	bool match = false;
+	int frame;
+	int n;
+
+	client = create_client_and_test_surface(where.x, where.y,
+						where.width, where.height);
+	assert(client);
+
+	/* Keep the cursor out of the way. */
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0, 0, 0);
+
+	export_connect(&conn);
+
+	buf = create_shm_buffer_a8r8g8b8(client, where.width, where.height);
+	fill_pattern(buf->image);
+	wl_surface_attach(client->surface->wl_surface, buf->proxy, 0, 0);
+	wl_surface_damage(client->surface->wl_surface, 0, 0,
+			  where.width, where.height);
+	frame_callback_set(client->surface->wl_surface, &frame);
+	wl_surface_commit(client->surface->wl_surface);
+	frame_callback_wait(client, &frame);
+
+	screenshot = capture_screenshot_of_output(client);
+	assert(screenshot);
+
+	/* The surface was composed where we put it, */
+	assert(surface_matches(screenshot->image, &where, buf->image));
+
+	/* and the frame announced last carries the very same pixels. Later
+	 * frames may have been sent already; any frame whose buffer was not
+	 * reused yet will do. */
+	n = export_drain(&conn, frames, ARRAY_LENGTH(frames));
+	assert(n > 0);
+	while (n-- > 0 && !match) {
+		testlog("checking exported frame %llu in buffer %u\n",
+			(unsigned long long) frames[n].seq, frames[n].buffer);
+		match = export_frame_matches(&conn, &frames[n],
+					     screenshot->image);
+	}
+	assert(match);
+
+	buffer_destroy(screenshot);
+	buffer_destroy(buf);
+	export_disconnect(&conn);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "shared/histogram.h"
+
+#include "shared/helpers.h"
+#include "zunitc/zunitc.h"
+
+ZUC_TEST(histogram_test, empty)
+{
+	struct weston_histogram h;
+
+	weston_histogram_init(&h);
+	ZUC_ASSERT_EQ(h.count, 0);
+	ZUC_ASSERT_EQ(weston_histogram_percentile(&h, 0.5), 0);
+}
+
+ZUC_TEST(histogram_test, small_values_exact)
+{
+	struct weston_histogram h;
+	uint64_t i;
+
+	weston_histogram_init(&h);
+	for (i = 1; i <= 10; i++)
+		weston_histogram_record(&h, i);
+
+	ZUC_ASSERT_EQ(h.count, 10);
+	ZUC_ASSERT_EQ(h.min, 1);
+	ZUC_ASSERT_EQ(h.max, 10);
+	ZUC_ASSERT_EQ(h.sum, 55);
+	ZUC_ASSERT_EQ(weston_histogram_percentile(&h, 0.5), 5);
+	ZUC_ASSERT_EQ(weston_histogram_percentile(&h, 0.9), 9);
+	ZUC_ASSERT_EQ(weston_histogram_percentile(&h, 1.0), 10);
+}
+
+ZUC_TEST(histogram_test, relative_error)
+{
+	uint64_t values[] = { 17, 100, 1000, 16667, 33333, 1000000,
+			      UINT64_MAX / 3 };
+	struct weston_histogram h;
+	uint64_t p;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(values); i++) {
+		weston_histogram_init(&h);
+		weston_histogram_record(&h, 0);
+		weston_histogram_record(&h, values[i]);
+		weston_histogram_record(&h, UINT64_MAX);
+
+		p = weston_histogram_percentile(&h, 0.5);
+		ZUC_ASSERT_TRUE(p >= values[i]);
+		ZUC_ASSERT_TRUE(p - values[i] <= values[i] / WESTON_HISTOGRAM_SUB);
+	}
+}
+
+ZUC_TEST(histogram_test, percentile_clamped_to_max)
+{
+	struct weston_histogram h;
+
+	weston_histogram_init(&h);
+	weston_histogram_record(&h, 1001);
+	ZUC_ASSERT_EQ(weston_histogram_percentile(&h, 0.99), 1001);
+	ZUC_ASSERT_EQ(weston_histogram_percentile(&h, 0.0), 1001);
+}
@@ -0,0 +1,334 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Microbenchmarks for per-frame hot paths
+ *
+ * Times the matrix helpers, vertex clipping and the region transforms
+ * that the compositor and renderers run for every view and every damage
+ * rectangle on every frame, with inputs shaped like a real scene:
+ * rotated and scaled views and fragmented damage. Each case prints one
+ * JSON line with ns/op and, on glibc, heap allocations/op.
+ *
+ * WESTON_BENCH_MIN_TIME_MS sets how long each case runs, default 200.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libweston/libweston.h>
+#include <libweston/matrix.h>
+#include "libweston-internal.h"
+#include "vertex-clipping.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "weston-bench-helper.h"
+
+#ifdef __GLIBC__
+/* Count heap allocations by interposing on the allocator; glibc exports
+ * its implementation under these names. */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static uint64_t alloc_count;
+
+void *
+malloc(size_t size)
+{
+	alloc_count++;
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+	alloc_count++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	alloc_count++;
+	return __libc_realloc(ptr, size);
+}
+
+#define HAVE_ALLOC_COUNT 1
+#else
+static uint64_t alloc_count;
+#define HAVE_ALLOC_COUNT 0
+#endif
+
+/* Keeps results alive so the compiler cannot drop the work. */
+static volatile float sink;
+
+struct hotpath_state {
+	struct weston_matrix view;
+	struct weston_matrix output;
+	struct weston_matrix scale;
+	struct weston_vector vector;
+	struct weston_view rotated_view;
+
+	struct polygon8 rotated_quad;
+	struct polygon8 axis_quad;
+	struct clip_context clip;
+
+	pixman_region32_t fragmented;
+	pixman_region32_t result;
+};
+
+struct hotpath_case {
+	const char *name;
+	void (*run)(struct hotpath_state *state);
+};
+
+static void
+run_matrix_multiply(struct hotpath_state *s)
+{
+	struct weston_matrix m = s->view;
+
+	weston_matrix_multiply(&m, &s->output);
+	sink = m.d[0];
+}
+
+static void
+run_matrix_transform(struct hotpath_state *s)
+{
+	struct weston_vector v = s->vector;
+
+	weston_matrix_transform(&s->view, &v);
+	sink = v.f[0];
+}
+
+static void
+run_matrix_invert(struct hotpath_state *s)
+{
+	struct weston_matrix inverse;
+
+	weston_matrix_invert(&inverse, &s->view);
+	sink = inverse.d[0];
+}
+
+static void
+run_clip_transformed(struct hotpath_state *s)
+{
+	float x[16], y[16];
+
+	sink = clip_transformed(&s->clip, &s->rotated_quad, x, y);
+}
+
+static void
+run_clip_simple(struct hotpath_state *s)
+{
+	float x[16], y[16];
+
+	sink = clip_simple(&s->clip, &s->axis_quad, x, y);
+}
+
+static void
+run_matrix_transform_region(struct hotpath_state *s)
+{
+	weston_matrix_transform_region(&s->result, &s->scale, &s->fragmented);
+	sink = pixman_region32_n_rects(&s->result);
+}
+
+static void
+run_transformed_region(struct hotpath_state *s)
+{
+	weston_transformed_region(1920, 1080, WL_OUTPUT_TRANSFORM_90, 2,
+				  &s->fragmented, &s->result);
+	sink = pixman_region32_n_rects(&s->result);
+}
+
+static void
+run_view_bbox(struct hotpath_state *s)
+{
+	static const pixman_box32_t box = { 0, 0, 640, 480 };
+
+	pixman_region32_fini(&s->result);
+	weston_view_compute_bbox(&s->rotated_view, &box, &s->result);
+	sink = pixman_region32_extents(&s->result)->x1;
+}
+
+static const struct hotpath_case cases[] = {
+	{ "weston_matrix_multiply", run_matrix_multiply },
+	{ "weston_matrix_transform", run_matrix_transform },
+	{ "weston_matrix_invert", run_matrix_invert },
+	{ "clip_transformed", run_clip_transformed },
+	{ "clip_simple", run_clip_simple },
+	{ "weston_matrix_transform_region", run_matrix_transform_region },
+	{ "weston_transformed_region", run_transformed_region },
+	{ "weston_view_compute_bbox", run_view_bbox },
+};
+
+static void
+state_init(struct hotpath_state *s)
+{
+	const float angle = 30.0f * M_PI / 180.0f;
+	float c = cosf(angle), sn = sinf(angle);
+	int i, x, y;
+
+	/* A view rotated by 30 degrees, scaled and moved, as a shell
+	 * animation or a rotated window would have. */
+	weston_matrix_init(&s->view);
+	weston_matrix_translate(&s->view, -320.0f, -240.0f, 0.0f);
+	weston_matrix_rotate_xy(&s->view, c, sn);
+	weston_matrix_scale(&s->view, 1.25f, 1.25f, 1.0f);
+	weston_matrix_translate(&s->view, 960.0f, 540.0f, 0.0f);
+
+	/* Global to output buffer coordinates of a scaled output. */
+	weston_matrix_init(&s->output);
+	weston_matrix_translate(&s->output, -1920.0f, 0.0f, 0.0f);
+	weston_matrix_scale(&s->output, 2.0f, 2.0f, 1.0f);
+
+	weston_matrix_init(&s->scale);
+	weston_matrix_scale(&s->scale, 1.5f, 1.5f, 1.0f);
+	weston_matrix_translate(&s->scale, 100.0f, 50.0f, 0.0f);
+
+	s->vector = (struct weston_vector) {{ 123.0f, 456.0f, 0.0f, 1.0f }};
+
+	/* Only the transform is used for the bounding box. */
+	memset(&s->rotated_view, 0, sizeof s->rotated_view);
+	s->rotated_view.transform.enabled = 1;
+	s->rotated_view.transform.matrix = s->view;
+
+	/* A 640x480 surface rotated by 30 degrees around its centre,
+	 * partially outside a 512x512 clip rectangle. */
+	s->rotated_quad.n = 4;
+	for (i = 0; i < 4; i++) {
+		float px = (i == 1 || i == 2) ? 320.0f : -320.0f;
+		float py = (i >= 2) ? 240.0f : -240.0f;
+
+		s->rotated_quad.x[i] = 256.0f + c * px - sn * py;
+		s->rotated_quad.y[i] = 256.0f + sn * px + c * py;
+	}
+
+	s->axis_quad.n = 4;
+	s->axis_quad.x[0] = -50.0f;	s->axis_quad.y[0] = -50.0f;
+	s->axis_quad.x[1] = 400.0f;	s->axis_quad.y[1] = -50.0f;
+	s->axis_quad.x[2] = 400.0f;	s->axis_quad.y[2] = 600.0f;
+	s->axis_quad.x[3] = -50.0f;	s->axis_quad.y[3] = 600.0f;
+
+	s->clip.clip.x1 = 0.0f;
+	s->clip.clip.y1 = 0.0f;
+	s->clip.clip.x2 = 512.0f;
+	s->clip.clip.y2 = 512.0f;
+
+	/* Damage like a terminal or text editor produces: a grid of
+	 * small disjoint glyph-sized rectangles. */
+	pixman_region32_init(&s->fragmented);
+	for (y = 0; y < 16; y++) {
+		for (x = 0; x < 16; x++) {
+			if ((x + y) % 3 == 0)
+				continue;
+			pixman_region32_union_rect(&s->fragmented,
+						   &s->fragmented,
+						   40 + x * 24, 30 + y * 40,
+						   10, 18);
+		}
+	}
+
+	pixman_region32_init(&s->result);
+}
+
+static void
+state_fini(struct hotpath_state *s)
+{
+	pixman_region32_fini(&s->fragmented);
+	pixman_region32_fini(&s->result);
+}
+
+static void
+run_case(struct hotpath_state *state, const struct hotpath_case *c,
+	 int64_t min_nsec, FILE *json)
+{
+	struct timespec begin, end;
+	uint64_t iterations = 0;
+	uint64_t batch = 64;
+	uint64_t allocs;
+	int64_t elapsed;
+	uint64_t i;
+
+	/* Warm up caches and the allocator. */
+	for (i = 0; i < 1000; i++)
+		c->run(state);
+
+	allocs = alloc_count;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	do {
+		for (i = 0; i < batch; i++)
+			c->run(state);
+		iterations += batch;
+		batch *= 2;
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		elapsed = timespec_sub_to_nsec(&end, &begin);
+	} while (elapsed < min_nsec);
+	allocs = alloc_count - allocs;
+
+	fprintf(json, "{ \"benchmark\": \"hotpath\", \"name\": \"%s\", "
+		"\"iterations\": %llu, \"ns_per_op\": %.2f, ",
+		c->name, (unsigned long long)iterations,
+		(double)elapsed / iterations);
+	if (HAVE_ALLOC_COUNT)
+		fprintf(json, "\"allocs_per_op\": %.3f }\n",
+			(double)allocs / iterations);
+	else
+		fprintf(json, "\"allocs_per_op\": null }\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct hotpath_state state;
+	int64_t min_nsec;
+	unsigned i;
+	FILE *json;
+
+	min_nsec = bench_env_int("WESTON_BENCH_MIN_TIME_MS", 200) * 1000000LL;
+
+	state_init(&state);
+	json = bench_json_open();
+
+	for (i = 0; i < ARRAY_LENGTH(cases); i++) {
+		if (argc > 1 && strcmp(argv[1], cases[i].name) != 0)
+			continue;
+
+		run_case(&state, &cases[i], min_nsec, json);
+	}
+
+	bench_json_close(json);
+	state_fini(&state);
+
+	return 0;
+}
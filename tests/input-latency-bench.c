@@ -0,0 +1,380 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Input-to-present latency benchmark
+ *
+ * Injects pointer, keyboard or touch events through the weston_test
+ * protocol, timestamped with the presentation clock. As soon as the
+ * event arrives, the client redraws its surface and commits, and the
+ * presentation feedback tells when that frame hit the screen. The event
+ * timestamp to presentation timestamp distribution is reported as JSON,
+ * split into event-to-client and commit-to-present parts.
+ *
+ * Injection times are spread over the refresh cycle so that the result
+ * covers the whole repaint window rather than one phase of it.
+ */
+
+#include "config.h"
+
+#include <linux/input.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+#include "shared/timespec-util.h"
+#include "weston-test-client-helper.h"
+#include "weston-bench-helper.h"
+#include "presentation-time-client-protocol.h"
+
+enum latency_input {
+	LATENCY_INPUT_POINTER,
+	LATENCY_INPUT_KEYBOARD,
+	LATENCY_INPUT_TOUCH,
+};
+
+struct latency_config {
+	const char *name;
+	enum latency_input input;
+};
+
+static const struct latency_config configs[] = {
+	{ "pointer", LATENCY_INPUT_POINTER },
+	{ "keyboard", LATENCY_INPUT_KEYBOARD },
+	{ "touch", LATENCY_INPUT_TOUCH },
+};
+
+/* The compositor may read a SHM buffer until it releases it, so the
+ * surface alternates between two buffers and only redraws a released
+ * one. */
+struct latency_buffer {
+	struct buffer *buffer;
+	bool busy;
+};
+
+struct latency_bench {
+	struct client *client;
+	struct latency_buffer buffers[2];
+	struct wp_presentation *presentation;
+	clockid_t clock_id;
+
+	struct timespec presented;
+	bool feedback_done;
+	bool feedback_discarded;
+};
+
+static void
+presentation_clock_id(void *data, struct wp_presentation *presentation,
+		      uint32_t clk_id)
+{
+	struct latency_bench *bench = data;
+
+	bench->clock_id = clk_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+	presentation_clock_id
+};
+
+static void
+feedback_sync_output(void *data, struct wp_presentation_feedback *fb,
+		     struct wl_output *output)
+{
+}
+
+static void
+feedback_presented(void *data, struct wp_presentation_feedback *fb,
+		   uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+		   uint32_t refresh_nsec, uint32_t seq_hi, uint32_t seq_lo,
+		   uint32_t flags)
+{
+	struct latency_bench *bench = data;
+
+	timespec_from_proto(&bench->presented, tv_sec_hi, tv_sec_lo, tv_nsec);
+	bench->feedback_done = true;
+	wp_presentation_feedback_destroy(fb);
+}
+
+static void
+feedback_discarded(void *data, struct wp_presentation_feedback *fb)
+{
+	struct latency_bench *bench = data;
+
+	bench->feedback_discarded = true;
+	bench->feedback_done = true;
+	wp_presentation_feedback_destroy(fb);
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+	feedback_sync_output,
+	feedback_presented,
+	feedback_discarded
+};
+
+static struct wp_presentation *
+get_presentation(struct client *client)
+{
+	struct global *g;
+
+	wl_list_for_each(g, &client->global_list, link) {
+		if (strcmp(g->interface, wp_presentation_interface.name) == 0)
+			return wl_registry_bind(client->wl_registry, g->name,
+						&wp_presentation_interface, 1);
+	}
+
+	assert(0 && "no wp_presentation found");
+	return NULL;
+}
+
+static void
+inject_event(struct latency_bench *bench, enum latency_input input,
+	     int i, const struct timespec *time)
+{
+	struct weston_test *wt = bench->client->test->weston_test;
+	uint32_t tv_sec_hi, tv_sec_lo, tv_nsec;
+
+	timespec_to_proto(time, &tv_sec_hi, &tv_sec_lo, &tv_nsec);
+
+	switch (input) {
+	case LATENCY_INPUT_POINTER:
+		weston_test_move_pointer(wt, tv_sec_hi, tv_sec_lo, tv_nsec,
+					 10 + i % 50, 10 + i % 50);
+		break;
+	case LATENCY_INPUT_KEYBOARD:
+		weston_test_send_key(wt, tv_sec_hi, tv_sec_lo, tv_nsec,
+				     KEY_A, i % 2 ?
+				     WL_KEYBOARD_KEY_STATE_RELEASED :
+				     WL_KEYBOARD_KEY_STATE_PRESSED);
+		break;
+	case LATENCY_INPUT_TOUCH:
+		weston_test_send_touch(wt, tv_sec_hi, tv_sec_lo, tv_nsec, 1,
+				       wl_fixed_from_int(10 + i % 50),
+				       wl_fixed_from_int(10 + i % 50),
+				       WL_TOUCH_MOTION);
+		break;
+	}
+
+	assert(wl_display_flush(bench->client->wl_display) >= 0);
+}
+
+static bool
+event_arrived(struct latency_bench *bench, enum latency_input input,
+	      const struct timespec *time)
+{
+	struct input *in = bench->client->input;
+	uint32_t msec = timespec_to_msec(time);
+
+	switch (input) {
+	case LATENCY_INPUT_POINTER:
+		return in->pointer->motion_time_msec == msec;
+	case LATENCY_INPUT_KEYBOARD:
+		return in->keyboard->key_time_msec == msec;
+	case LATENCY_INPUT_TOUCH:
+		return in->touch->motion_time_msec == msec;
+	}
+
+	return false;
+}
+
+static void
+buffer_release(void *data, struct wl_buffer *buffer)
+{
+	struct latency_buffer *lb = data;
+
+	lb->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	buffer_release
+};
+
+static void
+init_buffers(struct latency_bench *bench)
+{
+	struct surface *surface = bench->client->surface;
+	unsigned i;
+
+	/* The test surface buffer has been attached already. */
+	bench->buffers[0].buffer = surface->buffer;
+	bench->buffers[0].busy = true;
+	bench->buffers[1].buffer =
+		create_shm_buffer_a8r8g8b8(bench->client, surface->width,
+					   surface->height);
+	for (i = 0; i < ARRAY_LENGTH(bench->buffers); i++)
+		wl_buffer_add_listener(bench->buffers[i].buffer->proxy,
+				       &buffer_listener, &bench->buffers[i]);
+}
+
+static struct latency_buffer *
+get_buffer(struct latency_bench *bench)
+{
+	unsigned i;
+
+	for (;;) {
+		for (i = 0; i < ARRAY_LENGTH(bench->buffers); i++)
+			if (!bench->buffers[i].busy)
+				return &bench->buffers[i];
+
+		assert(wl_display_dispatch(bench->client->wl_display) >= 0);
+	}
+}
+
+static void
+redraw_and_commit(struct latency_bench *bench, int i)
+{
+	struct surface *surface = bench->client->surface;
+	struct latency_buffer *lb = get_buffer(bench);
+	struct wp_presentation_feedback *fb;
+	pixman_color_t color = {
+		.red = i % 2 ? 0xffff : 0,
+		.green = 0x8000,
+		.blue = i % 2 ? 0 : 0xffff,
+		.alpha = 0xffff,
+	};
+	pixman_image_t *solid;
+
+	solid = pixman_image_create_solid_fill(&color);
+	pixman_image_composite32(PIXMAN_OP_SRC, solid, NULL,
+				 lb->buffer->image, 0, 0, 0, 0, 0, 0,
+				 surface->width, surface->height);
+	pixman_image_unref(solid);
+
+	bench->feedback_done = false;
+	bench->feedback_discarded = false;
+
+	lb->busy = true;
+	wl_surface_attach(surface->wl_surface, lb->buffer->proxy, 0, 0);
+	wl_surface_damage(surface->wl_surface, 0, 0,
+			  surface->width, surface->height);
+	fb = wp_presentation_feedback(bench->presentation, surface->wl_surface);
+	wp_presentation_feedback_add_listener(fb, &feedback_listener, bench);
+	wl_surface_commit(surface->wl_surface);
+}
+
+/* The presentation clock may be CLOCK_MONOTONIC_RAW, which cannot be
+ * slept on, so pacing uses CLOCK_MONOTONIC. */
+static void
+sleep_until(const struct timespec *deadline)
+{
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+			       deadline, NULL) != 0)
+		;
+}
+
+TEST_P(input_latency_benchmark, configs)
+{
+	const struct latency_config *config = data;
+	struct latency_bench bench = { .clock_id = CLOCK_MONOTONIC };
+	struct bench_samples event_to_present;
+	struct bench_samples event_to_client;
+	struct bench_samples commit_to_present;
+	struct timespec inject, received, committed, next;
+	unsigned discarded = 0;
+	int samples, i;
+	FILE *json;
+
+	samples = bench_env_int("WESTON_BENCH_SAMPLES", 200);
+	assert(samples > 0);
+
+	bench.client = create_client_and_test_surface(0, 0, 100, 100);
+	assert(bench.client);
+	init_buffers(&bench);
+	bench.presentation = get_presentation(bench.client);
+	wp_presentation_add_listener(bench.presentation,
+				     &presentation_listener, &bench);
+
+	weston_test_activate_surface(bench.client->test->weston_test,
+				     bench.client->surface->wl_surface);
+	client_roundtrip(bench.client);
+
+	if (config->input == LATENCY_INPUT_TOUCH) {
+		weston_test_send_touch(bench.client->test->weston_test,
+				       0, 0, 0, 1, wl_fixed_from_int(10),
+				       wl_fixed_from_int(10), WL_TOUCH_DOWN);
+		client_roundtrip(bench.client);
+	}
+
+	bench_samples_init(&event_to_present);
+	bench_samples_init(&event_to_client);
+	bench_samples_init(&commit_to_present);
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	for (i = 0; i < samples; i++) {
+		/* Step by a period that is not a divisor of the refresh
+		 * period, so that injections sweep the repaint cycle. */
+		timespec_add_nsec(&next, &next, 23700000);
+		sleep_until(&next);
+
+		clock_gettime(bench.clock_id, &inject);
+		inject_event(&bench, config->input, i, &inject);
+
+		while (!event_arrived(&bench, config->input, &inject))
+			assert(wl_display_dispatch(bench.client->wl_display) >= 0);
+		clock_gettime(bench.clock_id, &received);
+
+		redraw_and_commit(&bench, i);
+		clock_gettime(bench.clock_id, &committed);
+
+		while (!bench.feedback_done)
+			assert(wl_display_dispatch(bench.client->wl_display) >= 0);
+
+		if (bench.feedback_discarded) {
+			discarded++;
+			continue;
+		}
+
+		bench_samples_add(&event_to_client,
+				  timespec_sub_to_nsec(&received, &inject));
+		bench_samples_add(&commit_to_present,
+				  timespec_sub_to_nsec(&bench.presented,
+						       &committed));
+		bench_samples_add(&event_to_present,
+				  timespec_sub_to_nsec(&bench.presented,
+						       &inject));
+	}
+
+	json = bench_json_open();
+	fprintf(json, "{ \"benchmark\": \"input-latency\", \"input\": \"%s\", "
+		"\"samples\": %d, \"discarded\": %u, ",
+		config->name, samples, discarded);
+	bench_json_print_samples(json, "event_to_present", &event_to_present);
+	fprintf(json, ", ");
+	bench_json_print_samples(json, "event_to_client", &event_to_client);
+	fprintf(json, ", ");
+	bench_json_print_samples(json, "commit_to_present",
+				 &commit_to_present);
+	fprintf(json, " }\n");
+	bench_json_close(json);
+
+	bench_samples_release(&event_to_present);
+	bench_samples_release(&event_to_client);
+	bench_samples_release(&commit_to_present);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <linux/input.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "shared/timespec-util.h"
+#include "weston-test-client-helper.h"
+
+/* Matches key-repeat.ini */
+#define REPEAT_RATE 50
+#define REPEAT_DELAY_MSEC 100
+
+static const struct timespec t1 = { .tv_sec = 1, .tv_nsec = 1000001 };
+static const struct timespec t2 = { .tv_sec = 2, .tv_nsec = 2000001 };
+
+static struct client *
+create_client_with_keyboard_focus(void)
+{
+	struct client *cl = create_client_and_test_surface(10, 10, 1, 1);
+	assert(cl);
+
+	weston_test_activate_surface(cl->test->weston_test,
+				     cl->surface->wl_surface);
+	client_roundtrip(cl);
+
+	return cl;
+}
+
+static void
+send_key(struct client *client, const struct timespec *time,
+	 uint32_t key, uint32_t state)
+{
+	uint32_t tv_sec_hi, tv_sec_lo, tv_nsec;
+
+	timespec_to_proto(time, &tv_sec_hi, &tv_sec_lo, &tv_nsec);
+	weston_test_send_key(client->test->weston_test, tv_sec_hi, tv_sec_lo,
+			     tv_nsec, key, state);
+	client_roundtrip(client);
+}
+
+TEST(client_repeat_is_disabled)
+{
+	struct client *client = create_client_with_keyboard_focus();
+	struct keyboard *keyboard = client->input->keyboard;
+
+	assert(keyboard->repeat_info.rate == 0);
+	assert(keyboard->repeat_info.delay == REPEAT_DELAY_MSEC);
+}
+
+TEST(compositor_repeats_held_key)
+{
+	struct client *client = create_client_with_keyboard_focus();
+	struct keyboard *keyboard = client->input->keyboard;
+	uint32_t first_repeat = timespec_to_msec(&t1) + REPEAT_DELAY_MSEC;
+	struct timespec pause = { .tv_sec = 0, .tv_nsec = 200000000 };
+
+	send_key(client, &t1, KEY_A, WL_KEYBOARD_KEY_STATE_PRESSED);
+	assert(keyboard->key_time_msec == timespec_to_msec(&t1));
+
+	/* Repeats are timestamped on the schedule from the press */
+	while (keyboard->key_time_msec == timespec_to_msec(&t1))
+		assert(wl_display_dispatch(client->wl_display) >= 0);
+
+	assert(keyboard->key == KEY_A);
+	assert(keyboard->state == WL_KEYBOARD_KEY_STATE_PRESSED);
+	assert(keyboard->key_time_msec >= first_repeat);
+	assert((keyboard->key_time_msec - first_repeat) %
+	       (1000 / REPEAT_RATE) == 0);
+
+	send_key(client, &t2, KEY_A, WL_KEYBOARD_KEY_STATE_RELEASED);
+	assert(keyboard->state == WL_KEYBOARD_KEY_STATE_RELEASED);
+
+	/* Nothing repeats after the release */
+	nanosleep(&pause, NULL);
+	client_roundtrip(client);
+	assert(keyboard->state == WL_KEYBOARD_KEY_STATE_RELEASED);
+	assert(keyboard->key_time_msec == timespec_to_msec(&t2));
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Keyboard delivery benchmark
+ *
+ * Runs the wl_keyboard delivery path of an in-process compositor against
+ * a client that has many wl_keyboard objects, like a toolkit plus an
+ * input method plus embedded web views would. Each operation is one
+ * dispatch worth of typing with a shifted letter, delivered either event
+ * by event or as a batch, see weston_keyboard_begin_batch(). Each case
+ * prints one JSON line with ns per dispatch and per key.
+ *
+ * WESTON_BENCH_MIN_TIME_MS sets how long each case runs, default 200.
+ * WESTON_BENCH_KEYBOARDS sets the wl_keyboard objects of the client,
+ * default 50.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libweston/libweston.h>
+#include "backend.h"
+#include "libweston-internal.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "weston-bench-helper.h"
+
+struct keyboard_state {
+	struct wl_display *display;
+	struct weston_compositor *compositor;
+	struct weston_seat seat;
+	struct weston_keyboard *keyboard;
+	struct weston_surface *surface;
+	struct wl_client *client;
+	int client_fd;
+};
+
+struct keyboard_case {
+	const char *name;
+	bool batch;
+};
+
+static const struct keyboard_case cases[] = {
+	{ "unbatched", false },
+	{ "batched", true },
+};
+
+/* Shift+A, then B and C: modifier updates between keys, as in typing */
+static const struct {
+	uint32_t key;
+	enum wl_keyboard_key_state state;
+} burst[] = {
+	{ KEY_LEFTSHIFT, WL_KEYBOARD_KEY_STATE_PRESSED },
+	{ KEY_A, WL_KEYBOARD_KEY_STATE_PRESSED },
+	{ KEY_A, WL_KEYBOARD_KEY_STATE_RELEASED },
+	{ KEY_LEFTSHIFT, WL_KEYBOARD_KEY_STATE_RELEASED },
+	{ KEY_B, WL_KEYBOARD_KEY_STATE_PRESSED },
+	{ KEY_B, WL_KEYBOARD_KEY_STATE_RELEASED },
+	{ KEY_C, WL_KEYBOARD_KEY_STATE_PRESSED },
+	{ KEY_C, WL_KEYBOARD_KEY_STATE_RELEASED },
+};
+
+static void
+unbind_resource(struct wl_resource *resource)
+{
+	wl_list_remove(wl_resource_get_link(resource));
+}
+
+/* The client never reads its socket, so empty it after each dispatch
+ * like a well-behaved client would before the buffers fill up. */
+static void
+drain_client(struct keyboard_state *s)
+{
+	char buf[16384];
+
+	wl_client_flush(s->client);
+	while (read(s->client_fd, buf, sizeof buf) > 0)
+		;
+}
+
+static void
+run_dispatch(struct keyboard_state *s, bool batch)
+{
+	struct timespec time;
+	unsigned i;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	if (batch)
+		weston_keyboard_begin_batch(s->keyboard);
+
+	for (i = 0; i < ARRAY_LENGTH(burst); i++)
+		notify_key(&s->seat, &time, burst[i].key, burst[i].state,
+			   STATE_UPDATE_AUTOMATIC);
+
+	if (batch)
+		weston_keyboard_end_batch(s->keyboard);
+
+	drain_client(s);
+}
+
+static int
+state_init(struct keyboard_state *s, int keyboards)
+{
+	struct weston_log_context *log_ctx;
+	struct wl_resource *resource;
+	int fds[2];
+	int i;
+
+	memset(s, 0, sizeof *s);
+
+	s->display = wl_display_create();
+	log_ctx = weston_log_ctx_compositor_create();
+	if (!s->display || !log_ctx)
+		return -1;
+
+	s->compositor = weston_compositor_create(s->display, log_ctx, NULL);
+	if (!s->compositor)
+		return -1;
+
+	if (weston_compositor_set_xkb_rule_names(s->compositor, NULL) < 0)
+		return -1;
+
+	weston_seat_init(&s->seat, s->compositor, "default");
+	if (weston_seat_init_keyboard(&s->seat, NULL) < 0)
+		return -1;
+	s->keyboard = weston_seat_get_keyboard(&s->seat);
+
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+		return -1;
+	s->client = wl_client_create(s->display, fds[0]);
+	s->client_fd = fds[1];
+	if (!s->client ||
+	    fcntl(s->client_fd, F_SETFL, O_NONBLOCK) < 0)
+		return -1;
+
+	for (i = 0; i < keyboards; i++) {
+		resource = wl_resource_create(s->client, &wl_keyboard_interface,
+					      7, 0);
+		if (!resource)
+			return -1;
+		wl_resource_set_implementation(resource, NULL, NULL,
+					       unbind_resource);
+		wl_list_insert(&s->keyboard->resource_list,
+			       wl_resource_get_link(resource));
+	}
+
+	s->surface = weston_surface_create(s->compositor);
+	if (!s->surface)
+		return -1;
+	s->surface->resource = wl_resource_create(s->client,
+						  &wl_surface_interface, 4, 0);
+	if (!s->surface->resource)
+		return -1;
+
+	weston_keyboard_set_focus(s->keyboard, s->surface);
+	drain_client(s);
+
+	return 0;
+}
+
+static void
+run_case(struct keyboard_state *state, const struct keyboard_case *c,
+	 int keyboards, int64_t min_nsec, FILE *json)
+{
+	struct timespec begin, end;
+	uint64_t iterations = 0;
+	uint64_t batch = 64;
+	int64_t elapsed;
+	uint64_t i;
+
+	/* Warm up caches and the connection buffers. */
+	for (i = 0; i < 100; i++)
+		run_dispatch(state, c->batch);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	do {
+		for (i = 0; i < batch; i++)
+			run_dispatch(state, c->batch);
+		iterations += batch;
+		batch *= 2;
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		elapsed = timespec_sub_to_nsec(&end, &begin);
+	} while (elapsed < min_nsec);
+
+	fprintf(json, "{ \"benchmark\": \"keyboard\", \"name\": \"%s\", "
+		"\"keyboards\": %d, \"iterations\": %llu, "
+		"\"ns_per_dispatch\": %.2f, \"ns_per_key\": %.2f }\n",
+		c->name, keyboards, (unsigned long long)iterations,
+		(double)elapsed / iterations,
+		(double)elapsed / (iterations * ARRAY_LENGTH(burst)));
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct keyboard_state state;
+	int64_t min_nsec;
+	int keyboards;
+	unsigned i;
+	FILE *json;
+
+	min_nsec = bench_env_int("WESTON_BENCH_MIN_TIME_MS", 200) * 1000000LL;
+	keyboards = bench_env_int("WESTON_BENCH_KEYBOARDS", 50);
+
+	/* The compositor is not torn down, it has no backend to do it. */
+	if (state_init(&state, keyboards) < 0) {
+		fprintf(stderr, "failed to set up the keyboard: %s\n",
+			strerror(errno));
+		return 77;
+	}
+
+	json = bench_json_open();
+
+	for (i = 0; i < ARRAY_LENGTH(cases); i++) {
+		if (argc > 1 && strcmp(argv[1], cases[i].name) != 0)
+			continue;
+
+		run_case(&state, &cases[i], keyboards, min_nsec, json);
+	}
+
+	bench_json_close(json);
+
+	weston_keyboard_set_focus(state.keyboard, NULL);
+	wl_client_destroy(state.client);
+	close(state.client_fd);
+
+	return 0;
+}
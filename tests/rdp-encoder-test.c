@@ -0,0 +1,423 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <wayland-server-core.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/rfx.h>
+#include <winpr/stream.h>
+
+#include "libweston/backend-rdp/rdp-encoder.h"
+#include "shared/helpers.h"
+#include "zunitc/zunitc.h"
+
+#define JOB_COUNT 16
+
+struct batch {
+	_Atomic unsigned calls[JOB_COUNT];
+	int done;
+};
+
+static void
+count_job(void *data, unsigned index)
+{
+	struct batch *batch = data;
+
+	atomic_fetch_add(&batch->calls[index], 1);
+}
+
+static void
+batch_done(void *data)
+{
+	struct batch *batch = data;
+
+	batch->done++;
+}
+
+static void
+check_batch(struct batch *batch)
+{
+	unsigned i;
+
+	for (i = 0; i < JOB_COUNT; i++)
+		ZUC_ASSERT_EQ(atomic_load(&batch->calls[i]), 1);
+}
+
+ZUC_TEST(rdp_encoder_test, done_on_event_loop)
+{
+	struct wl_event_loop *loop = wl_event_loop_create();
+	struct rdp_encoder *encoder;
+	struct batch batch = { 0 };
+
+	encoder = rdp_encoder_create(loop, 2);
+	ZUC_ASSERT_NOT_NULL(encoder);
+
+	ZUC_ASSERT_EQ(rdp_encoder_submit(encoder, JOB_COUNT, count_job,
+					 batch_done, &batch), 0);
+	ZUC_ASSERT_TRUE(rdp_encoder_busy(encoder));
+	ZUC_ASSERT_EQ(rdp_encoder_submit(encoder, JOB_COUNT, count_job,
+					 batch_done, &batch), -1);
+
+	/* The callback only ever comes from the event loop */
+	while (!batch.done)
+		wl_event_loop_dispatch(loop, 1000);
+
+	ZUC_ASSERT_EQ(batch.done, 1);
+	ZUC_ASSERT_FALSE(rdp_encoder_busy(encoder));
+	check_batch(&batch);
+
+	rdp_encoder_destroy(encoder);
+	wl_event_loop_destroy(loop);
+}
+
+ZUC_TEST(rdp_encoder_test, flush)
+{
+	struct wl_event_loop *loop = wl_event_loop_create();
+	struct rdp_encoder *encoder;
+	struct batch batch = { 0 };
+
+	encoder = rdp_encoder_create(loop, 2);
+	ZUC_ASSERT_NOT_NULL(encoder);
+
+	rdp_encoder_submit(encoder, JOB_COUNT, count_job, batch_done, &batch);
+	rdp_encoder_flush(encoder);
+	ZUC_ASSERT_EQ(batch.done, 1);
+	check_batch(&batch);
+
+	/* The pending wakeup must not complete the batch again */
+	wl_event_loop_dispatch(loop, 0);
+	ZUC_ASSERT_EQ(batch.done, 1);
+
+	rdp_encoder_destroy(encoder);
+	wl_event_loop_destroy(loop);
+}
+
+ZUC_TEST(rdp_encoder_test, destroy_waits)
+{
+	struct wl_event_loop *loop = wl_event_loop_create();
+	struct rdp_encoder *encoder;
+	struct batch batch = { 0 };
+
+	encoder = rdp_encoder_create(loop, 0);
+	ZUC_ASSERT_NOT_NULL(encoder);
+
+	rdp_encoder_submit(encoder, JOB_COUNT, count_job, batch_done, &batch);
+	rdp_encoder_destroy(encoder);
+	check_batch(&batch);
+	ZUC_ASSERT_EQ(batch.done, 0);
+
+	wl_event_loop_destroy(loop);
+}
+
+#define PEER_COUNT 3
+
+/* What rdp.c keeps per peer and output, without FreeRDP */
+struct fake_peer {
+	bool alive;
+	_Atomic int encoded;
+	int sent;
+	int x;
+};
+
+struct fake_output {
+	struct rdp_encode_jobs jobs;
+	struct fake_peer peers[PEER_COUNT];
+	int done;
+};
+
+/* Like rdp_output_encode_job(), and slow enough for the batch to still
+ * be in flight when a peer goes away */
+static void
+fake_encode_job(void *data, unsigned index)
+{
+	struct fake_output *output = data;
+	struct fake_peer *peer = output->jobs.jobs[index].peer;
+
+	usleep(20000);
+	if (peer->alive)
+		atomic_fetch_add(&peer->encoded, 1);
+	else
+		atomic_store(&peer->encoded, -1);
+}
+
+/* Like rdp_output_encode_done() */
+static void
+fake_encode_done(void *data)
+{
+	struct fake_output *output = data;
+	struct rdp_encode_job *job;
+	struct fake_peer *peer;
+	unsigned i;
+
+	for (i = 0; i < output->jobs.count; i++) {
+		job = &output->jobs.jobs[i];
+		peer = job->peer;
+		if (!peer)
+			continue;
+
+		if (!peer->alive ||
+		    pixman_region32_extents(&job->region)->x1 != peer->x)
+			peer->sent = -1;
+		else
+			peer->sent++;
+	}
+
+	rdp_encode_jobs_clear(&output->jobs);
+	output->done++;
+}
+
+static void
+fake_output_init(struct fake_output *output)
+{
+	pixman_region32_t region;
+	unsigned i;
+
+	memset(output, 0, sizeof *output);
+
+	for (i = 0; i < PEER_COUNT; i++) {
+		output->peers[i].alive = true;
+		output->peers[i].x = i * 10;
+
+		pixman_region32_init_rect(&region, i * 10, 0, 5, 5);
+		ZUC_ASSERT_EQ(rdp_encode_jobs_add(&output->jobs,
+						  &output->peers[i], &region),
+			      0);
+		pixman_region32_fini(&region);
+	}
+}
+
+ZUC_TEST(rdp_encoder_test, jobs_sent_on_done)
+{
+	struct wl_event_loop *loop = wl_event_loop_create();
+	struct rdp_encoder *encoder;
+	struct fake_output output;
+	unsigned i;
+
+	encoder = rdp_encoder_create(loop, 2);
+	ZUC_ASSERT_NOT_NULL(encoder);
+	fake_output_init(&output);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+
+	ZUC_ASSERT_EQ(rdp_encoder_submit(encoder, output.jobs.count,
+					 fake_encode_job, fake_encode_done,
+					 &output), 0);
+	while (!output.done)
+		wl_event_loop_dispatch(loop, 1000);
+
+	ZUC_ASSERT_EQ(output.done, 1);
+	ZUC_ASSERT_EQ(output.jobs.count, 0);
+	for (i = 0; i < PEER_COUNT; i++) {
+		ZUC_ASSERT_EQ(atomic_load(&output.peers[i].encoded), 1);
+		ZUC_ASSERT_EQ(output.peers[i].sent, 1);
+	}
+
+	/* Nothing in flight, nothing to wait for */
+	rdp_encoder_drop_peer(encoder, &output.jobs, &output.peers[0]);
+
+	rdp_encode_jobs_release(&output.jobs);
+	rdp_encoder_destroy(encoder);
+	wl_event_loop_destroy(loop);
+}
+
+/* A peer disconnecting while its job is in flight, as in
+ * rdp_peer_context_free() */
+ZUC_TEST(rdp_encoder_test, peer_freed_in_flight)
+{
+	struct wl_event_loop *loop = wl_event_loop_create();
+	struct rdp_encoder *encoder;
+	struct fake_output output;
+	unsigned i;
+
+	encoder = rdp_encoder_create(loop, 2);
+	ZUC_ASSERT_NOT_NULL(encoder);
+	fake_output_init(&output);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+
+	ZUC_ASSERT_EQ(rdp_encoder_submit(encoder, output.jobs.count,
+					 fake_encode_job, fake_encode_done,
+					 &output), 0);
+
+	/* The encoders are done with the peer once this returns, but the
+	 * rest of the frame still goes out from the event loop */
+	rdp_encoder_drop_peer(encoder, &output.jobs, &output.peers[1]);
+	ZUC_ASSERT_EQ(atomic_load(&output.peers[1].encoded), 1);
+	ZUC_ASSERT_EQ(output.done, 0);
+	ZUC_ASSERT_TRUE(rdp_encoder_busy(encoder));
+	output.peers[1].alive = false;
+
+	while (!output.done)
+		wl_event_loop_dispatch(loop, 1000);
+
+	ZUC_ASSERT_EQ(output.done, 1);
+	ZUC_ASSERT_EQ(output.jobs.count, 0);
+	for (i = 0; i < PEER_COUNT; i++) {
+		ZUC_ASSERT_EQ(atomic_load(&output.peers[i].encoded), 1);
+		ZUC_ASSERT_EQ(output.peers[i].sent, i == 1 ? 0 : 1);
+	}
+
+	rdp_encode_jobs_release(&output.jobs);
+	rdp_encoder_destroy(encoder);
+	wl_event_loop_destroy(loop);
+}
+
+#define IMAGE_WIDTH 256
+#define IMAGE_HEIGHT 192
+#define PEERS 3
+
+struct rfx_peer {
+	RFX_CONTEXT *rfx;
+	wStream *stream;
+};
+
+struct rfx_batch {
+	uint32_t *image;
+	RFX_RECT rects[2];
+	struct rfx_peer peers[PEERS];
+};
+
+static void
+rfx_peer_init(struct rfx_peer *peer)
+{
+	peer->rfx = rfx_context_new(TRUE);
+	rfx_context_reset(peer->rfx, IMAGE_WIDTH, IMAGE_HEIGHT);
+	rfx_context_set_pixel_format(peer->rfx, PIXEL_FORMAT_BGRX32);
+	peer->stream = Stream_New(NULL, 65536);
+}
+
+static void
+rfx_peer_release(struct rfx_peer *peer)
+{
+	Stream_Free(peer->stream, TRUE);
+	rfx_context_free(peer->rfx);
+}
+
+static void
+rfx_encode_job(void *data, unsigned index)
+{
+	struct rfx_batch *batch = data;
+	struct rfx_peer *peer = &batch->peers[index];
+
+	Stream_SetPosition(peer->stream, 0);
+	rfx_compose_message(peer->rfx, peer->stream, batch->rects,
+			    ARRAY_LENGTH(batch->rects), (BYTE *) batch->image,
+			    IMAGE_WIDTH, IMAGE_HEIGHT, IMAGE_WIDTH * 4);
+}
+
+/* Encoding peers concurrently must produce exactly what encoding them one
+ * after the other does, and a FreeRDP client must be able to decode it. */
+ZUC_TEST(rdp_encoder_test, remotefx_peers)
+{
+	struct wl_event_loop *loop = wl_event_loop_create();
+	struct rdp_encoder *encoder;
+	struct rfx_batch batch, serial;
+	RFX_CONTEXT *decoder;
+	REGION16 invalid;
+	uint32_t *decoded;
+	uint64_t error = 0, samples = 0;
+	unsigned i, x, y, c;
+	int a, b;
+
+	batch.image = malloc(IMAGE_WIDTH * IMAGE_HEIGHT * 4);
+	decoded = calloc(IMAGE_WIDTH * IMAGE_HEIGHT, 4);
+	ZUC_ASSERT_NOT_NULL(batch.image);
+	ZUC_ASSERT_NOT_NULL(decoded);
+
+	for (y = 0; y < IMAGE_HEIGHT; y++)
+		for (x = 0; x < IMAGE_WIDTH; x++)
+			batch.image[y * IMAGE_WIDTH + x] =
+				(x << 16) | (((y + x / 2) & 0xff) << 8) |
+				(255 - y);
+
+	batch.rects[0] = (RFX_RECT) { 0, 0, 128, 64 };
+	batch.rects[1] = (RFX_RECT) { 64, 96, 192, 96 };
+	serial = batch;
+
+	for (i = 0; i < PEERS; i++) {
+		rfx_peer_init(&batch.peers[i]);
+		rfx_peer_init(&serial.peers[i]);
+	}
+
+	encoder = rdp_encoder_create(loop, PEERS - 1);
+	ZUC_ASSERT_NOT_NULL(encoder);
+	rdp_encoder_submit(encoder, PEERS, rfx_encode_job, NULL, &batch);
+	rdp_encoder_wait(encoder);
+
+	for (i = 0; i < PEERS; i++) {
+		rfx_encode_job(&serial, i);
+		ZUC_ASSERT_EQ(Stream_GetPosition(batch.peers[i].stream),
+			      Stream_GetPosition(serial.peers[i].stream));
+		ZUC_ASSERT_EQ(memcmp(Stream_Buffer(batch.peers[i].stream),
+				     Stream_Buffer(serial.peers[i].stream),
+				     Stream_GetPosition(serial.peers[i].stream)),
+			      0);
+	}
+
+	decoder = rfx_context_new(FALSE);
+	ZUC_ASSERT_NOT_NULL(decoder);
+	rfx_context_reset(decoder, IMAGE_WIDTH, IMAGE_HEIGHT);
+	region16_init(&invalid);
+	ZUC_ASSERT_TRUE(rfx_process_message(decoder,
+					    Stream_Buffer(batch.peers[0].stream),
+					    Stream_GetPosition(batch.peers[0].stream),
+					    0, 0, (BYTE *) decoded,
+					    PIXEL_FORMAT_BGRX32, IMAGE_WIDTH * 4,
+					    IMAGE_HEIGHT, &invalid));
+	region16_uninit(&invalid);
+
+	/* RemoteFX is lossy, but not on a smooth gradient */
+	for (i = 0; i < ARRAY_LENGTH(batch.rects); i++) {
+		RFX_RECT *r = &batch.rects[i];
+
+		for (y = r->y; y < (unsigned) (r->y + r->height); y++) {
+			for (x = r->x; x < (unsigned) (r->x + r->width); x++) {
+				for (c = 0; c < 24; c += 8) {
+					a = (batch.image[y * IMAGE_WIDTH + x] >> c) & 0xff;
+					b = (decoded[y * IMAGE_WIDTH + x] >> c) & 0xff;
+					error += abs(a - b);
+					samples++;
+				}
+			}
+		}
+	}
+	ZUC_ASSERT_TRUE(error < samples * 4);
+
+	rfx_context_free(decoder);
+	for (i = 0; i < PEERS; i++) {
+		rfx_peer_release(&batch.peers[i]);
+		rfx_peer_release(&serial.peers[i]);
+	}
+	rdp_encoder_destroy(encoder);
+	wl_event_loop_destroy(loop);
+	free(decoded);
+	free(batch.image);
+}
@@ -0,0 +1,240 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pixman.h>
+
+#include "libweston/backend-rdp/rdp-tiles.h"
+#include "zunitc/zunitc.h"
+
+/* two full tile columns and a partial one, one full row and a partial one */
+#define WIDTH (2 * RDP_TILE_SIZE + 17)
+#define HEIGHT (RDP_TILE_SIZE + 9)
+
+struct picture {
+	pixman_image_t *image;
+	uint32_t *data;
+	int stride;
+	struct rdp_tiles tiles;
+};
+
+static void
+picture_init(struct picture *pic)
+{
+	int x, y;
+
+	pic->image = pixman_image_create_bits(PIXMAN_x8r8g8b8, WIDTH, HEIGHT,
+					      NULL, 0);
+	ZUC_ASSERT_NOT_NULL(pic->image);
+	pic->data = pixman_image_get_data(pic->image);
+	pic->stride = pixman_image_get_stride(pic->image) / sizeof(uint32_t);
+
+	for (y = 0; y < HEIGHT; y++)
+		for (x = 0; x < WIDTH; x++)
+			pic->data[y * pic->stride + x] =
+				0xff000000 | (x << 16) | (y << 8) | (x ^ y);
+
+	pic->tiles.hashes = NULL;
+	ZUC_ASSERT_EQ(0, rdp_tiles_init(&pic->tiles, WIDTH, HEIGHT));
+}
+
+static void
+picture_release(struct picture *pic)
+{
+	rdp_tiles_release(&pic->tiles);
+	pixman_image_unref(pic->image);
+}
+
+/* Filters damage and checks that what is left is exactly expected */
+static void
+check_filter(struct picture *pic, pixman_region32_t *damage,
+	     pixman_region32_t *expected)
+{
+	pixman_region32_t changed;
+	bool equal;
+
+	rdp_tiles_filter_damage(&pic->tiles, pic->image, damage, &changed);
+	equal = pixman_region32_equal(&changed, expected);
+	pixman_region32_fini(&changed);
+
+	ZUC_ASSERT_TRUE(equal);
+}
+
+static void
+check_filter_rect(struct picture *pic, int x, int y, int w, int h,
+		  int ex, int ey, int ew, int eh)
+{
+	pixman_region32_t damage, expected;
+
+	pixman_region32_init_rect(&damage, x, y, w, h);
+	pixman_region32_init_rect(&expected, ex, ey, ew, eh);
+	check_filter(pic, &damage, &expected);
+	pixman_region32_fini(&expected);
+	pixman_region32_fini(&damage);
+}
+
+ZUC_TEST(rdp_tiles_test, unchanged_repaint_is_dropped)
+{
+	struct picture pic;
+
+	picture_init(&pic);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+
+	/* nothing has been hashed yet */
+	check_filter_rect(&pic, 0, 0, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT);
+	check_filter_rect(&pic, 0, 0, WIDTH, HEIGHT, 0, 0, 0, 0);
+	check_filter_rect(&pic, 10, 20, 30, 40, 0, 0, 0, 0);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+
+	picture_release(&pic);
+}
+
+ZUC_TEST(rdp_tiles_test, change_keeps_only_its_tile)
+{
+	struct picture pic;
+
+	picture_init(&pic);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+	check_filter_rect(&pic, 0, 0, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT);
+
+	/* a pixel of the middle tile of the first row */
+	pic.data[5 * pic.stride + RDP_TILE_SIZE + 7] ^= 0x00010000;
+	check_filter_rect(&pic, 0, 0, WIDTH, HEIGHT,
+			  RDP_TILE_SIZE, 0, RDP_TILE_SIZE, RDP_TILE_SIZE);
+
+	/* a pixel of the partial tile in the corner */
+	pic.data[(HEIGHT - 1) * pic.stride + WIDTH - 1] ^= 0x00000001;
+	check_filter_rect(&pic, 0, 0, WIDTH, HEIGHT,
+			  2 * RDP_TILE_SIZE, RDP_TILE_SIZE, 17, 9);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+
+	picture_release(&pic);
+}
+
+ZUC_TEST(rdp_tiles_test, changed_is_clipped_to_damage)
+{
+	struct picture pic;
+	pixman_region32_t damage, expected;
+
+	picture_init(&pic);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+	check_filter_rect(&pic, 0, 0, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT);
+
+	/* damage over two tiles, of which only the first changed */
+	pic.data[3 * pic.stride + 3] = 0xff123456;
+	check_filter_rect(&pic, 1, 2, RDP_TILE_SIZE + 10, 8, 1, 2,
+			  RDP_TILE_SIZE - 1, 8);
+
+	/* two separate rectangles in the same changed tile */
+	pic.data[40 * pic.stride + 40] = 0xff654321;
+	pixman_region32_init_rect(&damage, 0, 0, 4, 4);
+	pixman_region32_union_rect(&damage, &damage, 38, 38, 4, 4);
+	pixman_region32_init(&expected);
+	pixman_region32_copy(&expected, &damage);
+	check_filter(&pic, &damage, &expected);
+	pixman_region32_fini(&expected);
+	pixman_region32_fini(&damage);
+
+	/* damage outside the image is dropped with its tiles */
+	check_filter_rect(&pic, -20, -20, 10, 10, 0, 0, 0, 0);
+	check_filter_rect(&pic, WIDTH, 0, 50, HEIGHT, 0, 0, 0, 0);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+
+	picture_release(&pic);
+}
+
+ZUC_TEST(rdp_tiles_test, reset_reports_everything)
+{
+	struct picture pic;
+
+	picture_init(&pic);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+	check_filter_rect(&pic, 0, 0, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT);
+
+	rdp_tiles_reset(&pic.tiles);
+	check_filter_rect(&pic, 0, 0, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT);
+
+	/* without a table all damage is changed */
+	rdp_tiles_release(&pic.tiles);
+	check_filter_rect(&pic, 0, 0, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT);
+	check_filter_rect(&pic, 0, 0, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+
+	picture_release(&pic);
+}
+
+/* FNV over 32-bit words lets changes to the top bit of two pixels of one
+ * lane cancel out; a pixel and the one below it share a lane */
+ZUC_TEST(rdp_tiles_test, paired_top_bits_change_the_hash)
+{
+	uint32_t tile[RDP_TILE_SIZE * RDP_TILE_SIZE] = { 0 };
+	uint64_t hash = rdp_tile_hash(tile, RDP_TILE_SIZE,
+				      RDP_TILE_SIZE, RDP_TILE_SIZE);
+	int x;
+
+	for (x = 0; x < RDP_TILE_SIZE; x++) {
+		tile[x] ^= 0x80000000;
+		tile[x + RDP_TILE_SIZE] ^= 0x80000000;
+		ZUC_ASSERT_NE(hash, rdp_tile_hash(tile, RDP_TILE_SIZE,
+						  RDP_TILE_SIZE,
+						  RDP_TILE_SIZE));
+		tile[x] ^= 0x80000000;
+		tile[x + RDP_TILE_SIZE] ^= 0x80000000;
+	}
+}
+
+ZUC_TEST(rdp_tiles_test, one_bit_flips_half_the_hash)
+{
+	static uint32_t tile[RDP_TILE_SIZE * RDP_TILE_SIZE];
+	uint64_t hash, flipped;
+	unsigned seed = 1;
+	int i, pixel, bit;
+	long bits = 0;
+
+	for (i = 0; i < RDP_TILE_SIZE * RDP_TILE_SIZE; i++)
+		tile[i] = rand_r(&seed);
+	hash = rdp_tile_hash(tile, RDP_TILE_SIZE,
+			     RDP_TILE_SIZE, RDP_TILE_SIZE);
+
+	for (i = 0; i < 1000; i++) {
+		pixel = rand_r(&seed) % (RDP_TILE_SIZE * RDP_TILE_SIZE);
+		bit = rand_r(&seed) % 32;
+
+		tile[pixel] ^= 1u << bit;
+		flipped = rdp_tile_hash(tile, RDP_TILE_SIZE,
+					RDP_TILE_SIZE, RDP_TILE_SIZE);
+		tile[pixel] ^= 1u << bit;
+
+		ZUC_ASSERT_NE(hash, flipped);
+		bits += __builtin_popcountll(hash ^ flipped);
+	}
+
+	/* 32 of the 64 bits on average */
+	ZUC_ASSERT_TRUE(bits > 1000 * 30 && bits < 1000 * 34);
+}
@@ -0,0 +1,508 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Compositor scene benchmark
+ *
+ * Spawns a number of clients, each with a test surface, optional
+ * subsurfaces and an optional viewport, commits new content on all of
+ * them at a fixed rate, and reports per-scenario compositor CPU time per
+ * frame, commit-to-present latency and commit-to-frame-callback latency
+ * as JSON. See the WESTON_BENCH_* variables below for the knobs.
+ */
+
+#include "config.h"
+
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+#include "shared/timespec-util.h"
+#include "weston-test-client-helper.h"
+#include "weston-bench-helper.h"
+#include "presentation-time-client-protocol.h"
+#include "viewporter-client-protocol.h"
+
+#define BENCH_MAX_SUBSURFACES 16
+
+struct scene_config {
+	const char *name;
+	int clients;
+	int subsurfaces;
+	bool viewport;
+};
+
+static const struct scene_config scenes[] = {
+	{ "shm", 4, 0, false },
+	{ "subsurfaces", 4, 4, false },
+	{ "viewporter", 4, 0, true },
+	{ "mixed", 8, 2, true },
+};
+
+struct bench;
+
+struct bench_commit {
+	struct bench_client *bc;
+	struct timespec commit_time;
+	struct wl_callback *frame;
+	struct wp_presentation_feedback *feedback;
+	bool pending;
+};
+
+/* The compositor may read a SHM buffer until it releases it, so the main
+ * surface alternates between two buffers and only redraws a released
+ * one. */
+struct bench_buffer {
+	struct buffer *buffer;
+	bool busy;
+};
+
+struct bench_client {
+	struct bench *bench;
+	struct client *client;
+	struct bench_buffer buffers[2];
+	struct wp_presentation *presentation;
+	struct wp_viewporter *viewporter;
+	struct wl_subcompositor *subcompositor;
+
+	struct wl_surface *child[BENCH_MAX_SUBSURFACES];
+	struct wl_subsurface *sub[BENCH_MAX_SUBSURFACES];
+	struct buffer *child_buffer[BENCH_MAX_SUBSURFACES];
+	struct wp_viewport *viewport;
+	int n_children;
+};
+
+struct bench {
+	const struct scene_config *config;
+	struct bench_client *clients;
+	int n_clients;
+
+	clockid_t clock_id;
+	struct bench_samples present_latency;
+	struct bench_samples frame_latency;
+	unsigned presented;
+	unsigned discarded;
+	unsigned outstanding;
+
+	/* Distinct presentation timestamps, i.e. compositor frames. */
+	struct timespec last_present;
+	unsigned compositor_frames;
+};
+
+static void *
+bind_global(struct client *client, const struct wl_interface *iface,
+	    uint32_t version)
+{
+	struct global *g;
+
+	wl_list_for_each(g, &client->global_list, link) {
+		if (strcmp(g->interface, iface->name) == 0)
+			return wl_registry_bind(client->wl_registry, g->name,
+						iface, version);
+	}
+
+	return NULL;
+}
+
+static void
+presentation_clock_id(void *data, struct wp_presentation *presentation,
+		      uint32_t clk_id)
+{
+	struct bench *bench = data;
+
+	bench->clock_id = clk_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+	presentation_clock_id
+};
+
+static void
+commit_done(struct bench_commit *commit)
+{
+	if (commit->frame || commit->feedback)
+		return;
+
+	commit->pending = false;
+	commit->bc->bench->outstanding--;
+}
+
+static void
+frame_done(void *data, struct wl_callback *callback, uint32_t msec)
+{
+	struct bench_commit *commit = data;
+	struct bench *bench = commit->bc->bench;
+	struct timespec now;
+
+	clock_gettime(bench->clock_id, &now);
+	bench_samples_add(&bench->frame_latency,
+			  timespec_sub_to_nsec(&now, &commit->commit_time));
+
+	wl_callback_destroy(callback);
+	commit->frame = NULL;
+	commit_done(commit);
+}
+
+static const struct wl_callback_listener frame_listener = {
+	frame_done
+};
+
+static void
+feedback_sync_output(void *data, struct wp_presentation_feedback *fb,
+		     struct wl_output *output)
+{
+}
+
+static void
+feedback_presented(void *data, struct wp_presentation_feedback *fb,
+		   uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+		   uint32_t refresh_nsec, uint32_t seq_hi, uint32_t seq_lo,
+		   uint32_t flags)
+{
+	struct bench_commit *commit = data;
+	struct bench *bench = commit->bc->bench;
+	struct timespec ts;
+
+	timespec_from_proto(&ts, tv_sec_hi, tv_sec_lo, tv_nsec);
+	bench_samples_add(&bench->present_latency,
+			  timespec_sub_to_nsec(&ts, &commit->commit_time));
+
+	if (!timespec_eq(&ts, &bench->last_present)) {
+		bench->last_present = ts;
+		bench->compositor_frames++;
+	}
+	bench->presented++;
+
+	wp_presentation_feedback_destroy(fb);
+	commit->feedback = NULL;
+	commit_done(commit);
+}
+
+static void
+feedback_discarded(void *data, struct wp_presentation_feedback *fb)
+{
+	struct bench_commit *commit = data;
+
+	commit->bc->bench->discarded++;
+
+	wp_presentation_feedback_destroy(fb);
+	commit->feedback = NULL;
+	commit_done(commit);
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+	feedback_sync_output,
+	feedback_presented,
+	feedback_discarded
+};
+
+static void
+buffer_release(void *data, struct wl_buffer *buffer)
+{
+	struct bench_buffer *bb = data;
+
+	bb->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	buffer_release
+};
+
+static struct bench_buffer *
+bench_client_get_buffer(struct bench_client *bc)
+{
+	unsigned i;
+
+	for (;;) {
+		for (i = 0; i < ARRAY_LENGTH(bc->buffers); i++)
+			if (!bc->buffers[i].busy)
+				return &bc->buffers[i];
+
+		assert(wl_display_dispatch(bc->client->wl_display) >= 0);
+	}
+}
+
+static void
+fill_buffer(struct buffer *buffer, uint32_t seed)
+{
+	pixman_color_t color = {
+		.red = (seed * 0x1000) & 0xffff,
+		.green = (seed * 0x2300) & 0xffff,
+		.blue = (seed * 0x3700) & 0xffff,
+		.alpha = 0xffff,
+	};
+	pixman_image_t *solid;
+
+	solid = pixman_image_create_solid_fill(&color);
+	pixman_image_composite32(PIXMAN_OP_SRC, solid, NULL, buffer->image,
+				 0, 0, 0, 0, 0, 0,
+				 pixman_image_get_width(buffer->image),
+				 pixman_image_get_height(buffer->image));
+	pixman_image_unref(solid);
+}
+
+static void
+bench_client_init(struct bench_client *bc, struct bench *bench, int index)
+{
+	const struct scene_config *config = bench->config;
+	int size = 64 + (index % 4) * 32;
+	int i;
+
+	bc->bench = bench;
+	bc->client = create_client_and_test_surface(20 + (index % 8) * 30,
+						    20 + (index / 8) * 30,
+						    size, size);
+	assert(bc->client);
+
+	/* The test surface buffer has been attached already. */
+	bc->buffers[0].buffer = bc->client->surface->buffer;
+	bc->buffers[0].busy = true;
+	bc->buffers[1].buffer = create_shm_buffer_a8r8g8b8(bc->client, size,
+							   size);
+	for (i = 0; i < (int) ARRAY_LENGTH(bc->buffers); i++)
+		wl_buffer_add_listener(bc->buffers[i].buffer->proxy,
+				       &buffer_listener, &bc->buffers[i]);
+
+	bc->presentation = bind_global(bc->client, &wp_presentation_interface,
+				       1);
+	assert(bc->presentation);
+	wp_presentation_add_listener(bc->presentation,
+				     &presentation_listener, bench);
+
+	bc->n_children = config->subsurfaces;
+	if (bc->n_children > 0) {
+		bc->subcompositor = bind_global(bc->client,
+						&wl_subcompositor_interface,
+						1);
+		assert(bc->subcompositor);
+	}
+
+	for (i = 0; i < bc->n_children; i++) {
+		struct wl_compositor *compositor = bc->client->wl_compositor;
+
+		bc->child[i] = wl_compositor_create_surface(compositor);
+		bc->sub[i] =
+			wl_subcompositor_get_subsurface(bc->subcompositor,
+							bc->child[i],
+							bc->client->surface->wl_surface);
+		wl_subsurface_set_position(bc->sub[i], 8 * i, 8 * i);
+		bc->child_buffer[i] =
+			create_shm_buffer_a8r8g8b8(bc->client, size / 2,
+						   size / 2);
+		fill_buffer(bc->child_buffer[i], i);
+	}
+
+	if (config->viewport) {
+		bc->viewporter = bind_global(bc->client,
+					     &wp_viewporter_interface, 1);
+		assert(bc->viewporter);
+		bc->viewport =
+			wp_viewporter_get_viewport(bc->viewporter,
+						   bc->client->surface->wl_surface);
+		wp_viewport_set_source(bc->viewport, wl_fixed_from_int(0),
+				       wl_fixed_from_int(0),
+				       wl_fixed_from_int(size / 2),
+				       wl_fixed_from_int(size / 2));
+		wp_viewport_set_destination(bc->viewport, size * 2, size * 2);
+	}
+
+	client_roundtrip(bc->client);
+}
+
+static void
+bench_client_commit(struct bench_client *bc, struct bench_commit *commit,
+		    uint32_t seq)
+{
+	struct surface *surface = bc->client->surface;
+	struct bench_buffer *bb;
+	int i;
+
+	for (i = 0; i < bc->n_children; i++) {
+		wl_surface_attach(bc->child[i], bc->child_buffer[i]->proxy,
+				  0, 0);
+		wl_surface_damage(bc->child[i], 0, 0, INT32_MAX, INT32_MAX);
+		wl_surface_commit(bc->child[i]);
+	}
+
+	bb = bench_client_get_buffer(bc);
+	fill_buffer(bb->buffer, seq);
+	bb->busy = true;
+	wl_surface_attach(surface->wl_surface, bb->buffer->proxy, 0, 0);
+	wl_surface_damage(surface->wl_surface, 0, 0,
+			  surface->width, surface->height);
+
+	commit->bc = bc;
+	commit->pending = true;
+	commit->frame = wl_surface_frame(surface->wl_surface);
+	wl_callback_add_listener(commit->frame, &frame_listener, commit);
+	commit->feedback = wp_presentation_feedback(bc->presentation,
+						    surface->wl_surface);
+	wp_presentation_feedback_add_listener(commit->feedback,
+					      &feedback_listener, commit);
+
+	clock_gettime(bc->bench->clock_id, &commit->commit_time);
+	wl_surface_commit(surface->wl_surface);
+	bc->bench->outstanding++;
+}
+
+/* Dispatch all clients until the deadline passes, or until nothing is
+ * outstanding if the deadline is NULL. */
+static void
+bench_dispatch(struct bench *bench, const struct timespec *deadline)
+{
+	struct pollfd *fds = xzalloc(bench->n_clients * sizeof *fds);
+	struct timespec now;
+	int64_t timeout;
+	int i;
+
+	for (i = 0; i < bench->n_clients; i++) {
+		struct wl_display *display = bench->clients[i].client->wl_display;
+
+		fds[i].fd = wl_display_get_fd(display);
+		fds[i].events = POLLIN;
+		assert(wl_display_flush(display) >= 0);
+	}
+
+	while (true) {
+		for (i = 0; i < bench->n_clients; i++) {
+			struct wl_display *display =
+				bench->clients[i].client->wl_display;
+
+			assert(wl_display_dispatch_pending(display) >= 0);
+		}
+
+		clock_gettime(bench->clock_id, &now);
+		if (deadline)
+			timeout = timespec_sub_to_msec(deadline, &now);
+		else
+			timeout = bench->outstanding ? 1000 : 0;
+
+		if (timeout <= 0)
+			break;
+
+		if (poll(fds, bench->n_clients, timeout) <= 0) {
+			assert(deadline && "timed out waiting for frames");
+			continue;
+		}
+
+		for (i = 0; i < bench->n_clients; i++) {
+			struct wl_display *display =
+				bench->clients[i].client->wl_display;
+
+			if (fds[i].revents & POLLIN)
+				assert(wl_display_dispatch(display) >= 0);
+		}
+	}
+
+	free(fds);
+}
+
+TEST_P(scene_benchmark, scenes)
+{
+	const struct scene_config *config = data;
+	struct bench bench = { .config = config, .clock_id = CLOCK_MONOTONIC };
+	struct bench_commit *commits;
+	struct timespec start, next, end;
+	int64_t cpu_start, cpu_end, period_nsec;
+	int frames, rate, frame, i;
+	pid_t compositor;
+	FILE *json;
+
+	bench.n_clients = bench_env_int("WESTON_BENCH_CLIENTS", config->clients);
+	frames = bench_env_int("WESTON_BENCH_FRAMES", 300);
+	rate = bench_env_int("WESTON_BENCH_RATE", 60);
+	assert(bench.n_clients > 0 && frames > 0 && rate > 0);
+	assert(config->subsurfaces <= BENCH_MAX_SUBSURFACES);
+	period_nsec = 1000000000LL / rate;
+
+	bench_samples_init(&bench.present_latency);
+	bench_samples_init(&bench.frame_latency);
+
+	bench.clients = xzalloc(bench.n_clients * sizeof *bench.clients);
+	for (i = 0; i < bench.n_clients; i++)
+		bench_client_init(&bench.clients[i], &bench, i);
+
+	/* Pick up the presentation clock before any timing. */
+	client_roundtrip(bench.clients[0].client);
+
+	commits = xzalloc((size_t)frames * bench.n_clients * sizeof *commits);
+
+	compositor = bench_compositor_pid();
+	cpu_start = bench_process_cpu_time_nsec(compositor);
+	clock_gettime(bench.clock_id, &start);
+	next = start;
+
+	for (frame = 0; frame < frames; frame++) {
+		for (i = 0; i < bench.n_clients; i++)
+			bench_client_commit(&bench.clients[i],
+					    &commits[frame * bench.n_clients + i],
+					    frame);
+
+		timespec_add_nsec(&next, &next, period_nsec);
+		bench_dispatch(&bench, &next);
+	}
+
+	bench_dispatch(&bench, NULL);
+
+	clock_gettime(bench.clock_id, &end);
+	cpu_end = bench_process_cpu_time_nsec(compositor);
+
+	json = bench_json_open();
+	fprintf(json, "{ \"benchmark\": \"scene\", \"scene\": \"%s\", "
+		"\"clients\": %d, \"subsurfaces\": %d, \"viewport\": %s, "
+		"\"rate_hz\": %d, \"commits\": %d, \"presented\": %u, "
+		"\"discarded\": %u, \"compositor_frames\": %u, "
+		"\"duration_ms\": %.3f, ",
+		config->name, bench.n_clients, config->subsurfaces,
+		config->viewport ? "true" : "false", rate,
+		frames * bench.n_clients, bench.presented, bench.discarded,
+		bench.compositor_frames,
+		timespec_sub_to_nsec(&end, &start) / 1e6);
+	if (cpu_start >= 0 && cpu_end >= 0 && bench.compositor_frames > 0)
+		fprintf(json, "\"compositor_cpu_per_frame_us\": %.3f, ",
+			(cpu_end - cpu_start) / 1e3 / bench.compositor_frames);
+	else
+		fprintf(json, "\"compositor_cpu_per_frame_us\": null, ");
+	bench_json_print_samples(json, "commit_to_present_latency",
+				 &bench.present_latency);
+	fprintf(json, ", ");
+	bench_json_print_samples(json, "frame_callback_latency",
+				 &bench.frame_latency);
+	fprintf(json, " }\n");
+	bench_json_close(json);
+
+	assert(bench.outstanding == 0);
+
+	bench_samples_release(&bench.present_latency);
+	bench_samples_release(&bench.frame_latency);
+	free(commits);
+	free(bench.clients);
+}
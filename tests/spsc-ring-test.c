@@ -0,0 +1,109 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+#include "shared/spsc-ring.h"
+
+#include "shared/helpers.h"
+#include "zunitc/zunitc.h"
+
+ZUC_TEST(spsc_ring_test, invalid_size)
+{
+	struct weston_spsc_ring ring;
+
+	ZUC_ASSERT_FALSE(weston_spsc_ring_init(&ring, 0));
+	ZUC_ASSERT_FALSE(weston_spsc_ring_init(&ring, 6));
+}
+
+ZUC_TEST(spsc_ring_test, fifo_and_full)
+{
+	struct weston_spsc_ring ring;
+	uintptr_t i;
+
+	ZUC_ASSERT_TRUE(weston_spsc_ring_init(&ring, 4));
+	ZUC_ASSERT_NULL(weston_spsc_ring_pop(&ring));
+
+	/* Go around a few times to exercise the index wrap */
+	for (i = 1; i <= 10; i++) {
+		ZUC_ASSERT_TRUE(weston_spsc_ring_push(&ring, (void *)i));
+		ZUC_ASSERT_EQ((uintptr_t)weston_spsc_ring_pop(&ring), i);
+	}
+
+	for (i = 1; i <= 4; i++)
+		ZUC_ASSERT_TRUE(weston_spsc_ring_push(&ring, (void *)i));
+	ZUC_ASSERT_FALSE(weston_spsc_ring_push(&ring, (void *)5));
+
+	for (i = 1; i <= 4; i++)
+		ZUC_ASSERT_EQ((uintptr_t)weston_spsc_ring_pop(&ring), i);
+	ZUC_ASSERT_NULL(weston_spsc_ring_pop(&ring));
+
+	weston_spsc_ring_release(&ring);
+}
+
+#define THREADED_COUNT 1000000
+
+static void *
+producer(void *data)
+{
+	struct weston_spsc_ring *ring = data;
+	uintptr_t i;
+
+	for (i = 1; i <= THREADED_COUNT; i++) {
+		while (!weston_spsc_ring_push(ring, (void *)i))
+			sched_yield();
+	}
+
+	return NULL;
+}
+
+ZUC_TEST(spsc_ring_test, threaded_order)
+{
+	struct weston_spsc_ring ring;
+	pthread_t thread;
+	uintptr_t expected = 1;
+	void *item;
+
+	ZUC_ASSERT_TRUE(weston_spsc_ring_init(&ring, 64));
+	ZUC_ASSERT_EQ(pthread_create(&thread, NULL, producer, &ring), 0);
+
+	while (expected <= THREADED_COUNT) {
+		item = weston_spsc_ring_pop(&ring);
+		if (!item) {
+			sched_yield();
+			continue;
+		}
+		ZUC_ASSERT_EQ((uintptr_t)item, expected);
+		expected++;
+	}
+
+	pthread_join(thread, NULL);
+	ZUC_ASSERT_NULL(weston_spsc_ring_pop(&ring));
+	weston_spsc_ring_release(&ring);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "shared/task-pool.h"
+
+#include "shared/helpers.h"
+#include "zunitc/zunitc.h"
+
+#define TASK_COUNT 1000
+
+struct task_counts {
+	_Atomic unsigned calls[TASK_COUNT];
+};
+
+static void
+count_task(void *data, unsigned index)
+{
+	struct task_counts *counts = data;
+
+	atomic_fetch_add(&counts->calls[index], 1);
+}
+
+static void
+run_and_check(struct weston_task_pool *pool, unsigned count)
+{
+	static struct task_counts counts;
+	unsigned i;
+
+	for (i = 0; i < TASK_COUNT; i++)
+		atomic_store(&counts.calls[i], 0);
+
+	weston_task_pool_run(pool, count, count_task, &counts);
+
+	/* Every index exactly once, all done when run returns */
+	for (i = 0; i < TASK_COUNT; i++)
+		ZUC_ASSERT_EQ(atomic_load(&counts.calls[i]), i < count);
+}
+
+ZUC_TEST(task_pool_test, no_threads)
+{
+	struct weston_task_pool *pool = weston_task_pool_create(0);
+
+	ZUC_ASSERT_NOT_NULL(pool);
+	run_and_check(pool, TASK_COUNT);
+	weston_task_pool_destroy(pool);
+}
+
+ZUC_TEST(task_pool_test, threads)
+{
+	struct weston_task_pool *pool = weston_task_pool_create(3);
+	unsigned i;
+
+	ZUC_ASSERT_NOT_NULL(pool);
+
+	/* Back to back jobs of varying size, including empty ones */
+	for (i = 0; i < 200; i++)
+		run_and_check(pool, (i * 37) % (TASK_COUNT + 1));
+
+	weston_task_pool_destroy(pool);
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+#include "libweston-internal.h"
+#include "timeline.h"
+#include "tools/timeline-decode/timeline-decode.h"
+
+/*
+ * Records timeline points through the 'timeline-binary' scope and runs
+ * the recorded stream through the weston-timeline-decode decoder.
+ */
+
+/* Longer than TIMELINE_BINARY_FLUSH_MS, so the records have been written
+ * out by the time the stream is checked. */
+#define CHECK_DELAY_MS 1000
+
+struct timeline_test {
+	struct weston_compositor *compositor;
+	struct weston_log_subscriber *subscriber;
+	FILE *stream;
+	struct wl_event_source *check_timer;
+};
+
+static bool
+has_line(const char *json, const char *name, const char *fields)
+{
+	const char *line = json;
+	const char *end;
+
+	while (*line) {
+		end = strchrnul(line, '\n');
+		if (memmem(line, end - line, name, strlen(name)) &&
+		    memmem(line, end - line, fields, strlen(fields)))
+			return true;
+		line = *end ? end + 1 : end;
+	}
+
+	return false;
+}
+
+static int
+check_stream(void *data)
+{
+	struct timeline_test *test = data;
+	char *json = NULL;
+	size_t size = 0;
+	FILE *out;
+
+	assert(fflush(test->stream) == 0);
+	rewind(test->stream);
+
+	out = open_memstream(&json, &size);
+	assert(out);
+	assert(timeline_decode(test->stream, out) == 0);
+	fclose(out);
+
+	/* more records get written while the compositor shuts down */
+	fseek(test->stream, 0, SEEK_END);
+
+	/* Every aux value of a point survives, each under its own key. */
+	assert(has_line(json, "\"N\":\"test_all_aux\"",
+			"\"vblank\":[1, 2], \"gpu\":[3, 4], \"input\":42 }"));
+	assert(has_line(json, "\"N\":\"test_gpu\"", "\"gpu\":[5, 6] }"));
+	assert(has_line(json, "\"N\":\"test_input\"", "\"input\":7 }"));
+	assert(!has_line(json, "\"N\":\"test_input\"", "vblank"));
+
+	free(json);
+	wl_event_source_remove(test->check_timer);
+	weston_compositor_exit(test->compositor);
+
+	return 0;
+}
+
+static void
+emit_points(void *data)
+{
+	struct timeline_test *test = data;
+	struct weston_compositor *compositor = test->compositor;
+	struct weston_output *output;
+	struct timespec vblank = { 1, 2 };
+	struct timespec gpu = { 3, 4 };
+	struct timespec gpu2 = { 5, 6 };
+	uint64_t input = 42;
+	uint64_t input2 = 7;
+	struct wl_event_loop *loop;
+
+	assert(!wl_list_empty(&compositor->output_list));
+	output = wl_container_of(compositor->output_list.next, output, link);
+
+	TL_POINT(compositor, "test_all_aux", TLP_OUTPUT(output),
+		 TLP_VBLANK(&vblank), TLP_GPU(&gpu), TLP_INPUT(&input),
+		 TLP_END);
+	TL_POINT(compositor, "test_gpu", TLP_OUTPUT(output), TLP_GPU(&gpu2),
+		 TLP_END);
+	TL_POINT(compositor, "test_input", TLP_INPUT(&input2), TLP_END);
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+	test->check_timer = wl_event_loop_add_timer(loop, check_stream, test);
+	assert(test->check_timer);
+	wl_event_source_timer_update(test->check_timer, CHECK_DELAY_MS);
+}
+
+WL_EXPORT int
+wet_module_init(struct weston_compositor *compositor,
+		int *argc, char *argv[])
+{
+	static struct timeline_test test;
+	struct wl_event_loop *loop;
+
+	test.compositor = compositor;
+	test.stream = tmpfile();
+	assert(test.stream);
+	test.subscriber = weston_log_subscriber_create_log(test.stream);
+	assert(test.subscriber);
+	weston_log_subscribe(compositor->weston_log_ctx, test.subscriber,
+			     "timeline-binary");
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+	wl_event_loop_add_idle(loop, emit_points, &test);
+
+	return 0;
+}
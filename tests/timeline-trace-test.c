@@ -0,0 +1,169 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+#include "libweston-internal.h"
+#include "timeline.h"
+
+/*
+ * Feeds timeline points through the 'timeline-binary' scope into the
+ * trace subscriber used by --trace, and checks the trace events it writes.
+ */
+
+/* Longer than TIMELINE_BINARY_FLUSH_MS, so the records have been written
+ * out by the time the trace is checked. */
+#define CHECK_DELAY_MS 1000
+
+struct trace_test {
+	struct weston_compositor *compositor;
+	struct weston_log_subscriber *subscriber;
+	FILE *stream;
+	struct wl_event_source *check_timer;
+};
+
+static char *
+read_stream(FILE *stream)
+{
+	char *buf;
+	long size;
+
+	assert(fflush(stream) == 0);
+	assert(fseek(stream, 0, SEEK_END) == 0);
+	size = ftell(stream);
+	assert(size >= 0);
+	rewind(stream);
+
+	buf = calloc(1, size + 1);
+	assert(buf);
+	assert(fread(buf, 1, size, stream) == (size_t)size);
+
+	return buf;
+}
+
+static bool
+has_event(const char *json, const char *phase, const char *name)
+{
+	const char *line = json;
+	const char *end;
+
+	while (*line) {
+		end = strchrnul(line, '\n');
+		if (memmem(line, end - line, phase, strlen(phase)) &&
+		    memmem(line, end - line, name, strlen(name)))
+			return true;
+		line = *end ? end + 1 : end;
+	}
+
+	return false;
+}
+
+static int
+check_trace(void *data)
+{
+	struct trace_test *test = data;
+	char *json;
+
+	json = read_stream(test->stream);
+
+	assert(strncmp(json, "[{\"ph\":\"M\"", 10) == 0);
+	assert(has_event(json, "\"ph\":\"M\"", "\"name\":\"output "));
+
+	/* begin/posted/finished become two back-to-back slices */
+	assert(has_event(json, "\"ph\":\"B\"", "\"name\":\"repaint\""));
+	assert(has_event(json, "\"ph\":\"E\"", "\"name\":\"repaint\""));
+	assert(has_event(json, "\"ph\":\"B\"", "\"name\":\"wait for vblank\""));
+	assert(has_event(json, "\"ph\":\"E\"", "\"name\":\"wait for vblank\""));
+
+	/* the vblank instant carries the aux timestamp, not the point's */
+	assert(has_event(json, "\"name\":\"vblank\"", "\"ts\":1000002.000"));
+
+	/* points without an output or surface are plain instants */
+	assert(has_event(json, "\"ph\":\"i\"", "\"name\":\"test_global\""));
+
+	free(json);
+
+	/* stop before the trailer is written on shutdown */
+	wl_event_source_remove(test->check_timer);
+	weston_compositor_exit(test->compositor);
+
+	return 0;
+}
+
+static void
+emit_points(void *data)
+{
+	struct trace_test *test = data;
+	struct weston_compositor *compositor = test->compositor;
+	struct weston_output *output;
+	struct timespec vblank = { 1, 2000 };
+	struct wl_event_loop *loop;
+
+	assert(!wl_list_empty(&compositor->output_list));
+	output = wl_container_of(compositor->output_list.next, output, link);
+
+	TL_POINT(compositor, "core_repaint_begin", TLP_OUTPUT(output),
+		 TLP_END);
+	TL_POINT(compositor, "core_repaint_posted", TLP_OUTPUT(output),
+		 TLP_END);
+	TL_POINT(compositor, "core_repaint_finished", TLP_OUTPUT(output),
+		 TLP_VBLANK(&vblank), TLP_END);
+	TL_POINT(compositor, "test_global", TLP_END);
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+	test->check_timer = wl_event_loop_add_timer(loop, check_trace, test);
+	assert(test->check_timer);
+	wl_event_source_timer_update(test->check_timer, CHECK_DELAY_MS);
+}
+
+WL_EXPORT int
+wet_module_init(struct weston_compositor *compositor,
+		int *argc, char *argv[])
+{
+	static struct trace_test test;
+	struct wl_event_loop *loop;
+
+	test.compositor = compositor;
+	test.stream = tmpfile();
+	assert(test.stream);
+	test.subscriber = weston_log_subscriber_create_trace(test.stream, true);
+	assert(test.subscriber);
+	weston_log_subscribe(compositor->weston_log_ctx, test.subscriber,
+			     "timeline-binary");
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+	wl_event_loop_add_idle(loop, emit_points, &test);
+
+	return 0;
+}
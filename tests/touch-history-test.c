@@ -0,0 +1,263 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "touch-history.h"
+
+#include "shared/timespec-util.h"
+#include "zunitc/zunitc.h"
+
+static bool
+near(double expected, double actual)
+{
+	return fabs(expected - actual) < 1e-6;
+}
+
+static void
+record_ms(struct touch_history *history, int64_t msec, double x, double y)
+{
+	struct timespec time;
+
+	timespec_from_msec(&time, 1000 + msec);
+	touch_history_record(history, &time, x, y);
+}
+
+static int64_t
+resample_ms(struct touch_history *history, int64_t msec,
+	    double *x, double *y)
+{
+	struct timespec target, time;
+
+	timespec_from_msec(&target, 1000 + msec);
+	touch_history_resample(history, &target, &time, x, y);
+
+	return timespec_to_msec(&time) - 1000;
+}
+
+static bool
+predict_ms(struct touch_history *history, int64_t now_msec,
+	   int64_t ahead_msec, double *x, double *y)
+{
+	struct timespec now;
+
+	timespec_from_msec(&now, 1000 + now_msec);
+
+	return touch_history_predict(history, &now, ahead_msec * 1000000,
+				     x, y);
+}
+
+ZUC_TEST(touch_history_test, ring_keeps_newest)
+{
+	struct touch_history history;
+	int i;
+
+	touch_history_reset(&history);
+	for (i = 0; i < TOUCH_HISTORY + 4; i++)
+		record_ms(&history, i, i, 0);
+
+	ZUC_ASSERT_EQ(TOUCH_HISTORY, history.count);
+	ZUC_ASSERT_TRUE(near(TOUCH_HISTORY + 3,
+			     touch_history_sample(&history, 0)->x));
+	ZUC_ASSERT_TRUE(near(4, touch_history_sample(&history,
+						     TOUCH_HISTORY - 1)->x));
+}
+
+ZUC_TEST(touch_history_test, resample_single_sample)
+{
+	struct touch_history history;
+	double x, y;
+
+	touch_history_reset(&history);
+	record_ms(&history, 10, 3, 4);
+
+	ZUC_ASSERT_EQ(10, resample_ms(&history, 30, &x, &y));
+	ZUC_ASSERT_TRUE(near(3, x));
+	ZUC_ASSERT_TRUE(near(4, y));
+}
+
+ZUC_TEST(touch_history_test, resample_interpolates)
+{
+	struct touch_history history;
+	double x, y;
+
+	touch_history_reset(&history);
+	record_ms(&history, 0, 0, 100);
+	record_ms(&history, 10, 100, 0);
+	record_ms(&history, 20, 300, 0);
+
+	ZUC_ASSERT_EQ(5, resample_ms(&history, 5, &x, &y));
+	ZUC_ASSERT_TRUE(near(50, x));
+	ZUC_ASSERT_TRUE(near(50, y));
+
+	ZUC_ASSERT_EQ(15, resample_ms(&history, 15, &x, &y));
+	ZUC_ASSERT_TRUE(near(200, x));
+	ZUC_ASSERT_TRUE(near(0, y));
+
+	/* exactly on a sample */
+	ZUC_ASSERT_EQ(10, resample_ms(&history, 10, &x, &y));
+	ZUC_ASSERT_TRUE(near(100, x));
+}
+
+ZUC_TEST(touch_history_test, resample_extrapolation_is_bounded)
+{
+	struct touch_history history;
+	double x, y;
+
+	touch_history_reset(&history);
+	record_ms(&history, 0, 0, 0);
+	record_ms(&history, 10, 100, 50);
+
+	/* at most half the last sample interval past the newest sample */
+	ZUC_ASSERT_EQ(15, resample_ms(&history, 40, &x, &y));
+	ZUC_ASSERT_TRUE(near(150, x));
+	ZUC_ASSERT_TRUE(near(75, y));
+
+	/* and never more than 8 ms */
+	touch_history_reset(&history);
+	record_ms(&history, 0, 0, 0);
+	record_ms(&history, 100, 100, 0);
+	ZUC_ASSERT_EQ(108, resample_ms(&history, 200, &x, &y));
+	ZUC_ASSERT_TRUE(near(108, x));
+}
+
+ZUC_TEST(touch_history_test, resample_before_oldest)
+{
+	struct touch_history history;
+	double x, y;
+
+	touch_history_reset(&history);
+	record_ms(&history, 10, 1, 2);
+	record_ms(&history, 20, 3, 4);
+
+	ZUC_ASSERT_EQ(10, resample_ms(&history, 0, &x, &y));
+	ZUC_ASSERT_TRUE(near(1, x));
+	ZUC_ASSERT_TRUE(near(2, y));
+}
+
+ZUC_TEST(touch_history_test, resample_same_timestamps)
+{
+	struct touch_history history;
+	double x, y;
+
+	touch_history_reset(&history);
+	record_ms(&history, 10, 1, 2);
+	record_ms(&history, 10, 3, 4);
+
+	/* no interval to extrapolate from, the newest sample is kept */
+	ZUC_ASSERT_EQ(10, resample_ms(&history, 20, &x, &y));
+	ZUC_ASSERT_TRUE(near(3, x));
+	ZUC_ASSERT_TRUE(near(4, y));
+}
+
+ZUC_TEST(touch_history_test, predict_needs_two_samples)
+{
+	struct touch_history history;
+	double x = -1, y = -1;
+
+	touch_history_reset(&history);
+	ZUC_ASSERT_FALSE(predict_ms(&history, 0, 10, &x, &y));
+
+	record_ms(&history, 0, 5, 5);
+	ZUC_ASSERT_FALSE(predict_ms(&history, 0, 10, &x, &y));
+
+	/* no time between the samples */
+	record_ms(&history, 0, 6, 6);
+	ZUC_ASSERT_FALSE(predict_ms(&history, 0, 10, &x, &y));
+
+	ZUC_ASSERT_TRUE(near(-1, x));
+	ZUC_ASSERT_TRUE(near(-1, y));
+}
+
+ZUC_TEST(touch_history_test, predict_constant_velocity)
+{
+	struct touch_history history;
+	double x, y;
+	int i;
+
+	/* 1000 px/s right, 500 px/s up */
+	touch_history_reset(&history);
+	for (i = 0; i < 6; i++)
+		record_ms(&history, i * 5, 100 + i * 5, 200 - i * 2.5);
+
+	ZUC_ASSERT_TRUE(predict_ms(&history, 25, 20, &x, &y));
+	ZUC_ASSERT_TRUE(near(125 + 20, x));
+	ZUC_ASSERT_TRUE(near(187.5 - 10, y));
+
+	/* the time since the newest sample counts as well */
+	ZUC_ASSERT_TRUE(predict_ms(&history, 30, 20, &x, &y));
+	ZUC_ASSERT_TRUE(near(125 + 25, x));
+}
+
+ZUC_TEST(touch_history_test, predict_stationary)
+{
+	struct touch_history history;
+	double x, y;
+	int i;
+
+	touch_history_reset(&history);
+	for (i = 0; i < 4; i++)
+		record_ms(&history, i * 8, 42, 24);
+
+	ZUC_ASSERT_TRUE(predict_ms(&history, 24, 30, &x, &y));
+	ZUC_ASSERT_TRUE(near(42, x));
+	ZUC_ASSERT_TRUE(near(24, y));
+}
+
+ZUC_TEST(touch_history_test, predict_ignores_old_samples)
+{
+	struct touch_history history;
+	double x, y;
+
+	/* a jump long before the recent, steady motion */
+	touch_history_reset(&history);
+	record_ms(&history, 0, 1000, 1000);
+	record_ms(&history, 100, 0, 0);
+	record_ms(&history, 110, 10, 0);
+	record_ms(&history, 120, 20, 0);
+
+	ZUC_ASSERT_TRUE(predict_ms(&history, 120, 10, &x, &y));
+	ZUC_ASSERT_TRUE(near(30, x));
+	ZUC_ASSERT_TRUE(near(0, y));
+}
+
+ZUC_TEST(touch_history_test, predict_horizon_is_bounded)
+{
+	struct touch_history history;
+	double x, y;
+
+	touch_history_reset(&history);
+	record_ms(&history, 0, 0, 0);
+	record_ms(&history, 10, 10, 0);
+
+	/* a stale touch point is not extrapolated any further than 50 ms
+	 * past its newest sample plus the prediction interval */
+	ZUC_ASSERT_TRUE(predict_ms(&history, 10000, 10, &x, &y));
+	ZUC_ASSERT_TRUE(near(10 + 60, x));
+}
@@ -0,0 +1,427 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "wcap-encode.h"
+#include "wcap/wcap-decode.h"
+
+#include "shared/helpers.h"
+#include "zunitc/zunitc.h"
+
+/*
+ * Records synthetic frames with the recorder's encoder, the way
+ * weston_recorder writes them, and checks that wcap_decoder brings back
+ * every picture, by playing the file through and by seeking.
+ */
+
+#define WIDTH 97
+#define HEIGHT 61
+#define NFRAMES 40
+#define KEYFRAME_INTERVAL 8
+
+struct recording {
+	char path[64];
+	uint32_t pictures[NFRAMES][WIDTH * HEIGHT];
+	struct wcap_index_entry index[NFRAMES];
+	uint64_t index_offset;
+	size_t size;
+};
+
+/* A rectangle that moves and changes size from frame to frame */
+static void
+frame_damage(int n, struct wcap_rectangle *rect)
+{
+	if (n == 0) {
+		rect->x1 = 0;
+		rect->y1 = 0;
+		rect->x2 = WIDTH;
+		rect->y2 = HEIGHT;
+		return;
+	}
+
+	rect->x1 = (n * 13) % (WIDTH - 20);
+	rect->y1 = (n * 7) % (HEIGHT - 10);
+	rect->x2 = rect->x1 + 5 + (n * 3) % 15;
+	rect->y2 = rect->y1 + 3 + n % 7;
+}
+
+static uint32_t
+frame_pixel(int n, int x, int y)
+{
+	/* runs of equal pixels as well as changing ones */
+	if ((x / 4 + n) % 3 == 0)
+		return 0xff000000 | (n * 0x010203);
+
+	return 0xff000000 | ((x * 5 + n) & 0xff) << 16 |
+	       ((y * 3 + n * 2) & 0xff) << 8 | ((x ^ y ^ n) & 0xff);
+}
+
+static void
+write_all(FILE *fp, const void *data, size_t size)
+{
+	ZUC_ASSERT_EQ(1, fwrite(data, size, 1, fp));
+}
+
+static void
+write_frame(struct recording *rec, FILE *fp, int n, uint32_t *frame,
+	    bool yflip)
+{
+	struct wcap_frame_header_v2 header;
+	struct wcap_checksum checksum;
+	struct wcap_rectangle rect, bands[2];
+	uint32_t *pixels, *out;
+	size_t len[2];
+	int x, y, row, width, height, nrects, i;
+
+	frame_damage(n, &rect);
+	width = rect.x2 - rect.x1;
+	height = rect.y2 - rect.y1;
+
+	/* new contents of the damage, in the renderer's row order */
+	pixels = malloc(width * height * 4);
+	out = malloc(WIDTH * HEIGHT * 4);
+	ZUC_ASSERT_NOT_NULL(pixels);
+	ZUC_ASSERT_NOT_NULL(out);
+	for (y = 0; y < height; y++) {
+		row = yflip ? y : height - y - 1;
+		for (x = 0; x < width; x++)
+			pixels[row * width + x] =
+				frame_pixel(n, rect.x1 + x, rect.y1 + y);
+	}
+
+	header.flags = 0;
+	nrects = 1;
+	len[0] = wcap_encode_rect(frame, WIDTH, &rect, pixels, yflip, out);
+	bands[0] = rect;
+
+	/* Keyframes are redone from the whole picture, in two bands */
+	if (n % KEYFRAME_INTERVAL == 0) {
+		header.flags = WCAP_FRAME_KEYFRAME;
+		nrects = 2;
+		bands[0] = (struct wcap_rectangle) { 0, 0, WIDTH, HEIGHT / 2 };
+		bands[1] = (struct wcap_rectangle) {
+			0, HEIGHT / 2, WIDTH, HEIGHT
+		};
+		len[0] = wcap_encode_key_rect(frame, WIDTH, &bands[0], out);
+		len[1] = wcap_encode_key_rect(frame, WIDTH, &bands[1],
+					      out + len[0]);
+	}
+
+	memcpy(rec->pictures[n], frame, sizeof rec->pictures[n]);
+
+	header.msecs = n * 16;
+	header.nrects = nrects;
+	header.size = nrects * sizeof bands[0];
+	wcap_checksum_init(&checksum);
+	wcap_checksum_update(&checksum, bands, header.size);
+	for (i = 0; i < nrects; i++) {
+		header.size += len[i] * 4;
+		wcap_checksum_update(&checksum,
+				     out + (i ? len[0] : 0), len[i] * 4);
+	}
+	header.checksum = wcap_checksum_final(&checksum);
+
+	rec->index[n].offset = ftell(fp);
+	rec->index[n].msecs = header.msecs;
+	rec->index[n].flags = header.flags;
+
+	write_all(fp, &header, sizeof header);
+	write_all(fp, bands, nrects * sizeof bands[0]);
+	write_all(fp, out, (len[0] + (nrects > 1 ? len[1] : 0)) * 4);
+
+	free(out);
+	free(pixels);
+}
+
+static void
+record(struct recording *rec, bool yflip, bool with_index)
+{
+	struct wcap_header header = {
+		.magic = WCAP_HEADER_MAGIC_V2,
+		.format = WCAP_FORMAT_XRGB8888,
+		.width = WIDTH,
+		.height = HEIGHT,
+	};
+	struct wcap_index_trailer trailer;
+	uint32_t *frame;
+	FILE *fp;
+	int fd, n;
+
+	frame = calloc(WIDTH * HEIGHT, 4);
+	ZUC_ASSERT_NOT_NULL(frame);
+
+	strcpy(rec->path, "/tmp/weston-wcap-test-XXXXXX");
+	fd = mkstemp(rec->path);
+	ZUC_ASSERT_TRUE(fd >= 0);
+	fp = fdopen(fd, "w");
+	ZUC_ASSERT_NOT_NULL(fp);
+
+	write_all(fp, &header, sizeof header);
+	for (n = 0; n < NFRAMES; n++)
+		write_frame(rec, fp, n, frame, yflip);
+
+	rec->index_offset = ftell(fp);
+	if (with_index) {
+		trailer.magic = WCAP_INDEX_MAGIC;
+		trailer.nframes = NFRAMES;
+		trailer.offset = rec->index_offset;
+		write_all(fp, rec->index, sizeof rec->index);
+		write_all(fp, &trailer, sizeof trailer);
+	}
+
+	rec->size = ftell(fp);
+	ZUC_ASSERT_EQ(0, fclose(fp));
+	free(frame);
+}
+
+static struct recording *
+recording_create(void)
+{
+	/* the pictures are too big for the stack */
+	return calloc(1, sizeof (struct recording));
+}
+
+static void
+recording_destroy(struct recording *rec)
+{
+	unlink(rec->path);
+	free(rec);
+}
+
+/* Overwrites part of the file */
+static void
+patch(struct recording *rec, long offset, const void *data, size_t size)
+{
+	FILE *fp;
+
+	fp = fopen(rec->path, "r+");
+	ZUC_ASSERT_NOT_NULL(fp);
+	ZUC_ASSERT_EQ(0, fseek(fp, offset, SEEK_SET));
+	write_all(fp, data, size);
+	ZUC_ASSERT_EQ(0, fclose(fp));
+}
+
+static bool
+picture_matches(struct wcap_decoder *decoder, const uint32_t *picture)
+{
+	int i;
+
+	for (i = 0; i < WIDTH * HEIGHT; i++) {
+		if ((decoder->frame[i] & 0x00ffffff) !=
+		    (picture[i] & 0x00ffffff))
+			return false;
+	}
+
+	return true;
+}
+
+static void
+check_playback(struct recording *rec, struct wcap_decoder *decoder)
+{
+	int n;
+
+	ZUC_ASSERT_EQ(WIDTH, decoder->width);
+	ZUC_ASSERT_EQ(HEIGHT, decoder->height);
+
+	for (n = 0; n < NFRAMES; n++) {
+		ZUC_ASSERT_EQ(1, wcap_decoder_get_frame(decoder));
+		ZUC_ASSERT_EQ(n * 16, decoder->msecs);
+		ZUC_ASSERT_TRUE(picture_matches(decoder, rec->pictures[n]));
+	}
+
+	ZUC_ASSERT_EQ(0, wcap_decoder_get_frame(decoder));
+}
+
+static void
+check_seeking(struct recording *rec, struct wcap_decoder *decoder)
+{
+	static const int frames[] = { 30, 5, 39, 16, 17, 0, 23, 9 };
+	unsigned i;
+
+	for (i = 0; i < ARRAY_LENGTH(frames); i++) {
+		ZUC_ASSERT_EQ(1, wcap_decoder_seek(decoder, frames[i]));
+		ZUC_ASSERT_TRUE(picture_matches(decoder,
+						rec->pictures[frames[i]]));
+	}
+}
+
+ZUC_TEST(wcap_test, round_trip)
+{
+	struct recording *rec = recording_create();
+	struct wcap_decoder *decoder;
+
+	ZUC_ASSERT_NOT_NULL(rec);
+	record(rec, true, true);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+
+	decoder = wcap_decoder_create(rec->path);
+	ZUC_ASSERT_NOT_NULL(decoder);
+	ZUC_ASSERT_NOT_NULL(decoder->index);
+	ZUC_ASSERT_EQ(NFRAMES, decoder->nframes);
+	check_playback(rec, decoder);
+	wcap_decoder_destroy(decoder);
+
+	recording_destroy(rec);
+}
+
+ZUC_TEST(wcap_test, round_trip_bottom_up)
+{
+	struct recording *rec = recording_create();
+	struct wcap_decoder *decoder;
+
+	ZUC_ASSERT_NOT_NULL(rec);
+	record(rec, false, true);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+
+	decoder = wcap_decoder_create(rec->path);
+	ZUC_ASSERT_NOT_NULL(decoder);
+	check_playback(rec, decoder);
+	wcap_decoder_destroy(decoder);
+
+	recording_destroy(rec);
+}
+
+ZUC_TEST(wcap_test, seek_with_index)
+{
+	struct recording *rec = recording_create();
+	struct wcap_decoder *decoder;
+
+	ZUC_ASSERT_NOT_NULL(rec);
+	record(rec, true, true);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+
+	decoder = wcap_decoder_create(rec->path);
+	ZUC_ASSERT_NOT_NULL(decoder);
+	check_seeking(rec, decoder);
+	ZUC_ASSERT_EQ(0, wcap_decoder_seek(decoder, NFRAMES));
+	ZUC_ASSERT_EQ(17, wcap_decoder_find_frame(decoder, 17 * 16 - 3));
+	wcap_decoder_destroy(decoder);
+
+	recording_destroy(rec);
+}
+
+ZUC_TEST(wcap_test, no_index_is_scanned)
+{
+	struct recording *rec = recording_create();
+	struct wcap_decoder *decoder;
+
+	ZUC_ASSERT_NOT_NULL(rec);
+	record(rec, true, false);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+
+	decoder = wcap_decoder_create(rec->path);
+	ZUC_ASSERT_NOT_NULL(decoder);
+	ZUC_ASSERT_EQ(NFRAMES, decoder->nframes);
+	check_seeking(rec, decoder);
+	wcap_decoder_destroy(decoder);
+
+	recording_destroy(rec);
+}
+
+ZUC_TEST(wcap_test, unordered_index_is_scanned)
+{
+	struct recording *rec = recording_create();
+	struct wcap_decoder *decoder;
+	uint64_t offset;
+
+	ZUC_ASSERT_NOT_NULL(rec);
+	record(rec, true, true);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+
+	/* frame 5 claims to start where frame 3 does */
+	offset = rec->index[3].offset;
+	patch(rec, rec->index_offset + 5 * sizeof rec->index[0],
+	      &offset, sizeof offset);
+
+	decoder = wcap_decoder_create(rec->path);
+	ZUC_ASSERT_NOT_NULL(decoder);
+	ZUC_ASSERT_EQ(rec->index[5].offset, decoder->index[5].offset);
+	check_seeking(rec, decoder);
+	wcap_decoder_destroy(decoder);
+
+	recording_destroy(rec);
+}
+
+ZUC_TEST(wcap_test, index_past_the_frames_is_scanned)
+{
+	struct recording *rec = recording_create();
+	struct wcap_decoder *decoder;
+	uint64_t offset;
+
+	ZUC_ASSERT_NOT_NULL(rec);
+	record(rec, true, true);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+
+	/* the last frame's header would run into the index */
+	offset = rec->index_offset - 4;
+	patch(rec, rec->index_offset + (NFRAMES - 1) * sizeof rec->index[0],
+	      &offset, sizeof offset);
+
+	decoder = wcap_decoder_create(rec->path);
+	ZUC_ASSERT_NOT_NULL(decoder);
+	ZUC_ASSERT_EQ(rec->index[NFRAMES - 1].offset,
+		      decoder->index[NFRAMES - 1].offset);
+	check_seeking(rec, decoder);
+	wcap_decoder_destroy(decoder);
+
+	recording_destroy(rec);
+}
+
+ZUC_TEST(wcap_test, overflowing_trailer_is_scanned)
+{
+	struct recording *rec = recording_create();
+	struct wcap_decoder *decoder;
+	struct wcap_index_trailer trailer = {
+		.magic = WCAP_INDEX_MAGIC,
+	};
+
+	ZUC_ASSERT_NOT_NULL(rec);
+	record(rec, true, true);
+	ZUC_ASSERT_FALSE(zuc_has_failure());
+
+	/* offset + index size + trailer size wraps around to the size, with
+	 * an index small enough to be allocated */
+	trailer.nframes = 1 << 20;
+	ZUC_ASSERT_TRUE(trailer.nframes * sizeof rec->index[0] > rec->size);
+	trailer.offset = (uint64_t) rec->size - sizeof trailer -
+			 (uint64_t) trailer.nframes * sizeof rec->index[0];
+	patch(rec, rec->size - sizeof trailer, &trailer, sizeof trailer);
+
+	decoder = wcap_decoder_create(rec->path);
+	ZUC_ASSERT_NOT_NULL(decoder);
+	ZUC_ASSERT_TRUE(decoder->nframes >= NFRAMES);
+	check_seeking(rec, decoder);
+	wcap_decoder_destroy(decoder);
+
+	recording_destroy(rec);
+}
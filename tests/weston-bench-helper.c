@@ -0,0 +1,229 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "weston-bench-helper.h"
+
+void
+bench_samples_init(struct bench_samples *samples)
+{
+	memset(samples, 0, sizeof *samples);
+}
+
+void
+bench_samples_release(struct bench_samples *samples)
+{
+	free(samples->nsec);
+	bench_samples_init(samples);
+}
+
+void
+bench_samples_add(struct bench_samples *samples, int64_t nsec)
+{
+	if (samples->count == samples->alloc) {
+		samples->alloc = samples->alloc ? samples->alloc * 2 : 256;
+		samples->nsec = realloc(samples->nsec,
+					samples->alloc * sizeof(int64_t));
+		assert(samples->nsec);
+	}
+
+	samples->nsec[samples->count++] = nsec;
+}
+
+static int
+compare_int64(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a;
+	int64_t y = *(const int64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int64_t
+percentile(const int64_t *sorted, unsigned count, unsigned pct)
+{
+	return sorted[(uint64_t)(count - 1) * pct / 100];
+}
+
+void
+bench_samples_summarize(struct bench_samples *samples,
+			struct bench_summary *summary)
+{
+	double sum = 0.0;
+	unsigned i;
+
+	memset(summary, 0, sizeof *summary);
+	summary->count = samples->count;
+	if (samples->count == 0)
+		return;
+
+	qsort(samples->nsec, samples->count, sizeof(int64_t), compare_int64);
+
+	for (i = 0; i < samples->count; i++)
+		sum += samples->nsec[i];
+
+	summary->min = samples->nsec[0];
+	summary->max = samples->nsec[samples->count - 1];
+	summary->p50 = percentile(samples->nsec, samples->count, 50);
+	summary->p90 = percentile(samples->nsec, samples->count, 90);
+	summary->p99 = percentile(samples->nsec, samples->count, 99);
+	summary->mean = sum / samples->count;
+}
+
+int
+bench_env_int(const char *name, int default_value)
+{
+	const char *str = getenv(name);
+	char *end;
+	long value;
+
+	if (!str || *str == '\0')
+		return default_value;
+
+	value = strtol(str, &end, 10);
+	if (*end != '\0' || value < 0) {
+		fprintf(stderr, "Ignoring invalid %s=%s\n", name, str);
+		return default_value;
+	}
+
+	return value;
+}
+
+static int
+read_proc_stat(pid_t pid, pid_t *ppid, int64_t *cpu_ticks)
+{
+	char path[64];
+	char buf[1024];
+	unsigned long long utime, stime;
+	FILE *fp;
+	char *p;
+	int parent;
+	size_t len;
+
+	snprintf(path, sizeof path, "/proc/%d/stat", (int)pid);
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+
+	len = fread(buf, 1, sizeof buf - 1, fp);
+	fclose(fp);
+	buf[len] = '\0';
+
+	/* The command name may contain spaces and parentheses. */
+	p = strrchr(buf, ')');
+	if (!p)
+		return -1;
+
+	if (sscanf(p + 1, " %*c %d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+		   "%llu %llu", &parent, &utime, &stime) != 3)
+		return -1;
+
+	if (ppid)
+		*ppid = parent;
+	if (cpu_ticks)
+		*cpu_ticks = utime + stime;
+
+	return 0;
+}
+
+/** Find the compositor that launched this test client
+ *
+ * The test runner forks every test, so the compositor is the parent of
+ * our parent.
+ */
+pid_t
+bench_compositor_pid(void)
+{
+	pid_t ppid;
+
+	if (read_proc_stat(getppid(), &ppid, NULL) < 0)
+		return -1;
+
+	return ppid;
+}
+
+/** Return user plus system CPU time consumed by a process, or -1 */
+int64_t
+bench_process_cpu_time_nsec(pid_t pid)
+{
+	long hz = sysconf(_SC_CLK_TCK);
+	int64_t ticks;
+
+	if (pid <= 0 || hz <= 0 || read_proc_stat(pid, NULL, &ticks) < 0)
+		return -1;
+
+	return ticks * (1000000000LL / hz);
+}
+
+/** Open the JSON result stream
+ *
+ * Results go to the file named by WESTON_BENCH_OUTPUT, appended as one
+ * JSON object per line, or to stdout by default.
+ */
+FILE *
+bench_json_open(void)
+{
+	const char *path = getenv("WESTON_BENCH_OUTPUT");
+	FILE *fp;
+
+	if (!path || *path == '\0')
+		return stdout;
+
+	fp = fopen(path, "a");
+	assert(fp && "cannot open WESTON_BENCH_OUTPUT");
+
+	return fp;
+}
+
+void
+bench_json_close(FILE *fp)
+{
+	if (fp == stdout)
+		fflush(fp);
+	else
+		fclose(fp);
+}
+
+void
+bench_json_print_samples(FILE *fp, const char *key,
+			 struct bench_samples *samples)
+{
+	struct bench_summary s;
+
+	bench_samples_summarize(samples, &s);
+
+	fprintf(fp, "\"%s\": { \"count\": %u, \"min_us\": %.3f, "
+		"\"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, "
+		"\"max_us\": %.3f, \"mean_us\": %.3f }",
+		key, s.count, s.min / 1e3, s.p50 / 1e3, s.p90 / 1e3,
+		s.p99 / 1e3, s.max / 1e3, s.mean / 1e3);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WESTON_BENCH_HELPER_H_
+#define _WESTON_BENCH_HELPER_H_
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/** A growing set of duration samples, in nanoseconds */
+struct bench_samples {
+	int64_t *nsec;
+	unsigned count;
+	unsigned alloc;
+};
+
+struct bench_summary {
+	unsigned count;
+	int64_t min;
+	int64_t p50;
+	int64_t p90;
+	int64_t p99;
+	int64_t max;
+	double mean;
+};
+
+void
+bench_samples_init(struct bench_samples *samples);
+
+void
+bench_samples_release(struct bench_samples *samples);
+
+void
+bench_samples_add(struct bench_samples *samples, int64_t nsec);
+
+void
+bench_samples_summarize(struct bench_samples *samples,
+			struct bench_summary *summary);
+
+int
+bench_env_int(const char *name, int default_value);
+
+pid_t
+bench_compositor_pid(void);
+
+int64_t
+bench_process_cpu_time_nsec(pid_t pid);
+
+FILE *
+bench_json_open(void);
+
+void
+bench_json_close(FILE *fp);
+
+void
+bench_json_print_samples(FILE *fp, const char *key,
+			 struct bench_samples *samples);
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Xwayland window creation benchmark
+ *
+ * Creates and maps a large number of override-redirect windows, as menus,
+ * tooltips and Java or Wine applications do, then maps one managed window.
+ * The window manager handles events in order, so once that window is
+ * mapped it has gone through the creation of all the others. The time
+ * from the first XCreateWindow() to that point, and the compositor CPU time
+ * spent meanwhile, are reported per round as JSON.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <X11/Xlib.h>
+
+#include "shared/timespec-util.h"
+#include "shared/xalloc.h"
+#include "weston-test-runner.h"
+#include "weston-bench-helper.h"
+
+static Window
+create_window(Display *display, Window root, int i, Bool override)
+{
+	XSetWindowAttributes attr = { .override_redirect = override };
+
+	return XCreateWindow(display, root, i % 100, i % 100, 10, 10, 0,
+			     CopyFromParent, InputOutput, CopyFromParent,
+			     CWOverrideRedirect, &attr);
+}
+
+/* Map a managed window and wait until the window manager has mapped it.
+ *
+ * Before mapping a window, the window manager completes every window
+ * created before it, so once the MapNotify is in, the replies to the
+ * requests it made for all earlier windows have been processed. */
+static void
+sync_with_wm(Display *display, Window root)
+{
+	Window window;
+	XEvent event;
+
+	window = create_window(display, root, 0, False);
+	XSelectInput(display, window, StructureNotifyMask);
+	XMapWindow(display, window);
+
+	do {
+		XNextEvent(display, &event);
+	} while (event.type != MapNotify || event.xmap.window != window);
+
+	XDestroyWindow(display, window);
+}
+
+TEST(xwayland_windows_benchmark)
+{
+	struct bench_samples create, compositor_cpu;
+	struct timespec start, end;
+	Display *display;
+	Window root, *windows;
+	pid_t compositor;
+	int64_t cpu_start, cpu_end;
+	int n_windows, rounds, round, i;
+	FILE *json;
+
+	if (access(XSERVER_PATH, X_OK) != 0)
+		exit(77);
+
+	n_windows = bench_env_int("WESTON_BENCH_WINDOWS", 10000);
+	rounds = bench_env_int("WESTON_BENCH_ROUNDS", 5);
+	assert(n_windows > 0 && rounds > 0);
+
+	display = XOpenDisplay(NULL);
+	assert(display);
+	root = DefaultRootWindow(display);
+
+	windows = xzalloc(n_windows * sizeof *windows);
+	compositor = bench_compositor_pid();
+
+	bench_samples_init(&create);
+	bench_samples_init(&compositor_cpu);
+
+	/* Warm up the window manager and the X server */
+	sync_with_wm(display, root);
+
+	for (round = 0; round < rounds; round++) {
+		cpu_start = bench_process_cpu_time_nsec(compositor);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		for (i = 0; i < n_windows; i++) {
+			windows[i] = create_window(display, root, i, True);
+			XMapWindow(display, windows[i]);
+		}
+		sync_with_wm(display, root);
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		cpu_end = bench_process_cpu_time_nsec(compositor);
+
+		bench_samples_add(&create, timespec_sub_to_nsec(&end, &start));
+		if (cpu_start >= 0 && cpu_end >= 0)
+			bench_samples_add(&compositor_cpu, cpu_end - cpu_start);
+
+		for (i = 0; i < n_windows; i++)
+			XDestroyWindow(display, windows[i]);
+		XSync(display, False);
+	}
+
+	json = bench_json_open();
+	fprintf(json, "{ \"benchmark\": \"xwayland-windows\", "
+		"\"windows\": %d, \"rounds\": %d, ", n_windows, rounds);
+	bench_json_print_samples(json, "create_to_wm_sync", &create);
+	fprintf(json, ", ");
+	bench_json_print_samples(json, "compositor_cpu", &compositor_cpu);
+	fprintf(json, " }\n");
+	bench_json_close(json);
+
+	bench_samples_release(&create);
+	bench_samples_release(&compositor_cpu);
+	free(windows);
+	XCloseDisplay(display);
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "timeline-decode.h"
+
+static void
+usage(int exit_code)
+{
+	fprintf(stderr, "usage: weston-timeline-decode [--help] "
+		"[<input> [<output>]]\n\n"
+		"Converts a stream recorded from the 'timeline-binary' debug\n"
+		"scope into the JSON timeline format read by wesgr.\n"
+		"Reads from stdin and writes to stdout by default.\n\n");
+
+	exit(exit_code);
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *in = stdin;
+	FILE *out = stdout;
+	int ret;
+
+	if (argc > 1 && strcmp(argv[1], "--help") == 0)
+		usage(EXIT_SUCCESS);
+	if (argc > 3)
+		usage(EXIT_FAILURE);
+
+	if (argc > 1 && strcmp(argv[1], "-") != 0) {
+		in = fopen(argv[1], "rb");
+		if (!in) {
+			perror(argv[1]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc > 2 && strcmp(argv[2], "-") != 0) {
+		out = fopen(argv[2], "w");
+		if (!out) {
+			perror(argv[2]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	ret = timeline_decode(in, out);
+
+	if (in != stdin)
+		fclose(in);
+	if (out != stdout)
+		fclose(out);
+
+	return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,252 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+
+#include "shared/timeline-binary.h"
+#include "timeline-decode.h"
+
+struct decoder {
+	FILE *in;
+	FILE *out;
+	char **names;
+	uint32_t names_size;
+
+	/* values of the aux records read so far, by flag bit */
+	uint64_t aux[WESTON_TIMELINE_BINARY_AUX_SLOTS];
+};
+
+static int
+read_record(struct decoder *dec, struct weston_timeline_binary_record *rec)
+{
+	return fread(rec, sizeof(*rec), 1, dec->in) == 1 ? 0 : -1;
+}
+
+/* Reads the string payload following a definition record. Returns NULL on
+ * a truncated stream, or an empty string for a NULL definition. */
+static char *
+read_payload(struct decoder *dec,
+	     const struct weston_timeline_binary_record *def)
+{
+	struct weston_timeline_binary_record rec;
+	size_t off;
+	char *str;
+
+	str = calloc(1, def->len + 1);
+	if (!str)
+		return NULL;
+
+	for (off = 0; off < def->len; off += sizeof(rec)) {
+		size_t n = def->len - off;
+
+		if (read_record(dec, &rec) < 0) {
+			free(str);
+			return NULL;
+		}
+
+		if (n > sizeof(rec))
+			n = sizeof(rec);
+		memcpy(str + off, &rec, n);
+	}
+
+	return str;
+}
+
+static int
+set_name(struct decoder *dec, uint32_t id, char *name)
+{
+	if (id >= dec->names_size) {
+		uint32_t size = dec->names_size ? dec->names_size : 32;
+		char **names;
+
+		while (size <= id)
+			size *= 2;
+
+		names = realloc(dec->names, size * sizeof(*names));
+		if (!names)
+			return -1;
+
+		memset(names + dec->names_size, 0,
+		       (size - dec->names_size) * sizeof(*names));
+		dec->names = names;
+		dec->names_size = size;
+	}
+
+	free(dec->names[id]);
+	dec->names[id] = name;
+
+	return 0;
+}
+
+static void
+print_string(struct decoder *dec,
+	     const struct weston_timeline_binary_record *def, const char *str)
+{
+	if (def->flags & WESTON_TIMELINE_BINARY_FLAG_NULL)
+		fprintf(dec->out, "null");
+	else
+		fprintf(dec->out, "\"%s\"", str);
+}
+
+static void
+print_timestamp(struct decoder *dec, const char *key, uint64_t nsec)
+{
+	fprintf(dec->out, ", \"%s\":[%" PRIu64 ", %" PRIu64 "]", key,
+		nsec / 1000000000, nsec % 1000000000);
+}
+
+static void
+print_point(struct decoder *dec, const struct weston_timeline_binary_record *rec)
+{
+	const char *name = NULL;
+
+	if (rec->id < dec->names_size)
+		name = dec->names[rec->id];
+
+	fprintf(dec->out, "{ \"T\":[%" PRIu64 ", %" PRIu64 "], \"N\":\"%s\"",
+		rec->t / 1000000000, rec->t % 1000000000,
+		name ? name : "unknown");
+
+	if (rec->output)
+		fprintf(dec->out, ", \"wo\":%u", rec->output);
+	if (rec->surface)
+		fprintf(dec->out, ", \"ws\":%u", rec->surface);
+	if (rec->flags & WESTON_TIMELINE_BINARY_FLAG_VBLANK)
+		print_timestamp(dec, "vblank",
+				weston_timeline_binary_aux(rec, dec->aux,
+					WESTON_TIMELINE_BINARY_FLAG_VBLANK));
+	if (rec->flags & WESTON_TIMELINE_BINARY_FLAG_GPU)
+		print_timestamp(dec, "gpu",
+				weston_timeline_binary_aux(rec, dec->aux,
+					WESTON_TIMELINE_BINARY_FLAG_GPU));
+	if (rec->flags & WESTON_TIMELINE_BINARY_FLAG_INPUT)
+		fprintf(dec->out, ", \"input\":%" PRIu64,
+			weston_timeline_binary_aux(rec, dec->aux,
+				WESTON_TIMELINE_BINARY_FLAG_INPUT));
+
+	fprintf(dec->out, " }\n");
+}
+
+static int
+decode(struct decoder *dec)
+{
+	struct weston_timeline_binary_record rec;
+	char *str;
+
+	if (read_record(dec, &rec) < 0 ||
+	    rec.type != WESTON_TIMELINE_BINARY_HEADER ||
+	    rec.aux != WESTON_TIMELINE_BINARY_MAGIC) {
+		fprintf(stderr, "not a binary timeline stream\n");
+		return -1;
+	}
+
+	/* Version 1 had no aux records; it is read the same way. */
+	if (rec.id < 1 || rec.id > WESTON_TIMELINE_BINARY_VERSION) {
+		fprintf(stderr, "unsupported binary timeline version %u\n",
+			rec.id);
+		return -1;
+	}
+
+	while (read_record(dec, &rec) == 0) {
+		switch (rec.type) {
+		case WESTON_TIMELINE_BINARY_NAME:
+			str = read_payload(dec, &rec);
+			if (!str || set_name(dec, rec.id, str) < 0)
+				goto truncated;
+			break;
+		case WESTON_TIMELINE_BINARY_OUTPUT:
+			str = read_payload(dec, &rec);
+			if (!str)
+				goto truncated;
+			fprintf(dec->out, "{ \"id\":%u, "
+				"\"type\":\"weston_output\", \"name\":", rec.id);
+			print_string(dec, &rec, str);
+			fprintf(dec->out, " }\n");
+			free(str);
+			break;
+		case WESTON_TIMELINE_BINARY_SURFACE:
+			str = read_payload(dec, &rec);
+			if (!str)
+				goto truncated;
+			fprintf(dec->out, "{ \"id\":%u, "
+				"\"type\":\"weston_surface\", \"desc\":", rec.id);
+			print_string(dec, &rec, str);
+			if (rec.surface)
+				fprintf(dec->out, ", \"main_surface\":%u",
+					rec.surface);
+			fprintf(dec->out, " }\n");
+			free(str);
+			break;
+		case WESTON_TIMELINE_BINARY_POINT:
+			print_point(dec, &rec);
+			break;
+		case WESTON_TIMELINE_BINARY_AUX:
+			if (rec.flags != 0)
+				dec->aux[ffs(rec.flags) - 1] = rec.aux;
+			break;
+		case WESTON_TIMELINE_BINARY_HEADER:
+			/* concatenated streams */
+			break;
+		default:
+			fprintf(stderr, "unknown record type %u\n", rec.type);
+			return -1;
+		}
+	}
+
+	return 0;
+
+truncated:
+	fprintf(stderr, "truncated binary timeline stream\n");
+	return -1;
+}
+
+/** Convert a binary timeline stream to the JSON timeline format
+ *
+ * Reads records from in until the end of the stream and writes one JSON
+ * object per line to out. Returns 0 on success, or -1 if the stream is
+ * not a binary timeline or is truncated.
+ */
+int
+timeline_decode(FILE *in, FILE *out)
+{
+	struct decoder dec = { .in = in, .out = out };
+	uint32_t i;
+	int ret;
+
+	ret = decode(&dec);
+
+	for (i = 0; i < dec.names_size; i++)
+		free(dec.names[i]);
+	free(dec.names);
+
+	return ret;
+}
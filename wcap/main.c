@@ -36,6 +36,8 @@
 #include <string.h>
 #include <fcntl.h>
 #include <assert.h>
+#include <limits.h>
+#include <pthread.h>
 
 #include <cairo.h>
 
@@ -169,55 +171,334 @@ convert_to_yuv444(struct wcap_decoder *decoder, unsigned char *out)
 	}
 }
 
-static void
-output_yuv_frame(struct wcap_decoder *decoder, int depth)
+static size_t
+yuv_frame_size(struct wcap_decoder *decoder, int depth)
 {
-	static unsigned char *out;
-	int size;
-
-	if (depth == 444) {
-		size = decoder->width * decoder->height * 3;
-	} else {
-		size = decoder->width * decoder->height * 3 / 2;
-	}
-	if (out == NULL)
-		out = malloc(size);
+	if (depth == 444)
+		return decoder->width * decoder->height * 3;
+	else
+		return decoder->width * decoder->height * 3 / 2;
+}
 
+static void
+convert_yuv_frame(struct wcap_decoder *decoder, int depth, unsigned char *out)
+{
 	if (depth == 444) {
 		convert_to_yuv444(decoder, out);
 	} else {
 		convert_to_yv12(decoder, out);
 	}
+}
 
+static void
+write_yuv_frame(unsigned char *out, size_t size)
+{
 	printf("FRAME\n");
 	fwrite(out, 1, size, stdout);
 }
 
+static void
+output_yuv_frame(struct wcap_decoder *decoder, int depth)
+{
+	static unsigned char *out;
+	size_t size;
+
+	size = yuv_frame_size(decoder, depth);
+	if (out == NULL)
+		out = malloc(size);
+
+	convert_yuv_frame(decoder, depth, out);
+	write_yuv_frame(out, size);
+}
+
+/* Output frames are sampled at a fixed rate: each one shows the first
+ * recorded frame at or after its time. */
+struct output_timing {
+	uint32_t start;
+	uint32_t frame_time;
+};
+
+static int
+output_frame_count(struct wcap_decoder *decoder, struct output_timing *t)
+{
+	uint32_t last = decoder->index[decoder->nframes - 1].msecs;
+
+	return (last - t->start) / t->frame_time + 1;
+}
+
+static int
+seek_output_frame(struct wcap_decoder *decoder, struct output_timing *t,
+		  int i)
+{
+	int frame;
+
+	frame = wcap_decoder_find_frame(decoder, t->start + i * t->frame_time);
+
+	return wcap_decoder_seek(decoder, frame);
+}
+
+#define YUV_CHUNK_FRAMES 8
+
+struct yuv_slot {
+	int ready;
+	int nframes;
+	unsigned char *out;
+};
+
+/* Consecutive chunks of output frames are decoded and converted by a
+ * set of threads, each with its own decoder, and written in order. */
+struct yuv_job {
+	struct wcap_decoder *decoder;
+	struct output_timing *timing;
+	int depth;
+	size_t frame_size;
+	int first, last;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int nchunks, next_chunk, written;
+	int nslots;
+	struct yuv_slot *slots;
+};
+
+struct yuv_worker {
+	pthread_t thread;
+	struct yuv_job *job;
+	struct wcap_decoder *decoder;
+};
+
+static void *
+yuv_worker_thread(void *data)
+{
+	struct yuv_worker *worker = data;
+	struct yuv_job *job = worker->job;
+	struct yuv_slot *slot;
+	int c, i, start;
+
+	for (;;) {
+		pthread_mutex_lock(&job->mutex);
+		while (job->next_chunk < job->nchunks &&
+		       job->next_chunk - job->written >= job->nslots)
+			pthread_cond_wait(&job->cond, &job->mutex);
+		c = job->next_chunk;
+		if (c < job->nchunks)
+			job->next_chunk++;
+		pthread_mutex_unlock(&job->mutex);
+
+		if (c >= job->nchunks)
+			break;
+
+		slot = &job->slots[c % job->nslots];
+		start = job->first + c * YUV_CHUNK_FRAMES;
+		slot->nframes = job->last + 1 - start;
+		if (slot->nframes > YUV_CHUNK_FRAMES)
+			slot->nframes = YUV_CHUNK_FRAMES;
+
+		for (i = 0; i < slot->nframes; i++) {
+			seek_output_frame(worker->decoder, job->timing,
+					  start + i);
+			convert_yuv_frame(worker->decoder, job->depth,
+					  slot->out + i * job->frame_size);
+		}
+
+		pthread_mutex_lock(&job->mutex);
+		slot->ready = c + 1;
+		pthread_cond_broadcast(&job->cond);
+		pthread_mutex_unlock(&job->mutex);
+	}
+
+	return NULL;
+}
+
+static int
+output_yuv_range_threaded(struct wcap_decoder *decoder,
+			  struct output_timing *timing, int depth,
+			  int first, int last, int nthreads)
+{
+	struct yuv_job job = { 0 };
+	struct yuv_worker *workers;
+	struct yuv_slot *slot;
+	int c, i, n = 0, ret = -1;
+
+	job.decoder = decoder;
+	job.timing = timing;
+	job.depth = depth;
+	job.frame_size = yuv_frame_size(decoder, depth);
+	job.first = first;
+	job.last = last;
+	job.nchunks = (last - first + YUV_CHUNK_FRAMES) / YUV_CHUNK_FRAMES;
+	job.nslots = nthreads * 2;
+	pthread_mutex_init(&job.mutex, NULL);
+	pthread_cond_init(&job.cond, NULL);
+
+	workers = calloc(nthreads, sizeof *workers);
+	job.slots = calloc(job.nslots, sizeof *job.slots);
+	if (workers == NULL || job.slots == NULL)
+		goto out;
+
+	for (i = 0; i < job.nslots; i++) {
+		job.slots[i].out = malloc(job.frame_size * YUV_CHUNK_FRAMES);
+		if (job.slots[i].out == NULL)
+			goto out;
+	}
+
+	for (n = 0; n < nthreads; n++) {
+		workers[n].job = &job;
+		workers[n].decoder = wcap_decoder_clone(decoder);
+		if (workers[n].decoder == NULL)
+			break;
+		if (pthread_create(&workers[n].thread, NULL,
+				   yuv_worker_thread, &workers[n]) != 0) {
+			wcap_decoder_destroy(workers[n].decoder);
+			break;
+		}
+	}
+	if (n == 0)
+		goto out;
+
+	for (c = 0; c < job.nchunks; c++) {
+		slot = &job.slots[c % job.nslots];
+
+		pthread_mutex_lock(&job.mutex);
+		while (slot->ready != c + 1)
+			pthread_cond_wait(&job.cond, &job.mutex);
+		pthread_mutex_unlock(&job.mutex);
+
+		for (i = 0; i < slot->nframes; i++)
+			write_yuv_frame(slot->out + i * job.frame_size,
+					job.frame_size);
+
+		pthread_mutex_lock(&job.mutex);
+		job.written++;
+		pthread_cond_broadcast(&job.cond);
+		pthread_mutex_unlock(&job.mutex);
+	}
+
+	ret = 0;
+
+out:
+	while (n > 0) {
+		n--;
+		pthread_join(workers[n].thread, NULL);
+		wcap_decoder_destroy(workers[n].decoder);
+	}
+	if (job.slots) {
+		for (i = 0; i < job.nslots; i++)
+			free(job.slots[i].out);
+	}
+	free(job.slots);
+	free(workers);
+	pthread_cond_destroy(&job.cond);
+	pthread_mutex_destroy(&job.mutex);
+
+	return ret;
+}
+
 static void
 usage(int exit_code)
 {
 	fprintf(stderr, "usage: wcap-decode "
 		"[--help] [--yuv4mpeg2] [--frame=<frame>] [--all] \n"
+		"\t[--range=<first>:<last>] [--threads=<n>]\n"
 		"\t[--rate=<num:denom>] <wcap file>\n\n"
 		"\t--help\t\t\tthis help text\n"
 		"\t--yuv4mpeg2\t\tdump wcap file to stdout in yuv4mpeg2 format\n"
 		"\t--yuv4mpeg2-444\t\tdump wcap file to stdout in yuv4mpeg2 444 format\n"
 		"\t--frame=<frame>\t\twrite out the given frame number as png\n"
 		"\t--all\t\t\twrite all frames as pngs\n"
+		"\t--range=<first>:<last>\tonly output frames first to last,\n"
+		"\t\t\t\tinclusive\n"
+		"\t--threads=<n>\t\tthreads decoding yuv4mpeg2 output\n"
 		"\t--rate=<num:denom>\treplay frame rate for yuv4mpeg2,\n"
 		"\t\t\t\tspecified as an integer fraction\n\n");
 
 	exit(exit_code);
 }
 
+/* v1 files, and v2 files without any complete frame, can only be
+ * decoded from the start */
+static int
+decode_sequential(struct wcap_decoder *decoder, int yuv4mpeg2, int all,
+		  int output_frame, int first, int last, uint32_t frame_time)
+{
+	char filename[200];
+	uint32_t msecs;
+	int i, has_frame;
+
+	i = 0;
+	has_frame = wcap_decoder_get_frame(decoder);
+	msecs = decoder->msecs;
+	while (has_frame) {
+		if (i >= first && i <= last) {
+			if (all || i == output_frame) {
+				snprintf(filename, sizeof filename,
+					 "wcap-frame-%d.png", i);
+				write_png(decoder, filename);
+				fprintf(stderr, "wrote %s\n", filename);
+			}
+			if (yuv4mpeg2)
+				output_yuv_frame(decoder, yuv4mpeg2);
+		}
+		i++;
+		msecs += frame_time;
+		while (decoder->msecs < msecs && has_frame)
+			has_frame = wcap_decoder_get_frame(decoder);
+	}
+
+	return i;
+}
+
+static int
+decode_indexed(struct wcap_decoder *decoder, int yuv4mpeg2, int all,
+	       int output_frame, int first, int last, uint32_t frame_time,
+	       int nthreads)
+{
+	struct output_timing timing;
+	char filename[200];
+	int i, count;
+
+	timing.start = decoder->index[0].msecs;
+	timing.frame_time = frame_time;
+	count = output_frame_count(decoder, &timing);
+	if (last >= count)
+		last = count - 1;
+
+	if (all || (output_frame >= first && output_frame <= last)) {
+		for (i = first; i <= last; i++) {
+			if (!all && i != output_frame)
+				continue;
+			seek_output_frame(decoder, &timing, i);
+			snprintf(filename, sizeof filename,
+				 "wcap-frame-%d.png", i);
+			write_png(decoder, filename);
+			fprintf(stderr, "wrote %s\n", filename);
+		}
+	}
+
+	if (yuv4mpeg2 && first <= last) {
+		if (nthreads < 2 ||
+		    output_yuv_range_threaded(decoder, &timing, yuv4mpeg2,
+					      first, last, nthreads) < 0) {
+			for (i = first; i <= last; i++) {
+				seek_output_frame(decoder, &timing, i);
+				output_yuv_frame(decoder, yuv4mpeg2);
+			}
+		}
+	}
+
+	return count;
+}
+
 int main(int argc, char *argv[])
 {
 	struct wcap_decoder *decoder;
-	int i, j, output_frame = -1, yuv4mpeg2 = 0, all = 0, has_frame;
+	int i, j, output_frame = -1, yuv4mpeg2 = 0, all = 0, count;
 	int num = 30, denom = 1;
-	char filename[200];
+	int first = 0, last = INT_MAX, nthreads;
 	char *mode;
-	uint32_t msecs, frame_time;
+	uint32_t frame_time;
+
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
 
 	for (i = 1, j = 1; i < argc; i++) {
 		if (strcmp(argv[i], "--yuv4mpeg2-444") == 0) {
@@ -230,6 +511,10 @@ int main(int argc, char *argv[])
 			all = 1;
 		} else if (sscanf(argv[i], "--frame=%d", &output_frame) == 1) {
 			;
+		} else if (sscanf(argv[i], "--range=%d:%d", &first, &last) == 2) {
+			;
+		} else if (sscanf(argv[i], "--threads=%d", &nthreads) == 1) {
+			;
 		} else if (sscanf(argv[i], "--rate=%d", &num) == 1) {
 			;
 		} else if (sscanf(argv[i], "--rate=%d:%d", &num, &denom) == 2) {
@@ -252,6 +537,15 @@ int main(int argc, char *argv[])
 		fprintf(stderr, "invalid rate, denom can not be 0\n");
 		exit(EXIT_FAILURE);
 	}
+	if (first < 0 || last < first) {
+		fprintf(stderr, "invalid range\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Only a single frame wanted, no need to look at the others */
+	if (output_frame >= 0 && !all && !yuv4mpeg2 &&
+	    first == 0 && last == INT_MAX)
+		first = last = output_frame;
 
 	decoder = wcap_decoder_create(argv[1]);
 	if (decoder == NULL) {
@@ -279,27 +573,20 @@ int main(int argc, char *argv[])
 		fflush(stdout);
 	}
 
-	i = 0;
-	has_frame = wcap_decoder_get_frame(decoder);
-	msecs = decoder->msecs;
 	frame_time = 1000 * denom / num;
-	while (has_frame) {
-		if (all || i == output_frame) {
-			snprintf(filename, sizeof filename,
-				 "wcap-frame-%d.png", i);
-			write_png(decoder, filename);
-			fprintf(stderr, "wrote %s\n", filename);
-		}
-		if (yuv4mpeg2)
-			output_yuv_frame(decoder, yuv4mpeg2);
-		i++;
-		msecs += frame_time;
-		while (decoder->msecs < msecs && has_frame)
-			has_frame = wcap_decoder_get_frame(decoder);
-	}
+	if (frame_time == 0)
+		frame_time = 1;
+
+	if (decoder->index && decoder->nframes > 0)
+		count = decode_indexed(decoder, yuv4mpeg2, all, output_frame,
+				       first, last, frame_time, nthreads);
+	else
+		count = decode_sequential(decoder, yuv4mpeg2, all,
+					  output_frame, first, last,
+					  frame_time);
 
 	fprintf(stderr, "wcap file: size %dx%d, %d frames\n",
-		decoder->width, decoder->height, i);
+		decoder->width, decoder->height, count);
 
 	wcap_decoder_destroy(decoder);
 
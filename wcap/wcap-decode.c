@@ -22,7 +22,6 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * SOFTWARE.
  */
-
 #include "config.h"
 
 #include <stdlib.h>
@@ -36,13 +35,13 @@
 #include <string.h>
 #include <fcntl.h>
 
-#include <cairo.h>
+#include <libweston/zalloc.h>
 
 #include "wcap-decode.h"
 
 static void
 wcap_decoder_decode_rectangle(struct wcap_decoder *decoder,
-			      struct wcap_rectangle *rect)
+			      struct wcap_rectangle *rect, void *end)
 {
 	uint32_t v, *p = decoder->p, *d;
 	int width = rect->x2 - rect->x1, height = rect->y2 - rect->y1;
@@ -52,7 +51,7 @@ wcap_decoder_decode_rectangle(struct wcap_decoder *decoder,
 	d = decoder->frame + (rect->y2 - 1) * decoder->width;
 	x = rect->x1;
 	i = 0;
-	while (i < count) {
+	while (i < count && (void *) p < end) {
 		v = *p++;
 		l = v >> 24;
 		if (l < 0xe0) {
@@ -85,6 +84,67 @@ wcap_decoder_decode_rectangle(struct wcap_decoder *decoder,
 	decoder->p = p;
 }
 
+static int
+wcap_decoder_check_rectangle(struct wcap_decoder *decoder,
+			     struct wcap_rectangle *rect)
+{
+	return rect->x1 >= 0 && rect->x1 < rect->x2 &&
+	       rect->x2 <= decoder->width &&
+	       rect->y1 >= 0 && rect->y1 < rect->y2 &&
+	       rect->y2 <= decoder->height;
+}
+
+static int
+wcap_decoder_get_frame_v2(struct wcap_decoder *decoder)
+{
+	struct wcap_frame_header_v2 *header;
+	struct wcap_rectangle *rects;
+	struct wcap_checksum checksum;
+	void *end;
+	uint32_t i;
+
+	if ((size_t) (decoder->end - decoder->p) < sizeof *header)
+		return 0;
+
+	header = decoder->p;
+	rects = (void *) (header + 1);
+	if (header->size > (size_t) (decoder->end - (void *) rects) ||
+	    header->nrects > header->size / sizeof *rects)
+		return 0;
+
+	end = (void *) rects + header->size;
+	decoder->msecs = header->msecs;
+	decoder->count++;
+
+	/* Leave the previous picture in place rather than decode
+	 * something we know is damaged */
+	wcap_checksum_init(&checksum);
+	wcap_checksum_update(&checksum, rects, header->size);
+	if (wcap_checksum_final(&checksum) != header->checksum) {
+		fprintf(stderr, "frame %u: checksum mismatch\n",
+			decoder->count - 1);
+		decoder->p = end;
+		return 1;
+	}
+
+	if (header->flags & WCAP_FRAME_KEYFRAME)
+		memset(decoder->frame, 0,
+		       decoder->width * decoder->height * 4);
+
+	decoder->p = rects + header->nrects;
+	for (i = 0; i < header->nrects; i++) {
+		if (!wcap_decoder_check_rectangle(decoder, &rects[i])) {
+			fprintf(stderr, "frame %u: bad rectangle\n",
+				decoder->count - 1);
+			break;
+		}
+		wcap_decoder_decode_rectangle(decoder, &rects[i], end);
+	}
+	decoder->p = end;
+
+	return 1;
+}
+
 int
 wcap_decoder_get_frame(struct wcap_decoder *decoder)
 {
@@ -92,6 +152,9 @@ wcap_decoder_get_frame(struct wcap_decoder *decoder)
 	struct wcap_frame_header *header;
 	uint32_t i;
 
+	if (decoder->version == 2)
+		return wcap_decoder_get_frame_v2(decoder);
+
 	if (decoder->p == decoder->end)
 		return 0;
 
@@ -102,7 +165,184 @@ wcap_decoder_get_frame(struct wcap_decoder *decoder)
 	rects = (void *) (header + 1);
 	decoder->p = (uint32_t *) (rects + header->nrects);
 	for (i = 0; i < header->nrects; i++)
-		wcap_decoder_decode_rectangle(decoder, &rects[i]);
+		wcap_decoder_decode_rectangle(decoder, &rects[i],
+					      decoder->end);
+
+	return 1;
+}
+
+static void
+wcap_decoder_rewind(struct wcap_decoder *decoder)
+{
+	decoder->p = decoder->map + sizeof (struct wcap_header);
+	decoder->count = 0;
+	memset(decoder->frame, 0, decoder->width * decoder->height * 4);
+}
+
+/* Decode up to and including the given frame, starting from the closest
+ * keyframe before it unless the current frame is already on the way.
+ * Without an index this replays from the start when going backwards. */
+int
+wcap_decoder_seek(struct wcap_decoder *decoder, uint32_t frame)
+{
+	uint32_t key;
+
+	if (decoder->index == NULL) {
+		if (decoder->count > frame + 1)
+			wcap_decoder_rewind(decoder);
+	} else {
+		if (frame >= decoder->nframes)
+			return 0;
+
+		key = frame;
+		while (key > 0 &&
+		       !(decoder->index[key].flags & WCAP_FRAME_KEYFRAME))
+			key--;
+
+		if (decoder->count <= key || decoder->count > frame + 1) {
+			if (key == 0)
+				wcap_decoder_rewind(decoder);
+			decoder->p = decoder->map + decoder->index[key].offset;
+			decoder->count = key;
+		}
+	}
+
+	while (decoder->count < frame + 1)
+		if (!wcap_decoder_get_frame(decoder))
+			return 0;
+
+	return 1;
+}
+
+/* The first frame at or after msecs, or nframes if there is none */
+int
+wcap_decoder_find_frame(struct wcap_decoder *decoder, uint32_t msecs)
+{
+	uint32_t lo = 0, hi, mid;
+
+	if (decoder->index == NULL)
+		return -1;
+
+	hi = decoder->nframes;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (decoder->index[mid].msecs < msecs)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Every frame the index points at must start after the previous one and
+ * have its header, and the data the header announces, before the index. */
+static int
+wcap_decoder_check_index(struct wcap_decoder *decoder,
+			 const struct wcap_index_entry *index,
+			 uint32_t nframes, uint64_t end)
+{
+	const struct wcap_frame_header_v2 *header;
+	uint64_t next = sizeof (struct wcap_header);
+	uint32_t i;
+
+	for (i = 0; i < nframes; i++) {
+		if (index[i].offset < next || index[i].offset % 4 != 0 ||
+		    index[i].offset > end ||
+		    end - index[i].offset < sizeof *header)
+			return 0;
+
+		header = decoder->map + index[i].offset;
+		if (header->size > end - index[i].offset - sizeof *header)
+			return 0;
+
+		next = index[i].offset + sizeof *header + header->size;
+	}
+
+	return 1;
+}
+
+static int
+wcap_decoder_read_index(struct wcap_decoder *decoder)
+{
+	struct wcap_index_trailer trailer;
+	size_t index_size, room;
+
+	if (decoder->size < sizeof (struct wcap_header) + sizeof trailer)
+		return 0;
+
+	memcpy(&trailer, decoder->map + decoder->size - sizeof trailer,
+	       sizeof trailer);
+	if (trailer.magic != WCAP_INDEX_MAGIC)
+		return 0;
+
+	/* The index sits between the frames and the trailer; checked
+	 * without adding up offset and size, which could overflow */
+	room = decoder->size - sizeof trailer;
+	if (trailer.offset < sizeof (struct wcap_header) ||
+	    trailer.offset > room ||
+	    trailer.nframes > (room - trailer.offset) /
+			      sizeof *decoder->index)
+		return 0;
+
+	index_size = (size_t) trailer.nframes * sizeof *decoder->index;
+	if (trailer.offset + index_size != room)
+		return 0;
+
+	decoder->index = malloc(index_size + 1);
+	if (decoder->index == NULL)
+		return 0;
+
+	memcpy(decoder->index, decoder->map + trailer.offset, index_size);
+
+	if (!wcap_decoder_check_index(decoder, decoder->index,
+				      trailer.nframes, trailer.offset)) {
+		fprintf(stderr, "bad index, scanning the frames instead\n");
+		free(decoder->index);
+		decoder->index = NULL;
+		return 0;
+	}
+
+	decoder->nframes = trailer.nframes;
+	decoder->end = decoder->map + trailer.offset;
+
+	return 1;
+}
+
+/* A recording that was not stopped cleanly has no index; rebuild it
+ * from the frame headers, up to the first incomplete frame. */
+static int
+wcap_decoder_scan_index(struct wcap_decoder *decoder)
+{
+	struct wcap_frame_header_v2 *header;
+	struct wcap_index_entry *index;
+	uint32_t alloc = 0;
+	void *p;
+
+	decoder->nframes = 0;
+	p = decoder->map + sizeof (struct wcap_header);
+	while ((size_t) (decoder->end - p) >= sizeof *header) {
+		header = p;
+		if (header->size > (size_t) (decoder->end - p) - sizeof *header)
+			break;
+
+		if (decoder->nframes == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			index = realloc(decoder->index, alloc * sizeof *index);
+			if (index == NULL)
+				return 0;
+			decoder->index = index;
+		}
+
+		index = &decoder->index[decoder->nframes++];
+		index->offset = p - decoder->map;
+		index->msecs = header->msecs;
+		index->flags = header->flags;
+
+		p += sizeof *header + header->size;
+	}
+
+	decoder->end = p;
 
 	return 1;
 }
@@ -115,7 +355,7 @@ wcap_decoder_create(const char *filename)
 	int frame_size;
 	struct stat buf;
 
-	decoder = malloc(sizeof *decoder);
+	decoder = zalloc(sizeof *decoder);
 	if (decoder == NULL)
 		return NULL;
 
@@ -127,13 +367,16 @@ wcap_decoder_create(const char *filename)
 
 	fstat(decoder->fd, &buf);
 	decoder->size = buf.st_size;
+	if (decoder->size < sizeof *header) {
+		fprintf(stderr, "file too short\n");
+		goto err_fd;
+	}
+
 	decoder->map = mmap(NULL, decoder->size,
 			    PROT_READ, MAP_PRIVATE, decoder->fd, 0);
 	if (decoder->map == MAP_FAILED) {
 		fprintf(stderr, "mmap failed\n");
-		close(decoder->fd);
-		free(decoder);
-		return NULL;
+		goto err_fd;
 	}
 
 	header = decoder->map;
@@ -144,23 +387,69 @@ wcap_decoder_create(const char *filename)
 	decoder->p = header + 1;
 	decoder->end = decoder->map + decoder->size;
 
+	switch (header->magic) {
+	case WCAP_HEADER_MAGIC:
+		decoder->version = 1;
+		break;
+	case WCAP_HEADER_MAGIC_V2:
+		decoder->version = 2;
+		if (!wcap_decoder_read_index(decoder) &&
+		    !wcap_decoder_scan_index(decoder))
+			goto err_map;
+		break;
+	default:
+		fprintf(stderr, "not a wcap file\n");
+		goto err_map;
+	}
+
 	frame_size = header->width * header->height * 4;
-	decoder->frame = malloc(frame_size);
-	if (decoder->frame == NULL) {
-		close(decoder->fd);
-		free(decoder);
+	decoder->frame = zalloc(frame_size);
+	if (decoder->frame == NULL)
+		goto err_map;
+
+	return decoder;
+
+err_map:
+	free(decoder->index);
+	munmap(decoder->map, decoder->size);
+err_fd:
+	close(decoder->fd);
+	free(decoder);
+	return NULL;
+}
+
+/* A second decoder over the same file, to decode another part of it on
+ * another thread. It must be destroyed before the original. */
+struct wcap_decoder *
+wcap_decoder_clone(struct wcap_decoder *decoder)
+{
+	struct wcap_decoder *clone;
+
+	clone = malloc(sizeof *clone);
+	if (clone == NULL)
+		return NULL;
+
+	*clone = *decoder;
+	clone->parent = decoder;
+	clone->frame = malloc(decoder->width * decoder->height * 4);
+	if (clone->frame == NULL) {
+		free(clone);
 		return NULL;
 	}
-	memset(decoder->frame, 0, frame_size);
 
-	return decoder;
+	wcap_decoder_rewind(clone);
+
+	return clone;
 }
 
 void
 wcap_decoder_destroy(struct wcap_decoder *decoder)
 {
-	munmap(decoder->map, decoder->size);
-	close(decoder->fd);
+	if (decoder->parent == NULL) {
+		munmap(decoder->map, decoder->size);
+		close(decoder->fd);
+		free(decoder->index);
+	}
 	free(decoder->frame);
 	free(decoder);
 }
@@ -22,19 +22,23 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * SOFTWARE.
  */
-
 #ifndef _WCAP_DECODE_
 #define _WCAP_DECODE_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define WCAP_HEADER_MAGIC	0x57434150
+#define WCAP_HEADER_MAGIC_V2	0x57435032
+#define WCAP_INDEX_MAGIC	0x57494458
 
 #define WCAP_FORMAT_XRGB8888	0x34325258
 #define WCAP_FORMAT_XBGR8888	0x34324258
 #define WCAP_FORMAT_RGBX8888	0x34325852
 #define WCAP_FORMAT_BGRX8888	0x34325842
 
+#define WCAP_FRAME_KEYFRAME	(1 << 0)
+
 struct wcap_header {
 	uint32_t magic;
 	uint32_t format;
@@ -46,10 +50,67 @@ struct wcap_frame_header {
 	uint32_t nrects;
 };
 
+/* size is the number of bytes of rectangles and pixel data following
+ * the header, checksum is wcap_checksum over those bytes. */
+struct wcap_frame_header_v2 {
+	uint32_t msecs;
+	uint32_t nrects;
+	uint32_t flags;
+	uint32_t size;
+	uint32_t checksum;
+};
+
 struct wcap_rectangle {
 	int32_t x1, y1, x2, y2;
 };
 
+/* offset is from the start of the file to the frame header */
+struct wcap_index_entry {
+	uint64_t offset;
+	uint32_t msecs;
+	uint32_t flags;
+};
+
+/* Last bytes of a complete v2 file, offset points at the index */
+struct wcap_index_trailer {
+	uint32_t magic;
+	uint32_t nframes;
+	uint64_t offset;
+};
+
+/* Fletcher-style sum over 32-bit words */
+struct wcap_checksum {
+	uint32_t a, b;
+};
+
+static inline void
+wcap_checksum_init(struct wcap_checksum *c)
+{
+	c->a = 1;
+	c->b = 0;
+}
+
+static inline void
+wcap_checksum_update(struct wcap_checksum *c, const void *data, size_t size)
+{
+	const uint32_t *p = data, *end = p + size / 4;
+	uint32_t a = c->a, b = c->b;
+
+	while (p < end) {
+		a += *p++;
+		b += a;
+	}
+
+	c->a = a;
+	c->b = b;
+}
+
+static inline uint32_t
+wcap_checksum_final(const struct wcap_checksum *c)
+{
+	return c->a ^ ((c->b << 16) | (c->b >> 16));
+}
+
 struct wcap_decoder {
 	int fd;
 	size_t size;
@@ -59,10 +120,19 @@ struct wcap_decoder {
 	uint32_t msecs;
 	uint32_t count;
 	int width, height;
+
+	/* v2 files only, shared between clones */
+	int version;
+	struct wcap_index_entry *index;
+	uint32_t nframes;
+	struct wcap_decoder *parent;
 };
 
 int wcap_decoder_get_frame(struct wcap_decoder *decoder);
+int wcap_decoder_seek(struct wcap_decoder *decoder, uint32_t frame);
+int wcap_decoder_find_frame(struct wcap_decoder *decoder, uint32_t msecs);
 struct wcap_decoder *wcap_decoder_create(const char *filename);
+struct wcap_decoder *wcap_decoder_clone(struct wcap_decoder *decoder);
 void wcap_decoder_destroy(struct wcap_decoder *decoder);
 
 #endif
@@ -27,6 +27,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/socket.h>
@@ -38,26 +39,39 @@
 
 #include "xwayland.h"
 #include <libweston/xwayland-api.h>
+#include "libweston/timeline.h"
 #include "shared/helpers.h"
 #include "shared/string-helpers.h"
+#include "shared/timespec-util.h"
 
-static int
-weston_xserver_handle_event(int listen_fd, uint32_t mask, void *data)
+static void
+weston_xserver_spawn(struct weston_xserver *wxs)
 {
-	struct weston_xserver *wxs = data;
 	char display[8];
 
 	snprintf(display, sizeof display, ":%d", wxs->display);
 
+	weston_compositor_read_presentation_clock(wxs->compositor,
+						  &wxs->spawn_time);
+	TL_POINT(wxs->compositor, "xwayland_spawn", TLP_END);
+
 	wxs->pid = wxs->spawn_func(wxs->user_data, display, wxs->abstract_fd, wxs->unix_fd);
 	if (wxs->pid == -1) {
 		weston_log("Failed to spawn the Xwayland server\n");
-		return 1;
+		return;
 	}
 
 	weston_log("Spawned Xwayland server, pid %d\n", wxs->pid);
 	wl_event_source_remove(wxs->abstract_source);
 	wl_event_source_remove(wxs->unix_source);
+}
+
+static int
+weston_xserver_handle_event(int listen_fd, uint32_t mask, void *data)
+{
+	struct weston_xserver *wxs = data;
+
+	weston_xserver_spawn(wxs);
 
 	return 1;
 }
@@ -310,8 +324,34 @@ weston_xwayland_xserver_loaded(struct weston_xwayland *xwayland,
 			       struct wl_client *client, int wm_fd)
 {
 	struct weston_xserver *wxs = (struct weston_xserver *)xwayland;
+	struct timespec loaded, ready;
+
+	weston_compositor_read_presentation_clock(wxs->compositor, &loaded);
+	TL_POINT(wxs->compositor, "xwayland_loaded", TLP_END);
+
 	wxs->wm = weston_wm_create(wxs, wm_fd);
 	wxs->client = client;
+
+	weston_compositor_read_presentation_clock(wxs->compositor, &ready);
+	TL_POINT(wxs->compositor, "xwayland_ready", TLP_END);
+
+	weston_log("Xwayland ready after %" PRId64 " ms "
+		   "(server %" PRId64 " ms, window manager %" PRId64 " ms)\n",
+		   timespec_sub_to_msec(&ready, &wxs->spawn_time),
+		   timespec_sub_to_msec(&loaded, &wxs->spawn_time),
+		   timespec_sub_to_msec(&ready, &loaded));
+}
+
+static void
+weston_xwayland_spawn(struct weston_xwayland *xwayland)
+{
+	struct weston_xserver *wxs = (struct weston_xserver *)xwayland;
+
+	/* Not listening anymore, or already running */
+	if (!wxs->loop || wxs->pid != 0)
+		return;
+
+	weston_xserver_spawn(wxs);
 }
 
 static void
@@ -320,6 +360,8 @@ weston_xwayland_xserver_exited(struct weston_xwayland *xwayland,
 {
 	struct weston_xserver *wxs = (struct weston_xserver *)xwayland;
 
+	TL_POINT(wxs->compositor, "xwayland_exited", TLP_END);
+
 	wxs->pid = 0;
 	wxs->client = NULL;
 
@@ -350,6 +392,7 @@ const struct weston_xwayland_api api = {
 	weston_xwayland_listen,
 	weston_xwayland_xserver_loaded,
 	weston_xwayland_xserver_exited,
+	weston_xwayland_spawn,
 };
 extern const struct weston_xwayland_surface_api surface_api;
 
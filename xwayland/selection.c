@@ -41,109 +41,194 @@
 #define wm_log(...) do {} while (0)
 #endif
 
+/*
+ * Selection contents are streamed in slices of at most incr_chunk_size
+ * bytes in both directions. X to Wayland, the property is read one slice
+ * at a time and the next slice, or the next INCR chunk, is only requested
+ * once the previous one has been written to the pipe. The replies are not
+ * waited for, weston_wm_poll_selection_property() picks them up after the
+ * X connection has been read. Wayland to X, a single buffer of
+ * incr_chunk_size bytes is reused, and the pipe is not watched while the
+ * buffer is full and the requestor has not yet deleted the property
+ * holding the previous chunk.
+ */
+static const size_t incr_chunk_size = 64 * 1024;
+
+static void
+weston_wm_request_selection_property(struct weston_wm *wm, int delete)
+{
+	/* a transfer that is still waiting for its reply is superseded */
+	if (wm->property_cookie_pending)
+		xcb_discard_reply(wm->conn, wm->property_cookie.sequence);
+
+	/* With delete set, the property is only deleted once the last
+	 * slice has been read. */
+	wm->property_cookie = xcb_get_property(wm->conn,
+					       delete,
+					       wm->selection_window,
+					       wm->atom.wl_selection,
+					       XCB_GET_PROPERTY_TYPE_ANY,
+					       wm->property_offset,
+					       incr_chunk_size / 4);
+	wm->property_cookie_pending = 1;
+	xcb_flush(wm->conn);
+}
+
+static void
+weston_wm_end_property_transfer(struct weston_wm *wm)
+{
+	free(wm->property_reply);
+	wm->property_reply = NULL;
+	if (wm->property_source)
+		wl_event_source_remove(wm->property_source);
+	wm->property_source = NULL;
+	close(wm->data_source_fd);
+	wm->data_source_fd = -1;
+}
+
+static void
+weston_wm_write_property(struct weston_wm *wm, xcb_get_property_reply_t *reply);
+
 static int
 writable_callback(int fd, uint32_t mask, void *data)
 {
 	struct weston_wm *wm = data;
 	unsigned char *property;
 	int len, remainder;
+	uint32_t bytes_after;
 
 	property = xcb_get_property_value(wm->property_reply);
 	remainder = xcb_get_property_value_length(wm->property_reply) -
 		wm->property_start;
 
 	len = write(fd, property + wm->property_start, remainder);
+	if (len == -1 && (errno == EAGAIN || errno == EINTR))
+		return 1;
+
 	if (len == -1) {
-		free(wm->property_reply);
-		wm->property_reply = NULL;
-		if (wm->property_source)
-			wl_event_source_remove(wm->property_source);
-		wm->property_source = NULL;
-		close(fd);
 		weston_log("write error to target fd: %s\n", strerror(errno));
+		weston_wm_end_property_transfer(wm);
 		return 1;
 	}
 
-	weston_log("wrote %d (chunk size %d) of %d bytes\n",
-		wm->property_start + len,
-		len, xcb_get_property_value_length(wm->property_reply));
-
 	wm->property_start += len;
-	if (len == remainder) {
-		free(wm->property_reply);
-		wm->property_reply = NULL;
-		if (wm->property_source)
-			wl_event_source_remove(wm->property_source);
-		wm->property_source = NULL;
-
-		if (wm->incr) {
-			xcb_delete_property(wm->conn,
-					    wm->selection_window,
-					    wm->atom.wl_selection);
-		} else {
-			weston_log("transfer complete\n");
-			close(fd);
-		}
+	if (len < remainder)
+		return 1;
+
+	bytes_after = wm->property_reply->bytes_after;
+	free(wm->property_reply);
+	wm->property_reply = NULL;
+
+	wl_event_source_remove(wm->property_source);
+	wm->property_source = NULL;
+
+	if (bytes_after > 0) {
+		/* More of this property to come; the slice of a non-INCR
+		 * transfer may delete it, an INCR chunk is deleted below
+		 * once written. */
+		weston_wm_request_selection_property(wm, !wm->incr);
+		return 1;
+	}
+
+	if (wm->incr) {
+		xcb_delete_property(wm->conn,
+				    wm->selection_window,
+				    wm->atom.wl_selection);
+		xcb_flush(wm->conn);
+	} else {
+		wm_log("transfer complete\n");
+		close(fd);
+		wm->data_source_fd = -1;
 	}
 
 	return 1;
 }
 
+/* Takes ownership of reply and writes it out once the pipe is writable */
 static void
 weston_wm_write_property(struct weston_wm *wm, xcb_get_property_reply_t *reply)
 {
 	wm->property_start = 0;
 	wm->property_reply = reply;
-	writable_callback(wm->data_source_fd, WL_EVENT_WRITABLE, wm);
+	wm->property_offset += xcb_get_property_value_length(reply) / 4;
 
-	if (wm->property_reply)
+	if (!wm->property_source)
 		wm->property_source =
 			wl_event_loop_add_fd(wm->server->loop,
 					     wm->data_source_fd,
 					     WL_EVENT_WRITABLE,
 					     writable_callback, wm);
+
+	if (!wm->property_source)
+		weston_wm_end_property_transfer(wm);
 }
 
 static void
 weston_wm_get_incr_chunk(struct weston_wm *wm)
 {
-	xcb_get_property_cookie_t cookie;
-	xcb_get_property_reply_t *reply;
-	FILE *fp;
-	char *logstr;
-	size_t logsize;
+	if (wm->property_reply || wm->property_cookie_pending ||
+	    wm->data_source_fd < 0)
+		return;
 
-	cookie = xcb_get_property(wm->conn,
-				  0, /* delete */
-				  wm->selection_window,
-				  wm->atom.wl_selection,
-				  XCB_GET_PROPERTY_TYPE_ANY,
-				  0, /* offset */
-				  0x1fffffff /* length */);
+	wm->property_offset = 0;
+	weston_wm_request_selection_property(wm, 0);
+}
 
-	reply = xcb_get_property_reply(wm->conn, cookie, NULL);
-	if (reply == NULL)
+/* Continues the transfer with a slice of the selection property */
+static void
+weston_wm_handle_selection_property(struct weston_wm *wm,
+				    xcb_get_property_reply_t *reply)
+{
+	if (reply == NULL) {
+		weston_wm_end_property_transfer(wm);
 		return;
-
-	fp = open_memstream(&logstr, &logsize);
-	if (fp) {
-		dump_property(fp, wm, wm->atom.wl_selection, reply);
-		if (fclose(fp) == 0)
-			wm_log("%s", logstr);
-		free(logstr);
 	}
 
-	if (xcb_get_property_value_length(reply) > 0) {
-		/* reply's ownership is transferred to wm, which is responsible
-		 * for freeing it */
+	if (!wm->incr && reply->type == wm->atom.incr) {
+		wm_log("incr transfer started\n");
+		wm->incr = 1;
+		free(reply);
+	} else if (xcb_get_property_value_length(reply) > 0) {
 		weston_wm_write_property(wm, reply);
 	} else {
-		weston_log("transfer complete\n");
-		close(wm->data_source_fd);
+		/* an empty property, or the empty chunk ending INCR */
+		wm_log("transfer complete\n");
+		weston_wm_end_property_transfer(wm);
 		free(reply);
 	}
 }
 
+/** Handle the reply to the pending selection property request
+ *
+ * Called after the X connection has been read, returns 1 if a reply was
+ * handled.
+ */
+int
+weston_wm_poll_selection_property(struct weston_wm *wm)
+{
+	xcb_get_property_reply_t *reply = NULL;
+	xcb_generic_error_t *error = NULL;
+
+	if (!wm->property_cookie_pending)
+		return 0;
+
+	if (!xcb_poll_for_reply(wm->conn, wm->property_cookie.sequence,
+				(void **) &reply, &error))
+		return 0;
+
+	wm->property_cookie_pending = 0;
+	free(error);
+
+	if (wm->data_source_fd < 0) {
+		free(reply);
+		return 1;
+	}
+
+	weston_wm_handle_selection_property(wm, reply);
+
+	return 1;
+}
+
 struct x11_data_source {
 	struct weston_data_source base;
 	struct weston_wm *wm;
@@ -255,41 +340,10 @@ weston_wm_get_selection_targets(struct weston_wm *wm)
 static void
 weston_wm_get_selection_data(struct weston_wm *wm)
 {
-	xcb_get_property_cookie_t cookie;
-	xcb_get_property_reply_t *reply;
-	FILE *fp;
-	char *logstr;
-	size_t logsize;
-
-	cookie = xcb_get_property(wm->conn,
-				  1, /* delete */
-				  wm->selection_window,
-				  wm->atom.wl_selection,
-				  XCB_GET_PROPERTY_TYPE_ANY,
-				  0, /* offset */
-				  0x1fffffff /* length */);
-
-	reply = xcb_get_property_reply(wm->conn, cookie, NULL);
-
-	fp = open_memstream(&logstr, &logsize);
-	if (fp) {
-		dump_property(fp, wm, wm->atom.wl_selection, reply);
-		if (fclose(fp) == 0)
-			wm_log("%s", logstr);
-		free(logstr);
-	}
-
-	if (reply == NULL) {
-		return;
-	} else if (reply->type == wm->atom.incr) {
-		wm->incr = 1;
-		free(reply);
-	} else {
-		wm->incr = 0;
-		/* reply's ownership is transferred to wm, which is responsible
-		 * for freeing it */
-		weston_wm_write_property(wm, reply);
-	}
+	/* The contents are not logged, they may be sensitive and large. */
+	wm->incr = 0;
+	wm->property_offset = 0;
+	weston_wm_request_selection_property(wm, 1);
 }
 
 static void
@@ -308,8 +362,6 @@ weston_wm_handle_selection_notify(struct weston_wm *wm,
 	}
 }
 
-static const size_t incr_chunk_size = 64 * 1024;
-
 static void
 weston_wm_send_selection_notify(struct weston_wm *wm, xcb_atom_t property)
 {
@@ -386,41 +438,94 @@ weston_wm_flush_source_data(struct weston_wm *wm)
 	return length;
 }
 
+static int
+weston_wm_read_data_source(int fd, uint32_t mask, void *data);
+
+/* Stop reading the source until the requestor took the pending chunk. The
+ * fd is not watched at all meanwhile, as a hung up pipe would be reported
+ * over and over even with no events selected. */
+static void
+weston_wm_pause_data_source(struct weston_wm *wm)
+{
+	wm->flush_property_on_delete = 1;
+	if (wm->property_source)
+		wl_event_source_remove(wm->property_source);
+	wm->property_source = NULL;
+}
+
+static void
+weston_wm_close_data_source(struct weston_wm *wm)
+{
+	if (wm->property_source)
+		wl_event_source_remove(wm->property_source);
+	wm->property_source = NULL;
+	close(wm->data_source_fd);
+	wm->data_source_fd = -1;
+}
+
+static void
+weston_wm_resume_data_source(struct weston_wm *wm)
+{
+	if (wm->property_source)
+		return;
+
+	wm->property_source = wl_event_loop_add_fd(wm->server->loop,
+						   wm->data_source_fd,
+						   WL_EVENT_READABLE,
+						   weston_wm_read_data_source,
+						   wm);
+	if (!wm->property_source) {
+		weston_log("failed to watch the data source\n");
+		weston_wm_close_data_source(wm);
+	}
+}
+
 static int
 weston_wm_read_data_source(int fd, uint32_t mask, void *data)
 {
 	struct weston_wm *wm = data;
-	int len, current, available;
+	int len, available;
 	void *p;
 
-	current = wm->source_data.size;
-	if (wm->source_data.size < incr_chunk_size)
-		p = wl_array_add(&wm->source_data, incr_chunk_size);
-	else
-		p = (char *) wm->source_data.data + wm->source_data.size;
-	available = wm->source_data.alloc - current;
+	/* The buffer is allocated once and reused for every transfer */
+	if (wm->source_data.alloc < incr_chunk_size) {
+		p = wl_array_add(&wm->source_data,
+				 incr_chunk_size - wm->source_data.size);
+		if (p == NULL) {
+			weston_log("out of memory for selection data\n");
+			weston_wm_send_selection_notify(wm, XCB_ATOM_NONE);
+			weston_wm_close_data_source(wm);
+			return 1;
+		}
+		wm->source_data.size = (char *) p - (char *) wm->source_data.data;
+	}
+
+	p = (char *) wm->source_data.data + wm->source_data.size;
+	available = incr_chunk_size - wm->source_data.size;
+	if (available == 0) {
+		/* a read of 0 bytes would look like the end of the source */
+		weston_wm_pause_data_source(wm);
+		return 1;
+	}
 
 	len = read(fd, p, available);
+	if (len == -1 && (errno == EAGAIN || errno == EINTR))
+		return 1;
+
 	if (len == -1) {
 		weston_log("read error from data source: %s\n",
 			   strerror(errno));
 		weston_wm_send_selection_notify(wm, XCB_ATOM_NONE);
-		if (wm->property_source)
-			wl_event_source_remove(wm->property_source);
-		wm->property_source = NULL;
-		close(fd);
-		wl_array_release(&wm->source_data);
+		weston_wm_close_data_source(wm);
+		wm->source_data.size = 0;
 		return 1;
 	}
 
-	weston_log("read %d (available %d, mask 0x%x) bytes: \"%.*s\"\n",
-		len, available, mask, len, (char *) p);
-
-	wm->source_data.size = current + len;
-	if (wm->source_data.size >= incr_chunk_size) {
+	wm->source_data.size += len;
+	if (wm->source_data.size == incr_chunk_size) {
 		if (!wm->incr) {
-			weston_log("got %zu bytes, starting incr\n",
-				wm->source_data.size);
+			wm_log("got %zu bytes, starting incr\n",
+			       wm->source_data.size);
 			wm->incr = 1;
 			xcb_change_property(wm->conn,
 					    XCB_PROP_MODE_REPLACE,
@@ -430,59 +535,34 @@ weston_wm_read_data_source(int fd, uint32_t mask, void *data)
 					    32, /* format */
 					    1, &incr_chunk_size);
 			wm->selection_property_set = 1;
-			wm->flush_property_on_delete = 1;
-			if (wm->property_source)
-				wl_event_source_remove(wm->property_source);
-			wm->property_source = NULL;
+			weston_wm_pause_data_source(wm);
 			weston_wm_send_selection_notify(wm, wm->selection_request.property);
 		} else if (wm->selection_property_set) {
-			weston_log("got %zu bytes, waiting for "
-				"property delete\n", wm->source_data.size);
-
-			wm->flush_property_on_delete = 1;
-			if (wm->property_source)
-				wl_event_source_remove(wm->property_source);
-			wm->property_source = NULL;
+			wm_log("got %zu bytes, waiting for property delete\n",
+			       wm->source_data.size);
+			weston_wm_pause_data_source(wm);
 		} else {
-			weston_log("got %zu bytes, "
-				"property deleted, setting new property\n",
-				wm->source_data.size);
+			wm_log("got %zu bytes, property deleted, "
+			       "setting new property\n", wm->source_data.size);
 			weston_wm_flush_source_data(wm);
 		}
+		xcb_flush(wm->conn);
 	} else if (len == 0 && !wm->incr) {
-		weston_log("non-incr transfer complete\n");
+		wm_log("non-incr transfer complete\n");
 		/* Non-incr transfer all done. */
 		weston_wm_flush_source_data(wm);
 		weston_wm_send_selection_notify(wm, wm->selection_request.property);
 		xcb_flush(wm->conn);
-		if (wm->property_source)
-			wl_event_source_remove(wm->property_source);
-		wm->property_source = NULL;
-		close(fd);
-		wl_array_release(&wm->source_data);
+		weston_wm_close_data_source(wm);
 		wm->selection_request.requestor = XCB_NONE;
 	} else if (len == 0 && wm->incr) {
-		weston_log("incr transfer complete\n");
+		wm_log("incr transfer complete\n");
 
 		wm->flush_property_on_delete = 1;
-		if (wm->selection_property_set) {
-			weston_log("got %zu bytes, waiting for "
-				"property delete\n", wm->source_data.size);
-		} else {
-			weston_log("got %zu bytes, "
-				"property deleted, setting new property\n",
-				wm->source_data.size);
+		if (!wm->selection_property_set)
 			weston_wm_flush_source_data(wm);
-		}
 		xcb_flush(wm->conn);
-		if (wm->property_source)
-			wl_event_source_remove(wm->property_source);
-		wm->property_source = NULL;
-		close(wm->data_source_fd);
-		wm->data_source_fd = -1;
-		close(fd);
-	} else {
-		weston_log("nothing happened, buffered the bytes\n");
+		weston_wm_close_data_source(wm);
 	}
 
 	return 1;
@@ -501,7 +581,7 @@ weston_wm_send_data(struct weston_wm *wm, xcb_atom_t target, const char *mime_ty
 		return;
 	}
 
-	wl_array_init(&wm->source_data);
+	wm->source_data.size = 0;
 	wm->selection_target = target;
 	wm->data_source_fd = p[0];
 	wm->property_source = wl_event_loop_add_fd(wm->server->loop,
@@ -520,32 +600,28 @@ weston_wm_send_incr_chunk(struct weston_wm *wm)
 {
 	int length;
 
-	weston_log("property deleted\n");
+	wm_log("property deleted\n");
 
 	wm->selection_property_set = 0;
 	if (wm->flush_property_on_delete) {
-		weston_log("setting new property, %zu bytes\n",
-			wm->source_data.size);
+		wm_log("setting new property, %zu bytes\n",
+		       wm->source_data.size);
 		wm->flush_property_on_delete = 0;
 		length = weston_wm_flush_source_data(wm);
 
 		if (wm->data_source_fd >= 0) {
-			wm->property_source =
-				wl_event_loop_add_fd(wm->server->loop,
-						     wm->data_source_fd,
-						     WL_EVENT_READABLE,
-						     weston_wm_read_data_source,
-						     wm);
+			/* Room in the buffer again */
+			weston_wm_resume_data_source(wm);
 		} else if (length > 0) {
 			/* Transfer is all done, but queue a flush for
 			 * the delete of the last chunk so we can set
 			 * the 0 sized property to signal the end of
 			 * the transfer. */
 			wm->flush_property_on_delete = 1;
-			wl_array_release(&wm->source_data);
 		} else {
 			wm->selection_request.requestor = XCB_NONE;
 		}
+		xcb_flush(wm->conn);
 	}
 }
 
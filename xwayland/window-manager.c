@@ -44,6 +44,7 @@
 #include <libweston/libweston.h>
 #include "xwayland.h"
 #include "xwayland-internal-interface.h"
+#include "libweston/timeline.h"
 
 #include "shared/cairo-util.h"
 #include "hash.h"
@@ -128,17 +129,59 @@ struct motif_wm_hints {
 #define _NET_WM_MOVERESIZE_MOVE_KEYBOARD    10   /* move via keyboard */
 #define _NET_WM_MOVERESIZE_CANCEL           11   /* cancel operation */
 
+/* Number of properties read by weston_wm_window_read_properties() */
+#define WM_WINDOW_PROPERTY_COUNT 11
+
 struct weston_output_weak_ref {
 	struct weston_output *output;
 	struct wl_listener destroy_listener;
 };
 
+/* Number of decoration templates kept around for reuse */
+#define WM_DECORATION_CACHE_SIZE 8
+
+/* Key for undecorated windows that only get a drop shadow; never clashes
+ * with THEME_FRAME_* flags */
+#define WM_DECORATION_SHADOW (1u << 31)
+
+/* Decorations are composed from nine pieces of a small template: the
+ * corners are copied as they are, the edges and the middle are stretched
+ * from one row or column of the template. The corners cover the shadow
+ * corners, rendered from (2, 2) and 64 pixels big, and the frame corners
+ * inside them. The template has a short stretch between the corners so
+ * the stretched row and column are sampled away from the corners. */
+#define WM_DECORATION_LEFT 66
+#define WM_DECORATION_TOP 66
+#define WM_DECORATION_RIGHT 54
+#define WM_DECORATION_BOTTOM 54
+#define WM_DECORATION_STRETCH 8
+
+/* Shadow and borders for one frame state, rendered once at the template
+ * size. Shared between all windows in that state whatever their size, most
+ * recently used first. */
+struct weston_wm_decoration {
+	struct wl_list link; /* weston_wm::decoration_cache */
+	uint32_t flags; /* THEME_FRAME_* or WM_DECORATION_SHADOW */
+	cairo_surface_t *surface;
+};
+
+/* The title text of one window, rendered for one focus state */
+struct weston_wm_title_layer {
+	cairo_surface_t *surface;
+	char *title;
+	uint32_t flags;
+	int frame_width;
+	int32_t x, y, width, height;
+};
+
 struct weston_wm_window {
 	struct weston_wm *wm;
 	xcb_window_t id;
 	xcb_window_t frame_id;
 	struct frame *frame;
 	cairo_surface_t *cairo_surface;
+	/* indexed by whether THEME_FRAME_ACTIVE is set */
+	struct weston_wm_title_layer title_layer[2];
 	uint32_t surface_id;
 	struct weston_surface *surface;
 	struct weston_desktop_xwayland_surface *shsurf;
@@ -146,6 +189,12 @@ struct weston_wm_window {
 	struct wl_event_source *repaint_source;
 	struct wl_event_source *configure_source;
 	int properties_dirty;
+	/* initial requests made in weston_wm_window_create(), see
+	 * weston_wm_process_pending_windows() */
+	bool create_pending;
+	struct wl_list pending_link; /* weston_wm::pending_window_list */
+	xcb_get_geometry_cookie_t geometry_cookie;
+	xcb_get_property_cookie_t property_cookie[WM_WINDOW_PROPERTY_COUNT];
 	int pid;
 	char *machine;
 	char *class;
@@ -500,17 +549,20 @@ read_and_dump_property(FILE *fp, struct weston_wm *wm,
 #define TYPE_NET_WM_STATE	XCB_ATOM_CUT_BUFFER2
 #define TYPE_WM_NORMAL_HINTS	XCB_ATOM_CUT_BUFFER3
 
+struct weston_wm_window_property {
+	xcb_atom_t atom;
+	xcb_atom_t type;
+	void *ptr;
+};
+
 static void
-weston_wm_window_read_properties(struct weston_wm_window *window)
+weston_wm_window_get_property_table(struct weston_wm_window *window,
+				    struct weston_wm_window_property *props)
 {
 	struct weston_wm *wm = window->wm;
 
 #define F(field) (&window->field)
-	const struct {
-		xcb_atom_t atom;
-		xcb_atom_t type;
-		void *ptr;
-	} props[] = {
+	const struct weston_wm_window_property table[] = {
 		{ XCB_ATOM_WM_CLASS,           XCB_ATOM_STRING,            F(class) },
 		{ XCB_ATOM_WM_NAME,            XCB_ATOM_STRING,            F(name) },
 		{ XCB_ATOM_WM_TRANSIENT_FOR,   XCB_ATOM_WINDOW,            F(transient_for) },
@@ -525,24 +577,50 @@ weston_wm_window_read_properties(struct weston_wm_window *window)
 	};
 #undef F
 
-	xcb_get_property_cookie_t cookie[ARRAY_LENGTH(props)];
-	xcb_get_property_reply_t *reply;
-	void *p;
-	uint32_t *xid;
-	xcb_atom_t *atom;
+	static_assert(ARRAY_LENGTH(table) == WM_WINDOW_PROPERTY_COUNT,
+		      "property table size mismatch");
+	memcpy(props, table, sizeof table);
+}
+
+/** Send the requests for all properties of interest */
+static void
+weston_wm_window_request_properties(struct weston_wm_window *window,
+				    xcb_get_property_cookie_t *cookie)
+{
+	struct weston_wm_window_property props[WM_WINDOW_PROPERTY_COUNT];
 	uint32_t i;
-	char name[1024];
 
-	if (!window->properties_dirty)
-		return;
-	window->properties_dirty = 0;
+	weston_wm_window_get_property_table(window, props);
 
 	for (i = 0; i < ARRAY_LENGTH(props); i++)
-		cookie[i] = xcb_get_property(wm->conn,
+		cookie[i] = xcb_get_property(window->wm->conn,
 					     0, /* delete */
 					     window->id,
 					     props[i].atom,
 					     XCB_ATOM_ANY, 0, 2048);
+}
+
+/** Collect the replies to weston_wm_window_request_properties()
+ *
+ * \param last_reply Points to the reply to the last request if it was
+ * already taken with xcb_poll_for_reply(), which may be NULL on error.
+ * NULL to wait for it instead.
+ */
+static void
+weston_wm_window_apply_properties(struct weston_wm_window *window,
+				  xcb_get_property_cookie_t *cookie,
+				  xcb_get_property_reply_t **last_reply)
+{
+	struct weston_wm *wm = window->wm;
+	struct weston_wm_window_property props[WM_WINDOW_PROPERTY_COUNT];
+	xcb_get_property_reply_t *reply;
+	void *p;
+	uint32_t *xid;
+	xcb_atom_t *atom;
+	uint32_t i, j;
+	char name[1024];
+
+	weston_wm_window_get_property_table(window, props);
 
 	window->decorate = window->override_redirect ? 0 : MWM_DECOR_EVERYTHING;
 	window->size_hints.flags = 0;
@@ -550,7 +628,10 @@ weston_wm_window_read_properties(struct weston_wm_window *window)
 	window->delete_window = 0;
 
 	for (i = 0; i < ARRAY_LENGTH(props); i++)  {
-		reply = xcb_get_property_reply(wm->conn, cookie[i], NULL);
+		if (i == ARRAY_LENGTH(props) - 1 && last_reply)
+			reply = *last_reply;
+		else
+			reply = xcb_get_property_reply(wm->conn, cookie[i], NULL);
 		if (!reply)
 			/* Bad window, typically */
 			continue;
@@ -587,8 +668,8 @@ weston_wm_window_read_properties(struct weston_wm_window *window)
 			break;
 		case TYPE_WM_PROTOCOLS:
 			atom = xcb_get_property_value(reply);
-			for (i = 0; i < reply->value_len; i++)
-				if (atom[i] == wm->atom.wm_delete_window) {
+			for (j = 0; j < reply->value_len; j++)
+				if (atom[j] == wm->atom.wm_delete_window) {
 					window->delete_window = 1;
 					break;
 				}
@@ -601,12 +682,12 @@ weston_wm_window_read_properties(struct weston_wm_window *window)
 		case TYPE_NET_WM_STATE:
 			window->fullscreen = 0;
 			atom = xcb_get_property_value(reply);
-			for (i = 0; i < reply->value_len; i++) {
-				if (atom[i] == wm->atom.net_wm_state_fullscreen)
+			for (j = 0; j < reply->value_len; j++) {
+				if (atom[j] == wm->atom.net_wm_state_fullscreen)
 					window->fullscreen = 1;
-				if (atom[i] == wm->atom.net_wm_state_maximized_vert)
+				if (atom[j] == wm->atom.net_wm_state_maximized_vert)
 					window->maximized_vert = 1;
-				if (atom[i] == wm->atom.net_wm_state_maximized_horz)
+				if (atom[j] == wm->atom.net_wm_state_maximized_horz)
 					window->maximized_horz = 1;
 			}
 			break;
@@ -647,6 +728,103 @@ weston_wm_window_read_properties(struct weston_wm_window *window)
 	}
 }
 
+/** Complete the state requested by weston_wm_window_create()
+ *
+ * \param last_reply As for weston_wm_window_apply_properties()
+ */
+static void
+weston_wm_window_finish_create(struct weston_wm_window *window,
+			       xcb_get_property_reply_t **last_reply)
+{
+	xcb_get_geometry_reply_t *geometry_reply;
+
+	geometry_reply = xcb_get_geometry_reply(window->wm->conn,
+						window->geometry_cookie, NULL);
+	/* technically we should use XRender and check the visual format's
+	alpha_mask, but checking depth is simpler and works in all known cases */
+	if (geometry_reply != NULL)
+		window->has_alpha = geometry_reply->depth == 32;
+	free(geometry_reply);
+
+	weston_wm_window_apply_properties(window, window->property_cookie,
+					  last_reply);
+
+	window->create_pending = false;
+	wl_list_remove(&window->pending_link);
+}
+
+/** Complete windows whose initial replies have arrived
+ *
+ * Replies come in request order, so this stops at the first window still
+ * waiting. When the reply to the last request of a window is there, all
+ * of them are.
+ */
+static int
+weston_wm_process_pending_windows(struct weston_wm *wm)
+{
+	struct weston_wm_window *window, *tmp;
+	xcb_generic_error_t *error;
+	xcb_get_property_reply_t *reply;
+	unsigned int sequence;
+	int count = 0;
+
+	wl_list_for_each_safe(window, tmp, &wm->pending_window_list,
+			      pending_link) {
+		sequence =
+			window->property_cookie[WM_WINDOW_PROPERTY_COUNT - 1].sequence;
+
+		reply = NULL;
+		error = NULL;
+		if (!xcb_poll_for_reply(wm->conn, sequence, (void **) &reply,
+					&error))
+			break;
+
+		/* An error is typically BadWindow, for a window that is
+		 * already gone; the other replies are errors as well. */
+		free(error);
+
+		weston_wm_window_finish_create(window, &reply);
+		count++;
+	}
+
+	return count;
+}
+
+/* Complete the pending windows up to and including window. Their replies
+ * come before those of window, so this waits for no more than window's,
+ * and windows are still completed in the order they were created. */
+static void
+weston_wm_window_finish_pending(struct weston_wm_window *window)
+{
+	struct weston_wm *wm = window->wm;
+	struct weston_wm_window *pending, *tmp;
+
+	wl_list_for_each_safe(pending, tmp, &wm->pending_window_list,
+			      pending_link) {
+		weston_wm_window_finish_create(pending, NULL);
+		if (pending == window)
+			break;
+	}
+}
+
+static void
+weston_wm_window_read_properties(struct weston_wm_window *window)
+{
+	xcb_get_property_cookie_t cookie[WM_WINDOW_PROPERTY_COUNT];
+
+	/* The window is needed before the replies to its initial requests
+	 * were processed; wait for them. */
+	if (window->create_pending)
+		weston_wm_window_finish_pending(window);
+
+	if (!window->properties_dirty)
+		return;
+	window->properties_dirty = 0;
+
+	weston_wm_window_request_properties(window, cookie);
+	weston_wm_window_apply_properties(window, cookie, NULL);
+}
+
 #undef TYPE_WM_PROTOCOLS
 #undef TYPE_MOTIF_WM_HINTS
 #undef TYPE_NET_WM_STATE
@@ -1264,6 +1442,263 @@ weston_wm_handle_unmap_notify(struct weston_wm *wm, xcb_generic_event_t *event)
 	xcb_unmap_window(wm->conn, window->frame_id);
 }
 
+static void
+weston_wm_decoration_destroy(struct weston_wm *wm,
+			     struct weston_wm_decoration *decoration)
+{
+	wl_list_remove(&decoration->link);
+	wm->decoration_cache_count--;
+	cairo_surface_destroy(decoration->surface);
+	free(decoration);
+}
+
+static void
+weston_wm_decoration_cache_release(struct weston_wm *wm)
+{
+	struct weston_wm_decoration *decoration, *tmp;
+
+	wl_list_for_each_safe(decoration, tmp, &wm->decoration_cache, link)
+		weston_wm_decoration_destroy(wm, decoration);
+}
+
+/* Returns the template for frames with the given flags, rendering it
+ * only if no window in that state has been drawn recently. The surface is
+ * owned by the cache. */
+static cairo_surface_t *
+weston_wm_window_get_decoration(struct weston_wm_window *window,
+				uint32_t flags)
+{
+	struct weston_wm *wm = window->wm;
+	struct weston_wm_decoration *decoration;
+	cairo_surface_t *surface;
+	cairo_t *cr;
+	int width, height;
+
+	wl_list_for_each(decoration, &wm->decoration_cache, link) {
+		if (decoration->flags == flags) {
+			wl_list_remove(&decoration->link);
+			wl_list_insert(&wm->decoration_cache,
+				       &decoration->link);
+			return decoration->surface;
+		}
+	}
+
+	width = WM_DECORATION_LEFT + WM_DECORATION_STRETCH +
+		WM_DECORATION_RIGHT;
+	height = WM_DECORATION_TOP + WM_DECORATION_STRETCH +
+		 WM_DECORATION_BOTTOM;
+	surface = cairo_surface_create_similar(window->cairo_surface,
+					       CAIRO_CONTENT_COLOR_ALPHA,
+					       width, height);
+	if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy(surface);
+		return NULL;
+	}
+
+	cr = cairo_create(surface);
+	if (flags & WM_DECORATION_SHADOW) {
+		render_shadow(cr, wm->theme->shadow,
+			      2, 2, width + 8, height + 8, 64, 64);
+	} else {
+		theme_render_frame_background(wm->theme, cr,
+					      width, height, flags);
+	}
+	cairo_destroy(cr);
+
+	decoration = zalloc(sizeof *decoration);
+	if (!decoration) {
+		cairo_surface_destroy(surface);
+		return NULL;
+	}
+	decoration->flags = flags;
+	decoration->surface = surface;
+	wl_list_insert(&wm->decoration_cache, &decoration->link);
+	wm->decoration_cache_count++;
+
+	if (wm->decoration_cache_count > WM_DECORATION_CACHE_SIZE) {
+		decoration = container_of(wm->decoration_cache.prev,
+					  struct weston_wm_decoration, link);
+		weston_wm_decoration_destroy(wm, decoration);
+	}
+
+	return surface;
+}
+
+/* Paints the background of a width x height frame with the given flags
+ * from its cached template. Returns false, leaving cr untouched, if the
+ * frame is too small to be composed or the template can't be rendered;
+ * the caller then renders the background directly. */
+static bool
+weston_wm_window_paint_decoration(struct weston_wm_window *window,
+				  cairo_t *cr, int width, int height,
+				  uint32_t flags)
+{
+	cairo_surface_t *template, *piece;
+	cairo_pattern_t *pattern;
+	int sx[3], sw[3], dx[3], dw[3];
+	int sy[3], sh[3], dy[3], dh[3];
+	int i, j;
+
+	if (width < WM_DECORATION_LEFT + WM_DECORATION_STRETCH +
+		    WM_DECORATION_RIGHT ||
+	    height < WM_DECORATION_TOP + WM_DECORATION_STRETCH +
+		     WM_DECORATION_BOTTOM)
+		return false;
+
+	template = weston_wm_window_get_decoration(window, flags);
+	if (!template)
+		return false;
+
+	sx[0] = 0;
+	sw[0] = WM_DECORATION_LEFT;
+	sx[1] = WM_DECORATION_LEFT + WM_DECORATION_STRETCH / 2;
+	sw[1] = 1;
+	sx[2] = WM_DECORATION_LEFT + WM_DECORATION_STRETCH;
+	sw[2] = WM_DECORATION_RIGHT;
+	dx[0] = 0;
+	dw[0] = WM_DECORATION_LEFT;
+	dx[1] = WM_DECORATION_LEFT;
+	dw[1] = width - WM_DECORATION_LEFT - WM_DECORATION_RIGHT;
+	dx[2] = width - WM_DECORATION_RIGHT;
+	dw[2] = WM_DECORATION_RIGHT;
+
+	sy[0] = 0;
+	sh[0] = WM_DECORATION_TOP;
+	sy[1] = WM_DECORATION_TOP + WM_DECORATION_STRETCH / 2;
+	sh[1] = 1;
+	sy[2] = WM_DECORATION_TOP + WM_DECORATION_STRETCH;
+	sh[2] = WM_DECORATION_BOTTOM;
+	dy[0] = 0;
+	dh[0] = WM_DECORATION_TOP;
+	dy[1] = WM_DECORATION_TOP;
+	dh[1] = height - WM_DECORATION_TOP - WM_DECORATION_BOTTOM;
+	dy[2] = height - WM_DECORATION_BOTTOM;
+	dh[2] = WM_DECORATION_BOTTOM;
+
+	cairo_save(cr);
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	for (j = 0; j < 3; j++) {
+		for (i = 0; i < 3; i++) {
+			/* Pieces of one pixel are padded out to the whole
+			 * edge or middle they cover */
+			piece = cairo_surface_create_for_rectangle(template,
+								   sx[i], sy[j],
+								   sw[i], sh[j]);
+			pattern = cairo_pattern_create_for_surface(piece);
+			cairo_pattern_set_extend(pattern, CAIRO_EXTEND_PAD);
+			cairo_pattern_set_filter(pattern, CAIRO_FILTER_NEAREST);
+			cairo_surface_destroy(piece);
+
+			cairo_identity_matrix(cr);
+			cairo_translate(cr, dx[i], dy[j]);
+			cairo_set_source(cr, pattern);
+			cairo_rectangle(cr, 0, 0, dw[i], dh[j]);
+			cairo_fill(cr);
+			cairo_pattern_destroy(pattern);
+		}
+	}
+	cairo_restore(cr);
+
+	return true;
+}
+
+static void
+weston_wm_title_layer_release(struct weston_wm_title_layer *layer)
+{
+	if (layer->surface)
+		cairo_surface_destroy(layer->surface);
+	free(layer->title);
+	memset(layer, 0, sizeof *layer);
+}
+
+/* Returns the title text rendered for the current frame state, positioned
+ * at the title rectangle, or NULL when there is nothing to draw. Each
+ * window keeps one layer per focus state so focus changes only recompose. */
+static cairo_surface_t *
+weston_wm_window_get_title_layer(struct weston_wm_window *window,
+				 uint32_t flags, int32_t *x, int32_t *y)
+{
+	struct weston_wm_title_layer *layer;
+	int32_t rx, ry, rw, rh;
+	cairo_surface_t *surface;
+	cairo_t *cr;
+
+	if (!window->name || (flags & THEME_FRAME_NO_TITLE))
+		return NULL;
+
+	frame_title_rect(window->frame, &rx, &ry, &rw, &rh);
+	if (rw <= 0 || rh <= 0)
+		return NULL;
+
+	*x = rx;
+	*y = ry;
+
+	layer = &window->title_layer[!!(flags & THEME_FRAME_ACTIVE)];
+	if (layer->surface && layer->flags == flags &&
+	    layer->frame_width == frame_width(window->frame) &&
+	    layer->x == rx && layer->y == ry &&
+	    layer->width == rw && layer->height == rh &&
+	    strcmp(layer->title, window->name) == 0)
+		return layer->surface;
+
+	weston_wm_title_layer_release(layer);
+
+	surface = cairo_surface_create_similar(window->cairo_surface,
+					       CAIRO_CONTENT_COLOR_ALPHA,
+					       rw, rh);
+	if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy(surface);
+		return NULL;
+	}
+
+	cr = cairo_create(surface);
+	cairo_translate(cr, -rx, -ry);
+	frame_repaint_title(window->frame, cr);
+	cairo_destroy(cr);
+
+	layer->title = strdup(window->name);
+	if (!layer->title) {
+		cairo_surface_destroy(surface);
+		return NULL;
+	}
+	layer->surface = surface;
+	layer->flags = flags;
+	layer->frame_width = frame_width(window->frame);
+	layer->x = rx;
+	layer->y = ry;
+	layer->width = rw;
+	layer->height = rh;
+
+	return surface;
+}
+
+static void
+weston_wm_window_draw_frame(struct weston_wm_window *window, cairo_t *cr,
+			    int width, int height)
+{
+	cairo_surface_t *title;
+	uint32_t flags;
+	int32_t x, y;
+
+	frame_set_title(window->frame, window->name);
+	flags = frame_theme_flags(window->frame);
+
+	if (!weston_wm_window_paint_decoration(window, cr, width, height,
+					       flags))
+		frame_repaint_background(window->frame, cr);
+
+	title = weston_wm_window_get_title_layer(window, flags, &x, &y);
+	if (title) {
+		cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+		cairo_set_source_surface(cr, title, x, y);
+		cairo_paint(cr);
+	}
+
+	/* Buttons are small and track pointer hover, draw them every time */
+	frame_repaint_buttons(window->frame, cr);
+	frame_status_clear(window->frame, FRAME_STATUS_REPAINT);
+}
+
 static void
 weston_wm_window_draw_decoration(struct weston_wm_window *window)
 {
@@ -1281,16 +1716,19 @@ weston_wm_window_draw_decoration(struct weston_wm_window *window)
 		/* nothing */
 	} else if (window->decorate) {
 		how = "decorate";
-		frame_set_title(window->frame, window->name);
-		frame_repaint(window->frame, cr);
+		weston_wm_window_draw_frame(window, cr, width, height);
 	} else {
 		how = "shadow";
-		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
-		cairo_set_source_rgba(cr, 0, 0, 0, 0);
-		cairo_paint(cr);
-
-		render_shadow(cr, window->wm->theme->shadow,
-			      2, 2, width + 8, height + 8, 64, 64);
+		if (!weston_wm_window_paint_decoration(window, cr,
+						       width, height,
+						       WM_DECORATION_SHADOW)) {
+			cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+			cairo_set_source_rgba(cr, 0, 0, 0, 0);
+			cairo_paint(cr);
+
+			render_shadow(cr, window->wm->theme->shadow,
+				      2, 2, width + 8, height + 8, 64, 64);
+		}
 	}
 
 	wm_printf(window->wm, "XWM: draw decoration, win %d, %s\n",
@@ -1463,14 +1901,19 @@ weston_wm_handle_property_notify(struct weston_wm *wm, xcb_generic_event_t *even
 		weston_wm_window_schedule_repaint(window);
 }
 
+/** Track a new X11 window
+ *
+ * The geometry and property requests are not waited for here: the replies
+ * are collected by weston_wm_process_pending_windows() as they arrive, or
+ * waited for by weston_wm_window_read_properties() if the window is needed
+ * earlier. Creating a window costs no round-trip.
+ */
 static void
 weston_wm_window_create(struct weston_wm *wm,
 			xcb_window_t id, int width, int height, int x, int y, int override)
 {
 	struct weston_wm_window *window;
 	uint32_t values[1];
-	xcb_get_geometry_cookie_t geometry_cookie;
-	xcb_get_geometry_reply_t *geometry_reply;
 
 	window = zalloc(sizeof *window);
 	if (window == NULL) {
@@ -1478,7 +1921,7 @@ weston_wm_window_create(struct weston_wm *wm,
 		return;
 	}
 
-	geometry_cookie = xcb_get_geometry(wm->conn, id);
+	window->geometry_cookie = xcb_get_geometry(wm->conn, id);
 
 	values[0] = XCB_EVENT_MASK_PROPERTY_CHANGE |
                     XCB_EVENT_MASK_FOCUS_CHANGE;
@@ -1486,7 +1929,6 @@ weston_wm_window_create(struct weston_wm *wm,
 
 	window->wm = wm;
 	window->id = id;
-	window->properties_dirty = 1;
 	window->override_redirect = override;
 	window->width = width;
 	window->height = height;
@@ -1497,12 +1939,10 @@ weston_wm_window_create(struct weston_wm *wm,
 	window->map_request_y = INT_MIN; /* out of range for valid positions */
 	weston_output_weak_ref_init(&window->legacy_fullscreen_output);
 
-	geometry_reply = xcb_get_geometry_reply(wm->conn, geometry_cookie, NULL);
-	/* technically we should use XRender and check the visual format's
-	alpha_mask, but checking depth is simpler and works in all known cases */
-	if (geometry_reply != NULL)
-		window->has_alpha = geometry_reply->depth == 32;
-	free(geometry_reply);
+	/* Any change after these requests marks the properties dirty */
+	weston_wm_window_request_properties(window, window->property_cookie);
+	window->create_pending = true;
+	wl_list_insert(wm->pending_window_list.prev, &window->pending_link);
 
 	hash_table_insert(wm->window_hash, id, window);
 }
@@ -1511,11 +1951,22 @@ static void
 weston_wm_window_destroy(struct weston_wm_window *window)
 {
 	struct weston_wm *wm = window->wm;
+	uint32_t i;
+
+	if (window->create_pending) {
+		xcb_discard_reply(wm->conn, window->geometry_cookie.sequence);
+		for (i = 0; i < WM_WINDOW_PROPERTY_COUNT; i++)
+			xcb_discard_reply(wm->conn,
+					  window->property_cookie[i].sequence);
+		wl_list_remove(&window->pending_link);
+	}
 
 	weston_output_weak_ref_clear(&window->legacy_fullscreen_output);
 
 	if (window->repaint_source)
 		wl_event_source_remove(window->repaint_source);
+	weston_wm_title_layer_release(&window->title_layer[0]);
+	weston_wm_title_layer_release(&window->title_layer[1]);
 	if (window->cairo_surface)
 		cairo_surface_destroy(window->cairo_surface);
 
@@ -2307,6 +2758,12 @@ weston_wm_handle_event(int fd, uint32_t mask, void *data)
 		count++;
 	}
 
+	count += weston_wm_process_pending_windows(wm);
+
+	/* this runs after every dispatch, so replies read from the
+	 * connection elsewhere are picked up too */
+	count += weston_wm_poll_selection_property(wm);
+
 	if (count != 0)
 		xcb_flush(wm->conn);
 
@@ -2585,6 +3042,7 @@ weston_wm_create(struct weston_xserver *wxs, int fd)
 	wl_event_source_check(wm->source);
 
 	weston_wm_get_resources(wm);
+	TL_POINT(wxs->compositor, "xwm_resources", TLP_END);
 	weston_wm_get_visual_and_colormap(wm);
 
 	values[0] =
@@ -2631,8 +3089,11 @@ weston_wm_create(struct weston_xserver *wxs, int fd)
 	wl_signal_add(&wxs->compositor->kill_signal,
 		      &wm->kill_listener);
 	wl_list_init(&wm->unpaired_window_list);
+	wl_list_init(&wm->pending_window_list);
+	wl_list_init(&wm->decoration_cache);
 
 	weston_wm_create_cursors(wm);
+	TL_POINT(wxs->compositor, "xwm_cursors", TLP_END);
 	weston_wm_window_set_cursor(wm, wm->screen->root, XWM_CURSOR_LEFT_PTR);
 
 	/* Create wm window and take WM_S0 selection last, which
@@ -2649,10 +3110,12 @@ weston_wm_destroy(struct weston_wm *wm)
 {
 	/* FIXME: Free windows in hash. */
 	hash_table_destroy(wm->window_hash);
+	weston_wm_decoration_cache_release(wm);
 	weston_wm_destroy_cursors(wm);
 	xcb_disconnect(wm->conn);
 	wl_event_source_remove(wm->source);
 	wl_list_remove(&wm->selection_listener.link);
+	wl_array_release(&wm->source_data);
 	wl_list_remove(&wm->activate_listener.link);
 	wl_list_remove(&wm->kill_listener.link);
 	wl_list_remove(&wm->create_surface_listener.link);
@@ -52,6 +52,7 @@ struct weston_xserver {
 	struct wl_listener destroy_listener;
 	weston_xwayland_spawn_xserver_func_t spawn_func;
 	void *user_data;
+	struct timespec spawn_time;
 
 	struct weston_log_scope *wm_debug;
 };
@@ -75,6 +76,9 @@ struct weston_wm {
 	struct wl_listener activate_listener;
 	struct wl_listener kill_listener;
 	struct wl_list unpaired_window_list;
+	struct wl_list pending_window_list; /* weston_wm_window::pending_link */
+	struct wl_list decoration_cache; /* weston_wm_decoration::link */
+	int decoration_cache_count;
 
 	xcb_window_t selection_window;
 	xcb_window_t selection_owner;
@@ -82,7 +86,10 @@ struct weston_wm {
 	int data_source_fd;
 	struct wl_event_source *property_source;
 	xcb_get_property_reply_t *property_reply;
+	xcb_get_property_cookie_t property_cookie;
+	int property_cookie_pending;
 	int property_start;
+	uint32_t property_offset; /* in 32-bit units, for xcb_get_property */
 	struct wl_array source_data;
 	xcb_selection_request_event_t selection_request;
 	xcb_atom_t selection_target;
@@ -173,6 +180,8 @@ weston_wm_selection_init(struct weston_wm *wm);
 int
 weston_wm_handle_selection_event(struct weston_wm *wm,
 				 xcb_generic_event_t *event);
+int
+weston_wm_poll_selection_property(struct weston_wm *wm);
 
 struct weston_wm *
 weston_wm_create(struct weston_xserver *wxs, int fd);